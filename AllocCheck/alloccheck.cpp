@@ -0,0 +1,311 @@
+﻿// =============================
+//      alloccheck.cpp
+//      Date : 2026-10-17
+// =============================
+// 핫 패스 무할당 검사
+//  - GAC_ALLOC_TRACK=1 로 빌드해 전역 operator new 를 세면서 서버 파이프라인(core/pipeline.h)을 구동
+//  - 가상 클라이언트 N 명이 매 tick 오디오 프레임을 넣고(IngestFrame), 믹서 스레드가 RunMixerLoop 로
+//    믹싱 / 팬아웃, 공급 스레드가 송신 큐를 비운다(PopPacket / AccountSent)
+//  - 느린 클라이언트 하나는 가끔만 비워 MAX_QUEUE_FRAMES 초과 drop 경로도 지나가게 한다
+//  - 워밍업 이후 ingest / mix / fanout / send 경로에서 할당이 한 번이라도 일어나면 실패 (종료 코드 1)
+//  - 시계는 VirtualClock (core/pipeline_harness.h, Soak 과 같은 구동) 이라 수천 tick 도 금방 끝난다
+//  - 이어서 governor tick 환산 검사 : 실제 tick 하나 뒤 빈 확인 N 번을 번갈아 돌려
+//    단계별 tick 합이 가상 경과 시간 / MIX_TICK_MS 와 맞지 않으면 실패
+//  - 마지막으로 ClientSlots (core/client_slots.h) 검사 : 가장 낮은 슬롯 재사용, 훑는 범위 축소, 가득 찼을 때 거부
+//
+//  사용법 : AllocCheck.exe [--clients N] [--warmup N] [--ticks N] [--kernel scalar|sse2|avx2]
+// =============================
+#define GAC_ALLOC_TRACK 1
+#include "../core/core.h"
+#include "../core/pipeline_harness.h"
+#include <cmath>
+#include <memory>
+
+#define CHECK_SLOW_DRAIN_TICKS (MAX_QUEUE_FRAMES * 2)	// 느린 클라이언트는 이 tick 마다 한 번만 비운다
+#define CHECK_DTX_PERIOD 50							// 클라이언트마다 이 주기로 DTX 제어 프레임
+#define CHECK_GOV_CYCLES 200							// governor 검사 : 빈 확인 수마다 돌리는 주기 수
+#define CHECK_GOV_LEAD_MS 2								// governor 검사 : 믹서 확인 시각보다 이만큼 먼저 넣는다 (< MIX_IDLE_MS)
+
+struct CheckConfig
+{
+    int clients = 64;
+    int warmupTicks = 200;
+    int ticks = 2000;
+    int kernel = -1;                        // -1 이면 BestMixKernel
+};
+
+static bool ParseArgs(int argc, char* argv[], CheckConfig& cfg)
+{
+    return parseArgPairs(argc, argv, [&](const std::string& a, const std::string& v)
+    {
+        if (a == "--clients") cfg.clients = (std::min)((std::max)(2, std::stoi(v)), CLIENT_SLOT_MAX);
+        else if (a == "--warmup") cfg.warmupTicks = (std::max)(1, std::stoi(v));
+        else if (a == "--ticks") cfg.ticks = (std::max)(1, std::stoi(v));
+        else if (a == "--kernel")
+        {
+            for (int n = 0; n < MIX_KERNEL_COUNT; n++)
+            {
+                if (v == GetMixKernel((MixKernelKind)n).name)
+                    cfg.kernel = n;
+            }
+            return cfg.kernel >= 0;
+        }
+        else return false;
+        return true;
+    });
+}
+
+// -------------------------------------------
+// governor tick 환산 검사
+//  - 공급자가 MIX_TICK_MS + N * MIX_IDLE_MS 마다 프레임 하나를 넣으면 믹서는 실제 tick 하나, 빈 확인 N 번을 되풀이한다
+//  - 그동안 단계별 tick 합 (gac_governor_level_ticks_total) 이 경과 / MIX_TICK_MS 에서 1 넘게 벗어나면 실패
+//    (실제 tick 뒤 대기를 쉬는 시간으로 다시 세거나 빈 확인을 tick 으로 세면 주기마다 어긋남이 쌓인다)
+// -------------------------------------------
+static uint64_t GovernorTicks()
+{
+    uint64_t n = 0;
+    for (int l = 0; l < GOV_LEVEL_COUNT; l++)
+        n += gMixGovernor.TicksAt(l);
+    return n;
+}
+
+static bool CheckGovernorTicks(const MixKernelOps& mix)
+{
+    static const int kIdlePolls[] = { 0, 1, 6, 20 };   // 20 : 클라이언트 프레임 (120ms) 하나에 tick 하나
+
+    gMixGovernor.Configure(true, MIX_TICK_MS * 1000000LL, GOV_SPEAKER_CAP_DEFAULT);
+    const std::vector<std::vector<char>> tone = makeToneFrames(1, 150.0, 0.0);
+    auto cli = std::make_shared<ClientInfo>();
+    cli->id = 1;
+    if (!AttachClient(cli))
+    {
+        std::cout << "[alloccheck] governor 검사 : 슬롯 부족" << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    {
+        VirtualPipeline pipeline;
+        pipeline.Start(mix);
+
+        // 믹서는 0, MIX_IDLE_MS, ... 에 확인하므로 그 사이에 넣어 순서가 가상 시각 동률에 맡겨지지 않게 한다
+        pipeline.SleepForMs(CHECK_GOV_LEAD_MS);
+        IngestFrame(*cli, tone[0].data(), AUDIO_BUFFER_SIZE, pipeline.NowNs());
+
+        for (int polls : kIdlePolls)
+        {
+            const int periodMs = MIX_TICK_MS + polls * MIX_IDLE_MS;
+            const int64_t startNs = pipeline.NowNs();
+            const uint64_t startTicks = GovernorTicks();
+            for (int c = 0; c < CHECK_GOV_CYCLES; c++)
+            {
+                pipeline.SleepForMs(periodMs);
+                drainClient(*cli);
+                IngestFrame(*cli, tone[0].data(), AUDIO_BUFFER_SIZE, pipeline.NowNs());
+            }
+
+            const double expected = (double)(pipeline.NowNs() - startNs) / (MIX_TICK_MS * 1000000.0);
+            const uint64_t counted = GovernorTicks() - startTicks;
+            const bool match = std::fabs((double)counted - expected) <= 1.0;
+            ok &= match;
+
+            char line[160];
+            snprintf(line, sizeof(line), "[alloccheck]   governor 빈 확인 %2d  경과 %8.1f tick  집계 %8llu tick  %s",
+                polls, expected, (unsigned long long)counted, match ? "ok" : "실패");
+            std::cout << line << std::endl;
+        }
+        pipeline.Stop();
+    }
+
+    DeactivateClient(*cli);
+    ClearClientQueue(*cli);
+    DetachClient(cli);
+    gMixGovernor.Configure(false, MIX_TICK_MS * 1000000LL, GOV_SPEAKER_CAP_DEFAULT);
+    return ok;
+}
+
+// -------------------------------------------
+// ClientSlots 검사 (gClientSlots 와 따로 만든 인스턴스, 스레드 없음)
+// -------------------------------------------
+static bool ExpectSlots(bool cond, const char* what)
+{
+    if (!cond)
+        std::cout << "[alloccheck]   slots 실패 : " << what << std::endl;
+    return cond;
+}
+
+static bool CheckClientSlots()
+{
+    static ClientSlots instance;                // 캐시 라인 정렬 배열이라 힙 (C++14 new) 대신 정적
+    ClientSlots* slots = &instance;
+    bool ok = true;
+
+    // 1. 빈 곳부터 차례로, 해제한 슬롯은 가장 낮은 번호부터 다시 쓴다
+    ok &= ExpectSlots(slots->Acquire(nullptr, 1) == 0 && slots->Acquire(nullptr, 2) == 1 && slots->Acquire(nullptr, 3) == 2,
+        "처음 배정이 0, 1, 2 가 아님");
+    slots->Release(1);
+    ok &= ExpectSlots(slots->End() == 3, "가운데 해제 뒤 범위가 3 이 아님");
+    ok &= ExpectSlots(slots->Acquire(nullptr, 4) == 1 && slots->Id(1) == 4, "해제한 1 번을 다시 쓰지 않음");
+
+    // 2. 끝에서부터 비면 훑는 범위가 줄어든다 (가운데 빈 칸은 건너뛰고)
+    slots->Release(1);
+    slots->Release(2);
+    ok &= ExpectSlots(slots->End() == 1, "끝 해제 뒤 범위가 1 로 줄지 않음");
+    slots->Release(0);
+    ok &= ExpectSlots(slots->End() == 0, "모두 해제 뒤 범위가 0 이 아님");
+
+    // 3. 플래그 : 배정하면 ACTIVE 만, Set / Clear / Count
+    const uint32_t a = slots->Acquire(nullptr, 5);
+    slots->Set(a, SLOT_TALKING);
+    ok &= ExpectSlots(slots->Flags(a) == (SLOT_ACTIVE | SLOT_TALKING) && slots->Count(SLOT_TALKING) == 1, "플래그 설정");
+    slots->Clear(a, SLOT_TALKING);
+    ok &= ExpectSlots(slots->Count(SLOT_TALKING) == 0 && slots->Count(SLOT_ACTIVE) == 1, "플래그 해제");
+    slots->Release(a);
+    ok &= ExpectSlots(slots->Flags(a) == 0, "해제한 슬롯에 플래그가 남음");
+
+    // 4. 가득 차면 CLIENT_SLOT_NONE, 하나 비우면 그 자리
+    bool sequential = true;
+    for (uint32_t i = 0; i < CLIENT_SLOT_MAX; i++)
+        sequential &= slots->Acquire(nullptr, i + 1) == i;
+    ok &= ExpectSlots(sequential && slots->End() == CLIENT_SLOT_MAX, "가득 채울 때 순서대로 배정되지 않음");
+    ok &= ExpectSlots(slots->Acquire(nullptr, 0) == CLIENT_SLOT_NONE, "가득 찬 뒤에도 배정됨");
+    slots->Release(CLIENT_SLOT_MAX / 2 + 3);
+    ok &= ExpectSlots(slots->Acquire(nullptr, 0) == CLIENT_SLOT_MAX / 2 + 3, "가득 찬 상태에서 비운 자리를 다시 쓰지 않음");
+    slots->Release(CLIENT_SLOT_MAX - 1);
+    ok &= ExpectSlots(slots->End() == CLIENT_SLOT_MAX - 1, "마지막 해제 뒤 범위가 줄지 않음");
+
+    std::cout << "[alloccheck]   slots    재사용 / 범위 / 상한 " << (ok ? "ok" : "실패") << std::endl;
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    CheckConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : AllocCheck.exe [--clients N] [--warmup N] [--ticks N] [--kernel scalar|sse2|avx2]" << std::endl;
+        return 1;
+    }
+
+    const MixKernelKind kind = cfg.kernel >= 0 ? (MixKernelKind)cfg.kernel : BestMixKernel();
+    if (!MixKernelSupported(kind))
+    {
+        std::cerr << "[alloccheck] 이 CPU 에서 지원하지 않는 커널: " << GetMixKernel(kind).name << std::endl;
+        return 1;
+    }
+    const MixKernelOps& mix = GetMixKernel(kind);
+
+    // 입력 : 클라이언트마다 다른 톤 한 프레임, DTX 제어 프레임 (루프 밖에서 한 번만 만든다)
+    const std::vector<std::vector<char>> tones = makeToneFrames(cfg.clients, 150.0, 1.0);
+    const HarnessCtrlFrame dtx = makeDtxFrame();
+
+    VirtualPipeline pipeline;
+
+    // 락 프로파일 경로도 같이 검사 (서버 --lock-profile)
+    gLockProfileEnabled = true;
+
+    std::vector<std::shared_ptr<ClientInfo>> clients;
+    for (int c = 0; c < cfg.clients; c++)
+    {
+        auto cli = std::make_shared<ClientInfo>();
+        cli->id = (uint32_t)(c + 1);
+        if (!AttachClient(cli))
+        {
+            std::cerr << "[alloccheck] 슬롯 부족 : 클라이언트 " << c << " 명에서 접속 거부 (최대 " << CLIENT_SLOT_MAX << "명)" << std::endl;
+            return 1;
+        }
+        clients.push_back(cli);
+    }
+
+    std::cout << "[alloccheck] 클라이언트 " << cfg.clients << " / 워밍업 " << cfg.warmupTicks
+        << " tick / 측정 " << cfg.ticks << " tick / 커널 " << mix.name << std::endl;
+
+    uint64_t before[HOT_PATH_COUNT] = {};
+    uint64_t after[HOT_PATH_COUNT] = {};
+    AllocCounts totalBefore, totalAfter;
+
+    pipeline.Start(mix);
+    const int total = cfg.warmupTicks + cfg.ticks;
+    for (int tick = 0; tick < total; tick++)
+    {
+        if (tick == cfg.warmupTicks)
+        {
+            for (int p = 0; p < HOT_PATH_COUNT; p++)
+                before[p] = gHotPathAllocs[p].load();
+            totalBefore = allocTotalCounts();
+        }
+
+        for (int c = 0; c < cfg.clients; c++)
+        {
+            ClientInfo& cli = *clients[c];
+            if ((tick + c) % CHECK_DTX_PERIOD == 0)
+                IngestFrame(cli, dtx.data, dtx.len, pipeline.NowNs());
+            else
+                IngestFrame(cli, tones[c].data(), AUDIO_BUFFER_SIZE, pipeline.NowNs());
+        }
+
+        pipeline.Tick();
+
+        // 0 번은 느린 클라이언트 : 송신 큐가 차서 팬아웃이 오래된 패킷을 버린다
+        for (int c = 1; c < cfg.clients; c++)
+            drainClient(*clients[c]);
+        if (tick % CHECK_SLOW_DRAIN_TICKS == 0)
+            drainClient(*clients[0]);
+    }
+
+    for (int p = 0; p < HOT_PATH_COUNT; p++)
+        after[p] = gHotPathAllocs[p].load();
+    totalAfter = allocTotalCounts();
+
+    pipeline.Stop();
+
+    for (auto& cli : clients)
+    {
+        DeactivateClient(*cli);
+        ClearClientQueue(*cli);
+        DetachClient(cli);
+    }
+
+    std::vector<uint64_t> counters;
+    gCounters.Sum(counters, CNT_COUNT);
+    std::cout << "[alloccheck] tick " << counters[CNT_MIX_TICKS] << " / 믹싱 프레임 " << counters[CNT_FRAMES_MIXED]
+        << " / 송신 " << counters[CNT_FRAMES_SENT] << " / drop " << counters[CNT_FRAMES_DROPPED]
+        << " / 풀 밖 믹스 버퍼 " << counters[CNT_MIX_POOL_MISSES] << std::endl;
+
+    bool failed = false;
+    for (int p = 0; p < HOT_PATH_COUNT; p++)
+    {
+        const uint64_t warm = before[p];
+        const uint64_t steady = after[p] - before[p];
+        if (steady)
+            failed = true;
+
+        char line[160];
+        snprintf(line, sizeof(line), "[alloccheck]   %-8s 워밍업 %8llu  측정 %8llu  %s",
+            kHotPathNames[p], (unsigned long long)warm, (unsigned long long)steady, steady ? "실패" : "ok");
+        std::cout << line << std::endl;
+    }
+    std::cout << "[alloccheck] 측정 구간 프로세스 전체 할당 " << (totalAfter.allocs - totalBefore.allocs)
+        << " 회 (" << (totalAfter.bytes - totalBefore.bytes) << " 바이트, 핫 패스 밖 포함)" << std::endl;
+
+    if (failed)
+    {
+        std::cout << "[alloccheck] 실패 : 워밍업 후 핫 패스에서 힙 할당" << std::endl;
+        return 1;
+    }
+
+    if (!CheckGovernorTicks(mix))
+    {
+        std::cout << "[alloccheck] 실패 : governor tick 수가 경과 시간과 다름" << std::endl;
+        return 1;
+    }
+
+    if (!CheckClientSlots())
+    {
+        std::cout << "[alloccheck] 실패 : ClientSlots 배정 / 해제" << std::endl;
+        return 1;
+    }
+
+    std::cout << "[alloccheck] 통과" << std::endl;
+    return 0;
+}
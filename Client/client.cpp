@@ -4,13 +4,41 @@
 //      Author : Dev.seunhak
 // =============================
 #include "../core/core.h"
+#include "../core/calibration.h"
+#include "../core/client_stats.h"
+#include "../core/echo.h"
+#include "../core/histogram.h"
+#include "../core/marker.h"
+#include "../core/spsc_ring.h"
+#include "../core/time_sync.h"
+#include "../core/vad.h"
+#include <algorithm>
 #include <csignal>
+#include <memory>
 #include <mmreg.h>
 
 #define SAMPLE_RATE 16000
 #define CHANNELS 1
 #define BITS_PER_SAMPLE 16
 
+// ───────────────────────────────
+// 파이프라인 상수
+// ───────────────────────────────
+#define CLIENT_RING_FRAMES 64               // 방향별 프레임 풀 크기 (2의 거듭제곱)
+#define CAPTURE_BUFFERS 4                       // waveIn 에 동시에 물려 두는 버퍼 수
+#define PLAYBACK_BUFFERS 4                     // waveOut 에 동시에 물려 두는 버퍼 수
+#define WAIT_SLICE_MS 100                        // 종료 플래그 확인 주기
+#define SEND_BACKLOG_FRAMES 12              // 송신 대기 허용량 (pre-roll 버스트 포함), 초과분은 오래된 것부터 drop
+
+// ───────────────────────────────
+// VAD / DTX 설정
+//   - 무음 구간에는 오디오를 보내지 않고 DTX 마커만 주기적으로 보낸다
+//   - 프레임 길이(ms)는 캡처 형식에서 계산
+// ───────────────────────────────
+#define FRAME_MS (AUDIO_BUFFER_SIZE * 1000.0f / (SAMPLE_RATE * CHANNELS * BITS_PER_SAMPLE / 8))
+#define MAX_PREROLL_FRAMES 8                // pre-roll 보관 상한
+#define DTX_INTERVAL_MS 1000                   // 무음 중 DTX 마커 재전송 주기
+
 // ───────────────────────────────
 // 글로벌 상태 변수
 // ───────────────────────────────
@@ -18,30 +46,66 @@ static std::atomic<bool> gRunning{ true };                  // 전체 실행 여
 static SOCKET gSock = INVALID_SOCKET;                   // 서버와의 TCP 소켓
 static HWAVEIN gWaveIn = nullptr;                             // 캡처 장치의 핸들러
 static HWAVEOUT gWaveOut = nullptr;                       // 재생 장치의 핸들러
+static bool gVadEnabled = true;                                 // --no-vad 로 끌 수 있음 (항상 송신)
+
+// ───────────────────────────────
+// 송신 채널 (CaptureThread → NetThread)
+//   - 락 없는 SPSC 링 + 프레임 풀 (프레임당 힙 할당 없음)
+//   - 네트워크 측이 밀려 풀이 바닥나면 캡처 측에서 새 프레임을 drop
+// ───────────────────────────────
+static FrameChannel<CLIENT_RING_FRAMES> gSendChannel;
+static std::atomic<size_t> gSendDropped{ 0 };
+
+// ───────────────────────────────
+// 재생 채널 (NetThread → PlaybackThread)
+//   - NetThread 는 네트워크에서 받은 프레임을 바로 풀 프레임에 수신
+//   - PlaybackThread 가 waveOutWrite 를 수행하고, 재생이 끝나면 풀에 반납
+//   - waveOutWrite 가 내부적으로 대기해도 NetThread 가 막히지 않음
+// ───────────────────────────────
+static FrameChannel<CLIENT_RING_FRAMES> gPlayChannel;
+static std::atomic<size_t> gPlayDropped{ 0 };
+
+// ───────────────────────────────
+// 단계별 지연 (ns, client_stats.h 의 ClientStage 순서)
+//   - 프레임에 찍은 originNs / queuedNs 로 각 스레드가 자기 단계를 기록 (기록 시 락 없음)
+//   - NetThread 가 CLIENT_REPORT_SEC 마다 구간 분포를 서버에 보고, 종료 시 누적 분포 출력
+//   - DTX 마커 / 보고 프레임은 재지 않는다 (originNs = 0)
+// ───────────────────────────────
+static LatencyHistogram gClientStageHist[CSTAGE_COUNT] = {
+    { "capture_gate" },
+    { "send_queue_wait" },
+    { "send" },
+    { "recv_enqueue" },
+    { "play_queue_wait" },
+    { "device_play" },
+    { "send_total" },
+    { "play_total" },
+};
+
+static void RecordStage(ClientStage stage, const AudioFrame& f, int64_t fromNs, int64_t toNs)
+{
+    if (f.originNs != 0 && toNs >= fromNs)
+        gClientStageHist[stage].Record((uint64_t)(toNs - fromNs));
+}
 
 // ───────────────────────────────
-// 송신 큐 (캡처 → 네트워크 송신 파이프라인)
+// 서버 시계 동기화 (time_sync.h)
+//   - NetThread 가 ping 을 보내고 pong 으로 gClockSync 를 갱신 (NetThread 전용)
+//   - 다른 스레드(재생 정렬 등)는 gServerClockOffsetNs 만 읽는다 (서버 시계 - 로컬 시계, 동기화 전 0)
 // ───────────────────────────────
-static std::mutex gSendMutex;
-static std::condition_variable gSendCV;
-static std::queue<std::shared_ptr<std::vector<char>>> gSendQueue;
-static std::atomic<size_t> gSendQueueFrames{ 0 };
-        //static std::queue<std::vector<char>> gSendQueue;
-        // 백프레셔 카운터
-        //static size_t gSendQueuedFrames = 0;
+static ClockSync gClockSync;
+static std::atomic<bool> gClockSynced{ false };
+static std::atomic<int64_t> gServerClockOffsetNs{ 0 };
 
 // ───────────────────────────────
-// 재생 큐 (수신 → 오디오 출력 파이프라인)
-//   - RecvThread 는 네트워크에서 받은 프레임을 빠르게 push
-//   - 별도의 PlaybackThread 가 waveOutWrite 를 수행
-//   - waveOutWrite 가 내부적으로 대기해도 RecvThread 가 막히지 않음
+// 스레드 깨우기 이벤트 (auto-reset)
+//   - gSendEvent    : 캡처 → NetThread, 송신할 프레임 있음
+//   - gPlayEvent    : NetThread / waveOut 완료 → PlaybackThread
+//   - gCaptureEvent : waveIn 버퍼 완료 → CaptureThread
 // ───────────────────────────────
-static std::mutex gPlayMutex;
-static std::condition_variable gPlayCV;
-static std::queue<std::shared_ptr<std::vector<char>>> gPlayQueue;
-static std::atomic<size_t> gPlayQueuedFrames{ 0 };
-            //static std::queue<std::vector<char>> gPlayQueue;
-            //static size_t gPlayQueuedFrames = 0; // 백프레셔 카운트
+static HANDLE gSendEvent = nullptr;
+static HANDLE gPlayEvent = nullptr;
+static HANDLE gCaptureEvent = nullptr;
 
 // ───────────────────────────────
 // 시그널 처리
@@ -60,196 +124,840 @@ static void TuneSocket(SOCKET s)
     setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&sz, sizeof(sz));
 }
 
-bool InitCapture() {
-    WAVEFORMATEX wf{};
+static void FillWaveFormat(WAVEFORMATEX& wf)
+{
+    wf = WAVEFORMATEX{};
     wf.wFormatTag = WAVE_FORMAT_PCM;
     wf.nChannels = CHANNELS;
     wf.nSamplesPerSec = SAMPLE_RATE;
     wf.wBitsPerSample = BITS_PER_SAMPLE;
     wf.nBlockAlign = (wf.nChannels * wf.wBitsPerSample) / 8;
     wf.nAvgBytesPerSec = wf.nSamplesPerSec * wf.nBlockAlign;
+}
 
-    if (waveInOpen(&gWaveIn, WAVE_MAPPER, &wf, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+// 버퍼 완료 시 gCaptureEvent 가 signal 된다 (폴링 없음)
+bool InitCapture() {
+    WAVEFORMATEX wf;
+    FillWaveFormat(wf);
+
+    if (waveInOpen(&gWaveIn, WAVE_MAPPER, &wf, (DWORD_PTR)gCaptureEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
         return false;
 
-    waveInStart(gWaveIn);
     return true;
 }
-void CaptureAudio(char* buffer, size_t size) {
-    if (!gWaveIn) InitCapture();
-    static WAVEHDR header{};
-    header.lpData = buffer;
-    header.dwBufferLength = (DWORD)size;
-    header.dwFlags = 0;
-    header.dwLoops = 0;
-    waveInPrepareHeader(gWaveIn, &header, sizeof(header));
-    waveInAddBuffer(gWaveIn, &header, sizeof(header));
-
-    // 블로킹 대기 (간단 구현)
-    while (!(header.dwFlags & WHDR_DONE)) Sleep(1);
-
-    waveInUnprepareHeader(gWaveIn, &header, sizeof(header));
-}
 
+// 재생 완료 시 gPlayEvent 가 signal 된다
 bool InitPlayback() {
-    WAVEFORMATEX wf{};
-    wf.wFormatTag = WAVE_FORMAT_PCM;
-    wf.nChannels = CHANNELS;
-    wf.nSamplesPerSec = SAMPLE_RATE;
-    wf.wBitsPerSample = BITS_PER_SAMPLE;
-    wf.nBlockAlign = (wf.nChannels * wf.wBitsPerSample) / 8;
-    wf.nAvgBytesPerSec = wf.nSamplesPerSec * wf.nBlockAlign;
+    WAVEFORMATEX wf;
+    FillWaveFormat(wf);
 
-    if (waveOutOpen(&gWaveOut, WAVE_MAPPER, &wf, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+    if (waveOutOpen(&gWaveOut, WAVE_MAPPER, &wf, (DWORD_PTR)gPlayEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
         return false;
 
     return true;
 }
 
 // ───────────────────────────────
-// PlayAudio (멀티버퍼 + 백그라운드 재생)
+// 풀 프레임을 캡처 장치에 직접 물린다 (복사 없음)
 // ───────────────────────────────
-void PlayAudio(std::shared_ptr<std::vector<char>> frame)
+static void AttachCaptureBuffer(WAVEHDR& hdr, AudioFrame* frame)
 {
-    if (!gWaveOut) InitPlayback();
+    ZeroMemory(&hdr, sizeof(WAVEHDR));
+    hdr.lpData = frame->data;
+    hdr.dwBufferLength = AUDIO_BUFFER_SIZE;
+    waveInPrepareHeader(gWaveIn, &hdr, sizeof(WAVEHDR));
+    waveInAddBuffer(gWaveIn, &hdr, sizeof(WAVEHDR));
+}
 
-    WAVEHDR* hdr = new WAVEHDR();
-    ZeroMemory(hdr, sizeof(WAVEHDR));
-    hdr->lpData = (LPSTR)frame->data();
-    hdr->dwBufferLength = (DWORD)frame->size();
-    hdr->dwFlags = 0;
-    hdr->dwLoops = 0;
+// ───────────────────────────────
+// 캡처 게이트 (CaptureThread 전용)
+//  - VAD 판정 결과에 따라 송신 / pre-roll 보관 / DTX 마커 송신을 결정
+//  - pre-roll 프레임은 캡처 스레드가 소유하므로 풀 반납 없이 재사용 가능
+// ───────────────────────────────
+struct CaptureGate
+{
+    VoiceActivityDetector vad{ FRAME_MS };
+    AudioFrame* preroll[MAX_PREROLL_FRAMES] = {};      // 오래된 순서
+    int prerollCount = 0;
+    int silentFrames = 0;                                             // 무음 시작 후 경과 프레임
+};
 
-    waveOutPrepareHeader(gWaveOut, hdr, sizeof(WAVEHDR));
-    waveOutWrite(gWaveOut, hdr, sizeof(WAVEHDR));
+// 송신 채널 publish (캡처 완료 ~ publish 를 capture_gate 로 기록)
+static void PublishToSend(AudioFrame* f)
+{
+    f->queuedNs = nowNs();
+    RecordStage(CSTAGE_CAPTURE_GATE, *f, f->originNs, f->queuedNs);
+    gSendChannel.Publish(f);
+}
 
-    // 재생 완료 후 메모리 해제
-    std::thread([hdr]()
-        {
-            while (!(hdr->dwFlags & WHDR_DONE)) Sleep(2);
-            waveOutUnprepareHeader(gWaveOut, hdr, sizeof(WAVEHDR));
-            delete hdr;
-        }).detach();
+static void SendDtxMarker(float noiseDb)
+{
+    AudioFrame* f = gSendChannel.Acquire();
+    if (!f)
+        return;
+
+    f->len = buildDtxFrame(f->data, noiseDb);
+    f->originNs = 0;
+    PublishToSend(f);
+    SetEvent(gSendEvent);
+}
+
+// 완료된 프레임을 송신하고 다음 캡처에 쓸 프레임을 반환
+// 풀이 비었으면 (네트워크 측 밀림) 이번 프레임은 drop 하고 같은 버퍼를 재사용
+static AudioFrame* PublishCaptured(AudioFrame* done)
+{
+    AudioFrame* next = gSendChannel.Acquire();
+    if (!next)
+    {
+        gSendDropped++;
+        return done;
+    }
+
+    PublishToSend(done);
+    SetEvent(gSendEvent);
+    return next;
+}
+
+static AudioFrame* GateCapturedFrame(CaptureGate& g, AudioFrame* done)
+{
+    // 부분 프레임(장치 reset 등)은 보내지 않는다 : 오디오 프레임은 항상 AUDIO_BUFFER_SIZE
+    if (!isAudioFrame(done->len))
+        return done;
+
+    if (!gVadEnabled)
+        return PublishCaptured(done);
+
+    const bool talking = g.vad.Process((const int16_t*)done->data, done->len / sizeof(int16_t));
+
+    // 1. 음성 : 보관해 둔 pre-roll 을 시간 순서대로 먼저 보낸다
+    if (talking)
+    {
+        for (int k = 0; k < g.prerollCount; k++)
+            PublishToSend(g.preroll[k]);
+        g.prerollCount = 0;
+        g.silentFrames = 0;
+        return PublishCaptured(done);
+    }
+
+    // 2. 무음 : 음성 종료 직후와 DTX_INTERVAL_MS 마다 DTX 마커만 보낸다
+    const int dtxEvery = (std::max)(1, (int)(DTX_INTERVAL_MS / FRAME_MS));
+    if (g.silentFrames % dtxEvery == 0)
+        SendDtxMarker(g.vad.NoiseFloorDb());
+    g.silentFrames++;
+
+    // 3. pre-roll 보관 : 가득 차면 가장 오래된 프레임을 다음 캡처 버퍼로 재사용
+    const int cap = (std::min)(g.vad.PrerollFrames(), MAX_PREROLL_FRAMES);
+    if (cap <= 0)
+        return done;
+
+    AudioFrame* reuse = nullptr;
+    if (g.prerollCount < cap)
+        reuse = gSendChannel.Acquire();
+
+    if (!reuse)
+    {
+        if (g.prerollCount == 0)
+            return done;
+
+        reuse = g.preroll[0];
+        memmove(&g.preroll[0], &g.preroll[1], (g.prerollCount - 1) * sizeof(AudioFrame*));
+        g.prerollCount--;
+    }
+
+    g.preroll[g.prerollCount++] = done;
+    return reuse;
 }
 
 // ───────────────────────────────
-// 캡처 스레드 -> SendQueue
+// 캡처 스레드 -> SendChannel
+//  1. 풀 프레임 CAPTURE_BUFFERS 개를 waveIn 에 등록
+//  2. 완료된 버퍼는 캡처 게이트(VAD)를 거쳐 송신 채널에 publish 하고 새 풀 프레임으로 교체
 // ───────────────────────────────
 void CaptureThread()
 {
+    setThreadName("capture");
+    if (!InitCapture())
+    {
+        std::cerr << "[클라이언트] 캡처 장치 열기 실패" << std::endl;
+        return;
+    }
+
+    WAVEHDR headers[CAPTURE_BUFFERS] = {};
+    AudioFrame* frames[CAPTURE_BUFFERS] = {};
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    {
+        frames[i] = gSendChannel.Acquire();
+        AttachCaptureBuffer(headers[i], frames[i]);
+    }
+    waveInStart(gWaveIn);
+
+    CaptureGate gate;
+
     while (gRunning)
     {
-        std::vector<char> frame(AUDIO_BUFFER_SIZE);
-        CaptureAudio(frame.data(), frame.size());       // 사용자 캡처 함수
+        WaitForSingleObject(gCaptureEvent, WAIT_SLICE_MS);
+
+        for (int i = 0; i < CAPTURE_BUFFERS; i++)
+        {
+            WAVEHDR& hdr = headers[i];
+            if (!(hdr.dwFlags & WHDR_DONE))
+                continue;
+
+            waveInUnprepareHeader(gWaveIn, &hdr, sizeof(WAVEHDR));
+
+            AudioFrame* done = frames[i];
+            done->len = hdr.dwBytesRecorded;
+            done->originNs = nowNs();
+            frames[i] = GateCapturedFrame(gate, done);
+
+            AttachCaptureBuffer(hdr, frames[i]);
+        }
+    }
+
+    // 장치 정리 : reset 으로 모든 버퍼를 반환받은 뒤 해제
+    waveInStop(gWaveIn);
+    waveInReset(gWaveIn);
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+        waveInUnprepareHeader(gWaveIn, &headers[i], sizeof(WAVEHDR));
+    waveInClose(gWaveIn);
+    gWaveIn = nullptr;
+}
+
+// ───────────────────────────────
+// 수신 처리 (NetThread 전용)
+//  - 읽을 수 있는 만큼 프레임을 모두 처리한 뒤 반환
+//  - 재생 풀이 바닥나면 scratch 로 받아 버린다 (스트림 경계 유지)
+//  - 서버 제어 프레임(시계 동기화 pong)은 재생하지 않고 같은 프레임에 다음 프레임을 받는다
+// ───────────────────────────────
+struct NetRecvContext
+{
+    FrameRecvState st;
+    AudioFrame* frame = nullptr;        // 현재 수신 중인 풀 프레임 (nullptr 이면 scratch)
+    AudioFrame scratch;
+};
+
+static void HandleServerControl(const char* frame, uint32_t len, int64_t recvNs)
+{
+    uint16_t type = 0;
+    const char* payload = nullptr;
+    uint16_t payloadLen = 0;
+    if (!parseCtrlFrame(frame, len, type, payload, payloadLen))
+        return;
+
+    TimePong pong;
+    if (type == CTRL_TIME_PONG && parseTimePong(payload, payloadLen, pong)
+        && gClockSync.AddSample(pong.t1, pong.t2, pong.t3, recvNs))
+    {
+        gServerClockOffsetNs.store(gClockSync.OffsetNs(recvNs), std::memory_order_relaxed);
+        gClockSynced.store(true, std::memory_order_release);
+    }
+}
+
+static bool PumpRecv(NetRecvContext& rx)
+{
+    for (;;)
+    {
+        AudioFrame* dst = rx.frame ? rx.frame : &rx.scratch;
+        int r = recvFrameNB(gSock, rx.st, dst->data, AUDIO_BUFFER_SIZE);
+        if (r == FRAME_IO_PENDING)
+            return true;
+        if (r == FRAME_IO_ERROR)
+            return false;
+
+        const int64_t recvNs = nowNs();
+        dst->len = rx.st.len;
+        rx.st = FrameRecvState{};
+
+        if (!isAudioFrame(dst->len))
+        {
+            HandleServerControl(dst->data, dst->len, recvNs);
+            continue;
+        }
+        dst->originNs = recvNs;
+
+        if (rx.frame)
+        {
+            rx.frame->queuedNs = nowNs();
+            RecordStage(CSTAGE_RECV_ENQUEUE, *rx.frame, rx.frame->originNs, rx.frame->queuedNs);
+            gPlayChannel.Publish(rx.frame);
+            SetEvent(gPlayEvent);
+        }
+        else
+        {
+            gPlayDropped++;
+        }
 
-        auto packet = std::make_shared<std::vector<char>>(std::move(frame));
+        // 프레임 경계에서만 다음 풀 프레임을 받는다
+        rx.frame = gPlayChannel.Acquire();
+    }
+}
+
+// ───────────────────────────────
+// 송신 처리 (NetThread 전용)
+//  - 순서대로 전송 (pre-roll 버스트 보존)
+//  - 대기 프레임이 SEND_BACKLOG_FRAMES 를 넘으면 오래된 것부터 풀에 반납
+//  - WSAEWOULDBLOCK 이면 상태를 유지하고 FD_WRITE 를 기다린다
+//  - 제어 프레임(시계 동기화 ping, 단계별 지연 보고)은 프레임 경계에서 다음 오디오 프레임보다 먼저 보낸다
+//    ping 의 t1 은 송신을 시작할 때 찍는다
+// ───────────────────────────────
+struct NetSendContext
+{
+    FrameSendState st;
+    AudioFrame* frame = nullptr;        // 송신 중인 풀 프레임
+    int64_t beginNs = 0;                 // frame 송신 시작 시각
+    char ctrl[CTRL_MAX_FRAME];          // 송신 중인 제어 프레임
+    bool ctrlSending = false;
+    char report[CTRL_MAX_FRAME];       // 대기 중인 CTRL_CLIENT_STATS 프레임
+    uint32_t reportLen = 0;             // 0 이면 보낼 보고 없음
+    bool pingDue = false;
+    uint32_t pingSeq = 0;               // 보낸 ping 수
+};
+
+static bool PumpSend(NetSendContext& tx)
+{
+    for (;;)
+    {
+        if (!tx.st.busy)
         {
-            std::lock_guard<std::mutex> lock(gSendMutex);
-            while (gSendQueueFrames >= MAX_QUEUE_FRAMES && !gSendQueue.empty())
+            if (tx.frame)
+            {
+                const int64_t sentNs = nowNs();
+                RecordStage(CSTAGE_SEND, *tx.frame, tx.beginNs, sentNs);
+                RecordStage(CSTAGE_SEND_TOTAL, *tx.frame, tx.frame->originNs, sentNs);
+                gSendChannel.Release(tx.frame);
+                tx.frame = nullptr;
+            }
+            tx.ctrlSending = false;
+
+            if (tx.pingDue)
             {
-                gSendQueue.pop();
-                gSendQueueFrames--;
+                TimePing ping;
+                ping.seq = tx.pingSeq++;
+                ping.t1 = nowNs();
+                gClockSync.FillPing(ping, ping.t1);
+                beginSendFrame(tx.st, tx.ctrl, buildTimePingFrame(tx.ctrl, ping));
+                tx.ctrlSending = true;
+                tx.pingDue = false;
+            }
+            else if (tx.reportLen)
+            {
+                memcpy(tx.ctrl, tx.report, tx.reportLen);
+                beginSendFrame(tx.st, tx.ctrl, tx.reportLen);
+                tx.ctrlSending = true;
+                tx.reportLen = 0;
+            }
+            else
+            {
+                while (gSendChannel.Pending() > SEND_BACKLOG_FRAMES)
+                {
+                    gSendChannel.Release(gSendChannel.Consume());
+                    gSendDropped++;
+                }
+
+                tx.frame = gSendChannel.Consume();
+                if (!tx.frame)
+                    return true;
+
+                tx.beginNs = nowNs();
+                RecordStage(CSTAGE_SEND_QUEUE_WAIT, *tx.frame, tx.frame->queuedNs, tx.beginNs);
+                beginSendFrame(tx.st, tx.frame->data, tx.frame->len);
             }
-            gSendQueue.push(packet);
-            gSendQueueFrames++;
         }
-        gSendCV.notify_one();
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        int r = sendFrameNB(gSock, tx.st);
+        if (r == FRAME_IO_PENDING)
+            return true;
+        if (r == FRAME_IO_ERROR)
+            return false;
+    }
+}
+
+// ───────────────────────────────
+// 단계별 지연 보고 (NetThread 전용)
+//  - 직전 보고 이후 구간 분포를 CTRL_CLIENT_STATS 프레임으로 만들어 송신 대기시킨다
+// ───────────────────────────────
+static void QueueStageReport(NetSendContext& tx, HistogramSnapshot (&prev)[CSTAGE_COUNT])
+{
+    HistogramSnapshot interval[CSTAGE_COUNT];
+    for (int i = 0; i < CSTAGE_COUNT; i++)
+    {
+        HistogramSnapshot cur = gClientStageHist[i].Snapshot();
+        interval[i] = cur.Since(prev[i]);
+        prev[i] = std::move(cur);
     }
+    tx.reportLen = buildClientReportFrame(tx.report, interval);
 }
 
 // ───────────────────────────────
-// SendThread
+// NetThread
+//  - 송신/수신을 하나의 논블로킹 이벤트 루프로 처리
+//  - 소켓 이벤트(FD_READ/FD_WRITE/FD_CLOSE) 와 캡처 측 gSendEvent 를 함께 대기
+//  - CLIENT_REPORT_SEC 마다 단계별 지연 보고, TIME_SYNC_INTERVAL_MS 마다 시계 동기화 ping
+//    (처음 TIME_SYNC_WINDOW 번은 TIME_SYNC_BURST_MS 간격, 둘 다 WAIT_SLICE_MS 단위로 확인)
 // ───────────────────────────────
-void SendThread()
+void NetThread()
 {
+    setThreadName("net");
+    WSAEVENT sockEvent = WSACreateEvent();
+
+    // WSAEventSelect 는 소켓을 자동으로 논블로킹으로 전환한다
+    if (WSAEventSelect(gSock, sockEvent, FD_READ | FD_WRITE | FD_CLOSE) == SOCKET_ERROR)
+    {
+        std::cerr << "[클라이언트] WSAEventSelect 실패: " << WSAGetLastError() << std::endl;
+        WSACloseEvent(sockEvent);
+        gRunning = false;
+        return;
+    }
+
+    HANDLE handles[2] = { sockEvent, gSendEvent };
+
+    // AudioFrame scratch 를 포함하므로 스택 대신 힙에 한 번만 만든다
+    std::unique_ptr<NetRecvContext> rx(new NetRecvContext());
+    rx->frame = gPlayChannel.Acquire();
+    NetSendContext tx;
+
+    HistogramSnapshot reportPrev[CSTAGE_COUNT];
+    const int64_t reportPeriodNs = CLIENT_REPORT_SEC * 1000000000LL;
+    int64_t nextReportNs = nowNs() + reportPeriodNs;
+    int64_t nextPingNs = nowNs();
+
     while (gRunning)
     {
-        std::shared_ptr<std::vector<char>> packet;
+        if (WaitForMultipleObjects(2, handles, FALSE, WAIT_SLICE_MS) == WAIT_FAILED)
+            break;
+
+        // 이전 보고 / ping 이 아직 나가지 않았으면 (송신 밀림) 다음 확인 때 다시
+        const int64_t now = nowNs();
+        if (now >= nextReportNs && tx.reportLen == 0)
+        {
+            QueueStageReport(tx, reportPrev);
+            nextReportNs = now + reportPeriodNs;
+        }
+        if (now >= nextPingNs && !tx.pingDue)
         {
-            std::unique_lock<std::mutex > lock(gSendMutex);
-            gSendCV.wait(lock, [] { return !gSendQueue.empty() || !gRunning; });
-            if (!gRunning)
-                break;
+            tx.pingDue = true;
+            nextPingNs = now + (tx.pingSeq < TIME_SYNC_WINDOW ? TIME_SYNC_BURST_MS : TIME_SYNC_INTERVAL_MS) * 1000000LL;
+        }
 
-            // 최신 프레임만 전송
-            while (gSendQueue.size() > 1)
-            {
-                gSendQueue.pop();
-                gSendQueueFrames--;
-            }
-            packet = gSendQueue.front();
-            gSendQueue.pop();
-            gSendQueueFrames--;
+        WSANETWORKEVENTS ne{};
+        WSAEnumNetworkEvents(gSock, sockEvent, &ne);
+
+        // 1. 수신 (FD_CLOSE 와 함께 도착한 잔여 데이터도 먼저 읽는다)
+        if (!PumpRecv(*rx))
+        {
+            std::cerr << "[클라이언트] 서버 연결 끊김" << std::endl;
+            break;
+        }
+        if (ne.lNetworkEvents & FD_CLOSE)
+        {
+            std::cerr << "[클라이언트] 서버 연결 종료" << std::endl;
+            break;
         }
 
-        if (!sendFrame(gSock, packet->data(), (uint32_t)packet->size()))
+        // 2. 송신
+        if (!PumpSend(tx))
         {
             std::cerr << "[클라이언트] 송신 실패" << std::endl;
-            gRunning = false;
             break;
         }
     }
+
+    gRunning = false;
+    SetEvent(gPlayEvent);
+    SetEvent(gCaptureEvent);
+
+    WSAEventSelect(gSock, sockEvent, 0);
+    WSACloseEvent(sockEvent);
 }
 
 // ───────────────────────────────
-// RecvThread
+// PlaybackThread
+//  1. 재생이 끝난 버퍼는 풀에 반납 (detach 스레드 폴링 없음)
+//  2. 최신 프레임만 재생, 장치 버퍼가 모두 사용 중이면 drop
 // ───────────────────────────────
-void RecvThread()
+void PlaybackThread()
 {
+    setThreadName("playback");
+    if (!InitPlayback())
+    {
+        std::cerr << "[클라이언트] 재생 장치 열기 실패" << std::endl;
+        return;
+    }
+
+    WAVEHDR headers[PLAYBACK_BUFFERS] = {};
+    AudioFrame* playing[PLAYBACK_BUFFERS] = {};    // nullptr = 비어 있는 슬롯
+    int64_t writeNs[PLAYBACK_BUFFERS] = {};           // 슬롯별 waveOutWrite 시각
+
     while (gRunning)
     {
-        std::vector<char> buf(AUDIO_BUFFER_SIZE);
-        if (!recvFrame(gSock, buf)) { gRunning = false; break; }
+        WaitForSingleObject(gPlayEvent, WAIT_SLICE_MS);
 
-        auto packet = std::make_shared<std::vector<char>>(std::move(buf));
+        // 1. 재생 완료 버퍼 회수
+        int freeSlot = -1;
+        for (int i = 0; i < PLAYBACK_BUFFERS; i++)
         {
-            std::lock_guard<std::mutex> lock(gPlayMutex);
-            while (gPlayQueuedFrames >= MAX_QUEUE_FRAMES && !gPlayQueue.empty())
+            if (playing[i] && (headers[i].dwFlags & WHDR_DONE))
             {
-                gPlayQueue.pop();
-                gPlayQueuedFrames--;
+                const int64_t doneNs = nowNs();
+                RecordStage(CSTAGE_DEVICE_PLAY, *playing[i], writeNs[i], doneNs);
+                RecordStage(CSTAGE_PLAY_TOTAL, *playing[i], playing[i]->originNs, doneNs);
+                waveOutUnprepareHeader(gWaveOut, &headers[i], sizeof(WAVEHDR));
+                gPlayChannel.Release(playing[i]);
+                playing[i] = nullptr;
             }
-            gPlayQueue.push(packet);
-            gPlayQueuedFrames++;
+            if (!playing[i] && freeSlot < 0)
+                freeSlot = i;
+        }
+
+        // 2. 최신 프레임만 재생
+        size_t skipped = 0;
+        AudioFrame* frame = gPlayChannel.ConsumeLatest(skipped);
+        gPlayDropped += skipped;
+        if (!frame)
+            continue;
+
+        if (freeSlot < 0)
+        {
+            gPlayChannel.Release(frame);
+            gPlayDropped++;
+            continue;
         }
-        gPlayCV.notify_one();
+
+        WAVEHDR& hdr = headers[freeSlot];
+        ZeroMemory(&hdr, sizeof(WAVEHDR));
+        hdr.lpData = frame->data;
+        hdr.dwBufferLength = frame->len;
+        waveOutPrepareHeader(gWaveOut, &hdr, sizeof(WAVEHDR));
+        writeNs[freeSlot] = nowNs();
+        RecordStage(CSTAGE_PLAY_QUEUE_WAIT, *frame, frame->queuedNs, writeNs[freeSlot]);
+        waveOutWrite(gWaveOut, &hdr, sizeof(WAVEHDR));
+        playing[freeSlot] = frame;
+    }
+
+    // 장치 정리
+    waveOutReset(gWaveOut);
+    for (int i = 0; i < PLAYBACK_BUFFERS; i++)
+    {
+        if (!playing[i])
+            continue;
+        waveOutUnprepareHeader(gWaveOut, &headers[i], sizeof(WAVEHDR));
+        gPlayChannel.Release(playing[i]);
     }
- }
+    waveOutClose(gWaveOut);
+    gWaveOut = nullptr;
+}
 
 // ───────────────────────────────
-// PlaybackThread
+// 에코 왕복 진단 (--echo-test [N])
+//  - CTRL_ECHO 로 서버 에코 방에 들어간 뒤 마커 레인 0 에 seq 를 쓴 무음 프레임 N 개를 FRAME_MS 간격으로 보낸다
+//  - 서버가 운영 경로(수신 / 믹싱 큐 / 믹서 tick / 송신 큐)를 거쳐 돌려준 프레임과 CTRL_ECHO_TIMING 으로
+//    왕복 시간을 단계별로 나눈다 (echo.h)
+//  - uplink / downlink 를 나누려면 서버 시계 offset 이 필요하므로 시작 전에 시계 동기화 ping 을
+//    TIME_SYNC_BURST_MS 간격으로 TIME_SYNC_WINDOW 번 보내고, 진단 중에도 TIME_SYNC_INTERVAL_MS 마다 보낸다
+//  - 오디오 장치는 쓰지 않는다 (송신 : main 스레드, 수신 : 별도 스레드 블로킹 recvFrame)
 // ───────────────────────────────
-void PlaybackThread()
+#define ECHO_TEST_FRAMES 500                    // 기본 프레임 수 (FRAME_MS 120ms 기준 약 60초)
+#define ECHO_TEST_DRAIN_MS 1000                 // 마지막 프레임 송신 후 에코를 기다리는 시간
+
+static LatencyHistogram gEchoStageHist[ECHO_STAGE_COUNT] = {
+    { "uplink" },
+    { "ingest" },
+    { "mix_queue_wait" },
+    { "mix_fanout" },
+    { "send_queue_wait" },
+    { "server_send" },
+    { "downlink" },
+    { "rtt" },
+};
+
+struct EchoTestState
 {
-    while (gRunning)
+    std::atomic<int64_t> sendNs[MARKER_SEQ_MAX + 1];   // seq 별 송신 시작 (송신 스레드 기록)
+    int64_t recvNs[MARKER_SEQ_MAX + 1];                 // seq 별 에코 수신 완료 (이하 수신 스레드 전용)
+    ClockSync clock;
+    uint32_t completed = 0;                                  // 단계 시각까지 받은 왕복
+    uint32_t unsynced = 0;                                    // 시계 동기화 전이라 rtt 만 기록한 왕복
+
+    EchoTestState()
     {
-        std::shared_ptr<std::vector<char>> frame;
+        for (auto& v : sendNs)
+            v.store(0, std::memory_order_relaxed);
+        memset(recvNs, 0, sizeof(recvNs));
+    }
+};
+
+static void SendTimePing(uint32_t seq)
+{
+    TimePing ping;
+    ping.seq = seq;
+    ping.t1 = nowNs();
+    char ctrl[CTRL_MAX_FRAME];
+    sendFrame(gSock, ctrl, buildTimePingFrame(ctrl, ping));
+}
+
+static void EchoReceiveLoop(EchoTestState& st)
+{
+    setThreadName("echo-recv");
+    std::vector<char> frame;
+    while (recvFrame(gSock, frame))
+    {
+        const int64_t now = nowNs();
+        if (isAudioFrame((uint32_t)frame.size()))
+        {
+            uint16_t seq = 0;
+            if (ReadMarker((const int16_t*)frame.data(), 0, seq))
+                st.recvNs[seq] = now;
+            continue;
+        }
+
+        uint16_t type = 0;
+        const char* payload = nullptr;
+        uint16_t payloadLen = 0;
+        if (!parseCtrlFrame(frame.data(), (uint32_t)frame.size(), type, payload, payloadLen))
+            continue;
+
+        TimePong pong;
+        EchoTiming timing;
+        if (type == CTRL_TIME_PONG && parseTimePong(payload, payloadLen, pong))
+        {
+            st.clock.AddSample(pong.t1, pong.t2, pong.t3, now);
+        }
+        else if (type == CTRL_ECHO_TIMING && parseEchoTiming(payload, payloadLen, timing))
         {
-            std::unique_lock<std::mutex> lock(gPlayMutex);
-            gPlayCV.wait(lock, [] { return !gPlayQueue.empty() || !gRunning; });
-            if (!gRunning) break;
+            // 에코 프레임이 먼저 도착한다 (서버 송신 스레드가 프레임 -> 단계 시각 순서로 보냄)
+            const int64_t sendNs = st.sendNs[timing.seq].load(std::memory_order_acquire);
+            const int64_t recvNs = st.recvNs[timing.seq];
+            if (sendNs == 0 || recvNs == 0)
+                continue;
 
-            // 최신 프레임만 재생
-            while (gPlayQueue.size() > 1)
+            if (!st.clock.Synced())
             {
-                gPlayQueue.pop();
-                gPlayQueuedFrames--;
+                gEchoStageHist[ECHO_STAGE_RTT].Record((uint64_t)(recvNs - sendNs));
+                st.unsynced++;
+                continue;
             }
 
-            frame = gPlayQueue.front();
-            gPlayQueue.pop();
-            gPlayQueuedFrames--;
+            int64_t stages[ECHO_STAGE_COUNT];
+            splitEchoRoundTrip(timing, sendNs, recvNs, st.clock.OffsetNs(sendNs), stages);
+            for (int i = 0; i < ECHO_STAGE_COUNT; i++)
+                gEchoStageHist[i].Record((uint64_t)(std::max)((int64_t)0, stages[i]));
+            st.completed++;
+        }
+    }
+}
+
+static int RunEchoTest(int frames)
+{
+    std::unique_ptr<EchoTestState> st(new EchoTestState());
+    std::thread receiver(EchoReceiveLoop, std::ref(*st));
+
+    char ctrl[CTRL_MAX_FRAME];
+    sendFrame(gSock, ctrl, buildEchoRequestFrame(ctrl, true));
+
+    // 1. 시계 동기화 워밍업
+    uint32_t pingSeq = 0;
+    for (int i = 0; i < TIME_SYNC_WINDOW; i++)
+    {
+        SendTimePing(pingSeq++);
+        std::this_thread::sleep_for(std::chrono::milliseconds(TIME_SYNC_BURST_MS));
+    }
+
+    // 2. 마커 프레임 송신 (FRAME_MS 간격, 밀리면 따라잡지 않고 다음 간격부터)
+    std::cout << "[echo] 마커 프레임 " << frames << "개 송신" << std::endl;
+    char pcm[AUDIO_BUFFER_SIZE] = {};
+    const int64_t frameNs = (int64_t)(FRAME_MS * 1e6);
+    const int pingEvery = (std::max)(1, (int)(TIME_SYNC_INTERVAL_MS / FRAME_MS));
+    int64_t nextNs = nowNs();
+    for (int i = 0; i < frames && gRunning; i++)
+    {
+        if (i % pingEvery == 0)
+            SendTimePing(pingSeq++);
+
+        const uint16_t seq = (uint16_t)(i + 1);
+        WriteMarker((int16_t*)pcm, 0, seq);
+        st->sendNs[seq].store(nowNs(), std::memory_order_release);
+        if (!sendFrame(gSock, pcm, AUDIO_BUFFER_SIZE))
+        {
+            std::cerr << "[echo] 송신 실패" << std::endl;
+            break;
+        }
+
+        nextNs = (std::max)(nextNs + frameNs, nowNs());
+        std::this_thread::sleep_for(std::chrono::nanoseconds(nextNs - nowNs()));
+    }
+
+    // 3. 남은 에코를 기다린 뒤 소켓을 닫아 수신 스레드를 끝낸다
+    std::this_thread::sleep_for(std::chrono::milliseconds(ECHO_TEST_DRAIN_MS));
+    shutdown(gSock, SD_BOTH);
+    receiver.join();
+
+    const uint32_t roundTrips = st->completed + st->unsynced;
+    char line[200];
+    snprintf(line, sizeof(line), "[echo] 왕복 %u / %d (유실 %d), 시계 동기화 표본 %u, 최소 RTT %.3f ms (uplink / downlink 오차 최대 %.3f ms)",
+        roundTrips, frames, frames - (int)roundTrips, st->clock.Samples(), st->clock.RttNs() / 1e6, st->clock.RttNs() / 2e6);
+    std::cout << line << std::endl;
+    if (st->unsynced > 0)
+        std::cout << "[echo] 시계 동기화 전 왕복 " << st->unsynced << "개는 rtt 만 기록" << std::endl;
+
+    std::cout << "[echo] 단계별 왕복 지연" << std::endl;
+    printHistogramHeader(std::cout);
+    for (int i = 0; i < ECHO_STAGE_COUNT; i++)
+        printHistogramRow(std::cout, gEchoStageHist[i].Name(), gEchoStageHist[i].Snapshot());
+
+    return roundTrips > 0 ? 0 : 1;
+}
+
+// ───────────────────────────────
+// 음향 루프백 보정 (calibration.h)
+//   - 장치 입출력 버퍼링(waveOut 출력 ~ 스피커 ~ 마이크 ~ waveIn 입력) 지연을 잰다 : 서버 연결 없이 실행
+//   - device   : 재생 / 캡처 장치를 직접 연다 (스피커와 마이크가 서로 들리게, 헤드셋이면 마이크를 이어폰에 가까이)
+//   - loopback : 알려진 지연 + 감쇠 + 잡음을 넣은 합성 루프백, 측정값이 지연과 1 샘플 안에서 맞으면 0 반환 (자동 점검)
+//   - file     : --calibrate-write 로 내보낸 자극을 재생하면서 녹음한 WAV 분석 (녹음 시작 = 재생 시작 기준)
+// ───────────────────────────────
+#define CAL_LOOPBACK_DEFAULT_MS 120
+#define CAL_LOOPBACK_GAIN 0.2f                      // 합성 루프백 감쇠 (-14 dB)
+#define CAL_LOOPBACK_NOISE 3000                     // 합성 루프백 잡음 진폭 (자극보다 큰 잡음)
+#define CAL_DEVICE_SLACK_MS 1000                    // 캡처 시작 ~ 재생 시작 사이 여유
+
+enum CalibrationMode
+{
+    CAL_MODE_NONE,
+    CAL_MODE_DEVICE,
+    CAL_MODE_LOOPBACK,
+    CAL_MODE_FILE,
+    CAL_MODE_WRITE
+};
+
+// 캡처 버퍼 하나와 재생 버퍼 하나를 장치에 물리고 둘 다 끝날 때까지 기다린다
+//   - captureShift : waveOutWrite 직전의 캡처 위치 (waveInGetPosition)
+static bool CaptureDeviceLoopback(const CalibrationPlan& plan, std::vector<int16_t>& capture, int64_t& captureShift)
+{
+    static_assert(CHANNELS == 1, "calibration expects mono device format");
+    WAVEFORMATEX wf;
+    FillWaveFormat(wf);
+
+    HWAVEIN in = nullptr;
+    HWAVEOUT out = nullptr;
+    if (waveInOpen(&in, WAVE_MAPPER, &wf, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+        return false;
+    if (waveOutOpen(&out, WAVE_MAPPER, &wf, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+    {
+        waveInClose(in);
+        return false;
+    }
+
+    capture.assign(CalibrationCaptureSamples(plan) + (size_t)SAMPLE_RATE * CAL_DEVICE_SLACK_MS / 1000, 0);
+    WAVEHDR inHdr = {};
+    inHdr.lpData = (LPSTR)capture.data();
+    inHdr.dwBufferLength = (DWORD)(capture.size() * sizeof(int16_t));
+    waveInPrepareHeader(in, &inHdr, sizeof(WAVEHDR));
+    waveInAddBuffer(in, &inHdr, sizeof(WAVEHDR));
+
+    // waveOut 은 재생 버퍼를 읽기만 한다
+    WAVEHDR outHdr = {};
+    outHdr.lpData = (LPSTR)const_cast<int16_t*>(plan.play.data());
+    outHdr.dwBufferLength = (DWORD)(plan.play.size() * sizeof(int16_t));
+    waveOutPrepareHeader(out, &outHdr, sizeof(WAVEHDR));
+
+    waveInStart(in);
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_SLICE_MS));
+
+    MMTIME pos = {};
+    pos.wType = TIME_SAMPLES;
+    waveInGetPosition(in, &pos, sizeof(pos));
+    waveOutWrite(out, &outHdr, sizeof(WAVEHDR));
+    captureShift = pos.wType == TIME_SAMPLES ? (int64_t)pos.u.sample
+        : pos.wType == TIME_BYTES ? (int64_t)(pos.u.cb / wf.nBlockAlign) : 0;
+    if (pos.wType != TIME_SAMPLES && pos.wType != TIME_BYTES)
+        std::cerr << "[calibrate] 캡처 위치를 읽지 못함 : 캡처 시작 기준으로 잰다 (" << WAIT_SLICE_MS << " ms 만큼 크게 나온다)" << std::endl;
+
+    while (gRunning && !((inHdr.dwFlags & WHDR_DONE) && (outHdr.dwFlags & WHDR_DONE)))
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_SLICE_MS));
+
+    waveOutReset(out);
+    waveOutUnprepareHeader(out, &outHdr, sizeof(WAVEHDR));
+    waveOutClose(out);
+    waveInReset(in);
+    capture.resize(inHdr.dwBytesRecorded / sizeof(int16_t));
+    waveInUnprepareHeader(in, &inHdr, sizeof(WAVEHDR));
+    waveInClose(in);
+    return gRunning;
+}
+
+static int RunCalibration(CalibrationMode mode, const std::string& path, int loopbackMs)
+{
+    CalibrationPlan plan;
+    BuildCalibrationPlan(SAMPLE_RATE, plan);
+
+    if (mode == CAL_MODE_WRITE)
+    {
+        if (!WriteWavMono16(path, SAMPLE_RATE, plan.play))
+        {
+            std::cerr << "[calibrate] 자극 파일 쓰기 실패 : " << path << std::endl;
+            return 1;
+        }
+        std::cout << "[calibrate] 자극 " << plan.play.size() * 1000 / SAMPLE_RATE << " ms 기록 : " << path << std::endl;
+        return 0;
+    }
+
+    std::vector<int16_t> capture;
+    int64_t captureShift = 0;
+    if (mode == CAL_MODE_DEVICE)
+    {
+        std::cout << "[calibrate] 재생 / 캡처 장치로 자극 " << CAL_TRIALS << "회 재생 ("
+            << plan.play.size() * 1000 / SAMPLE_RATE << " ms)" << std::endl;
+        if (!CaptureDeviceLoopback(plan, capture, captureShift))
+        {
+            std::cerr << "[calibrate] 장치 열기 실패 또는 중단" << std::endl;
+            return 1;
         }
+    }
+    else if (mode == CAL_MODE_LOOPBACK)
+    {
+        SimulateAcousticLoopback(plan.play, (size_t)SAMPLE_RATE * loopbackMs / 1000, CAL_LOOPBACK_GAIN, CAL_LOOPBACK_NOISE, capture);
+    }
+    else
+    {
+        uint32_t rate = 0;
+        if (!ReadWavMono16(path, rate, capture) || rate != SAMPLE_RATE)
+        {
+            std::cerr << "[calibrate] 16bit PCM " << SAMPLE_RATE << " Hz WAV 가 아님 : " << path << std::endl;
+            return 1;
+        }
+    }
 
-        PlayAudio(frame); // 재생
+    CalibrationResult r;
+    AnalyzeCalibration(plan, capture.data(), capture.size(), captureShift, BestMixKernel(), r);
+
+    char line[200];
+    for (int t = 0; t < CAL_TRIALS; t++)
+    {
+        const CalibrationTrial& tr = r.trials[t];
+        if (tr.found)
+            snprintf(line, sizeof(line), "[calibrate]   시도 %d : %8.3f ms  (peak / rms %.1f)", t + 1, tr.latencySamples * 1000.0 / SAMPLE_RATE, tr.peakRatio);
+        else
+            snprintf(line, sizeof(line), "[calibrate]   시도 %d : 검출 실패 (peak / rms %.1f < %.1f)", t + 1, tr.peakRatio, CAL_MIN_PEAK_RATIO);
+        std::cout << line << std::endl;
+    }
+    snprintf(line, sizeof(line), "[calibrate] 장치 왕복 지연 %.3f ms (검출 %d / %d, spread %.3f ms, 상관 %s %.1f ms)",
+        r.latencyMs, r.detected, CAL_TRIALS, r.spreadMs, r.kernel, r.analyzeMs);
+    std::cout << line << std::endl;
+
+    // 과반이 검출되어야 성공, 합성 루프백은 넣은 지연과 1 샘플 안에서 맞아야 한다
+    if (r.detected * 2 <= CAL_TRIALS)
+        return 1;
+    if (mode == CAL_MODE_LOOPBACK && std::fabs(r.latencyMs - loopbackMs) > 1000.0 / SAMPLE_RATE)
+    {
+        std::cerr << "[calibrate] 합성 루프백 지연 " << loopbackMs << " ms 와 다름" << std::endl;
+        return 1;
     }
+    return 0;
 }
 
 // ───────────────────────────────
 // main
 // ───────────────────────────────
-int main()
+int main(int argc, char* argv[])
 {
     std::cout << "// ───────────────────────────────" << std::endl;
     std::cout << "// 비압축 Wave 형식의 오디오 송수신 프로그램 [ 클라이언트 ]" << std::endl;
@@ -259,7 +967,43 @@ int main()
     std::cout << "//    * Date" << std::endl << "//        [2025-08-25]" << std::endl;
     std::cout << "// ───────────────────────────────" << std::endl << std::endl;
 
+    // 실행 인자 확인 → VAD 끄기 / 에코 왕복 진단 / 음향 루프백 보정
+    int echoFrames = 0;
+    CalibrationMode calMode = CAL_MODE_NONE;
+    std::string calPath;
+    int calLoopbackMs = CAL_LOOPBACK_DEFAULT_MS;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string a = argv[i];
+        if (a == "--no-vad")
+        {
+            gVadEnabled = false;
+            std::cout << "[system] VAD 비활성화 : 무음 구간도 송신" << std::endl;
+        }
+        else if (a == "--echo-test")
+        {
+            echoFrames = ECHO_TEST_FRAMES;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+                echoFrames = (std::min)((std::max)(1, std::atoi(argv[++i])), MARKER_SEQ_MAX);
+        }
+        else if (a == "--calibrate")
+            calMode = CAL_MODE_DEVICE;
+        else if (a == "--calibrate-loopback")
+        {
+            calMode = CAL_MODE_LOOPBACK;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+                calLoopbackMs = (std::min)(std::atoi(argv[++i]), CAL_MAX_LATENCY_MS);
+        }
+        else if ((a == "--calibrate-file" || a == "--calibrate-write") && i + 1 < argc)
+        {
+            calMode = a == "--calibrate-file" ? CAL_MODE_FILE : CAL_MODE_WRITE;
+            calPath = argv[++i];
+        }
+    }
+
     std::signal(SIGINT, SignalHandler);
+    if (calMode != CAL_MODE_NONE)
+        return RunCalibration(calMode, calPath, calLoopbackMs);
 
     WSADATA wsa;
     WSAStartup(MAKEWORD(2, 2), &wsa);
@@ -280,9 +1024,21 @@ int main()
 
     TuneSocket(gSock);
 
+    if (echoFrames > 0)
+    {
+        const int rc = RunEchoTest(echoFrames);
+        closesocket(gSock);
+        WSACleanup();
+        return rc;
+    }
+
+    gSendEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    gPlayEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    gCaptureEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    // 캡처 / 네트워크 이벤트 루프 / 재생 : 3개 스레드
     std::thread tCapture(CaptureThread);
-    std::thread tSend(SendThread);
-    std::thread tRecv(RecvThread);
+    std::thread tNet(NetThread);
     std::thread tPlay(PlaybackThread);
 
     // 5. 안전 종료 ( 엔터 입력 대기 )
@@ -290,12 +1046,32 @@ int main()
         std::string dummy;
         std::getline(std::cin, dummy);
 
+    gRunning = false;
+    SetEvent(gSendEvent);
+    SetEvent(gPlayEvent);
+    SetEvent(gCaptureEvent);
+
     tCapture.join();
-    tSend.join();
-    tRecv.join();
+    tNet.join();
     tPlay.join();
 
+    std::cout << "[system] drop 통계 : 송신 " << gSendDropped << " / 재생 " << gPlayDropped << std::endl;
+    if (gClockSynced)
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "[system] 시계 동기화 : 표본 %u, 최소 RTT %.3f ms, skew %.2f ppm",
+            gClockSync.Samples(), gClockSync.RttNs() / 1e6, gClockSync.SkewPpm());
+        std::cout << line << std::endl;
+    }
+    std::cout << "[system] 단계별 지연 (누적)" << std::endl;
+    printHistogramHeader(std::cout);
+    for (int i = 0; i < CSTAGE_COUNT; i++)
+        printHistogramRow(std::cout, gClientStageHist[i].Name(), gClientStageHist[i].Snapshot());
+
     closesocket(gSock);
+    CloseHandle(gSendEvent);
+    CloseHandle(gPlayEvent);
+    CloseHandle(gCaptureEvent);
     WSACleanup();
 }
 
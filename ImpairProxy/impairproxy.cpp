@@ -0,0 +1,1109 @@
+﻿// =============================
+//      impairproxy.cpp
+//      Date : 2026-10-17
+// =============================
+// 로컬 네트워크 장애 프록시
+//  - 클라이언트(LoadGen, Client) 와 서버 사이에 끼워 지연 / 지터 / 손실 / 순서 바뀜 / 대역폭 제한을 넣는다
+//  - 방향별(up : 클라이언트 -> 서버, down : 서버 -> 클라이언트) 로 따로 설정
+//  - 파라미터 / 통계는 방향별 공용, 순서 유지 / 버스트 손실 상태 / 대역폭 링크는 흐름(접속)마다 따로
+//    (한 클라이언트의 지터나 버스트가 다른 클라이언트 패킷을 밀거나 버리지 않는다)
+//  - 하나의 스레드 / 하나의 이벤트 루프(WSAPoll) + 전달 시각 순 힙
+//
+//  TCP 모드 (기본)
+//  - 길이 헤더 프레임 단위로 받아 프레임 통째로 지연 / 손실 처리 (바이트 스트림을 자르지 않는다)
+//  - 손실은 오디오 프레임만 버린다 (제어 프레임은 항상 전달, 지연만 적용)
+//  - 지터가 있어도 흐름 안의 도착 순서는 유지 (TCP 라 같은 접속 안에서만 head-of-line 으로 밀린다), reorder 만 순서를 바꾼다
+//
+//  UDP 모드 (--udp)
+//  - 데이터그램 중계, 클라이언트 주소마다 서버 쪽 소켓 하나 (30초 무송수신이면 정리)
+//  - 지터만으로도 순서가 바뀐다 (실제 UDP 경로와 같음)
+//
+//  장애 파라미터 (key=value)
+//    latency=ms      기본 지연                    jitter=ms   지터 크기 (분포의 표준편차 / 반폭 / 평균)
+//    dist=uniform|normal|pareto  지터 분포 (평균 0, pareto 는 오른쪽으로 긴 꼬리)
+//    loss=P          무작위 손실 확률 (0~1)
+//    ge_p=P ge_r=P   Gilbert-Elliott 버스트 손실 : good->bad, bad->good 전이 확률 (ge_p > 0 이면 사용)
+//    ge_good=P ge_bad=P  각 상태의 손실 확률 (기본 0 / 1)
+//    reorder=P       지연 없이 바로 내보내 앞 패킷을 추월시키는 확률
+//    rate=kbps       흐름마다 대역폭 상한 (0 = 무제한)  queue=ms  병목 큐 길이, 넘치면 tail drop (기본 1000)
+//
+//  시나리오 파일 (--scenario)
+//    # 시각(초)  방향(up|down|both)  key=value ...   ('reset' 은 그 방향을 기본값으로)
+//    0    both  latency=30 jitter=5 dist=normal
+//    10   up    loss=0.02
+//    20   both  ge_p=0.05 ge_r=0.4 ge_bad=0.6
+//    40   down  rate=512 queue=200
+//    60   both  reset
+//    90   end                                       (프록시 종료)
+//
+//  사용법 : ImpairProxy.exe [--listen N] [--server IP] [--port N] [--udp] [--scenario 파일]
+//                           [--up k=v,k=v] [--down k=v,...] [--both k=v,...] [--seed N] [--report-sec N]
+//    예) ImpairProxy.exe --both latency=40,jitter=10,loss=0.01
+//        LoadGen.exe --server 127.0.0.1 --port 9798
+// =============================
+#include "../core/core.h"
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sstream>
+
+// -------------------------------------------
+// 상수
+// -------------------------------------------
+#define PROXY_MAX_FRAME 65536						// TCP 프레임 / UDP 데이터그램 최대 크기
+#define PROXY_MAX_PENDING (4 * 1024 * 1024)		// 방향별 송신 대기 상한 (넘으면 반대편 수신 중단)
+#define PROXY_READ_BURST 64							// 이벤트 한 번에 읽는 최대 프레임 수
+#define PROXY_POLL_MAX_MS 50
+#define PROXY_UDP_IDLE_SEC 30
+#define PARETO_SHAPE 2.5								// 지터 pareto 분포 모양 (작을수록 꼬리가 길다)
+
+enum Direction
+{
+    DIR_UP = 0,                             // 클라이언트 -> 서버
+    DIR_DOWN = 1,                           // 서버 -> 클라이언트
+    DIR_COUNT
+};
+
+static const char* const kDirNames[DIR_COUNT] = { "up", "down" };
+
+enum JitterDist
+{
+    JITTER_UNIFORM,
+    JITTER_NORMAL,
+    JITTER_PARETO
+};
+
+static const char* const kDistNames[] = { "uniform", "normal", "pareto" };
+
+// -------------------------------------------
+// 장애 파라미터 / 통계
+// -------------------------------------------
+struct ImpairParams
+{
+    double latencyMs = 0;
+    double jitterMs = 0;
+    JitterDist dist = JITTER_UNIFORM;
+    double loss = 0;
+    double geP = 0;                             // 0 이면 Gilbert-Elliott 사용 안 함
+    double geR = 1;
+    double geLossGood = 0;
+    double geLossBad = 1;
+    double reorder = 0;
+    double rateKbps = 0;                        // 0 이면 무제한
+    double queueMs = 1000;
+};
+
+struct ImpairStats
+{
+    uint64_t in = 0;
+    uint64_t forwarded = 0;
+    uint64_t lostRandom = 0;
+    uint64_t lostBurst = 0;
+    uint64_t lostQueue = 0;
+    uint64_t reordered = 0;
+    uint64_t sendFailed = 0;                    // UDP 송신 실패 (소켓 버퍼 가득 등)
+    uint64_t bytesOut = 0;
+    int64_t addedUsSum = 0;                     // 전달한 패킷의 추가 지연 합
+};
+
+static bool ParseNumber(const std::string& s, double& out)
+{
+    if (s.empty())
+        return false;
+    char* end = nullptr;
+    out = strtod(s.c_str(), &end);
+    return end && *end == 0 && out >= 0;
+}
+
+static bool ParseProbability(const std::string& s, double& out)
+{
+    return ParseNumber(s, out) && out <= 1.0;
+}
+
+// 파라미터 하나 적용 (알 수 없는 키 / 잘못된 값이면 false)
+static bool ApplyParam(ImpairParams& p, const std::string& key, const std::string& value)
+{
+    if (key == "latency") return ParseNumber(value, p.latencyMs);
+    if (key == "jitter") return ParseNumber(value, p.jitterMs);
+    if (key == "loss") return ParseProbability(value, p.loss);
+    if (key == "ge_p") return ParseProbability(value, p.geP);
+    if (key == "ge_r") return ParseProbability(value, p.geR);
+    if (key == "ge_good") return ParseProbability(value, p.geLossGood);
+    if (key == "ge_bad") return ParseProbability(value, p.geLossBad);
+    if (key == "reorder") return ParseProbability(value, p.reorder);
+    if (key == "rate") return ParseNumber(value, p.rateKbps);
+    if (key == "queue") return ParseNumber(value, p.queueMs);
+    if (key == "dist")
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (value == kDistNames[i])
+            {
+                p.dist = (JitterDist)i;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static std::string DescribeParams(const ImpairParams& p)
+{
+    char line[256];
+    snprintf(line, sizeof(line),
+        "latency %.1fms jitter %.1fms(%s) loss %.3f ge %.3f/%.3f(%.2f/%.2f) reorder %.3f rate %.0fkbps queue %.0fms",
+        p.latencyMs, p.jitterMs, kDistNames[p.dist], p.loss, p.geP, p.geR, p.geLossGood, p.geLossBad,
+        p.reorder, p.rateKbps, p.queueMs);
+    return line;
+}
+
+// -------------------------------------------
+// 흐름 하나, 방향 하나의 장애 상태
+//  - 흐름마다 따로 두어 다른 접속의 패킷과 섞이지 않게 한다
+// -------------------------------------------
+struct ImpairFlowState
+{
+    bool geBad = false;                         // Gilbert-Elliott 상태
+    int64_t linkFreeUs = 0;                     // 병목 링크가 비는 시각
+    int64_t lastDeliverUs = 0;                  // 순서 유지 (TCP) 기준 : 직전 전달 시각
+};
+
+// -------------------------------------------
+// Impairment
+//  - 한 방향의 장애 모델 : 패킷 하나마다 버릴지, 언제 내보낼지 결정
+//  - 순서 : Gilbert-Elliott -> 무작위 손실 -> 대역폭(병목 큐) -> reorder / 지연 + 지터
+//  - 파라미터 / 통계 / 난수는 방향 공용, 흐름별 상태는 호출 측이 넘긴다
+// -------------------------------------------
+class Impairment
+{
+public:
+    explicit Impairment(uint64_t seed) : mRng(seed) {}
+
+    ImpairParams params;
+    ImpairStats stats;
+
+    // 반환 : 전달 시각 (us), 버리면 -1
+    //  - lossless : 손실만 면제 (TCP 제어 프레임)
+    //  - keepOrder : 지터로 앞 패킷을 추월하지 않게 (TCP)
+    int64_t Schedule(ImpairFlowState& fs, size_t bytes, int64_t nowUs, bool lossless, bool keepOrder)
+    {
+        stats.in++;
+
+        if (!lossless)
+        {
+            if (params.geP > 0)
+            {
+                if (!fs.geBad && Uniform() < params.geP)
+                    fs.geBad = true;
+                else if (fs.geBad && Uniform() < params.geR)
+                    fs.geBad = false;
+
+                if (Uniform() < (fs.geBad ? params.geLossBad : params.geLossGood))
+                {
+                    stats.lostBurst++;
+                    return -1;
+                }
+            }
+
+            if (params.loss > 0 && Uniform() < params.loss)
+            {
+                stats.lostRandom++;
+                return -1;
+            }
+        }
+
+        // 병목 링크 : 직렬화 시간만큼 링크를 점유, 대기 시간이 큐 길이를 넘으면 tail drop
+        int64_t sendUs = nowUs;
+        if (params.rateKbps > 0)
+        {
+            const int64_t startUs = (std::max)(nowUs, fs.linkFreeUs);
+            if (!lossless && startUs - nowUs > (int64_t)(params.queueMs * 1000.0))
+            {
+                stats.lostQueue++;
+                return -1;
+            }
+            fs.linkFreeUs = startUs + (int64_t)(bytes * 8000.0 / params.rateKbps);
+            sendUs = fs.linkFreeUs;
+        }
+
+        int64_t deliverUs;
+        if (params.reorder > 0 && Uniform() < params.reorder)
+        {
+            // 지연 없이 바로 : 지연 중인 앞 패킷들을 추월한다
+            stats.reordered++;
+            deliverUs = sendUs;
+        }
+        else
+        {
+            const double delayMs = (std::max)(0.0, params.latencyMs + Jitter());
+            deliverUs = sendUs + (int64_t)(delayMs * 1000.0);
+            if (keepOrder)
+                deliverUs = (std::max)(deliverUs, fs.lastDeliverUs);
+            fs.lastDeliverUs = deliverUs;
+        }
+
+        stats.forwarded++;
+        stats.addedUsSum += deliverUs - nowUs;
+        return deliverUs;
+    }
+
+    // 기본값으로 (이미 예약된 전달과 병목 링크 점유는 그대로, 흐름별 버스트 상태는 호출 측이 되돌린다)
+    void Reset()
+    {
+        params = ImpairParams();
+    }
+
+private:
+    double Uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(mRng); }
+
+    // 평균 0 지터 (ms)
+    double Jitter()
+    {
+        const double j = params.jitterMs;
+        if (j <= 0)
+            return 0;
+
+        switch (params.dist)
+        {
+        case JITTER_NORMAL:
+            return std::normal_distribution<double>(0.0, j)(mRng);
+        case JITTER_PARETO:
+        {
+            // 평균이 j 인 pareto 표본에서 j 를 빼서 평균 0, 최소 -j/shape
+            const double xm = j * (PARETO_SHAPE - 1.0) / PARETO_SHAPE;
+            const double u = (std::max)(Uniform(), 1e-12);
+            return xm / std::pow(u, 1.0 / PARETO_SHAPE) - j;
+        }
+        default:
+            return (Uniform() * 2.0 - 1.0) * j;
+        }
+    }
+
+    std::mt19937_64 mRng;
+};
+
+// -------------------------------------------
+// 시나리오
+// -------------------------------------------
+struct ScenarioStep
+{
+    double atSec = 0;
+    int dirMask = 0;                            // bit0 up, bit1 down
+    bool end = false;
+    std::vector<std::pair<std::string, std::string>> kv;     // "reset" 은 값 없는 키
+};
+
+static bool ParseDirection(const std::string& s, int& mask)
+{
+    if (s == "up") mask = 1 << DIR_UP;
+    else if (s == "down") mask = 1 << DIR_DOWN;
+    else if (s == "both") mask = (1 << DIR_UP) | (1 << DIR_DOWN);
+    else return false;
+    return true;
+}
+
+// "key=value" 하나를 검증해서 추가
+static bool AddStepParam(ScenarioStep& step, const std::string& token)
+{
+    if (token == "reset")
+    {
+        step.kv.emplace_back(token, std::string());
+        return true;
+    }
+
+    const size_t eq = token.find('=');
+    if (eq == std::string::npos)
+        return false;
+
+    ImpairParams probe;
+    const std::string key = token.substr(0, eq);
+    const std::string value = token.substr(eq + 1);
+    if (!ApplyParam(probe, key, value))
+        return false;
+
+    step.kv.emplace_back(key, value);
+    return true;
+}
+
+static bool LoadScenario(const std::string& path, std::vector<ScenarioStep>& steps)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "[impair] 시나리오 파일 열기 실패: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNo = 0;
+    double lastSec = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos)
+            line.resize(hash);
+
+        std::istringstream ss(line);
+        std::string timeTok, dirTok;
+        if (!(ss >> timeTok))
+            continue;
+
+        ScenarioStep step;
+        bool ok = ParseNumber(timeTok, step.atSec) && step.atSec >= lastSec && (ss >> dirTok);
+        if (ok && dirTok == "end")
+            step.end = true;
+        else if (ok)
+            ok = ParseDirection(dirTok, step.dirMask);
+
+        std::string token;
+        while (ok && !step.end && (ss >> token))
+            ok = AddStepParam(step, token);
+
+        if (!ok)
+        {
+            std::cerr << "[impair] " << path << ":" << lineNo << " 해석 실패: " << line << std::endl;
+            return false;
+        }
+
+        lastSec = step.atSec;
+        steps.push_back(step);
+    }
+    return true;
+}
+
+// -------------------------------------------
+// 설정
+// -------------------------------------------
+struct ProxyConfig
+{
+    int listenPort = PORT + 1;
+    std::string serverIp = "127.0.0.1";
+    int serverPort = PORT;
+    bool udp = false;
+    std::string scenarioPath;
+    uint64_t seed = 1;
+    int reportSec = 5;
+    ScenarioStep initial;                       // --up / --down / --both (시각 0)
+};
+
+static std::atomic<bool> gRunning{ true };
+
+static void SignalHandler(int) { gRunning = false; }
+
+static int64_t NowUs()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void SetNonBlocking(SOCKET s)
+{
+    u_long nb = 1;
+    ioctlsocket(s, FIONBIO, &nb);
+}
+
+static bool ParseArgs(int argc, char* argv[], ProxyConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--udp")
+        {
+            cfg.udp = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+
+        std::string v = argv[++i];
+        if (a == "--listen") cfg.listenPort = std::stoi(v);
+        else if (a == "--server") cfg.serverIp = v;
+        else if (a == "--port") cfg.serverPort = std::stoi(v);
+        else if (a == "--scenario") cfg.scenarioPath = v;
+        else if (a == "--seed") cfg.seed = std::stoull(v);
+        else if (a == "--report-sec") cfg.reportSec = (std::max)(1, std::stoi(v));
+        else if (a == "--up" || a == "--down" || a == "--both")
+        {
+            // 키 앞에 방향을 붙여 둔다 (예 : up:latency), ApplyStep 이 다시 떼어낸다
+            int mask = 0;
+            ParseDirection(a.substr(2), mask);
+            std::istringstream ss(v);
+            std::string token;
+            while (std::getline(ss, token, ','))
+            {
+                ScenarioStep one;
+                if (!AddStepParam(one, token))
+                    return false;
+                for (int d = 0; d < DIR_COUNT; d++)
+                {
+                    if (mask & (1 << d))
+                        cfg.initial.kv.emplace_back(std::string(kDirNames[d]) + ":" + one.kv[0].first, one.kv[0].second);
+                }
+            }
+        }
+        else return false;
+    }
+    return true;
+}
+
+// -------------------------------------------
+// 흐름 (클라이언트 하나)
+//  - TCP : 클라이언트 소켓 + 서버 쪽 소켓, 방향별 프레임 수신 상태 / 송신 대기 버퍼
+//  - UDP : 서버 쪽 소켓 + 클라이언트 주소 (클라이언트 쪽은 공용 수신 소켓)
+// -------------------------------------------
+struct Flow
+{
+    uint32_t id = 0;
+    SOCKET client = INVALID_SOCKET;
+    SOCKET server = INVALID_SOCKET;
+    bool connected = false;                     // 서버 쪽 연결 완료 (UDP 는 항상 true)
+    sockaddr_in clientAddr{};
+    int64_t lastActiveUs = 0;
+
+    FrameRecvState rs[DIR_COUNT];
+    std::vector<char> rbuf[DIR_COUNT];
+    std::vector<char> out[DIR_COUNT];           // 방향 목적지로 나갈 바이트 (길이 헤더 포함)
+    size_t outOff[DIR_COUNT] = { 0, 0 };
+    ImpairFlowState impair[DIR_COUNT];          // 방향별 장애 상태 (이 흐름 전용)
+
+    size_t Pending(int d) const { return out[d].size() - outOff[d]; }
+};
+
+// 전달 예약 (힙)
+struct Delivery
+{
+    int64_t atUs;
+    uint64_t seq;                               // 같은 시각이면 예약 순서
+    uint32_t flow;
+    int dir;
+    std::shared_ptr<std::vector<char>> data;
+
+    bool operator>(const Delivery& o) const
+    {
+        return atUs != o.atUs ? atUs > o.atUs : seq > o.seq;
+    }
+};
+
+// -------------------------------------------
+// ImpairProxy
+// -------------------------------------------
+class ImpairProxy
+{
+public:
+    explicit ImpairProxy(const ProxyConfig& cfg)
+        : mCfg(cfg)
+    {
+        for (int d = 0; d < DIR_COUNT; d++)
+            mImpair[d].reset(new Impairment(cfg.seed * 2 + d));
+
+        inet_pton(AF_INET, cfg.serverIp.c_str(), &mServerAddr.sin_addr);
+        mServerAddr.sin_family = AF_INET;
+        mServerAddr.sin_port = htons((unsigned short)cfg.serverPort);
+    }
+
+    ~ImpairProxy()
+    {
+        while (!mFlows.empty())
+            CloseFlow(mFlows.begin()->first);
+        if (mListen != INVALID_SOCKET)
+            closesocket(mListen);
+    }
+
+    bool Open()
+    {
+        mListen = socket(AF_INET, mCfg.udp ? SOCK_DGRAM : SOCK_STREAM, mCfg.udp ? IPPROTO_UDP : IPPROTO_TCP);
+        if (mListen == INVALID_SOCKET)
+            return false;
+
+        int flag = 1;
+        setsockopt(mListen, SOL_SOCKET, SO_REUSEADDR, (const char*)&flag, sizeof(flag));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((unsigned short)mCfg.listenPort);
+        if (bind(mListen, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR)
+            return false;
+        if (!mCfg.udp && listen(mListen, SOMAXCONN) == SOCKET_ERROR)
+            return false;
+
+        if (mCfg.udp)
+        {
+            int buf = 1 << 20;
+            setsockopt(mListen, SOL_SOCKET, SO_RCVBUF, (const char*)&buf, sizeof(buf));
+            setsockopt(mListen, SOL_SOCKET, SO_SNDBUF, (const char*)&buf, sizeof(buf));
+        }
+        SetNonBlocking(mListen);
+        return true;
+    }
+
+    void Run(const std::vector<ScenarioStep>& steps)
+    {
+        const int64_t start = NowUs();
+        int64_t nextReport = start + mCfg.reportSec * 1000000LL;
+        int64_t nextSweep = start + 1000000LL;
+        size_t stepIdx = 0;
+        bool done = false;
+
+        std::vector<WSAPOLLFD> fds;
+        std::vector<std::pair<uint32_t, bool>> owners;      // fds[i] 의 (흐름, 서버 쪽 여부), 0 번은 수신 소켓
+
+        while (gRunning && !done)
+        {
+            int64_t now = NowUs();
+
+            while (stepIdx < steps.size() && now >= start + (int64_t)(steps[stepIdx].atSec * 1e6))
+            {
+                const ScenarioStep& step = steps[stepIdx++];
+                if (step.end)
+                {
+                    done = true;
+                    break;
+                }
+                ApplyStep(step, (now - start) / 1e6);
+            }
+
+            DeliverDue(now);
+
+            // 다음 깨어날 시각 : 전달 예약 / 시나리오 단계 / 리포트 중 가장 이른 것
+            int64_t wakeUs = (std::min)(nextReport, now + (int64_t)PROXY_POLL_MAX_MS * 1000);
+            if (!mHeap.empty())
+                wakeUs = (std::min)(wakeUs, mHeap.top().atUs);
+            if (stepIdx < steps.size())
+                wakeUs = (std::min)(wakeUs, start + (int64_t)(steps[stepIdx].atSec * 1e6));
+            const int timeoutMs = (int)(std::max)((int64_t)0, (wakeUs - now + 999) / 1000);
+
+            BuildPoll(fds, owners);
+            int n = WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs);
+            if (n == SOCKET_ERROR)
+            {
+                std::cerr << "[impair] WSAPoll 실패: " << WSAGetLastError() << std::endl;
+                break;
+            }
+
+            now = NowUs();
+            for (size_t i = 0; n > 0 && i < fds.size(); i++)
+            {
+                if (!fds[i].revents)
+                    continue;
+                if (i == 0 && mCfg.udp)
+                    ReadUdpClients(now);
+                else if (i == 0)
+                    AcceptClients();
+                else
+                    HandleEvents(owners[i].first, owners[i].second, fds[i].revents, now);
+            }
+
+            if (now >= nextSweep)
+            {
+                if (mCfg.udp)
+                    SweepIdleUdp(now);
+                nextSweep = now + 1000000LL;
+            }
+
+            if (now >= nextReport)
+            {
+                Report(false);
+                nextReport += mCfg.reportSec * 1000000LL;
+            }
+        }
+
+        Report(true);
+    }
+
+private:
+    // ---------------------------------------
+    // 시나리오 적용
+    // ---------------------------------------
+    void ApplyStep(const ScenarioStep& step, double atSec)
+    {
+        bool touched[DIR_COUNT] = { false, false };
+        for (const auto& kv : step.kv)
+        {
+            // --up / --down 으로 들어온 키는 "up:latency" 처럼 방향이 붙어 있다
+            int mask = step.dirMask;
+            std::string key = kv.first;
+            const size_t colon = key.find(':');
+            if (colon != std::string::npos)
+            {
+                ParseDirection(key.substr(0, colon), mask);
+                key = key.substr(colon + 1);
+            }
+
+            for (int d = 0; d < DIR_COUNT; d++)
+            {
+                if (!(mask & (1 << d)))
+                    continue;
+                if (key == "reset")
+                {
+                    mImpair[d]->Reset();
+                    for (auto& kvf : mFlows)
+                        kvf.second->impair[d].geBad = false;
+                }
+                else
+                    ApplyParam(mImpair[d]->params, key, kv.second);
+                touched[d] = true;
+            }
+        }
+
+        for (int d = 0; d < DIR_COUNT; d++)
+        {
+            if (touched[d])
+            {
+                char head[64];
+                snprintf(head, sizeof(head), "[impair] t=%.1fs %-4s ", atSec, kDirNames[d]);
+                std::cout << head << DescribeParams(mImpair[d]->params) << std::endl;
+            }
+        }
+    }
+
+    // ---------------------------------------
+    // 전달
+    // ---------------------------------------
+    void Schedule(Flow& f, int dir, std::shared_ptr<std::vector<char>> data, bool lossless, int64_t now)
+    {
+        const int64_t at = mImpair[dir]->Schedule(f.impair[dir], data->size(), now, lossless, !mCfg.udp);
+        if (at < 0)
+            return;
+        mHeap.push(Delivery{ at, ++mSeq, f.id, dir, std::move(data) });
+    }
+
+    void DeliverDue(int64_t now)
+    {
+        while (!mHeap.empty() && mHeap.top().atUs <= now)
+        {
+            Delivery d = mHeap.top();
+            mHeap.pop();
+
+            auto it = mFlows.find(d.flow);
+            if (it == mFlows.end())
+                continue;                       // 이미 닫힌 흐름
+            Flow& f = *it->second;
+            ImpairStats& st = mImpair[d.dir]->stats;
+            st.bytesOut += d.data->size();
+
+            if (mCfg.udp)
+            {
+                int r;
+                if (d.dir == DIR_UP)
+                    r = send(f.server, d.data->data(), (int)d.data->size(), 0);
+                else
+                    r = sendto(mListen, d.data->data(), (int)d.data->size(), 0, (const sockaddr*)&f.clientAddr, sizeof(f.clientAddr));
+                if (r == SOCKET_ERROR)
+                    st.sendFailed++;
+                continue;
+            }
+
+            f.out[d.dir].insert(f.out[d.dir].end(), d.data->begin(), d.data->end());
+            if (!Flush(f, d.dir))
+                CloseFlow(f.id);
+        }
+    }
+
+    // 송신 대기 버퍼를 가능한 만큼 보낸다 (WSAEWOULDBLOCK 이면 POLLWRNORM 으로 이어서)
+    bool Flush(Flow& f, int dir)
+    {
+        SOCKET s = dir == DIR_UP ? f.server : f.client;
+        if (!f.connected)
+            return true;
+
+        while (f.Pending(dir) > 0)
+        {
+            int n = send(s, f.out[dir].data() + f.outOff[dir], (int)f.Pending(dir), 0);
+            if (n == SOCKET_ERROR)
+                return WSAGetLastError() == WSAEWOULDBLOCK;
+            f.outOff[dir] += (size_t)n;
+        }
+        f.out[dir].clear();
+        f.outOff[dir] = 0;
+        return true;
+    }
+
+    // ---------------------------------------
+    // 이벤트 루프
+    // ---------------------------------------
+    void BuildPoll(std::vector<WSAPOLLFD>& fds, std::vector<std::pair<uint32_t, bool>>& owners)
+    {
+        fds.clear();
+        owners.clear();
+
+        WSAPOLLFD p{};
+        p.fd = mListen;
+        p.events = POLLRDNORM;
+        fds.push_back(p);
+        owners.emplace_back(0, false);
+
+        for (const auto& kv : mFlows)
+        {
+            const Flow& f = *kv.second;
+            p.revents = 0;
+
+            // 서버 쪽 : 연결 중이면 쓰기 대기, 이후 down 수신 + up 송신
+            p.fd = f.server;
+            if (!f.connected)
+                p.events = POLLWRNORM;
+            else
+                p.events = (short)((f.Pending(DIR_DOWN) < PROXY_MAX_PENDING ? POLLRDNORM : 0) |
+                    (f.Pending(DIR_UP) > 0 ? POLLWRNORM : 0));
+            if (p.events)
+            {
+                fds.push_back(p);
+                owners.emplace_back(f.id, true);
+            }
+
+            // 클라이언트 쪽 (TCP 만) : 서버 연결 뒤부터 up 수신 + down 송신
+            if (mCfg.udp || !f.connected)
+                continue;
+            p.fd = f.client;
+            p.events = (short)((f.Pending(DIR_UP) < PROXY_MAX_PENDING ? POLLRDNORM : 0) |
+                (f.Pending(DIR_DOWN) > 0 ? POLLWRNORM : 0));
+            if (p.events)
+            {
+                fds.push_back(p);
+                owners.emplace_back(f.id, false);
+            }
+        }
+    }
+
+    void HandleEvents(uint32_t id, bool serverSide, short revents, int64_t now)
+    {
+        auto it = mFlows.find(id);
+        if (it == mFlows.end())
+            return;
+        Flow& f = *it->second;
+
+        if (serverSide && !f.connected)
+        {
+            int err = 0;
+            int len = sizeof(err);
+            getsockopt(f.server, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+            if (err != 0 || (revents & (POLLERR | POLLHUP | POLLNVAL)))
+            {
+                std::cerr << "[impair] 서버 연결 실패 (흐름 " << id << ", " << err << ")" << std::endl;
+                CloseFlow(id);
+                return;
+            }
+
+            int flag = 1;
+            setsockopt(f.server, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+            f.connected = true;
+            return;
+        }
+
+        if (mCfg.udp)
+        {
+            ReadUdpServer(f, now);
+            return;
+        }
+
+        // 서버 쪽에서 읽으면 down, 클라이언트 쪽에서 읽으면 up
+        const int readDir = serverSide ? DIR_DOWN : DIR_UP;
+        const int writeDir = serverSide ? DIR_UP : DIR_DOWN;
+
+        if ((revents & POLLWRNORM) && !Flush(f, writeDir))
+        {
+            CloseFlow(id);
+            return;
+        }
+
+        if (revents & (POLLRDNORM | POLLERR | POLLHUP))
+        {
+            if (!ReadFrames(f, readDir, now))
+                CloseFlow(id);
+        }
+    }
+
+    bool ReadFrames(Flow& f, int dir, int64_t now)
+    {
+        SOCKET s = dir == DIR_UP ? f.client : f.server;
+        std::vector<char>& buf = f.rbuf[dir];
+        if (buf.empty())
+            buf.resize(PROXY_MAX_FRAME);
+
+        for (int i = 0; i < PROXY_READ_BURST; i++)
+        {
+            int r = recvFrameNB(s, f.rs[dir], buf.data(), (uint32_t)buf.size());
+            if (r == FRAME_IO_PENDING)
+                return true;
+            if (r == FRAME_IO_ERROR)
+                return false;
+
+            const uint32_t len = f.rs[dir].len;
+            f.rs[dir] = FrameRecvState{};
+
+            auto data = std::make_shared<std::vector<char>>(sizeof(uint32_t) + len);
+            const uint32_t nlen = htonl(len);
+            memcpy(data->data(), &nlen, sizeof(nlen));
+            memcpy(data->data() + sizeof(nlen), buf.data(), len);
+            Schedule(f, dir, std::move(data), !isAudioFrame(len), now);
+        }
+        return true;
+    }
+
+    void AcceptClients()
+    {
+        while (true)
+        {
+            SOCKET c = accept(mListen, nullptr, nullptr);
+            if (c == INVALID_SOCKET)
+                return;
+
+            SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (s == INVALID_SOCKET)
+            {
+                closesocket(c);
+                continue;
+            }
+
+            SetNonBlocking(c);
+            SetNonBlocking(s);
+            int flag = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+
+            if (connect(s, (sockaddr*)&mServerAddr, sizeof(mServerAddr)) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)
+            {
+                closesocket(c);
+                closesocket(s);
+                continue;
+            }
+
+            std::unique_ptr<Flow> f(new Flow());
+            f->id = ++mNextFlowId;
+            f->client = c;
+            f->server = s;
+            mFlows[f->id] = std::move(f);
+            mFlowsOpened++;
+        }
+    }
+
+    // ---------------------------------------
+    // UDP
+    // ---------------------------------------
+    static uint64_t AddrKey(const sockaddr_in& a)
+    {
+        return ((uint64_t)a.sin_addr.s_addr << 16) | a.sin_port;
+    }
+
+    void ReadUdpClients(int64_t now)
+    {
+        char buf[PROXY_MAX_FRAME];
+        for (int i = 0; i < PROXY_READ_BURST; i++)
+        {
+            sockaddr_in from{};
+            int fromLen = sizeof(from);
+            int n = recvfrom(mListen, buf, sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+            if (n == SOCKET_ERROR)
+            {
+                // WSAECONNRESET : 이전 sendto 에 대한 ICMP port unreachable, 무시하고 계속
+                if (WSAGetLastError() == WSAECONNRESET)
+                    continue;
+                return;
+            }
+
+            Flow* f = FindOrCreateUdpFlow(from);
+            if (!f)
+                continue;
+            f->lastActiveUs = now;
+            Schedule(*f, DIR_UP, std::make_shared<std::vector<char>>(buf, buf + n), false, now);
+        }
+    }
+
+    void ReadUdpServer(Flow& f, int64_t now)
+    {
+        char buf[PROXY_MAX_FRAME];
+        for (int i = 0; i < PROXY_READ_BURST; i++)
+        {
+            int n = recv(f.server, buf, sizeof(buf), 0);
+            if (n == SOCKET_ERROR)
+            {
+                if (WSAGetLastError() == WSAECONNRESET)
+                    continue;
+                return;
+            }
+
+            f.lastActiveUs = now;
+            Schedule(f, DIR_DOWN, std::make_shared<std::vector<char>>(buf, buf + n), false, now);
+        }
+    }
+
+    Flow* FindOrCreateUdpFlow(const sockaddr_in& from)
+    {
+        const uint64_t key = AddrKey(from);
+        auto it = mUdpByAddr.find(key);
+        if (it != mUdpByAddr.end())
+            return mFlows[it->second].get();
+
+        SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (s == INVALID_SOCKET)
+            return nullptr;
+        // connect : 서버 주소에서 온 데이터그램만 받는다
+        if (connect(s, (sockaddr*)&mServerAddr, sizeof(mServerAddr)) == SOCKET_ERROR)
+        {
+            closesocket(s);
+            return nullptr;
+        }
+        SetNonBlocking(s);
+
+        std::unique_ptr<Flow> f(new Flow());
+        f->id = ++mNextFlowId;
+        f->server = s;
+        f->connected = true;
+        f->clientAddr = from;
+        Flow* raw = f.get();
+        mUdpByAddr[key] = f->id;
+        mFlows[f->id] = std::move(f);
+        mFlowsOpened++;
+        return raw;
+    }
+
+    void SweepIdleUdp(int64_t now)
+    {
+        std::vector<uint32_t> idle;
+        for (const auto& kv : mFlows)
+        {
+            if (now - kv.second->lastActiveUs > PROXY_UDP_IDLE_SEC * 1000000LL)
+                idle.push_back(kv.first);
+        }
+        for (uint32_t id : idle)
+            CloseFlow(id);
+    }
+
+    void CloseFlow(uint32_t id)
+    {
+        auto it = mFlows.find(id);
+        if (it == mFlows.end())
+            return;
+
+        Flow& f = *it->second;
+        if (f.client != INVALID_SOCKET)
+            closesocket(f.client);
+        if (f.server != INVALID_SOCKET)
+            closesocket(f.server);
+        if (mCfg.udp)
+            mUdpByAddr.erase(AddrKey(f.clientAddr));
+        mFlows.erase(it);
+        mFlowsClosed++;
+    }
+
+    // ---------------------------------------
+    // 통계
+    // ---------------------------------------
+    void Report(bool final)
+    {
+        const int64_t now = NowUs();
+        if (mLastReportUs == 0)
+            mLastReportUs = mStartUs;
+        const double sec = final ? (now - mStartUs) / 1e6 : (now - mLastReportUs) / 1e6;
+
+        std::cout << (final ? "[impair] 누적" : "[impair] 구간") << " 흐름 " << mFlows.size()
+            << " (열림 " << mFlowsOpened << " / 닫힘 " << mFlowsClosed << ")" << std::endl;
+
+        for (int d = 0; d < DIR_COUNT; d++)
+        {
+            const ImpairStats& cur = mImpair[d]->stats;
+            ImpairStats diff = cur;
+            if (!final)
+            {
+                const ImpairStats& prev = mPrev[d];
+                diff.in -= prev.in;
+                diff.forwarded -= prev.forwarded;
+                diff.lostRandom -= prev.lostRandom;
+                diff.lostBurst -= prev.lostBurst;
+                diff.lostQueue -= prev.lostQueue;
+                diff.reordered -= prev.reordered;
+                diff.sendFailed -= prev.sendFailed;
+                diff.bytesOut -= prev.bytesOut;
+                diff.addedUsSum -= prev.addedUsSum;
+                mPrev[d] = cur;
+            }
+
+            char line[320];
+            snprintf(line, sizeof(line),
+                "[impair]   %-4s 입력 %llu 전달 %llu 손실 %llu/%llu/%llu (무작위/버스트/큐) 순서변경 %llu"
+                " 송신실패 %llu 추가지연 평균 %.1fms %.0fkbps",
+                kDirNames[d], (unsigned long long)diff.in, (unsigned long long)diff.forwarded,
+                (unsigned long long)diff.lostRandom, (unsigned long long)diff.lostBurst,
+                (unsigned long long)diff.lostQueue, (unsigned long long)diff.reordered,
+                (unsigned long long)diff.sendFailed,
+                diff.forwarded ? diff.addedUsSum / 1000.0 / diff.forwarded : 0.0,
+                sec > 0 ? diff.bytesOut * 8.0 / 1000.0 / sec : 0.0);
+            std::cout << line << std::endl;
+        }
+        mLastReportUs = now;
+    }
+
+    ProxyConfig mCfg;
+    SOCKET mListen = INVALID_SOCKET;
+    sockaddr_in mServerAddr{};
+    std::unique_ptr<Impairment> mImpair[DIR_COUNT];
+    ImpairStats mPrev[DIR_COUNT];
+
+    std::map<uint32_t, std::unique_ptr<Flow>> mFlows;
+    std::map<uint64_t, uint32_t> mUdpByAddr;
+    uint32_t mNextFlowId = 0;
+    uint64_t mFlowsOpened = 0;
+    uint64_t mFlowsClosed = 0;
+
+    std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> mHeap;
+    uint64_t mSeq = 0;
+
+    int64_t mStartUs = NowUs();
+    int64_t mLastReportUs = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    ProxyConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : ImpairProxy.exe [--listen N] [--server IP] [--port N] [--udp] [--scenario 파일]"
+            " [--up k=v,k=v] [--down k=v,...] [--both k=v,...] [--seed N] [--report-sec N]" << std::endl;
+        return 1;
+    }
+
+    // 명령행 파라미터가 시각 0 의 첫 단계, 시나리오 파일이 그 뒤
+    std::vector<ScenarioStep> steps;
+    if (!cfg.initial.kv.empty())
+        steps.push_back(cfg.initial);
+    if (!cfg.scenarioPath.empty() && !LoadScenario(cfg.scenarioPath, steps))
+        return 1;
+
+    WSADATA wsa{};
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        std::cerr << "[impair] WSAStartup 실패" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, SignalHandler);
+
+    // 전달 시각 해상도 1ms
+    timeBeginPeriod(1);
+
+    {
+        ImpairProxy proxy(cfg);
+        if (!proxy.Open())
+        {
+            std::cerr << "[impair] 포트 " << cfg.listenPort << " 열기 실패: " << WSAGetLastError() << std::endl;
+        }
+        else
+        {
+            std::cout << "[impair] " << (cfg.udp ? "UDP" : "TCP") << " 127.0.0.1:" << cfg.listenPort << " -> "
+                << cfg.serverIp << ":" << cfg.serverPort << " (시나리오 단계 " << steps.size()
+                << ", seed " << cfg.seed << ")" << std::endl;
+            setThreadName("impair-reactor");
+            proxy.Run(steps);
+        }
+    }
+
+    timeEndPeriod(1);
+    WSACleanup();
+    return 0;
+}
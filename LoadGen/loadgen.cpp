@@ -0,0 +1,636 @@
+﻿// =============================
+//      loadgen.cpp
+//      Date : 2026-10-17
+// =============================
+// 헤드리스 부하 생성기
+//  - 하나의 프로세스 / 하나의 이벤트 루프(WSAPoll)에서 수천 개의 가상 클라이언트 접속
+//  - 가상 클라이언트는 발화/무음이 번갈아 나오는 talk-spurt 패턴으로 20ms 프레임 송신
+//  - 측정용 probe 클라이언트는 오디오 마커 레인에 seq 를 실어 보내고,
+//    모든 수신 프레임에서 마커를 찾아 mouth-to-ear 지연과 프레임 누락을 계산한다
+//
+//  - --talk-ratio 0 이면 probe 외에는 말하지 않는 청취자만 (서버 대기 청취자 / 접속당 메모리 측정용)
+//
+//  사용법 : LoadGen.exe [--server IP] [--port N] [--clients N] [--seconds N]
+//                       [--probes N] [--talk-ratio R] [--talk-sec S] [--ramp N]
+// =============================
+#include "../core/core.h"
+#include "../core/marker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <memory>
+#include <random>
+
+// -------------------------------------------
+// 상수
+// -------------------------------------------
+#define LOADGEN_TICK_MS 20							// 프레임 주기 (AUDIO_BUFFER_SIZE = 20ms)
+#define LOADGEN_PROBE_WINDOW 1024				// 레인별 송신 시각 보관 개수 (seq % window)
+#define LOADGEN_TONES 50								// 합성 톤 종류
+#define LOADGEN_TONE_AMPLITUDE 300				// 수천 명이 더해져도 포화가 덜 나도록 작게
+#define LOADGEN_CONNECT_TIMEOUT_MS 5000
+#define LAT_BUCKET_US 100								// 지연 히스토그램 해상도 (0.1ms)
+#define LAT_BUCKETS 20000								// 0 ~ 2초, 초과분은 마지막 버킷
+
+// -------------------------------------------
+// 설정
+// -------------------------------------------
+struct LoadGenConfig
+{
+    std::string serverIp = "127.0.0.1";
+    int port = PORT;
+    int clients = 1000;
+    int seconds = 60;
+    int probes = MARKER_LANES;              // 마커를 싣는 측정용 클라이언트 수 (항상 발화)
+    double talkRatio = 0.1;                     // 평균 발화 비율 (0 = 청취만)
+    double talkSec = 1.0;                       // 평균 발화 구간 길이 (지수 분포)
+    int rampPerSec = 500;                      // 초당 신규 접속 수
+};
+
+static std::atomic<bool> gRunning{ true };
+
+static void SignalHandler(int) { gRunning = false; }
+
+// -------------------------------------------
+// 지연 히스토그램 (고정 0.1ms 버킷)
+// -------------------------------------------
+struct LatencyHistogram
+{
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LAT_BUCKETS, 0);
+    uint64_t count = 0;
+    int64_t maxUs = 0;
+
+    void Record(int64_t us)
+    {
+        if (us < 0)
+            us = 0;
+        size_t b = (size_t)(us / LAT_BUCKET_US);
+        if (b >= LAT_BUCKETS)
+            b = LAT_BUCKETS - 1;
+        buckets[b]++;
+        count++;
+        maxUs = (std::max)(maxUs, us);
+    }
+
+    // q : 0.0 ~ 1.0, 결과는 ms
+    double PercentileMs(double q) const
+    {
+        if (count == 0)
+            return 0.0;
+        uint64_t target = (uint64_t)std::ceil(q * count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); b++)
+        {
+            seen += buckets[b];
+            if (seen >= target)
+                return (b + 1) * LAT_BUCKET_US / 1000.0;
+        }
+        return maxUs / 1000.0;
+    }
+
+    void Reset()
+    {
+        std::fill(buckets.begin(), buckets.end(), 0);
+        count = 0;
+        maxUs = 0;
+    }
+};
+
+// -------------------------------------------
+// 가상 클라이언트
+// -------------------------------------------
+enum class VcState
+{
+    Idle,
+    Connecting,
+    Connected,
+    Closed
+};
+
+struct VirtualClient
+{
+    SOCKET sock = INVALID_SOCKET;
+    VcState state = VcState::Idle;
+    int64_t connectStartUs = 0;
+
+    int lane = -1;                               // probe 이면 마커 레인 번호
+    int tone = 0;
+    bool talking = false;
+    int64_t nextToggleUs = 0;
+
+    FrameSendState tx;
+    char txBuf[AUDIO_BUFFER_SIZE];
+    FrameRecvState rx;
+    char rxBuf[AUDIO_BUFFER_SIZE];
+    uint16_t lastSeq = 0;                     // 레인 0 기준 마지막으로 본 seq
+
+    uint64_t framesSent = 0;
+    uint64_t framesRecv = 0;
+    uint64_t sendStalls = 0;                 // 이전 프레임이 아직 송신 중이라 건너뛴 프레임
+    uint64_t drops = 0;                         // probe seq 누락 수
+};
+
+struct ProbeSlot
+{
+    uint16_t seq = 0;
+    int64_t sentUs = 0;
+};
+
+static int64_t NowUs()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void TuneSocket(SOCKET s)
+{
+    int flag = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+}
+
+static bool ParseArgs(int argc, char* argv[], LoadGenConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (i + 1 >= argc)
+            return false;
+
+        std::string v = argv[++i];
+        if (a == "--server") cfg.serverIp = v;
+        else if (a == "--port") cfg.port = std::stoi(v);
+        else if (a == "--clients") cfg.clients = std::stoi(v);
+        else if (a == "--seconds") cfg.seconds = std::stoi(v);
+        else if (a == "--probes") cfg.probes = (std::min)(std::stoi(v), MARKER_LANES);
+        else if (a == "--talk-ratio") cfg.talkRatio = std::stod(v);
+        else if (a == "--talk-sec") cfg.talkSec = std::stod(v);
+        else if (a == "--ramp") cfg.rampPerSec = std::stoi(v);
+        else return false;
+    }
+    cfg.probes = (std::min)(cfg.probes, cfg.clients);
+    if (cfg.talkRatio > 0.0)
+        cfg.talkRatio = (std::min)((std::max)(cfg.talkRatio, 0.001), 1.0);
+    else
+        cfg.talkRatio = 0.0;
+    return true;
+}
+
+// -------------------------------------------
+// LoadGen
+//  - 모든 가상 클라이언트 상태와 이벤트 루프를 보유
+// -------------------------------------------
+class LoadGen
+{
+public:
+    explicit LoadGen(const LoadGenConfig& cfg)
+        : mCfg(cfg), mClients(cfg.clients), mPoll(cfg.clients), mRng(12345)
+    {
+        // 합성 톤 : 48kHz stereo 20ms
+        mTones.resize(LOADGEN_TONES * AUDIO_BUFFER_SIZE / sizeof(int16_t));
+        const int frames = AUDIO_BUFFER_SIZE / (int)sizeof(int16_t) / 2;
+        for (int t = 0; t < LOADGEN_TONES; t++)
+        {
+            int16_t* pcm = &mTones[t * AUDIO_BUFFER_SIZE / sizeof(int16_t)];
+            const double hz = 150.0 + t * 10.0;
+            for (int n = 0; n < frames; n++)
+            {
+                int16_t v = (int16_t)(LOADGEN_TONE_AMPLITUDE * std::sin(2.0 * 3.14159265358979 * hz * n / 48000.0));
+                pcm[n * 2] = v;
+                pcm[n * 2 + 1] = v;
+            }
+        }
+
+        for (int i = 0; i < cfg.clients; i++)
+        {
+            mClients[i].tone = i % LOADGEN_TONES;
+            mClients[i].lane = i < cfg.probes ? i : -1;
+            mPoll[i].fd = INVALID_SOCKET;
+            mPoll[i].events = 0;
+        }
+
+        inet_pton(AF_INET, cfg.serverIp.c_str(), &mAddr.sin_addr);
+        mAddr.sin_family = AF_INET;
+        mAddr.sin_port = htons((unsigned short)cfg.port);
+    }
+
+    void Run()
+    {
+        const int64_t start = NowUs();
+        const int64_t end = start + (int64_t)mCfg.seconds * 1000000;
+        int64_t nextTick = start;
+        int64_t nextReport = start + 1000000;
+        int opened = 0;
+
+        while (gRunning && NowUs() < end)
+        {
+            int64_t now = NowUs();
+
+            // 1. 접속 램프업
+            const int target = (std::min)(mCfg.clients, (int)((now - start) * mCfg.rampPerSec / 1000000) + 1);
+            while (opened < target)
+                Open(opened++, now);
+
+            // 2. 다음 tick 까지 소켓 이벤트 대기
+            int waitMs = (int)(std::max<int64_t>)(0, (nextTick - now) / 1000);
+            int n = WSAPoll(mPoll.data(), (ULONG)mPoll.size(), waitMs);
+            if (n == SOCKET_ERROR)
+            {
+                std::cerr << "[loadgen] WSAPoll 실패: " << WSAGetLastError() << std::endl;
+                break;
+            }
+
+            now = NowUs();
+            if (n > 0)
+            {
+                for (size_t i = 0; i < mPoll.size(); i++)
+                {
+                    if (mPoll[i].revents)
+                        HandleEvents((int)i, mPoll[i].revents, now);
+                }
+            }
+
+            // 3. 프레임 tick (늦었으면 밀린 만큼 따라잡지 않고 한 번만)
+            if (now >= nextTick)
+            {
+                Tick(now);
+                nextTick += LOADGEN_TICK_MS * 1000;
+                if (nextTick < now)
+                    nextTick = now + LOADGEN_TICK_MS * 1000;
+            }
+
+            // 4. 1초 보고
+            if (now >= nextReport)
+            {
+                Report((now - start) / 1000000);
+                nextReport += 1000000;
+            }
+        }
+
+        Summary((NowUs() - start) / 1e6);
+    }
+
+private:
+    void Open(int i, int64_t now)
+    {
+        VirtualClient& c = mClients[i];
+        c.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (c.sock == INVALID_SOCKET)
+        {
+            mConnectFailures++;
+            c.state = VcState::Closed;
+            return;
+        }
+
+        u_long nb = 1;
+        ioctlsocket(c.sock, FIONBIO, &nb);
+
+        if (connect(c.sock, (sockaddr*)&mAddr, sizeof(mAddr)) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)
+        {
+            Close(i, true);
+            return;
+        }
+
+        c.state = VcState::Connecting;
+        c.connectStartUs = now;
+        mPoll[i].fd = c.sock;
+        mPoll[i].events = POLLWRNORM;
+    }
+
+    void Close(int i, bool failed)
+    {
+        VirtualClient& c = mClients[i];
+        if (c.sock != INVALID_SOCKET)
+            closesocket(c.sock);
+        if (failed)
+            mConnectFailures++;
+        else if (c.state == VcState::Connected)
+            mDisconnects++;
+
+        c.sock = INVALID_SOCKET;
+        c.state = VcState::Closed;
+        mPoll[i].fd = INVALID_SOCKET;
+        mPoll[i].events = 0;
+        mPoll[i].revents = 0;
+    }
+
+    void HandleEvents(int i, short revents, int64_t now)
+    {
+        VirtualClient& c = mClients[i];
+
+        if (c.state == VcState::Connecting)
+        {
+            int err = 0;
+            int len = sizeof(err);
+            getsockopt(c.sock, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+            if (err != 0 || (revents & (POLLERR | POLLHUP | POLLNVAL)))
+            {
+                Close(i, true);
+                return;
+            }
+
+            TuneSocket(c.sock);
+            c.state = VcState::Connected;
+            mConnected++;
+            ScheduleTalk(c, now, true);
+            UpdatePollEvents(i);
+            return;
+        }
+
+        if (c.state != VcState::Connected)
+            return;
+
+        // 수신 (POLLHUP 과 함께 온 잔여 데이터도 먼저 읽는다)
+        if (revents & (POLLRDNORM | POLLHUP | POLLERR))
+        {
+            if (!PumpRecv(c, now))
+            {
+                Close(i, false);
+                return;
+            }
+        }
+
+        if ((revents & POLLWRNORM) && c.tx.busy)
+        {
+            if (sendFrameNB(c.sock, c.tx) == FRAME_IO_ERROR)
+            {
+                Close(i, false);
+                return;
+            }
+        }
+
+        UpdatePollEvents(i);
+    }
+
+    void UpdatePollEvents(int i)
+    {
+        mPoll[i].events = POLLRDNORM | (mClients[i].tx.busy ? POLLWRNORM : 0);
+    }
+
+    bool PumpRecv(VirtualClient& c, int64_t now)
+    {
+        for (;;)
+        {
+            int r = recvFrameNB(c.sock, c.rx, c.rxBuf, AUDIO_BUFFER_SIZE);
+            if (r == FRAME_IO_PENDING)
+                return true;
+            if (r == FRAME_IO_ERROR)
+                return false;
+
+            const uint32_t len = c.rx.len;
+            c.rx = FrameRecvState{};
+            mIntervalBytesRecv += len + sizeof(uint32_t);
+            if (!isAudioFrame(len))
+                continue;
+
+            c.framesRecv++;
+            mIntervalFramesRecv++;
+            InspectMarkers(c, (const int16_t*)c.rxBuf, now);
+        }
+    }
+
+    // 수신 프레임의 모든 probe 레인을 확인해 지연 기록, 레인 0 의 seq 누락은 drop 으로 센다
+    void InspectMarkers(VirtualClient& c, const int16_t* pcm, int64_t now)
+    {
+        for (int lane = 0; lane < mCfg.probes; lane++)
+        {
+            uint16_t seq = 0;
+            if (!ReadMarker(pcm, lane, seq))
+                continue;
+
+            const ProbeSlot& slot = mProbeSlots[lane][seq % LOADGEN_PROBE_WINDOW];
+            if (slot.seq == seq)
+            {
+                mTotalLatency.Record(now - slot.sentUs);
+                mIntervalLatency.Record(now - slot.sentUs);
+            }
+
+            if (lane == 0)
+            {
+                if (c.lastSeq != 0 && seq != NextMarkerSeq(c.lastSeq))
+                {
+                    int gap = ((int)seq - (int)c.lastSeq - 1 + MARKER_SEQ_MAX) % MARKER_SEQ_MAX;
+                    c.drops += gap;
+                    mIntervalDrops += gap;
+                }
+                c.lastSeq = seq;
+            }
+        }
+    }
+
+    // 발화 / 무음 전환 시각 예약 (지수 분포)
+    void ScheduleTalk(VirtualClient& c, int64_t now, bool initial)
+    {
+        if (c.lane >= 0)
+        {
+            c.talking = true;
+            c.nextToggleUs = INT64_MAX;
+            return;
+        }
+
+        // 청취 전용 (--talk-ratio 0)
+        if (mCfg.talkRatio <= 0.0)
+        {
+            c.talking = false;
+            c.nextToggleUs = INT64_MAX;
+            return;
+        }
+
+        if (initial)
+        {
+            std::bernoulli_distribution pick(mCfg.talkRatio);
+            c.talking = pick(mRng);
+        }
+
+        const double silenceSec = mCfg.talkSec * (1.0 - mCfg.talkRatio) / mCfg.talkRatio;
+        std::exponential_distribution<double> dist(1.0 / (c.talking ? mCfg.talkSec : silenceSec));
+        c.nextToggleUs = now + (int64_t)(dist(mRng) * 1e6);
+    }
+
+    void Tick(int64_t now)
+    {
+        for (size_t i = 0; i < mClients.size(); i++)
+        {
+            VirtualClient& c = mClients[i];
+            if (c.state == VcState::Connected && c.nextToggleUs <= now)
+            {
+                const bool wasTalking = c.talking;
+                c.talking = !c.talking;
+                ScheduleTalk(c, now, false);
+
+                // 발화 종료 : 실제 클라이언트처럼 DTX 마커 송신
+                if (wasTalking && !c.tx.busy)
+                {
+                    beginSendFrame(c.tx, c.txBuf, buildDtxFrame(c.txBuf, -60.0f));
+                    if (!SendNow((int)i))
+                        continue;
+                }
+            }
+
+            if (c.state == VcState::Connected && c.talking)
+                SendAudio((int)i, now);
+        }
+    }
+
+    void SendAudio(int i, int64_t now)
+    {
+        VirtualClient& c = mClients[i];
+        if (c.tx.busy)
+        {
+            c.sendStalls++;
+            return;
+        }
+
+        int16_t* pcm = (int16_t*)c.txBuf;
+        memcpy(pcm, &mTones[c.tone * AUDIO_BUFFER_SIZE / sizeof(int16_t)], AUDIO_BUFFER_SIZE);
+        ClearMarkerLanes(pcm);
+
+        if (c.lane >= 0)
+        {
+            mProbeSeq[c.lane] = NextMarkerSeq(mProbeSeq[c.lane]);
+            const uint16_t seq = mProbeSeq[c.lane];
+            WriteMarker(pcm, c.lane, seq);
+            ProbeSlot& slot = mProbeSlots[c.lane][seq % LOADGEN_PROBE_WINDOW];
+            slot.seq = seq;
+            slot.sentUs = now;
+        }
+
+        beginSendFrame(c.tx, c.txBuf, AUDIO_BUFFER_SIZE);
+        if (SendNow(i))
+        {
+            c.framesSent++;
+            mIntervalFramesSent++;
+        }
+    }
+
+    bool SendNow(int i)
+    {
+        VirtualClient& c = mClients[i];
+        if (sendFrameNB(c.sock, c.tx) == FRAME_IO_ERROR)
+        {
+            Close(i, false);
+            return false;
+        }
+        UpdatePollEvents(i);
+        return true;
+    }
+
+    void Report(int64_t sec)
+    {
+        // 접속 타임아웃 정리
+        const int64_t now = NowUs();
+        for (size_t i = 0; i < mClients.size(); i++)
+        {
+            if (mClients[i].state == VcState::Connecting && now - mClients[i].connectStartUs > LOADGEN_CONNECT_TIMEOUT_MS * 1000LL)
+                Close((int)i, true);
+        }
+
+        std::cout << "[loadgen] t=" << sec << "s 접속 " << (mConnected - mDisconnects) << "/" << mCfg.clients
+            << " 송신 " << mIntervalFramesSent << " fps"
+            << " 수신 " << mIntervalFramesRecv << " fps (" << (mIntervalBytesRecv / 1048576.0) << " MB/s)"
+            << " 지연 p50 " << mIntervalLatency.PercentileMs(0.50) << "ms"
+            << " p99 " << mIntervalLatency.PercentileMs(0.99) << "ms"
+            << " drop " << mIntervalDrops << std::endl;
+
+        mTotalFramesSent += mIntervalFramesSent;
+        mTotalFramesRecv += mIntervalFramesRecv;
+        mTotalBytesRecv += mIntervalBytesRecv;
+        mIntervalFramesSent = mIntervalFramesRecv = mIntervalBytesRecv = mIntervalDrops = 0;
+        mIntervalLatency.Reset();
+    }
+
+    void Summary(double elapsedSec)
+    {
+        mTotalFramesSent += mIntervalFramesSent;
+        mTotalFramesRecv += mIntervalFramesRecv;
+        mTotalBytesRecv += mIntervalBytesRecv;
+
+        uint64_t totalDrops = 0, totalStalls = 0;
+        int clientsWithDrops = 0;
+        std::vector<int> order;
+        for (size_t i = 0; i < mClients.size(); i++)
+        {
+            totalDrops += mClients[i].drops;
+            totalStalls += mClients[i].sendStalls;
+            if (mClients[i].drops > 0)
+            {
+                clientsWithDrops++;
+                order.push_back((int)i);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return mClients[a].drops > mClients[b].drops; });
+
+        std::cout << std::endl << "// ───────────────────────────────" << std::endl;
+        std::cout << "// loadgen 결과 (" << elapsedSec << " 초)" << std::endl;
+        std::cout << "//    접속 성공 " << mConnected << " / 실패 " << mConnectFailures << " / 도중 종료 " << mDisconnects << std::endl;
+        std::cout << "//    서버 ingest  " << (mTotalFramesSent / elapsedSec) << " fps" << std::endl;
+        std::cout << "//    서버 fan-out " << (mTotalFramesRecv / elapsedSec) << " fps ("
+            << (mTotalBytesRecv / elapsedSec / 1048576.0) << " MB/s)" << std::endl;
+        std::cout << "//    mouth-to-ear (ms) p50 " << mTotalLatency.PercentileMs(0.50)
+            << " p90 " << mTotalLatency.PercentileMs(0.90)
+            << " p99 " << mTotalLatency.PercentileMs(0.99)
+            << " p99.9 " << mTotalLatency.PercentileMs(0.999)
+            << " max " << (mTotalLatency.maxUs / 1000.0)
+            << " (표본 " << mTotalLatency.count << ")" << std::endl;
+        std::cout << "//    drop 합계 " << totalDrops << " (drop 발생 클라이언트 " << clientsWithDrops << " 명)"
+            << ", 송신 지연으로 건너뛴 프레임 " << totalStalls << std::endl;
+
+        for (size_t k = 0; k < order.size() && k < 10; k++)
+        {
+            const VirtualClient& c = mClients[order[k]];
+            std::cout << "//      client#" << order[k] << " drop " << c.drops << " 수신 " << c.framesRecv << std::endl;
+        }
+        std::cout << "// ───────────────────────────────" << std::endl;
+    }
+
+    LoadGenConfig mCfg;
+    std::vector<VirtualClient> mClients;
+    std::vector<WSAPOLLFD> mPoll;
+    std::vector<int16_t> mTones;
+    sockaddr_in mAddr{};
+    std::mt19937 mRng;
+
+    uint16_t mProbeSeq[MARKER_LANES] = {};
+    ProbeSlot mProbeSlots[MARKER_LANES][LOADGEN_PROBE_WINDOW];
+
+    LatencyHistogram mTotalLatency;
+    LatencyHistogram mIntervalLatency;
+    uint64_t mIntervalFramesSent = 0, mIntervalFramesRecv = 0, mIntervalBytesRecv = 0, mIntervalDrops = 0;
+    uint64_t mTotalFramesSent = 0, mTotalFramesRecv = 0, mTotalBytesRecv = 0;
+    int mConnected = 0, mConnectFailures = 0, mDisconnects = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    LoadGenConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : LoadGen.exe [--server IP] [--port N] [--clients N] [--seconds N]"
+            " [--probes N] [--talk-ratio R] [--talk-sec S] [--ramp N]" << std::endl;
+        return 1;
+    }
+
+    WSADATA wsa{};
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        std::cerr << "[loadgen] WSAStartup 실패" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, SignalHandler);
+
+    // 20ms tick 을 맞추기 위해 타이머 해상도 1ms
+    timeBeginPeriod(1);
+
+    std::cout << "[loadgen] " << cfg.serverIp << ":" << cfg.port << " 에 " << cfg.clients << " 클라이언트, "
+        << cfg.seconds << " 초 (probe " << cfg.probes << ", 발화 비율 " << cfg.talkRatio << ")" << std::endl;
+
+    // VirtualClient 배열이 크므로 힙에 둔다
+    std::unique_ptr<LoadGen> gen(new LoadGen(cfg));
+    setThreadName("loadgen-reactor");
+    gen->Run();
+
+    timeEndPeriod(1);
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,283 @@
+﻿// =============================
+//      mixbench.cpp
+//      Date : 2026-10-17
+// =============================
+// 믹서 마이크로벤치마크
+//  - 서버 MixerThread 의 믹싱 경로(core/mixer.h)만 떼어 내 한 tick 을 반복 측정
+//  - 축 : 입력 스트림 수 / 버스 형식(int16, float) / 커널(scalar, sse2, avx2)
+//         / mix-minus 여부 / 무음 스트림 비율
+//  - 출력 : ns/sample, 20ms tick 당 코어 하나가 감당하는 스트림 수, 추정 메모리 대역폭
+//  - --csv 로 릴리스 간 회귀 추적용 CSV 저장 (--label 에 릴리스 이름)
+//
+//  사용법 : MixBench.exe [--csv 파일] [--label 이름] [--streams 2,10,100]
+//                        [--min-ms N] [--pin-core N]
+// =============================
+#include "../core/core.h"
+#include "../core/mixer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+#define BENCH_TICK_MS 20						// 서버 믹서 tick 주기
+#define BENCH_WARMUP_TICKS 3
+#define BENCH_MIN_TICKS 5
+#define BENCH_SPEECH_AMPLITUDE 2000
+
+struct BenchConfig
+{
+    std::vector<int> streams = { 2, 10, 100, 1000, 10000 };
+    std::vector<double> silentFractions = { 0.0, 0.5, 0.9 };
+    std::string csvPath;
+    std::string label = "dev";
+    int minMs = 200;                        // 케이스당 최소 측정 시간
+    int pinCore = -1;                      // 지정 시 해당 코어에 고정 (측정 잡음 감소)
+};
+
+struct BenchCase
+{
+    int streams;
+    bool floatBus;
+    MixKernelKind kernel;
+    bool mixMinus;
+    double silentFraction;
+};
+
+struct BenchResult
+{
+    double nsPerTick;
+    double nsPerSample;
+    double streamsPerCore;
+    double gbPerSec;
+    int activeStreams;
+};
+
+// -------------------------------------------
+// 측정용 버퍼 (최대 스트림 수 기준으로 한 번만 할당)
+// -------------------------------------------
+struct BenchBuffers
+{
+    std::vector<int16_t> inputs;            // streams * MIX_FRAME_SAMPLES
+    std::vector<int16_t> outputs;          // mix-minus 출력 (스트림별)
+    std::vector<int16_t> bus16;
+    std::vector<float> busF;
+    std::vector<int16_t> common;           // 무음 청취자용 공통 믹스
+    std::vector<int> active;
+
+    explicit BenchBuffers(int maxStreams)
+        : inputs((size_t)maxStreams * MIX_FRAME_SAMPLES),
+        outputs((size_t)maxStreams * MIX_FRAME_SAMPLES),
+        bus16(MIX_FRAME_SAMPLES), busF(MIX_FRAME_SAMPLES), common(MIX_FRAME_SAMPLES)
+    {
+        active.reserve(maxStreams);
+    }
+
+    // 무음 비율에 맞춰 스트림을 고르게 섞어 배치
+    void Fill(int streams, double silentFraction)
+    {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> dist(-BENCH_SPEECH_AMPLITUDE, BENCH_SPEECH_AMPLITUDE);
+        for (int s = 0; s < streams; s++)
+        {
+            int16_t* pcm = &inputs[(size_t)s * MIX_FRAME_SAMPLES];
+            const bool silent = (int)((s + 1) * silentFraction) != (int)(s * silentFraction);
+            for (size_t i = 0; i < MIX_FRAME_SAMPLES; i++)
+                pcm[i] = silent ? 0 : (int16_t)dist(rng);
+        }
+    }
+};
+
+// -------------------------------------------
+// 믹서 tick 한 번
+//  1. 무음 스트림은 건너뛰고 나머지를 버스에 누적
+//  2. 공통 믹스(무음 청취자용) 생성
+//  3. mix-minus : 발화자마다 (전체 - 본인) 출력
+// -------------------------------------------
+static void RunTick(const BenchCase& c, const MixKernelOps& ops, BenchBuffers& b)
+{
+    b.active.clear();
+
+    if (c.floatBus)
+    {
+        std::fill(b.busF.begin(), b.busF.end(), 0.0f);
+        for (int s = 0; s < c.streams; s++)
+        {
+            const int16_t* in = &b.inputs[(size_t)s * MIX_FRAME_SAMPLES];
+            if (ops.isSilent(in, MIX_FRAME_SAMPLES))
+                continue;
+            ops.accum(b.busF.data(), in, MIX_FRAME_SAMPLES);
+            b.active.push_back(s);
+        }
+
+        ops.busToPcm(b.common.data(), b.busF.data(), nullptr, MIX_FRAME_SAMPLES);
+        if (c.mixMinus)
+        {
+            for (int s : b.active)
+                ops.busToPcm(&b.outputs[(size_t)s * MIX_FRAME_SAMPLES], b.busF.data(),
+                    &b.inputs[(size_t)s * MIX_FRAME_SAMPLES], MIX_FRAME_SAMPLES);
+        }
+    }
+    else
+    {
+        std::fill(b.bus16.begin(), b.bus16.end(), (int16_t)0);
+        for (int s = 0; s < c.streams; s++)
+        {
+            const int16_t* in = &b.inputs[(size_t)s * MIX_FRAME_SAMPLES];
+            if (ops.isSilent(in, MIX_FRAME_SAMPLES))
+                continue;
+            ops.add16(b.bus16.data(), in, MIX_FRAME_SAMPLES);
+            b.active.push_back(s);
+        }
+
+        if (c.mixMinus)
+        {
+            for (int s : b.active)
+                ops.sub16(&b.outputs[(size_t)s * MIX_FRAME_SAMPLES], b.bus16.data(),
+                    &b.inputs[(size_t)s * MIX_FRAME_SAMPLES], MIX_FRAME_SAMPLES);
+        }
+    }
+}
+
+// tick 당 메모리 트래픽 추정 (바이트)
+static double EstimateBytes(const BenchCase& c, int active)
+{
+    const double in = (double)AUDIO_BUFFER_SIZE;                // 입력 프레임 1개
+    const double bus = c.floatBus ? in * 2 : in;                // float 버스는 2배
+    double bytes = c.streams * in + active * 2 * bus;            // 입력 읽기 + 버스 read/write
+    if (c.floatBus)
+        bytes += bus + in;                                                // 공통 믹스
+    if (c.mixMinus)
+        bytes += active * (bus + in + in);                           // 버스 + 본인 읽기, 출력 쓰기
+    return bytes;
+}
+
+static BenchResult RunCase(const BenchCase& c, BenchBuffers& b, int minMs)
+{
+    using clock = std::chrono::steady_clock;
+    const MixKernelOps& ops = GetMixKernel(c.kernel);
+
+    b.Fill(c.streams, c.silentFraction);
+    for (int i = 0; i < BENCH_WARMUP_TICKS; i++)
+        RunTick(c, ops, b);
+
+    int ticks = 0;
+    const auto start = clock::now();
+    auto now = start;
+    while (ticks < BENCH_MIN_TICKS || now - start < std::chrono::milliseconds(minMs))
+    {
+        RunTick(c, ops, b);
+        ticks++;
+        now = clock::now();
+    }
+
+    const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    BenchResult r;
+    r.nsPerTick = ns / ticks;
+    r.nsPerSample = r.nsPerTick / ((double)c.streams * MIX_FRAME_SAMPLES);
+    r.streamsPerCore = c.streams * (BENCH_TICK_MS * 1e6) / r.nsPerTick;
+    r.activeStreams = (int)b.active.size();
+    r.gbPerSec = EstimateBytes(c, r.activeStreams) / r.nsPerTick;     // bytes/ns == GB/s
+    return r;
+}
+
+static std::vector<int> ParseIntList(const std::string& s)
+{
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        out.push_back(std::stoi(item));
+    return out;
+}
+
+static bool ParseArgs(int argc, char* argv[], BenchConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (i + 1 >= argc)
+            return false;
+
+        std::string v = argv[++i];
+        if (a == "--csv") cfg.csvPath = v;
+        else if (a == "--label") cfg.label = v;
+        else if (a == "--streams") cfg.streams = ParseIntList(v);
+        else if (a == "--min-ms") cfg.minMs = std::stoi(v);
+        else if (a == "--pin-core") cfg.pinCore = std::stoi(v);
+        else return false;
+    }
+    return !cfg.streams.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : MixBench.exe [--csv 파일] [--label 이름] [--streams 2,10,100] [--min-ms N] [--pin-core N]" << std::endl;
+        return 1;
+    }
+
+    if (cfg.pinCore >= 0)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cfg.pinCore);
+
+    std::ofstream csv;
+    if (!cfg.csvPath.empty())
+    {
+        csv.open(cfg.csvPath);
+        if (!csv)
+        {
+            std::cerr << "[mixbench] CSV 파일 열기 실패: " << cfg.csvPath << std::endl;
+            return 1;
+        }
+        csv << "label,streams,bus,kernel,mix_minus,silent_fraction,active_streams,"
+            "ns_per_tick,ns_per_sample,streams_per_core_20ms,est_gb_per_s" << std::endl;
+    }
+
+    const int maxStreams = *std::max_element(cfg.streams.begin(), cfg.streams.end());
+    std::unique_ptr<BenchBuffers> buffers(new BenchBuffers(maxStreams));
+
+    std::cout << "streams  bus    kernel  mix-  silent   ns/tick      ns/sample  streams/core  GB/s" << std::endl;
+
+    for (int streams : cfg.streams)
+    {
+        for (int floatBus = 0; floatBus < 2; floatBus++)
+        {
+            for (int k = 0; k < MIX_KERNEL_COUNT; k++)
+            {
+                if (!MixKernelSupported((MixKernelKind)k))
+                    continue;
+
+                for (int mixMinus = 0; mixMinus < 2; mixMinus++)
+                {
+                    for (double silent : cfg.silentFractions)
+                    {
+                        BenchCase c{ streams, floatBus != 0, (MixKernelKind)k, mixMinus != 0, silent };
+                        BenchResult r = RunCase(c, *buffers, cfg.minMs);
+                        const char* bus = c.floatBus ? "float" : "int16";
+                        const char* kernel = GetMixKernel(c.kernel).name;
+
+                        char line[160];
+                        snprintf(line, sizeof(line), "%7d  %-5s  %-6s  %-4s  %5.2f  %11.0f  %9.3f  %12.0f  %5.2f",
+                            streams, bus, kernel, c.mixMinus ? "on" : "off", silent,
+                            r.nsPerTick, r.nsPerSample, r.streamsPerCore, r.gbPerSec);
+                        std::cout << line << std::endl;
+
+                        if (csv)
+                        {
+                            csv << cfg.label << "," << streams << "," << bus << "," << kernel << ","
+                                << (c.mixMinus ? 1 : 0) << "," << silent << "," << r.activeStreams << ","
+                                << r.nsPerTick << "," << r.nsPerSample << "," << r.streamsPerCore << ","
+                                << r.gbPerSec << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,447 @@
+﻿// =============================
+//      netbench.cpp
+//      Date : 2026-10-17
+// =============================
+// 프레이밍 송수신 마이크로벤치마크
+//  - core/core.h 의 길이-프리픽스 송수신을 루프백 TCP 소켓 쌍 위에서 반복 측정
+//  - 송신 : sendFrame (헤더 / payload 따로 send) / sendFrameGather (WSASend 한 번)
+//           / sendFramesGather (밀린 프레임을 한 번에 묶어 WSASend)
+//  - 수신 : recvFrame (헤더 / payload 따로 recv) / FrameReader (버퍼 하나로 여러 프레임)
+//  - 축 : 프레임 크기 / 밀림 깊이 (수신 측 확인 전에 송신 측이 연속으로 보내는 프레임 수)
+//  - 출력 : 프레임당 벽시계 ns, 송신 / 수신 측 소켓 호출 수와 CPU ns,
+//           코어 하나가 감당하는 초당 프레임 수 (1e9 / 프레임당 CPU ns)
+//  - 소켓 호출 수는 GAC_SOCKET_COUNTERS 래퍼 카운터로 센다 (커널 추적 도구 없이)
+//  - --csv 로 릴리스 간 회귀 추적용 CSV 저장 (--label 에 릴리스 이름)
+//
+//  사용법 : NetBench.exe [--csv 파일] [--label 이름] [--sizes 64,3840] [--depths 1,4,16]
+//                        [--min-ms N] [--sockbuf 바이트 (0 = OS 기본값)]
+// =============================
+#define GAC_SOCKET_COUNTERS 1
+
+#include "../core/core.h"
+#include "../core/thread_stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#define BENCH_PROBE_FRAMES 256					// 반복 횟수를 정하기 위한 예비 측정 프레임 수
+#define BENCH_MIN_BURSTS 8
+#define BENCH_FILL_BYTE 0x5A
+
+enum SendKind
+{
+    SEND_FRAME,                             // sendFrame
+    SEND_GATHER,                            // sendFrameGather
+    SEND_BATCH,                             // sendFramesGather (밀림 깊이만큼 묶음)
+    SEND_KIND_COUNT
+};
+
+enum RecvKind
+{
+    RECV_FRAME,                             // recvFrame
+    RECV_READER,                            // FrameReader
+    RECV_KIND_COUNT
+};
+
+static const char* kSendNames[SEND_KIND_COUNT] = { "frame", "gather", "batch" };
+static const char* kRecvNames[RECV_KIND_COUNT] = { "frame", "reader" };
+
+struct BenchConfig
+{
+    std::vector<int> sizes = { 64, CTRL_MAX_FRAME, AUDIO_BUFFER_SIZE, 16384 };
+    std::vector<int> depths = { 1, 4, 16, 64 };
+    std::string csvPath;
+    std::string label = "dev";
+    int minMs = 200;                        // 케이스당 최소 측정 시간
+    int sockBuf = 32 * 1024;               // 서버 / 클라이언트 TuneSocket 과 같은 값
+};
+
+struct BenchCase
+{
+    int size;
+    int depth;
+    SendKind send;
+    RecvKind recv;
+};
+
+// 한 쪽 스레드가 측정한 값
+struct SideStats
+{
+    uint64_t calls = 0;                     // 소켓 호출 수
+    uint64_t cycles = 0;                    // 스레드 CPU 사이클
+    bool ok = true;
+};
+
+struct BenchResult
+{
+    double nsPerFrame;                      // 벽시계
+    double sendCallsPerFrame;
+    double recvCallsPerFrame;
+    double sendCpuNs;                       // 프레임당 송신 스레드 CPU ns
+    double recvCpuNs;
+    double sendFpsPerCore;
+    double recvFpsPerCore;
+};
+
+// -------------------------------------------
+// 루프백 소켓 쌍
+//  - 127.0.0.1 임의 포트에 listen → connect → accept
+//  - 양쪽 모두 Nagle 끔 (서버 / 클라이언트와 같은 조건)
+// -------------------------------------------
+static void TuneSocket(SOCKET s, int sockBuf)
+{
+    int flag = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+
+    if (sockBuf > 0)
+    {
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&sockBuf, sizeof(sockBuf));
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&sockBuf, sizeof(sockBuf));
+    }
+}
+
+static bool MakeLoopbackPair(SOCKET& sender, SOCKET& receiver, int sockBuf)
+{
+    sender = receiver = INVALID_SOCKET;
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+        return false;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    int addrLen = sizeof(addr);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(listener, 1) == SOCKET_ERROR ||
+        getsockname(listener, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR)
+    {
+        closesocket(listener);
+        return false;
+    }
+
+    sender = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sender == INVALID_SOCKET || connect(sender, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR)
+    {
+        closesocket(listener);
+        return false;
+    }
+
+    receiver = accept(listener, nullptr, nullptr);
+    closesocket(listener);
+    if (receiver == INVALID_SOCKET)
+        return false;
+
+    TuneSocket(sender, sockBuf);
+    TuneSocket(receiver, sockBuf);
+    return true;
+}
+
+// -------------------------------------------
+// 밀림 깊이 동기화
+//  - 송신 측은 depth 개를 연속으로 보낸 뒤 수신 측이 모두 꺼낼 때까지 기다린다
+//  - 소켓 버퍼에 쌓이는 프레임이 최대 depth 개로 유지됨
+//    (depth 1 = 프레임마다 왕복, 클수록 서버 송신 큐가 밀린 상황)
+// -------------------------------------------
+struct BurstSync
+{
+    std::mutex m;
+    std::condition_variable cv;
+    uint64_t acked = 0;                     // 수신 측이 다 꺼낸 burst 수
+
+    void Ack()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            acked++;
+        }
+        cv.notify_one();
+    }
+
+    // 수신 실패 : 기다리는 송신 측을 풀어 준다
+    void Abort()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            acked = UINT64_MAX;
+        }
+        cv.notify_one();
+    }
+
+    void WaitFor(uint64_t bursts)
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&] { return acked >= bursts; });
+    }
+};
+
+static bool CheckFrame(const char* data, uint32_t len, const BenchCase& c)
+{
+    return len == (uint32_t)c.size &&
+        (uint8_t)data[0] == BENCH_FILL_BYTE && (uint8_t)data[len - 1] == BENCH_FILL_BYTE;
+}
+
+static void ReceiverThread(SOCKET s, const BenchCase& c, uint64_t bursts, BurstSync& sync, SideStats& out)
+{
+    setThreadName("netbench-recv");
+
+    std::vector<char> frame;
+    FrameReader reader;
+
+    const SocketCallCounts calls0 = socketThreadCounts();
+    const uint64_t cycles0 = threadCyclesNow();
+
+    for (uint64_t b = 0; b < bursts; b++)
+    {
+        for (int i = 0; i < c.depth; i++)
+        {
+            const char* data = nullptr;
+            uint32_t len = 0;
+            if (c.recv == RECV_FRAME)
+            {
+                if (!recvFrame(s, frame))
+                {
+                    out.ok = false;
+                    break;
+                }
+                data = frame.data();
+                len = (uint32_t)frame.size();
+            }
+            else if (!reader.Next(s, data, len))
+            {
+                out.ok = false;
+                break;
+            }
+
+            if (!CheckFrame(data, len, c))
+            {
+                out.ok = false;
+                break;
+            }
+        }
+
+        if (!out.ok)
+        {
+            // 송신 측이 send 에서 막히지 않도록 연결을 끊고 대기를 푼다
+            shutdown(s, SD_BOTH);
+            sync.Abort();
+            break;
+        }
+        sync.Ack();
+    }
+
+    out.cycles = threadCyclesNow() - cycles0;
+    out.calls = socketThreadCounts().recvs - calls0.recvs;
+}
+
+// -------------------------------------------
+// bursts * depth 개 프레임 송수신
+//  - 송신은 호출 스레드, 수신은 별도 스레드
+//  - 반환 : 벽시계 ns (실패 시 -1)
+// -------------------------------------------
+static int64_t RunBursts(SOCKET sender, SOCKET receiver, const BenchCase& c,
+    const std::vector<char>& payload, uint64_t bursts, SideStats& sendStats, SideStats& recvStats)
+{
+    BurstSync sync;
+    recvStats = SideStats();
+    sendStats = SideStats();
+
+    std::vector<const char*> frames((size_t)c.depth, payload.data());
+    std::vector<uint32_t> lens((size_t)c.depth, (uint32_t)c.size);
+
+    std::thread rx(ReceiverThread, receiver, std::cref(c), bursts, std::ref(sync), std::ref(recvStats));
+
+    const SocketCallCounts calls0 = socketThreadCounts();
+    const uint64_t cycles0 = threadCyclesNow();
+    const int64_t start = nowNs();
+
+    for (uint64_t b = 0; b < bursts && sendStats.ok; b++)
+    {
+        if (c.send == SEND_BATCH)
+        {
+            sendStats.ok = sendFramesGather(sender, frames.data(), lens.data(), frames.size());
+        }
+        else
+        {
+            for (int i = 0; i < c.depth && sendStats.ok; i++)
+            {
+                sendStats.ok = c.send == SEND_FRAME
+                    ? sendFrame(sender, payload.data(), (uint32_t)c.size)
+                    : sendFrameGather(sender, payload.data(), (uint32_t)c.size);
+            }
+        }
+
+        if (sendStats.ok)
+            sync.WaitFor(b + 1);
+    }
+
+    const int64_t elapsed = nowNs() - start;
+    sendStats.cycles = threadCyclesNow() - cycles0;
+    sendStats.calls = socketThreadCounts().sends - calls0.sends;
+
+    // 송신 실패 시 수신 스레드가 recv 에서 풀려나도록 연결을 끊는다
+    if (!sendStats.ok)
+        shutdown(sender, SD_BOTH);
+    rx.join();
+
+    return sendStats.ok && recvStats.ok ? elapsed : -1;
+}
+
+static bool RunCase(const BenchCase& c, int minMs, int sockBuf, BenchResult& r)
+{
+    SOCKET sender, receiver;
+    if (!MakeLoopbackPair(sender, receiver, sockBuf))
+    {
+        std::cerr << "[netbench] 루프백 연결 실패: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    const std::vector<char> payload((size_t)c.size, (char)BENCH_FILL_BYTE);
+    SideStats sendStats, recvStats;
+
+    // 1. 예비 측정 (워밍업 겸 burst 당 시간 추정)
+    const uint64_t probeBursts = (std::max)((uint64_t)1, (uint64_t)(BENCH_PROBE_FRAMES / c.depth));
+    const int64_t probeNs = RunBursts(sender, receiver, c, payload, probeBursts, sendStats, recvStats);
+
+    // 2. 최소 측정 시간을 채우는 burst 수로 본 측정
+    int64_t ns = -1;
+    uint64_t bursts = 0;
+    if (probeNs >= 0)
+    {
+        const double perBurst = (std::max)(1.0, (double)probeNs / probeBursts);
+        bursts = (std::max)((uint64_t)BENCH_MIN_BURSTS, (uint64_t)(minMs * 1e6 / perBurst));
+        ns = RunBursts(sender, receiver, c, payload, bursts, sendStats, recvStats);
+    }
+
+    closesocket(sender);
+    closesocket(receiver);
+
+    if (ns < 0)
+    {
+        std::cerr << "[netbench] 송수신 실패 또는 프레임 손상 (size " << c.size << ", depth " << c.depth << ")" << std::endl;
+        return false;
+    }
+
+    const double frames = (double)bursts * c.depth;
+    const double cyclesPerNs = threadCyclesPerNs();
+    r.nsPerFrame = ns / frames;
+    r.sendCallsPerFrame = sendStats.calls / frames;
+    r.recvCallsPerFrame = recvStats.calls / frames;
+    r.sendCpuNs = sendStats.cycles / cyclesPerNs / frames;
+    r.recvCpuNs = recvStats.cycles / cyclesPerNs / frames;
+    r.sendFpsPerCore = r.sendCpuNs > 0 ? 1e9 / r.sendCpuNs : 0.0;
+    r.recvFpsPerCore = r.recvCpuNs > 0 ? 1e9 / r.recvCpuNs : 0.0;
+    return true;
+}
+
+static std::vector<int> ParseIntList(const std::string& s)
+{
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        out.push_back(std::stoi(item));
+    return out;
+}
+
+static bool ParseArgs(int argc, char* argv[], BenchConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (i + 1 >= argc)
+            return false;
+
+        std::string v = argv[++i];
+        if (a == "--csv") cfg.csvPath = v;
+        else if (a == "--label") cfg.label = v;
+        else if (a == "--sizes") cfg.sizes = ParseIntList(v);
+        else if (a == "--depths") cfg.depths = ParseIntList(v);
+        else if (a == "--min-ms") cfg.minMs = std::stoi(v);
+        else if (a == "--sockbuf") cfg.sockBuf = std::stoi(v);
+        else return false;
+    }
+
+    for (int size : cfg.sizes)
+        if (size <= 0 || size > (1 << 24))
+            return false;
+    for (int depth : cfg.depths)
+        if (depth <= 0)
+            return false;
+    return !cfg.sizes.empty() && !cfg.depths.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : NetBench.exe [--csv 파일] [--label 이름] [--sizes 64,3840] [--depths 1,4,16] [--min-ms N] [--sockbuf 바이트]" << std::endl;
+        return 1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        std::cerr << "[netbench] WSAStartup 실패" << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!cfg.csvPath.empty())
+    {
+        csv.open(cfg.csvPath);
+        if (!csv)
+        {
+            std::cerr << "[netbench] CSV 파일 열기 실패: " << cfg.csvPath << std::endl;
+            WSACleanup();
+            return 1;
+        }
+        csv << "label,size,depth,send,recv,ns_per_frame,send_calls_per_frame,recv_calls_per_frame,"
+            "send_cpu_ns,recv_cpu_ns,send_fps_per_core,recv_fps_per_core" << std::endl;
+    }
+
+    std::cout << " size  depth  send    recv    ns/frame  send/f  recv/f  send-cpu  recv-cpu  send-fps/core  recv-fps/core" << std::endl;
+
+    int failures = 0;
+    for (int size : cfg.sizes)
+    {
+        for (int depth : cfg.depths)
+        {
+            for (int sk = 0; sk < SEND_KIND_COUNT; sk++)
+            {
+                for (int rk = 0; rk < RECV_KIND_COUNT; rk++)
+                {
+                    BenchCase c{ size, depth, (SendKind)sk, (RecvKind)rk };
+                    BenchResult r;
+                    if (!RunCase(c, cfg.minMs, cfg.sockBuf, r))
+                    {
+                        failures++;
+                        continue;
+                    }
+
+                    char line[200];
+                    snprintf(line, sizeof(line), "%5d  %5d  %-6s  %-6s  %8.0f  %6.2f  %6.2f  %8.0f  %8.0f  %13.0f  %13.0f",
+                        size, depth, kSendNames[sk], kRecvNames[rk], r.nsPerFrame,
+                        r.sendCallsPerFrame, r.recvCallsPerFrame, r.sendCpuNs, r.recvCpuNs,
+                        r.sendFpsPerCore, r.recvFpsPerCore);
+                    std::cout << line << std::endl;
+
+                    if (csv)
+                    {
+                        csv << cfg.label << "," << size << "," << depth << "," << kSendNames[sk] << ","
+                            << kRecvNames[rk] << "," << r.nsPerFrame << "," << r.sendCallsPerFrame << ","
+                            << r.recvCallsPerFrame << "," << r.sendCpuNs << "," << r.recvCpuNs << ","
+                            << r.sendFpsPerCore << "," << r.recvFpsPerCore << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+    WSACleanup();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+﻿// =============================
+//      replay.cpp
+//      Date : 2026-10-17
+// =============================
+// 캡처 재생기
+//  - 서버 --record 로 만든 .gacap 파일을 네트워크 없이 서버 파이프라인(core/pipeline.h)에 넣는다
+//    (IngestFrame -> 믹서 스레드 RunMixerLoop -> 송신 큐 -> AccountSent, 소켓 송신만 생략)
+//  - 공급 스레드가 캡처 시각에 맞춰 프레임을 넣고, 믹서는 서버와 같은 루프로 따로 돈다
+//  - 기본은 VirtualClock (최대 속도, 결정적), --realtime 이면 SystemClock 으로 캡처 시각 그대로
+//  - 결과 : 재생 속도 배율, tick 비용 분포, 출력 체크섬 (믹서 변경 전후 비교용)
+//  - 느린 소켓은 재현하지 않는다 (송신 큐는 공급 스레드가 깨어날 때마다 모두 비운다)
+//
+//  사용법 : Replay.exe 캡처파일 [--realtime] [--kernel scalar|sse2|avx2] [--loops N]
+// =============================
+#include "../core/core.h"
+#include "../core/pipeline.h"
+#include <chrono>
+#include <map>
+#include <memory>
+
+struct ReplayConfig
+{
+    std::string path;
+    bool realtime = false;
+    int kernel = -1;                        // -1 이면 BestMixKernel
+    int loops = 1;
+};
+
+struct ReplayStats
+{
+    uint64_t records = 0;
+    uint64_t audioFrames = 0;
+    uint64_t ctrlFrames = 0;
+    uint64_t ticks = 0;
+    uint64_t packets = 0;
+    int64_t mediaNs = 0;                    // 재생한 미디어 시간
+    size_t peakClients = 0;
+    uint64_t refusedRecords = 0;            // 슬롯 부족으로 접속을 받지 못해 건너뛴 레코드
+    uint64_t checksum = 1469598103934665603ULL;     // FNV-1a 64 offset
+};
+
+// 재생 중 존재하는 가상 클라이언트 (캡처 clientId -> ClientInfo)
+typedef std::map<uint32_t, std::shared_ptr<ClientInfo>> ReplayClients;
+
+static void FoldChecksum(uint64_t& h, const char* data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)data[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+// 슬롯이 없으면 서버처럼 접속을 거부하고 nullptr (그 레코드는 건너뛴다)
+static std::shared_ptr<ClientInfo> JoinClient(ReplayClients& clients, uint32_t id, ReplayStats& st)
+{
+    auto it = clients.find(id);
+    if (it != clients.end())
+        return it->second;
+
+    auto cli = std::make_shared<ClientInfo>();
+    cli->id = id;
+    if (!AttachClient(cli))
+    {
+        st.refusedRecords++;
+        return nullptr;
+    }
+    clients[id] = cli;
+    st.peakClients = (std::max)(st.peakClients, clients.size());
+    return cli;
+}
+
+static void LeaveClient(ReplayClients& clients, uint32_t id)
+{
+    auto it = clients.find(id);
+    if (it == clients.end())
+        return;
+
+    DeactivateClient(*it->second);
+    ClearClientQueue(*it->second);
+    DetachClient(it->second);
+    clients.erase(it);
+}
+
+// -------------------------------------------
+// DrainQueues
+//  - 모든 송신 큐를 비워 송신 완료로 처리 (clientId 순서로 체크섬에 반영)
+// -------------------------------------------
+static void DrainQueues(ReplayClients& clients, ReplayStats& st)
+{
+    for (auto& kv : clients)
+    {
+        OutPacket packet;
+        while (PopPacket(*kv.second, packet, false))
+        {
+            const int64_t now = pipelineNowNs();
+            AccountSent(*kv.second, packet, now, now);
+            if (packet.timePong)
+                continue;                               // 시계 동기화 응답은 믹서 출력이 아니다
+            FoldChecksum(st.checksum, packet.data->data(), packet.data->size());
+            st.packets++;
+        }
+    }
+}
+
+// -------------------------------------------
+// ReplayOnce
+//  - 캡처 한 바퀴 재생, 반환 : 벽시계 소요 ns
+//  1. 믹서 스레드 시작 (gPipelineClock 참여자)
+//  2. 현재 스레드가 공급자 : 레코드 시각까지 잠든 뒤 적용, 깨어날 때마다 송신 큐 비움
+//  3. 마지막 레코드 후 tick 두 번 분량 기다렸다가 종료
+// -------------------------------------------
+static int64_t ReplayOnce(CaptureReader& reader, const MixKernelOps& mix, ReplayStats& st)
+{
+    MediaClock& clock = *gPipelineClock;
+    ReplayClients clients;
+    CaptureRecord rec;
+    std::atomic<bool> running{ true };
+
+    std::vector<uint64_t> before;
+    gCounters.Sum(before, CNT_COUNT);
+
+    reader.Rewind();
+    const int64_t wallStart = nowNs();
+    const int64_t mediaStart = clock.NowNs();
+    int64_t captureStart = -1;
+
+    clock.Join();                           // 공급자 (현재 스레드)
+    clock.Join();                           // 믹서
+    std::thread mixer(RunMixerLoop, std::cref(mix), std::cref(running));
+
+    {
+        ClockParticipant feeder(clock);
+        while (reader.Next(rec))
+        {
+            if (captureStart < 0)
+                captureStart = rec.tsNs;
+
+            clock.SleepUntil(mediaStart + (rec.tsNs - captureStart));
+            DrainQueues(clients, st);
+
+            st.records++;
+            switch (rec.type)
+            {
+            case CAPTURE_JOIN:
+                JoinClient(clients, rec.clientId, st);
+                break;
+            case CAPTURE_LEAVE:
+                LeaveClient(clients, rec.clientId);
+                break;
+            case CAPTURE_FRAME:
+            {
+                auto cli = JoinClient(clients, rec.clientId, st);
+                if (!cli)
+                    break;
+                if (isAudioFrame(rec.len))
+                    st.audioFrames++;
+                else
+                    st.ctrlFrames++;
+                IngestFrame(*cli, rec.data, rec.len, clock.NowNs());
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // 남은 프레임이 믹싱될 때까지
+        clock.SleepForMs(MIX_TICK_MS * 2);
+        DrainQueues(clients, st);
+        running = false;
+    }
+    mixer.join();
+
+    while (!clients.empty())
+        LeaveClient(clients, clients.begin()->first);
+
+    std::vector<uint64_t> after;
+    gCounters.Sum(after, CNT_COUNT);
+    st.ticks = after[CNT_MIX_TICKS] - before[CNT_MIX_TICKS];
+    st.mediaNs = clock.NowNs() - mediaStart;
+
+    return nowNs() - wallStart;
+}
+
+static bool ParseArgs(int argc, char* argv[], ReplayConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--realtime")
+            cfg.realtime = true;
+        else if (a == "--kernel" && i + 1 < argc)
+        {
+            std::string k = argv[++i];
+            for (int n = 0; n < MIX_KERNEL_COUNT; n++)
+            {
+                if (k == GetMixKernel((MixKernelKind)n).name)
+                    cfg.kernel = n;
+            }
+            if (cfg.kernel < 0)
+                return false;
+        }
+        else if (a == "--loops" && i + 1 < argc)
+            cfg.loops = (std::max)(1, std::atoi(argv[++i]));
+        else if (cfg.path.empty() && a[0] != '-')
+            cfg.path = a;
+        else
+            return false;
+    }
+    return !cfg.path.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    ReplayConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : Replay.exe 캡처파일 [--realtime] [--kernel scalar|sse2|avx2] [--loops N]" << std::endl;
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.Open(cfg.path))
+    {
+        std::cerr << "[replay] 캡처 파일 열기 실패: " << cfg.path << std::endl;
+        return 1;
+    }
+    if (reader.Header().frameBytes != AUDIO_BUFFER_SIZE)
+    {
+        std::cerr << "[replay] 프레임 크기 불일치 (캡처 " << reader.Header().frameBytes
+            << " / 현재 " << AUDIO_BUFFER_SIZE << ")" << std::endl;
+        return 1;
+    }
+
+    const MixKernelKind kind = cfg.kernel >= 0 ? (MixKernelKind)cfg.kernel : BestMixKernel();
+    if (!MixKernelSupported(kind))
+    {
+        std::cerr << "[replay] 이 CPU 에서 지원하지 않는 커널: " << GetMixKernel(kind).name << std::endl;
+        return 1;
+    }
+    const MixKernelOps& mix = GetMixKernel(kind);
+
+    // 캡처 길이 (첫 / 마지막 레코드 시각)
+    CaptureRecord rec;
+    int64_t firstNs = -1, lastNs = 0;
+    while (reader.Next(rec))
+    {
+        if (firstNs < 0)
+            firstNs = rec.tsNs;
+        lastNs = rec.tsNs;
+    }
+    const double captureSec = firstNs < 0 ? 0.0 : (lastNs - firstNs) / 1e9;
+
+    std::cout << "[replay] " << cfg.path << " (" << reader.SizeBytes() / 1024 << " KB, " << captureSec << " 초)"
+        << " 커널 " << mix.name << (cfg.realtime ? " / 실시간" : " / 가상 시계 (최대 속도)") << std::endl;
+
+    // ETW 프로브 (WPR 로 재생 구간을 프로파일링할 때), 메인 스레드는 공급자
+    registerProbes();
+    nameThread("replay-feeder");
+
+    // 파이프라인 시계 교체 (믹서 / 공급 스레드 시작 전)
+    VirtualClock virtualClock;
+    if (!cfg.realtime)
+        gPipelineClock = &virtualClock;
+
+    for (int loop = 0; loop < cfg.loops; loop++)
+    {
+        ReplayStats st;
+        const int64_t wallNs = ReplayOnce(reader, mix, st);
+        const double wallSec = wallNs / 1e9;
+        const double mediaSec = st.mediaNs / 1e9;
+
+        char line[320];
+        snprintf(line, sizeof(line),
+            "[replay] #%d 레코드 %llu (오디오 %llu / 제어 %llu) 최대 클라이언트 %zu tick %llu 패킷 %llu"
+            " 미디어 %.3f초 / 소요 %.3f초 (x%.1f) 체크섬 %016llx",
+            loop + 1, (unsigned long long)st.records, (unsigned long long)st.audioFrames,
+            (unsigned long long)st.ctrlFrames, st.peakClients, (unsigned long long)st.ticks,
+            (unsigned long long)st.packets, mediaSec, wallSec, wallSec > 0 ? mediaSec / wallSec : 0.0,
+            (unsigned long long)st.checksum);
+        std::cout << line << std::endl;
+        if (st.refusedRecords)
+            std::cout << "[replay] 슬롯 부족으로 접속을 거부해 건너뛴 레코드 " << st.refusedRecords << " (최대 " << CLIENT_SLOT_MAX << "명)" << std::endl;
+    }
+
+    // 누적 단계 분포 (대기 단계는 미디어 시계 기준, tick / 팬아웃은 실제 CPU 시간)
+    std::cout << "[replay] 단계별 지연 (누적)" << std::endl;
+    printHistogramHeader(std::cout);
+    for (int i = 0; i < STAGE_COUNT; i++)
+        printHistogramRow(std::cout, gStageHist[i].Name(), gStageHist[i].Snapshot());
+
+    unregisterProbes();
+    return 0;
+}
@@ -4,10 +4,14 @@
 //      Author : Dev.seunhak
 // =============================
 #include "../core/core.h"
+#include "../core/pipeline.h"
+#include "../core/park.h"
+#include "../core/stats_shm.h"
 #include <atomic>
 #include <csignal>
 #include <memory>
 #include <algorithm>
+#include <sstream>
 
 // -------------------------------------------
 // 전역 상태
@@ -16,43 +20,26 @@
 // 서버 실행 상태 (Ctrl+C 등으로 false 가 되면 종료 된다)
 static std::atomic<bool> gRunning{ true };
 
-// -------------------------------------------
-// 클라이언트 엔트리
-//  1. 각 클라이언트 별 송신 전용 큐 / 스레드를 보유
-//  2. 느린 클리이언트가 있어도 다른 클라이언트로의 송신은 지연되지 않는다
-// -------------------------------------------
-struct ClientInfo
-{
-    SOCKET sock = INVALID_SOCKET;
-    // 송신 전용 큐
-    std::mutex qMutex;
-    std::condition_variable qCV;
-    // 공유 포인터로 패킷을 보관하여 불필요한 복사를 줄인다
-    std::queue<std::shared_ptr<std::vector<char>>> q;
-    // 송신 스레드
-    std::thread sendThread;
-    // 활성 상태
-    std::atomic<bool> active{ true };
-    // 백프레셔 카운터 (무한 메모리 증가 방지용) - 단순 프레임 수 제한
-    size_t queuedFrames = 0;
-};
+// 메트릭 엔드포인트 포트 (0 이면 끔)
+static int gMetricsPort = METRICS_PORT;
 
-static std::vector<std::shared_ptr<ClientInfo>> gClients;
-// -------------------------------------------
-// 멀티스레드에서 동시에 gClients 벡터를 접근할 수 있으므로
-// mutex로 보호한다
-// -------------------------------------------
-static std::mutex gClientMutex;
+// 히스토그램 출력 주기 (초, 0 이면 주기 출력 안 함) / Ctrl+Break 요청 플래그
+static int gHistIntervalSec = 10;
+static std::atomic<bool> gHistDumpRequested{ false };
 
-// ---------------------------
-// 믹싱 큐
-// ---------------------------
-struct MixFrame
-{
-    std::vector<char> data;                 // 16bit stereo PCM
-};
-static std::mutex gMixMutex;
-static std::vector<MixFrame> gMixFrames;
+// 공유 메모리 통계 게시 주기 (ms, 0 이면 끔)
+static int gShmPeriodMs = 10;
+
+// 믹서 CPU 예산 관리 (governor.h) 사용 여부 / 발화자 상한
+static bool gGovernorEnabled = true;
+static int gMaxSpeakers = GOV_SPEAKER_CAP_DEFAULT;
+
+// 대기 청취자 (park.h) : 말하지 않는 접속은 수신 스레드 없이 대기 스레드 하나가 맡는다
+static bool gParkingEnabled = true;
+static ListenerPark gListenerPark;
+
+// 접속을 받기 전 프로세스 메모리 (접속당 메모리 = 증가분 / 접속 수)
+static ProcessMemory gMemoryBase;
 
 // -------------------------------------------
 // 소켓 옵션 보조 함수
@@ -79,16 +66,12 @@ static void TuneSocket(SOCKET s)
 static void RemoveClient(const std::shared_ptr<ClientInfo>& cli)
 {
     // 이미 종료된 경우 중복 방지
-    if (!cli || !cli->active.exchange(false))
+    if (!cli || !DeactivateClient(*cli))
         return;
     
     // 1. 활성 플래그 내리고 대기 깨우기
     //cli->active = false;
-    {
-        std::lock_guard<std::mutex> lock(cli->qMutex);
-        while (!cli->q.empty()) cli->q.pop();
-        cli->queuedFrames = 0;
-    }
+    ClearClientQueue(*cli);
     cli->qCV.notify_all();
 
     // 2. 소켓 정리
@@ -104,15 +87,10 @@ static void RemoveClient(const std::shared_ptr<ClientInfo>& cli)
         cli->sendThread.join();
 
     // 4. gClients 에서 제거
-    {
-        std::lock_guard<std::mutex> glock(gClientMutex);
-
-        gClients.erase(std::remove(gClients.begin(), gClients.end(), cli), gClients.end());
-
-        /*auto it = std::find(gClients.begin(), gClients.end(), cli);
-        if (it != gClients.end())
-            gClients.erase(it);*/
-    }
+    DetachClient(cli);
+    /*auto it = std::find(gClients.begin(), gClients.end(), cli);
+    if (it != gClients.end())
+        gClients.erase(it);*/
 
     std::cout << "[서버] 클라이언트 제거 완료 (잔여 " << gClients.size() << "명)" << std::endl;
 }
@@ -125,30 +103,55 @@ static void RemoveClient(const std::shared_ptr<ClientInfo>& cli)
 // -------------------------------------------
 static void ClientSendThread(std::shared_ptr<ClientInfo> cli)
 {
+    char threadName[TRACE_NAME_MAX];
+    snprintf(threadName, sizeof(threadName), "send-%u", cli->id);
+    nameThread(threadName);
+    ThreadStatsScope threadStats(THREAD_ROLE_SEND);
+    RtThreadScope rt(THREAD_ROLE_SEND);
+
     while (cli->active)
     {
-        std::shared_ptr<std::vector<char>> packet;
+        OutPacket packet;
 
         // 1. 큐에서 패킷 대기
-        {
-            std::unique_lock<std::mutex> lock(cli->qMutex);
-            cli->qCV.wait(lock, [&] { return !cli->q.empty() || !cli->active; });
-            if (!cli->active)
-                break;
+        if (!PopPacket(*cli, packet, true))
+            break;
+        const int64_t dequeueNs = pipelineNowNs();
 
-            packet = cli->q.front();
-            cli->q.pop();
-            if (cli->queuedFrames > 0)
-                cli->queuedFrames--;
-        }
+        // 시계 동기화 pong 은 보내기 직전 시각(t3)을 채운다
+        if (packet.timePong)
+            stampTimePong(packet.data->data(), pipelineNowNs());
 
         // 2. 안전 패킷 송신
-        if (!sendFrame(cli->sock, packet->data(), (uint32_t)packet->size()))
+        if (!sendFrame(cli->sock, packet.data->data(), (uint32_t)packet.data->size()))
         {
             std::cerr << "[서버] 클라이언트 송신 실패" << std::endl;
-            cli->active = false;
+            DeactivateClient(*cli);
             break;
         }
+
+        const int64_t sentNs = pipelineNowNs();
+        AccountSent(*cli, packet, dequeueNs, sentNs);
+        traceComplete("send", dequeueNs, sentNs, cli->id);
+
+        // 에코 마커 프레임이면 서버 단계 시각을 바로 뒤에 보낸다 (echo.h)
+        if (packet.echoSeq != 0)
+        {
+            EchoTiming timing;
+            timing.seq = packet.echoSeq;
+            timing.recvNs = packet.originNs;
+            timing.queuedNs = packet.echoQueuedNs;
+            timing.mixNs = packet.echoMixNs;
+            timing.enqueueNs = packet.enqueueNs;
+            timing.dequeueNs = dequeueNs;
+            timing.sentNs = sentNs;
+            char ctrl[CTRL_MAX_FRAME];
+            if (!sendFrame(cli->sock, ctrl, buildEchoTimingFrame(ctrl, timing)))
+            {
+                DeactivateClient(*cli);
+                break;
+            }
+        }
     }
 
     // 루프 탈출 시 클라이언트 제거 --> 수정 -> RecvThread 에서만 최종적으로 호출
@@ -158,25 +161,48 @@ static void ClientSendThread(std::shared_ptr<ClientInfo> cli)
 // -------------------------------------------
 // ClientRecvThread
 //  1. 클라이언트가 보낸 오디오 프레임을 수신
-//  2. BroadcastAudio 로 전체에게 송신
+//  2. IngestFrame 으로 믹싱 큐에 push (제어 프레임은 HandleControlFrame)
+//  3. 대기 상태에서 깨어난 경우 pendingLen 은 대기 스레드가 이미 읽은 길이 헤더 (payload 부터 읽는다)
+//  4. 발화를 마치면 (DTX) 대기 상태로 돌아가고 스레드 / 수신 버퍼를 반납한다
 // -------------------------------------------
-static void ClientRecvThread(std::shared_ptr<ClientInfo> cli)
+static void ClientRecvThread(std::shared_ptr<ClientInfo> cli, uint32_t pendingLen)
 {
+    char threadName[TRACE_NAME_MAX];
+    snprintf(threadName, sizeof(threadName), "recv-%u", cli->id);
+    nameThread(threadName);
+    ThreadStatsScope threadStats(THREAD_ROLE_RECV);
+    RtThreadScope rt(THREAD_ROLE_RECV);
+
     std::vector<char> frame;
     while (gRunning && cli->active)
     {
-        if (!recvFrame(cli->sock, frame))
+        // 추적 중일 때만 대기 시작 시각을 읽는다
+        const int64_t waitStartNs = traceEnabled() ? nowNs() : 0;
+        bool ok;
+        if (pendingLen != 0)
+        {
+            frame.resize(pendingLen);
+            ok = recvAll(cli->sock, frame.data(), (int)pendingLen);
+            pendingLen = 0;
+        }
+        else
+            ok = recvFrame(cli->sock, frame);
+        if (!ok)
         {
             std::cout << "[서버] 클라이언트 연결 종료" << std::endl;
             break;
         }
+        const int64_t recvNs = pipelineNowNs();
+        if (waitStartNs != 0)
+            traceComplete("recv", waitStartNs, recvNs, cli->id);
 
-        // 믹스 프레임 수신
-        MixFrame mf;
-        mf.data = frame;
+        IngestFrame(*cli, frame.data(), (uint32_t)frame.size(), recvNs);
+
+        // 발화 종료 (DTX) : 대기 상태로 돌아간다
+        if (gParkingEnabled && !cli->talking && !isAudioFrame((uint32_t)frame.size()))
         {
-            std::lock_guard<std::mutex> lock(gMixMutex);
-            gMixFrames.push_back(std::move(mf));
+            gListenerPark.Park(cli, true);
+            return;
         }
         
         //// 수신 프레임을 전체에게 브로드 캐스트
@@ -188,69 +214,58 @@ static void ClientRecvThread(std::shared_ptr<ClientInfo> cli)
 }
 
 // -------------------------------------------
-// MixerThread
-//  1. 클라이언트가 보낸 오디오를 믹싱
+// ParkThread
+//  1. 대기 청취자 소켓 전부를 WSAPoll 하나로 지켜본다 (제어 프레임만 직접 처리)
+//  2. 발화를 시작하면 수신 스레드를 만들어 넘기고, 연결이 끊기면 제거
 // -------------------------------------------
-static void MixerThread()
+static void WakeParkedClient(const std::shared_ptr<ClientInfo>& cli, uint32_t pendingLen)
 {
-    const int FRAME_SIZE = AUDIO_BUFFER_SIZE;   // 20ms PCM
-    const int NUM_CHANNELS = 2;
-
-    while (gRunning)
-    {
-        std::vector<MixFrame> framesToMix;
-
-        {
-            std::lock_guard<std::mutex> lock(gMixMutex);
-            if (gMixFrames.empty())
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
-                continue;
-            }
-            framesToMix.swap(gMixFrames);
-        }
-
-        // mix
-        std::vector<char> mixed(FRAME_SIZE, 0);
-        for (auto& f : framesToMix)
-        {
-            for (size_t i = 0; i < FRAME_SIZE; i += 2)
-            {
-                short* dst = (short*)&mixed[i];
-                short* src = (short*)&f.data[i];
-                int s = *dst + *src;
-
-                if (s > 32767)
-                    s = 32767;
+    std::thread(ClientRecvThread, cli, pendingLen).detach();
+}
 
-                if (s < -32768)
-                    s = -32768;
+static void ReapParkedClient(std::shared_ptr<ClientInfo> cli)
+{
+    std::cout << "[서버] 클라이언트 연결 종료 (대기)" << std::endl;
+    RemoveClient(cli);
+}
 
-                *dst = (short)s;
-            }
-        }
+// 정리 (소켓 닫기, 송신 스레드 join, 로그) 는 대기 스레드 밖에서 : 느린 정리 하나가 다른 대기 접속의 poll 을 막지 않게
+// 종료 중에는 poll 이 이미 끝났으므로 그 자리에서 (접속 수만큼 스레드를 한꺼번에 띄우지 않는다)
+static void DropParkedClient(const std::shared_ptr<ClientInfo>& cli)
+{
+    if (gRunning)
+        std::thread(ReapParkedClient, cli).detach();
+    else
+        ReapParkedClient(cli);
+}
 
-        // 모든 클라이언트에 push
-        std::lock_guard<std::mutex> glock(gClientMutex);
-        for (auto& cli : gClients)
-        {
-            if (!cli->active)
-                continue;
+static void ParkThread()
+{
+    nameThread("park");
+    ThreadStatsScope threadStats(THREAD_ROLE_PARK);
+    RtThreadScope rt(THREAD_ROLE_PARK);
+    gListenerPark.Run(gRunning, WakeParkedClient, DropParkedClient);
+}
 
-            std::lock_guard<std::mutex> lock(cli->qMutex);
-            while (cli->queuedFrames >= MAX_QUEUE_FRAMES && !cli->q.empty())
-            {
-                cli->q.pop();
-                cli->queuedFrames--;
-            }
+// -------------------------------------------
+// MixerThread
+//  1. 클라이언트가 보낸 오디오를 믹싱
+// -------------------------------------------
+static void MixerThread()
+{
+    // 실행 CPU 에서 지원되는 가장 넓은 SIMD 커널 (int16 포화 덧셈, 기존 결과와 동일)
+    const MixKernelOps& mix = GetMixKernel(BestMixKernel());
+    std::cout << "[서버] 믹싱 커널 : " << mix.name << std::endl;
+    ThreadStatsScope threadStats(THREAD_ROLE_MIXER);
 
-            cli->q.push(std::make_shared<std::vector<char>>(mixed));
-            cli->queuedFrames++;
-            cli->qCV.notify_one();
-        }
+    // 실시간 우선순위 / CPU 고정 / 스택 잠금 (--rt, --mixer-cpus, --lock-memory)
+    RtThreadScope rt(THREAD_ROLE_MIXER);
+    std::cout << "[서버] 믹서 스레드 : ";
+    rtDescribeRole(THREAD_ROLE_MIXER, std::cout);
+    std::cout << std::endl;
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
-    }
+    // tick / 대기 주기는 파이프라인 미디어 시계(서버는 실제 시간)로 구동
+    RunMixerLoop(mix, gRunning);
 }
 
 // -------------------------------------------
@@ -286,6 +301,546 @@ static void MixerThread()
 //	}
 //}
 
+// -------------------------------------------
+// DumpStageHistograms
+//  - 단계별 구간(직전 출력 이후) 분포와 누적 분포를 표로 출력
+// -------------------------------------------
+static void DumpStageHistograms(HistogramSnapshot (&prev)[STAGE_COUNT], const char* reason)
+{
+    std::ostringstream os;
+    os << "[서버] 단계별 지연 (" << reason << ", 구간)" << std::endl;
+    printHistogramHeader(os);
+
+    HistogramSnapshot cur[STAGE_COUNT];
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        cur[i] = gStageHist[i].Snapshot();
+        printHistogramRow(os, gStageHist[i].Name(), cur[i].Since(prev[i]));
+    }
+
+    os << "[서버] 단계별 지연 (누적)" << std::endl;
+    printHistogramHeader(os);
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        printHistogramRow(os, gStageHist[i].Name(), cur[i]);
+        prev[i] = std::move(cur[i]);
+    }
+
+    os << "[서버] 믹서 깨어남 지연 (누적)" << std::endl;
+    printHistogramHeader(os);
+    printHistogramRow(os, gMixWakeDelayHist.Name(), gMixWakeDelayHist.Snapshot());
+
+    std::vector<uint64_t> counters;
+    gCounters.Sum(counters, CNT_COUNT);
+    os << "[서버] 클라이언트 보고 단계별 지연 (누적, 보고 " << counters[CNT_CLIENT_REPORTS] << "건)" << std::endl;
+    printHistogramHeader(os);
+    for (int i = 0; i < CSTAGE_COUNT; i++)
+        printHistogramRow(os, gClientStageHist[i].Name(), gClientStageHist[i].Snapshot());
+
+    os << "[서버] 스레드 CPU (역할별 누적)" << std::endl;
+    printThreadStats(os);
+
+    // 접속당 메모리 (기준값 : 접속을 받기 전)
+    const size_t connected = (size_t)(counters[CNT_CLIENTS_ACCEPTED] - counters[CNT_CLIENTS_REMOVED]);
+    const ProcessMemory mem = processMemoryNow();
+    char line[256];
+    snprintf(line, sizeof(line), "[서버] 메모리 : private %.1f MB (기준 %.1f MB), 접속 %zu명 (대기 %zu명), 접속당 %.1f KB",
+        mem.privateBytes / 1048576.0, gMemoryBase.privateBytes / 1048576.0, connected, gListenerPark.Parked(),
+        connectionFootprintBytes(gMemoryBase, mem, connected) / 1024.0);
+    os << line << std::endl;
+
+    if (gLockProfileEnabled)
+    {
+        os << "[서버] 락 호출 지점 (누적, 대기 합계 순)" << std::endl;
+        printLockProfile(os);
+    }
+    std::cout << os.str();
+}
+
+// -------------------------------------------
+// StatsThread
+//  - gHistIntervalSec 주기 또는 Ctrl+Break 요청 시 히스토그램 출력
+// -------------------------------------------
+static void StatsThread()
+{
+    nameThread("stats");
+    ThreadStatsScope threadStats(THREAD_ROLE_STATS);
+    HistogramSnapshot prev[STAGE_COUNT];
+    auto last = std::chrono::steady_clock::now();
+
+    while (gRunning)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        if (gHistDumpRequested.exchange(false))
+        {
+            DumpStageHistograms(prev, "요청");
+            last = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if (gHistIntervalSec > 0 &&
+            std::chrono::steady_clock::now() - last >= std::chrono::seconds(gHistIntervalSec))
+        {
+            DumpStageHistograms(prev, "주기");
+            last = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+// -------------------------------------------
+// 메트릭 렌더링 (Prometheus 텍스트 형식)
+//  - 카운터/게이지는 모두 락 없이 읽는다
+//  - 클라이언트 목록만 gClientMutex 안에서 shared_ptr 로 복사 (포인터 복사뿐)
+//  - 초당 rate 는 MetricsThread 가 1초마다 샘플링한 값
+// -------------------------------------------
+struct MetricRates
+{
+    std::vector<uint64_t> prev;
+    int64_t prevNs = 0;
+    double framesReceived = 0;
+    double framesMixed = 0;
+    double framesSent = 0;
+    double bytesIn = 0;
+    double bytesOut = 0;
+};
+
+static void SampleRates(MetricRates& r)
+{
+    const int64_t now = nowNs();
+    if (r.prevNs != 0 && now - r.prevNs < 1000000000LL)
+        return;
+
+    std::vector<uint64_t> cur;
+    gCounters.Sum(cur, CNT_COUNT);
+    if (r.prevNs != 0)
+    {
+        const double sec = (now - r.prevNs) / 1e9;
+        r.framesReceived = (cur[CNT_FRAMES_RECEIVED] - r.prev[CNT_FRAMES_RECEIVED]) / sec;
+        r.framesMixed = (cur[CNT_FRAMES_MIXED] - r.prev[CNT_FRAMES_MIXED]) / sec;
+        r.framesSent = (cur[CNT_FRAMES_SENT] - r.prev[CNT_FRAMES_SENT]) / sec;
+        r.bytesIn = (cur[CNT_BYTES_IN] - r.prev[CNT_BYTES_IN]) / sec;
+        r.bytesOut = (cur[CNT_BYTES_OUT] - r.prev[CNT_BYTES_OUT]) / sec;
+    }
+    r.prev.swap(cur);
+    r.prevNs = now;
+}
+
+static std::string RenderMetrics(const MetricRates& rates)
+{
+    std::vector<uint64_t> c;
+    gCounters.Sum(c, CNT_COUNT);
+
+    std::vector<std::shared_ptr<ClientInfo>> clients;
+    uint32_t slotEnd, talking;
+    {
+        ProfiledLock glock(gClientMutex, gSiteMetricsScrape);
+        clients = gClients;
+        slotEnd = gClientSlots.End();
+        talking = gClientSlots.Count(SLOT_TALKING);
+    }
+
+    PromWriter w;
+    w.Family("gac_clients_connected", "gauge", "Currently connected clients.");
+    w.Sample("gac_clients_connected", (double)clients.size());
+    w.Family("gac_clients_accepted_total", "counter", "Accepted client connections.");
+    w.Sample("gac_clients_accepted_total", (double)c[CNT_CLIENTS_ACCEPTED]);
+    w.Family("gac_clients_removed_total", "counter", "Removed client connections.");
+    w.Sample("gac_clients_removed_total", (double)c[CNT_CLIENTS_REMOVED]);
+    w.Family("gac_clients_talking", "gauge", "Connected clients between their first audio frame and DTX.");
+    w.Sample("gac_clients_talking", (double)talking);
+    w.Family("gac_client_slot_span", "gauge", "Client slots the mixer scans each tick (highest used slot + 1).");
+    w.Sample("gac_client_slot_span", (double)slotEnd);
+    w.Family("gac_clients_parked", "gauge", "Connected clients that have no receive thread because they are not talking.");
+    w.Sample("gac_clients_parked", (double)gListenerPark.Parked());
+    w.Family("gac_park_wakeups_total", "counter", "Parked clients that started talking and were given a receive thread.");
+    w.Sample("gac_park_wakeups_total", (double)c[CNT_PARK_WAKEUPS]);
+    w.Family("gac_park_returns_total", "counter", "Receive threads that returned their client to the park after DTX.");
+    w.Sample("gac_park_returns_total", (double)c[CNT_PARK_RETURNS]);
+
+    // 접속당 메모리 (private 바이트 증가분 / 접속 수, 기준값은 접속을 받기 전)
+    const ProcessMemory mem = processMemoryNow();
+    w.Family("gac_process_private_bytes", "gauge", "Process private (committed) bytes.");
+    w.Sample("gac_process_private_bytes", (double)mem.privateBytes);
+    w.Family("gac_process_working_set_bytes", "gauge", "Process working set bytes.");
+    w.Sample("gac_process_working_set_bytes", (double)mem.workingSetBytes);
+    w.Family("gac_connection_footprint_bytes", "gauge", "Private bytes added since startup divided by connected clients.");
+    w.Sample("gac_connection_footprint_bytes", connectionFootprintBytes(gMemoryBase, mem, clients.size()));
+
+    w.Family("gac_frames_received_total", "counter", "Audio frames received from clients.");
+    w.Sample("gac_frames_received_total", (double)c[CNT_FRAMES_RECEIVED]);
+    w.Family("gac_control_frames_received_total", "counter", "Control frames (DTX etc.) received from clients.");
+    w.Sample("gac_control_frames_received_total", (double)c[CNT_CTRL_RECEIVED]);
+    w.Family("gac_frames_mixed_total", "counter", "Input frames summed by the mixer.");
+    w.Sample("gac_frames_mixed_total", (double)c[CNT_FRAMES_MIXED]);
+    w.Family("gac_frames_enqueued_total", "counter", "Mixed frames pushed to client send queues.");
+    w.Sample("gac_frames_enqueued_total", (double)c[CNT_FRAMES_ENQUEUED]);
+    w.Family("gac_frames_sent_total", "counter", "Mixed frames written to client sockets.");
+    w.Sample("gac_frames_sent_total", (double)c[CNT_FRAMES_SENT]);
+    w.Family("gac_frames_dropped_total", "counter", "Frames dropped by MAX_QUEUE_FRAMES backpressure.");
+    w.Sample("gac_frames_dropped_total", (double)c[CNT_FRAMES_DROPPED]);
+    w.Family("gac_bytes_in_total", "counter", "Bytes received including length prefix.");
+    w.Sample("gac_bytes_in_total", (double)c[CNT_BYTES_IN]);
+    w.Family("gac_bytes_out_total", "counter", "Bytes sent including length prefix.");
+    w.Sample("gac_bytes_out_total", (double)c[CNT_BYTES_OUT]);
+
+    w.Family("gac_frames_received_per_second", "gauge", "Audio frames received over the last second.");
+    w.Sample("gac_frames_received_per_second", rates.framesReceived);
+    w.Family("gac_frames_mixed_per_second", "gauge", "Input frames mixed over the last second.");
+    w.Sample("gac_frames_mixed_per_second", rates.framesMixed);
+    w.Family("gac_frames_sent_per_second", "gauge", "Mixed frames sent over the last second.");
+    w.Sample("gac_frames_sent_per_second", rates.framesSent);
+    w.Family("gac_bytes_in_per_second", "gauge", "Bytes received over the last second.");
+    w.Sample("gac_bytes_in_per_second", rates.bytesIn);
+    w.Family("gac_bytes_out_per_second", "gauge", "Bytes sent over the last second.");
+    w.Sample("gac_bytes_out_per_second", rates.bytesOut);
+
+    w.Family("gac_mixer_ticks_total", "counter", "Mixer ticks that mixed at least one frame.");
+    w.Sample("gac_mixer_ticks_total", (double)c[CNT_MIX_TICKS]);
+    w.Family("gac_mixer_tick_overruns_total", "counter", "Mixer ticks whose work exceeded the tick period.");
+    w.Sample("gac_mixer_tick_overruns_total", (double)c[CNT_TICK_OVERRUNS]);
+    w.Family("gac_mixer_tick_seconds", "gauge", "Duration of the last mixer tick.");
+    w.Sample("gac_mixer_tick_seconds", gMixTickLastNs.load(std::memory_order_relaxed) / 1e9);
+    w.Family("gac_mixer_tick_max_seconds", "gauge", "Longest mixer tick since start.");
+    w.Sample("gac_mixer_tick_max_seconds", gMixTickMaxNs.load(std::memory_order_relaxed) / 1e9);
+    w.Family("gac_mixer_tick_cpu_seconds", "gauge", "On-CPU time of the last mixer tick (thread cycles).");
+    w.Sample("gac_mixer_tick_cpu_seconds", gMixTickCpuNs.load(std::memory_order_relaxed) / 1e9);
+    w.Family("gac_mixer_tick_offcpu_seconds", "gauge", "Wall time of the last mixer tick not spent on CPU (preemption, lock waits, faults).");
+    w.Sample("gac_mixer_tick_offcpu_seconds", gMixTickOffCpuNs.load(std::memory_order_relaxed) / 1e9);
+    w.Family("gac_mixer_tick_cpu_seconds_total", "counter", "On-CPU time accumulated by mixer ticks.");
+    w.Sample("gac_mixer_tick_cpu_seconds_total", c[CNT_MIX_TICK_CPU_NS] / 1e9);
+    w.Family("gac_mixer_tick_offcpu_seconds_total", "counter", "Off-CPU wall time accumulated by mixer ticks.");
+    w.Sample("gac_mixer_tick_offcpu_seconds_total", c[CNT_MIX_TICK_OFFCPU_NS] / 1e9);
+    {
+        const HistogramSnapshot wake = gMixWakeDelayHist.Snapshot();
+        w.Family("gac_mixer_wake_delay_seconds", "summary", "Delay between the mixer's sleep deadline and it running again.");
+        w.Sample("gac_mixer_wake_delay_seconds", "quantile=\"0.5\"", wake.Percentile(0.50) / 1e9);
+        w.Sample("gac_mixer_wake_delay_seconds", "quantile=\"0.99\"", wake.Percentile(0.99) / 1e9);
+        w.Sample("gac_mixer_wake_delay_seconds", "quantile=\"0.999\"", wake.Percentile(0.999) / 1e9);
+        w.Sample("gac_mixer_wake_delay_seconds_count", (double)wake.total);
+    }
+    w.Family("gac_mix_queue_depth", "gauge", "Frames drained from the mix queue in the last tick.");
+    w.Sample("gac_mix_queue_depth", (double)gMixBatchFrames.load(std::memory_order_relaxed));
+    w.Family("gac_mix_pool_misses_total", "counter", "Mix buffers allocated outside the pool because every pooled buffer was still queued.");
+    w.Sample("gac_mix_pool_misses_total", (double)c[CNT_MIX_POOL_MISSES]);
+
+    // 믹서 CPU 예산 관리 (작업자 = 믹서 스레드 하나)
+    if (gMixGovernor.Enabled())
+    {
+        const std::string worker = "worker=\"mixer\"";
+        w.Family("gac_governor_level", "gauge", "Degradation level (0 normal, 1 lean, 2 speaker_cap, 3 closed).");
+        w.Sample("gac_governor_level", worker, (double)gMixGovernor.Level());
+        w.Family("gac_governor_tick_cost_seconds", "gauge", "Smoothed mixer tick cost tracked by the governor.");
+        w.Sample("gac_governor_tick_cost_seconds", worker, gMixGovernor.CostNs() / 1e9);
+        w.Family("gac_governor_headroom_ratio", "gauge", "Fraction of the tick budget left after the smoothed tick cost.");
+        w.Sample("gac_governor_headroom_ratio", worker, gMixGovernor.Headroom());
+        w.Family("gac_governor_client_cost_seconds", "gauge", "Smoothed fan-out cost per client, used for admission.");
+        w.Sample("gac_governor_client_cost_seconds", worker, gMixGovernor.PerClientNs() / 1e9);
+        w.Family("gac_governor_steps_total", "counter", "Governor level changes by direction and target level.");
+        for (int l = 0; l < GOV_LEVEL_COUNT; l++)
+        {
+            const std::string level = worker + ",level=\"" + kGovernorLevelNames[l] + "\"";
+            if (l > GOV_NORMAL)
+                w.Sample("gac_governor_steps_total", level + ",direction=\"up\"", (double)gMixGovernor.StepsUp(l));
+            if (l < GOV_CLOSED)
+                w.Sample("gac_governor_steps_total", level + ",direction=\"down\"", (double)gMixGovernor.StepsDown(l));
+        }
+        w.Family("gac_governor_level_ticks_total", "counter", "Mixer ticks spent at each governor level (idle time counted in tick-length units, not idle polls).");
+        for (int l = 0; l < GOV_LEVEL_COUNT; l++)
+            w.Sample("gac_governor_level_ticks_total", worker + ",level=\"" + kGovernorLevelNames[l] + "\"", (double)gMixGovernor.TicksAt(l));
+        w.Family("gac_governor_frames_capped_total", "counter", "Input frames left out of the mix by the speaker cap.");
+        w.Sample("gac_governor_frames_capped_total", worker, (double)c[CNT_GOV_FRAMES_CAPPED]);
+        w.Family("gac_governor_joins_refused_total", "counter", "Connections refused because the mixer had no budget for another client.");
+        w.Sample("gac_governor_joins_refused_total", worker, (double)c[CNT_GOV_JOINS_REFUSED]);
+    }
+
+    // 역할별 스레드 CPU / 컨텍스트 스위치 (종료한 송수신 스레드 포함 누적)
+    {
+        ThreadRoleReport roles[THREAD_ROLE_COUNT];
+        collectThreadStats(roles);
+        w.Family("gac_threads", "gauge", "Live threads per role.");
+        for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+            w.Sample("gac_threads", std::string("role=\"") + kThreadRoleNames[r] + "\"", (double)roles[r].threads);
+        w.Family("gac_thread_cpu_seconds_total", "counter", "Thread CPU time per role and mode.");
+        for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+        {
+            const std::string role = std::string("role=\"") + kThreadRoleNames[r] + "\"";
+            w.Sample("gac_thread_cpu_seconds_total", role + ",mode=\"user\"", roles[r].total.userNs / 1e9);
+            w.Sample("gac_thread_cpu_seconds_total", role + ",mode=\"kernel\"", roles[r].total.kernelNs / 1e9);
+        }
+        w.Family("gac_thread_cpu_cycles_total", "counter", "Thread CPU cycles per role.");
+        for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+            w.Sample("gac_thread_cpu_cycles_total", std::string("role=\"") + kThreadRoleNames[r] + "\"", (double)roles[r].total.cycles);
+        w.Family("gac_thread_context_switches_total", "counter", "Context switches per role (Windows does not split voluntary/involuntary).");
+        for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+            w.Sample("gac_thread_context_switches_total", std::string("role=\"") + kThreadRoleNames[r] + "\"", (double)roles[r].total.contextSwitches);
+    }
+
+    // 실시간 스케줄링 / CPU 고정 / 메모리 잠금 : 요청이 아니라 실제로 얻은 값
+    {
+        w.Family("gac_rt_info", "gauge", "Requested real-time mode and the process priority class actually granted.");
+        w.Sample("gac_rt_info", std::string("requested=\"") + kRtSchedModeNames[gRtReport.requested] +
+            "\",priority_class=\"" + rtPriorityClassName(gRtReport.priorityClass) + "\"", 1.0);
+        const ThreadRole rtRoles[] = { THREAD_ROLE_MIXER, THREAD_ROLE_SEND, THREAD_ROLE_RECV, THREAD_ROLE_PARK };
+        w.Family("gac_rt_thread_priority", "gauge", "Thread priority read back after applying the real-time settings.");
+        for (ThreadRole r : rtRoles)
+            w.Sample("gac_rt_thread_priority", std::string("role=\"") + kThreadRoleNames[r] + "\"",
+                (double)gRtReport.roles[r].priority.load(std::memory_order_relaxed));
+        w.Family("gac_rt_thread_mmcss", "gauge", "1 if the thread is registered with MMCSS.");
+        for (ThreadRole r : rtRoles)
+            w.Sample("gac_rt_thread_mmcss", std::string("role=\"") + kThreadRoleNames[r] + "\"",
+                gRtReport.roles[r].mmcss.load(std::memory_order_relaxed) ? 1.0 : 0.0);
+        w.Family("gac_rt_thread_affinity_mask", "gauge", "CPU mask the thread is pinned to (0 = not pinned).");
+        for (ThreadRole r : rtRoles)
+            w.Sample("gac_rt_thread_affinity_mask", std::string("role=\"") + kThreadRoleNames[r] + "\"",
+                (double)gRtReport.roles[r].affinity.load(std::memory_order_relaxed));
+        w.Family("gac_rt_thread_failures_total", "counter", "Requested real-time settings a thread could not obtain.");
+        for (ThreadRole r : rtRoles)
+            w.Sample("gac_rt_thread_failures_total", std::string("role=\"") + kThreadRoleNames[r] + "\"",
+                (double)gRtReport.roles[r].failures.load(std::memory_order_relaxed));
+        w.Family("gac_rt_locked_bytes", "gauge", "Bytes of prefaulted pools and stacks locked into the working set.");
+        w.Sample("gac_rt_locked_bytes", (double)gRtReport.lockedBytes.load(std::memory_order_relaxed));
+        w.Family("gac_rt_lock_failures_total", "counter", "VirtualLock calls that failed (working set quota).");
+        w.Sample("gac_rt_lock_failures_total", (double)gRtReport.lockFailures.load(std::memory_order_relaxed));
+    }
+
+    // GAC_ALLOC_TRACK 빌드에서만 (워밍업 뒤 늘어나면 핫 패스 할당 회귀)
+    if (allocTrackEnabled())
+    {
+        w.Family("gac_hot_path_allocations_total", "counter", "Heap allocations made inside hot pipeline paths.");
+        for (int p = 0; p < HOT_PATH_COUNT; p++)
+            w.Sample("gac_hot_path_allocations_total", std::string("path=\"") + kHotPathNames[p] + "\"",
+                (double)gHotPathAllocs[p].load(std::memory_order_relaxed));
+        const AllocCounts total = allocTotalCounts();
+        w.Family("gac_heap_allocations_total", "counter", "Heap allocations made by the whole process.");
+        w.Sample("gac_heap_allocations_total", (double)total.allocs);
+        w.Family("gac_heap_allocated_bytes_total", "counter", "Bytes requested from the heap by the whole process.");
+        w.Sample("gac_heap_allocated_bytes_total", (double)total.bytes);
+    }
+
+    // 락 호출 지점별 경합 (--lock-profile)
+    if (gLockProfileEnabled)
+    {
+        w.Family("gac_mixer_tick_lock_wait_seconds", "gauge", "Time the last mixer tick spent waiting on contended locks.");
+        w.Sample("gac_mixer_tick_lock_wait_seconds", gMixTickLockWaitNs.load(std::memory_order_relaxed) / 1e9);
+
+        const std::vector<LockSiteReport> locks = collectLockProfile();
+        struct LockFamily { const char* name; const char* type; const char* help; };
+        static const LockFamily lockFamilies[] = {
+            { "gac_lock_acquisitions_total", "counter", "Lock acquisitions per call site." },
+            { "gac_lock_contended_total", "counter", "Acquisitions that found the lock held." },
+            { "gac_lock_wait_seconds_total", "counter", "Time spent waiting for contended locks." },
+            { "gac_lock_hold_seconds_total", "counter", "Time locks were held." },
+        };
+        for (int f = 0; f < 4; f++)
+        {
+            w.Family(lockFamilies[f].name, lockFamilies[f].type, lockFamilies[f].help);
+            for (const LockSiteReport& r : locks)
+            {
+                const std::string label = std::string("lock=\"") + r.site->LockName() + "\",site=\"" + r.site->SiteName() + "\"";
+                const double v[4] = { (double)r.acquisitions, (double)r.contended, r.waitNs / 1e9, r.holdNs / 1e9 };
+                w.Sample(lockFamilies[f].name, label, v[f]);
+            }
+        }
+
+        w.Family("gac_lock_wait_seconds", "summary", "Wait time of contended acquisitions per call site.");
+        for (const LockSiteReport& r : locks)
+        {
+            const std::string label = std::string("lock=\"") + r.site->LockName() + "\",site=\"" + r.site->SiteName() + "\"";
+            w.Sample("gac_lock_wait_seconds", label + ",quantile=\"0.5\"", r.wait.Percentile(0.50) / 1e9);
+            w.Sample("gac_lock_wait_seconds", label + ",quantile=\"0.99\"", r.wait.Percentile(0.99) / 1e9);
+            w.Sample("gac_lock_wait_seconds", label + ",quantile=\"0.999\"", r.wait.Percentile(0.999) / 1e9);
+        }
+    }
+
+    // 단계별 지연 (gStageHist 누적 분위수)
+    w.Family("gac_stage_latency_seconds", "summary", "Per-stage server latency.");
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        const HistogramSnapshot snap = gStageHist[i].Snapshot();
+        const std::string stage = std::string("stage=\"") + gStageHist[i].Name() + "\"";
+        w.Sample("gac_stage_latency_seconds", stage + ",quantile=\"0.5\"", snap.Percentile(0.50) / 1e9);
+        w.Sample("gac_stage_latency_seconds", stage + ",quantile=\"0.99\"", snap.Percentile(0.99) / 1e9);
+        w.Sample("gac_stage_latency_seconds", stage + ",quantile=\"0.999\"", snap.Percentile(0.999) / 1e9);
+        w.Sample("gac_stage_latency_seconds_count", stage, (double)snap.total);
+    }
+
+    // 클라이언트가 보고한 단계별 지연 (전체 클라이언트 합산, 버킷 상한값 기준)
+    w.Family("gac_client_reports_total", "counter", "Client stage latency reports merged.");
+    w.Sample("gac_client_reports_total", (double)c[CNT_CLIENT_REPORTS]);
+    w.Family("gac_client_stage_latency_seconds", "summary", "Per-stage client latency reported over the control path.");
+    for (int i = 0; i < CSTAGE_COUNT; i++)
+    {
+        const HistogramSnapshot snap = gClientStageHist[i].Snapshot();
+        const std::string stage = std::string("stage=\"") + kClientStageNames[i] + "\"";
+        w.Sample("gac_client_stage_latency_seconds", stage + ",quantile=\"0.5\"", snap.Percentile(0.50) / 1e9);
+        w.Sample("gac_client_stage_latency_seconds", stage + ",quantile=\"0.99\"", snap.Percentile(0.99) / 1e9);
+        w.Sample("gac_client_stage_latency_seconds", stage + ",quantile=\"0.999\"", snap.Percentile(0.999) / 1e9);
+        w.Sample("gac_client_stage_latency_seconds_count", stage, (double)snap.total);
+    }
+
+    // 시계 동기화 (클라이언트가 ping 에 실어 보낸 추정값, 동기화된 클라이언트만)
+    w.Family("gac_time_sync_pings_total", "counter", "Clock sync pings received.");
+    w.Sample("gac_time_sync_pings_total", (double)c[CNT_TIME_PINGS]);
+    w.Family("gac_time_sync_pongs_total", "counter", "Clock sync pongs sent.");
+    w.Sample("gac_time_sync_pongs_total", (double)c[CNT_TIME_PONGS]);
+    w.Family("gac_echo_frames_total", "counter", "Frames returned to clients in echo mode.");
+    w.Sample("gac_echo_frames_total", (double)c[CNT_ECHO_FRAMES]);
+    {
+        w.Family("gac_client_clock_offset_seconds", "gauge", "Server minus client monotonic clock, as estimated by the client.");
+        for (auto& cli : clients)
+        {
+            if (cli->clockSynced.load(std::memory_order_acquire))
+                w.Sample("gac_client_clock_offset_seconds", "client=\"" + std::to_string(cli->id) + "\"",
+                    cli->clockOffsetNs.load(std::memory_order_relaxed) / 1e9);
+        }
+        w.Family("gac_client_clock_rtt_seconds", "gauge", "Minimum clock sync round trip in the client's filter window.");
+        for (auto& cli : clients)
+        {
+            if (cli->clockSynced.load(std::memory_order_acquire))
+                w.Sample("gac_client_clock_rtt_seconds", "client=\"" + std::to_string(cli->id) + "\"",
+                    cli->clockRttNs.load(std::memory_order_relaxed) / 1e9);
+        }
+        w.Family("gac_client_clock_skew_ppm", "gauge", "Server clock rate relative to the client clock, in ppm.");
+        for (auto& cli : clients)
+        {
+            if (cli->clockSynced.load(std::memory_order_acquire))
+                w.Sample("gac_client_clock_skew_ppm", "client=\"" + std::to_string(cli->id) + "\"",
+                    cli->clockSkewPpb.load(std::memory_order_relaxed) / 1e3);
+        }
+    }
+
+    // 클라이언트별
+    struct PerClient { const char* name; const char* type; const char* help; std::atomic<uint64_t> ClientInfo::* field; };
+    static const PerClient perClient[] = {
+        { "gac_client_frames_received_total", "counter", "Audio frames received per client.", &ClientInfo::framesIn },
+        { "gac_client_bytes_in_total", "counter", "Bytes received per client.", &ClientInfo::bytesIn },
+        { "gac_client_frames_sent_total", "counter", "Mixed frames sent per client.", &ClientInfo::framesOut },
+        { "gac_client_bytes_out_total", "counter", "Bytes sent per client.", &ClientInfo::bytesOut },
+        { "gac_client_frames_dropped_total", "counter", "Frames dropped by MAX_QUEUE_FRAMES per client.", &ClientInfo::dropped },
+        { "gac_client_send_queue_depth", "gauge", "Frames waiting in the client send queue.", &ClientInfo::queueDepth },
+    };
+    for (const PerClient& m : perClient)
+    {
+        w.Family(m.name, m.type, m.help);
+        for (auto& cli : clients)
+        {
+            const std::string label = "client=\"" + std::to_string(cli->id) + "\"";
+            w.Sample(m.name, label, (double)((*cli).*m.field).load(std::memory_order_relaxed));
+        }
+    }
+
+    return w.Str();
+}
+
+// -------------------------------------------
+// MetricsThread
+//  - 127.0.0.1:gMetricsPort 에서 GET /metrics 응답
+//  - 믹서/송수신 경로와 공유하는 락 없음 (클라이언트 목록 복사 제외)
+// -------------------------------------------
+static void MetricsThread()
+{
+    nameThread("metrics");
+    ThreadStatsScope threadStats(THREAD_ROLE_METRICS);
+    SOCKET s = openMetricsListener((uint16_t)gMetricsPort);
+    if (s == INVALID_SOCKET)
+    {
+        std::cerr << "[서버] 메트릭 포트 " << gMetricsPort << " 열기 실패: " << WSAGetLastError() << std::endl;
+        return;
+    }
+    std::cout << "[서버] 메트릭 http://127.0.0.1:" << gMetricsPort << "/metrics" << std::endl;
+
+    MetricRates rates;
+    serveMetrics(s, gRunning,
+        [&] { return RenderMetrics(rates); },
+        [&] { SampleRates(rates); });
+    closesocket(s);
+}
+
+// -------------------------------------------
+// ShmPublishThread
+//  - gShmPeriodMs 주기로 카운터 / 믹서 게이지 / 클라이언트별 상태를 공유 메모리 세그먼트에 게시
+//    (StatTop 도구가 읽는다, 핫 패스는 관여하지 않음)
+//  - 클라이언트 목록은 접속 / 제거 카운터가 바뀐 주기에만 gClientMutex 안에서 다시 복사
+//    (평소에는 믹서 팬아웃과 락을 다투지 않는다)
+// -------------------------------------------
+static void ShmPublishThread(StatsShmWriter* shm)
+{
+    nameThread("shm-publish");
+    ThreadStatsScope threadStats(THREAD_ROLE_PUBLISH);
+
+    std::unique_ptr<StatsShmPayload> p(new StatsShmPayload());     // 클라이언트 배열 때문에 크다 (스택 대신 힙)
+    std::vector<std::shared_ptr<ClientInfo>> clients;
+    std::vector<uint64_t> c;
+    uint64_t membership = UINT64_MAX;
+
+    while (gRunning)
+    {
+        gCounters.Sum(c, CNT_COUNT);
+        const uint64_t curMembership = c[CNT_CLIENTS_ACCEPTED] + c[CNT_CLIENTS_REMOVED];
+        if (curMembership != membership)
+        {
+            ProfiledLock glock(gClientMutex, gSiteShmPublish);
+            clients = gClients;
+            membership = curMembership;
+        }
+
+        p->publishNs = nowNs();
+        p->publishCount++;
+        p->clientsAccepted = c[CNT_CLIENTS_ACCEPTED];
+        p->clientsRemoved = c[CNT_CLIENTS_REMOVED];
+        p->framesReceived = c[CNT_FRAMES_RECEIVED];
+        p->ctrlReceived = c[CNT_CTRL_RECEIVED];
+        p->framesMixed = c[CNT_FRAMES_MIXED];
+        p->framesEnqueued = c[CNT_FRAMES_ENQUEUED];
+        p->framesSent = c[CNT_FRAMES_SENT];
+        p->framesDropped = c[CNT_FRAMES_DROPPED];
+        p->bytesIn = c[CNT_BYTES_IN];
+        p->bytesOut = c[CNT_BYTES_OUT];
+        p->mixTicks = c[CNT_MIX_TICKS];
+        p->tickOverruns = c[CNT_TICK_OVERRUNS];
+        p->tickCpuNs = c[CNT_MIX_TICK_CPU_NS];
+        p->tickOffCpuNs = c[CNT_MIX_TICK_OFFCPU_NS];
+
+        p->tickLastNs = gMixTickLastNs.load(std::memory_order_relaxed);
+        p->tickMaxNs = gMixTickMaxNs.load(std::memory_order_relaxed);
+        p->tickLastCpuNs = gMixTickCpuNs.load(std::memory_order_relaxed);
+        p->tickLastOffCpuNs = gMixTickOffCpuNs.load(std::memory_order_relaxed);
+        p->tickLockWaitNs = gMixTickLockWaitNs.load(std::memory_order_relaxed);
+        p->mixBatchFrames = gMixBatchFrames.load(std::memory_order_relaxed);
+
+        p->clientsTotal = (uint32_t)clients.size();
+        p->clientCount = (uint32_t)(std::min)(clients.size(), (size_t)STATS_SHM_MAX_CLIENTS);
+        for (uint32_t i = 0; i < p->clientCount; i++)
+        {
+            const ClientInfo& cli = *clients[i];
+            StatsShmClient& out = p->clients[i];
+            out.id = cli.id;
+            out.talking = cli.talking.load(std::memory_order_relaxed) ? 1 : 0;
+            out.framesIn = cli.framesIn.load(std::memory_order_relaxed);
+            out.bytesIn = cli.bytesIn.load(std::memory_order_relaxed);
+            out.framesOut = cli.framesOut.load(std::memory_order_relaxed);
+            out.bytesOut = cli.bytesOut.load(std::memory_order_relaxed);
+            out.dropped = cli.dropped.load(std::memory_order_relaxed);
+            out.queueDepth = cli.queueDepth.load(std::memory_order_relaxed);
+        }
+
+        shm->Publish(*p);
+        std::this_thread::sleep_for(std::chrono::milliseconds(gShmPeriodMs));
+    }
+}
+
+// -------------------------------------------
+// DumpSignalHandler
+//  - Ctrl+Break(SIGBREAK) 로 즉시 히스토그램 출력 요청
+//  - CRT 는 핸들러 호출 후 SIG_DFL 로 되돌리므로 다시 등록한다
+// -------------------------------------------
+static void DumpSignalHandler(int sig)
+{
+    gHistDumpRequested = true;
+    std::signal(sig, DumpSignalHandler);
+}
+
 // -------------------------------------------
 // SignalHandler
 //  - Ctrl+C(SIGINT) 발생 시 gRunning = false 로 설정하여
@@ -305,8 +860,68 @@ static void SignalHandler(int)
 //  3. 클라이언트가 접속하면 ClientThread 실행
 //  4. 종료 시 모든 소켓 정리
 // -------------------------------------------
-int main()
+int main(int argc, char* argv[])
 {
+    // --hist-interval N : 단계별 지연 히스토그램 출력 주기 (초, 0 = 끔)
+    // --metrics-port N  : 메트릭 HTTP 포트 (0 = 끔)
+    // --trace 파일      : Chrome/Perfetto trace-event JSON 기록
+    // --record 파일     : 수신 프레임 캡처 (.gacap, Replay 도구로 재생)
+    // --lock-profile    : 락 호출 지점별 대기 / 보유 시간 기록 (히스토그램 출력, /metrics 에 포함)
+    // --shm-ms N        : 공유 메모리 통계 게시 주기 (ms, 0 = 끔, StatTop 도구로 읽는다)
+    // --shm-name 이름    : 공유 메모리 세그먼트 이름 (기본 Local\GroupAudioChat.Stats)
+    // --no-governor     : 믹서 CPU 예산 관리 끄기 (부하가 올라도 기능을 내리지 않고 접속도 거부하지 않음)
+    // --max-speakers N  : 발화자 상한 단계에서 한 tick 에 믹싱할 최대 발화자 수 (기본 8)
+    // --rt 모드          : 미디어 스레드 우선순위 (none / mmcss / high / realtime, rt_sched.h)
+    // --mixer-cpus 목록  : 믹서 스레드 CPU 고정 (예 : 2 또는 2-3)
+    // --io-cpus 목록     : 송수신 스레드 CPU 고정 (예 : 0,1)
+    // --lock-memory     : 믹서 풀 / 믹싱 큐 / 믹서 스택을 미리 건드려 작업 집합에 잠근다
+    // --no-parking      : 말하지 않는 접속도 접속마다 수신 스레드를 둔다 (대기 청취자 끄기, park.h)
+    std::string tracePath;
+    std::string recordPath;
+    std::wstring shmName = STATS_SHM_DEFAULT_NAME;
+    RtConfig rtConfig;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (a == "--lock-profile")
+            gLockProfileEnabled = true;
+        else if (a == "--no-governor")
+            gGovernorEnabled = false;
+        else if (a == "--max-speakers" && hasValue)
+            gMaxSpeakers = (std::max)(1, std::atoi(argv[++i]));
+        else if (a == "--rt" && hasValue)
+        {
+            if (!parseRtSchedMode(argv[++i], rtConfig.mode))
+                std::cerr << "[서버] 알 수 없는 --rt 모드 (none / mmcss / high / realtime) : " << argv[i] << std::endl;
+        }
+        else if ((a == "--mixer-cpus" || a == "--io-cpus") && hasValue)
+        {
+            DWORD_PTR& mask = a == "--mixer-cpus" ? rtConfig.mixerCpus : rtConfig.ioCpus;
+            if (!parseCpuList(argv[++i], mask))
+                std::cerr << "[서버] 잘못된 CPU 목록 (" << a << ") : " << argv[i] << std::endl;
+        }
+        else if (a == "--lock-memory")
+            rtConfig.lockMemory = true;
+        else if (a == "--no-parking")
+            gParkingEnabled = false;
+        else if (a == "--hist-interval" && hasValue)
+            gHistIntervalSec = (std::max)(0, std::atoi(argv[++i]));
+        else if (a == "--metrics-port" && hasValue)
+            gMetricsPort = (std::max)(0, std::atoi(argv[++i]));
+        else if (a == "--trace" && hasValue)
+            tracePath = argv[++i];
+        else if (a == "--record" && hasValue)
+            recordPath = argv[++i];
+        else if (a == "--shm-ms" && hasValue)
+            gShmPeriodMs = (std::max)(0, std::atoi(argv[++i]));
+        else if (a == "--shm-name" && hasValue)
+        {
+            const std::string n = argv[++i];
+            shmName.assign(n.begin(), n.end());
+        }
+    }
+
     std::cout << "// ───────────────────────────────" << std::endl;
     std::cout << "// 비압축 Wave 형식의 오디오 송수신 프로그램 [ 서버 ]" << std::endl;
     std::cout << "//    * 형식 *PCM, 2ch, 48000kHz, 16bit" << std::endl;
@@ -325,6 +940,7 @@ int main()
 
     // 2 Ctrl+C 처리 핸들러 등록
     std::signal(SIGINT, SignalHandler);
+    std::signal(SIGBREAK, DumpSignalHandler);
 
     // 3. 리슨 소켓 생성
     SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -364,8 +980,63 @@ int main()
 
     std::cout << "[오디오 서버] 포트" << PORT << " 수신 대기" << std::endl;
 
+    // ETW 프로브 등록 (세션이 켜지 않으면 기록 비용 없음), 메인 스레드는 accept 루프
+    registerProbes();
+    nameThread("accept");
+    ThreadStatsScope acceptThreadStats(THREAD_ROLE_ACCEPT);
+
     // ** 믹서 스레드 등록
+    TraceSession trace;
+    if (!tracePath.empty())
+    {
+        if (trace.Start(tracePath))
+            std::cout << "[서버] trace 기록 : " << tracePath << std::endl;
+        else
+            std::cerr << "[서버] trace 파일 열기 실패: " << tracePath << std::endl;
+    }
+
+    CaptureWriter capture;
+    if (!recordPath.empty())
+    {
+        if (capture.Open(recordPath))
+        {
+            gCaptureWriter = &capture;
+            std::cout << "[서버] 수신 프레임 기록 : " << recordPath << std::endl;
+        }
+        else
+            std::cerr << "[서버] 캡처 파일 열기 실패: " << recordPath << std::endl;
+    }
+
+    gMixGovernor.Configure(gGovernorEnabled, MIX_TICK_MS * 1000000LL, gMaxSpeakers);
+    if (gMixGovernor.Enabled())
+        std::cout << "[서버] 믹서 예산 관리 : 켜짐 (발화자 상한 " << gMixGovernor.SpeakerCap() << "명)" << std::endl;
+
+    // 실시간 설정 (프로세스 단위) 후 파이프라인 풀 prefault / 잠금, 미디어 스레드는 시작 시 각자 적용
+    rtApplyProcess(rtConfig, std::cout);
+    if (rtConfig.lockMemory)
+        PrefaultPipeline(MIX_PREFAULT_FRAMES);
+
     std::thread mixer(MixerThread);
+    std::thread stats(StatsThread);
+    std::thread park;
+    if (gParkingEnabled)
+        park = std::thread(ParkThread);
+    std::thread metrics;
+    if (gMetricsPort > 0)
+        metrics = std::thread(MetricsThread);
+
+    StatsShmWriter shm;
+    std::thread shmPublish;
+    if (gShmPeriodMs > 0)
+    {
+        if (shm.Create(shmName, (uint32_t)gShmPeriodMs))
+            shmPublish = std::thread(ShmPublishThread, &shm);
+        else
+            std::cerr << "[서버] 공유 메모리 통계 세그먼트 생성 실패: " << GetLastError() << std::endl;
+    }
+
+    // 접속당 메모리 기준값 (공용 스레드 / 풀이 모두 만들어진 뒤)
+    gMemoryBase = processMemoryNow();
 
     // 6. 메인 루프 : 새로운 클라이언트 accept
     while (gRunning)
@@ -379,22 +1050,39 @@ int main()
             continue;
         }
 
+        // 믹서 예산이 없으면 받지 않는다 (기존 참가자의 tick 마감 우선)
+        if (!gMixGovernor.AdmitJoin())
+        {
+            gCounters.Add(CNT_GOV_JOINS_REFUSED);
+            closesocket(s);
+            std::cout << "[서버] 접속 거부 : 믹서 예산 부족 (단계 " << kGovernorLevelNames[gMixGovernor.Level()] << ")" << std::endl;
+            continue;
+        }
+
         // 소켓 튜닝 (지연 감소)
         TuneSocket(s);
 
         // ClientInfo 생성 및 등록
+        static uint32_t nextClientId = 0;
         auto cli = std::make_shared<ClientInfo>();
         cli->sock = s;
+        cli->id = ++nextClientId;
+        if (!AttachClient(cli))
         {
-            std::lock_guard<std::mutex> glock(gClientMutex);
-            gClients.push_back(cli);
+            closesocket(s);
+            std::cout << "[서버] 접속 거부 : 슬롯 부족 (최대 " << CLIENT_SLOT_MAX << "명)" << std::endl;
+            continue;
         }
 
         // 송신 스레드 시작
         cli->sendThread = std::thread(ClientSendThread, cli);
 
-        // 수신 스레드는 detach (자체적으로 RemoveClient 처리)
-        std::thread(ClientRecvThread, cli).detach();
+        // 수신은 대기 스레드가 맡다가 발화를 시작하면 수신 스레드로 넘긴다
+        // 대기 청취자를 끄면 바로 수신 스레드를 detach (자체적으로 RemoveClient 처리)
+        if (gParkingEnabled)
+            gListenerPark.Park(cli, false);
+        else
+            std::thread(ClientRecvThread, cli, 0u).detach();
 
         std::cout << "[서버] 클라이언트 접속 (총 " << (int)gClients.size() << " 명)" << std::endl;    
     }
@@ -413,7 +1101,23 @@ int main()
   //  }
 
     mixer.join();
+    stats.join();
+    if (park.joinable())
+        park.join();
+    if (metrics.joinable())
+        metrics.join();
+    if (shmPublish.joinable())
+        shmPublish.join();
+    shm.Close();
+    trace.Stop();
+    if (gCaptureWriter)
+    {
+        gCaptureWriter = nullptr;
+        capture.Close();
+        std::cout << "[서버] 캡처 레코드 " << capture.Records() << "개 (버림 " << capture.Dropped() << "개)" << std::endl;
+    }
     closesocket(listenSock);
+    unregisterProbes();
     WSACleanup();
     std::cout << "[서버] 정상 종료" << std::endl;
     return 0;
@@ -0,0 +1,464 @@
+﻿// =============================
+//      soak.cpp
+//      Date : 2026-10-17
+// =============================
+// 장시간 soak 시험 (메모리 증가 / 지연 drift 추적)
+//  - 서버 파이프라인(core/pipeline.h)을 VirtualClock 으로 몇 시간 분량 구동하며 접속 / 종료 / 발화 churn 을 건다
+//    . 인원은 --clients 근처에서 오르내리고, 세션 길이는 평균 --session-sec (지수 분포)
+//    . 발화 / 무음 구간이 번갈아 오고 무음 진입 때 DTX, 1초마다 시계 동기화 ping, CLIENT_REPORT_SEC 마다 단계 보고
+//    . 일부는 에코 모드, 일부는 송신 큐를 가끔만 비우는 느린 클라이언트 (drop 경로)
+//  - 클라이언트마다 서버 수신 스레드처럼 세션 스레드를 띄우고, 종료 때 그 스레드가
+//    큐 비우기 / gClients 제거(DetachClient)를 한다 : 스레드 / gClients / 송신 큐 정리가 churn 을 따라가는지 본다
+//    (끝난 세션 스레드는 표본 직전에 join 해 OS 스레드 수에 종료 중인 스레드가 섞이지 않게 한다)
+//  - --sample-sec (가상 시간) 마다 프로세스 private bytes / working set, 살아 있는 힙 할당 수(GAC_ALLOC_TRACK),
+//    OS 스레드 수, 구간 지연(수신 ~ 송신, 느린 클라이언트 제외) / mix_tick p99 를 기록
+//  - 워밍업 구간을 뺀 표본에 최소제곱 직선을 맞춰 실행 구간 동안의 증가량이 허용치(절대값과 상대값 둘 다)를 넘으면 실패
+//  - 끝나면 모두 내보내고 세션 스레드를 join 한 뒤 gClients / 접속-제거 카운터 / OS 스레드 수가 처음으로 돌아오는지 확인
+//
+//  사용법 : Soak.exe [--hours H] [--clients N] [--session-sec S] [--sample-sec S] [--warmup-min M] [--seed N] [--csv 파일]
+// =============================
+#define GAC_ALLOC_TRACK 1
+#include "../core/core.h"
+#include "../core/pipeline_harness.h"
+#include <fstream>
+#include <memory>
+#include <Psapi.h>
+#include <TlHelp32.h>
+
+#pragma comment(lib, "psapi.lib")
+
+#define SOAK_TALK_MEAN_SEC 2.0						// 발화 구간 평균
+#define SOAK_SILENCE_MEAN_SEC 3.0						// 무음 구간 평균
+#define SOAK_JOIN_PROB 0.2								// 정원 미달일 때 tick 마다 한 명 들어올 확률
+#define SOAK_SLOW_EVERY 8								// 이 수마다 한 명은 느린 클라이언트
+#define SOAK_ECHO_EVERY 16								// 이 수마다 한 명은 에코 모드
+#define SOAK_SLOW_DRAIN_TICKS (MAX_QUEUE_FRAMES * 2)	// 느린 클라이언트는 이 tick 마다 한 번만 비운다
+
+struct SoakConfig
+{
+    double hours = 2.0;
+    int clients = 24;
+    double sessionSec = 90.0;
+    int sampleSec = 60;
+    int warmupMin = 10;
+    uint32_t seed = 1;
+    std::string csv;
+};
+
+static bool ParseArgs(int argc, char* argv[], SoakConfig& cfg)
+{
+    return parseArgPairs(argc, argv, [&](const std::string& a, const std::string& v)
+    {
+        if (a == "--hours") cfg.hours = (std::max)(0.05, std::stod(v));
+        else if (a == "--clients") cfg.clients = (std::min)((std::max)(2, std::stoi(v)), CLIENT_SLOT_MAX);
+        else if (a == "--session-sec") cfg.sessionSec = (std::max)(1.0, std::stod(v));
+        else if (a == "--sample-sec") cfg.sampleSec = (std::max)(1, std::stoi(v));
+        else if (a == "--warmup-min") cfg.warmupMin = (std::max)(0, std::stoi(v));
+        else if (a == "--seed") cfg.seed = (uint32_t)std::stoul(v);
+        else if (a == "--csv") cfg.csv = v;
+        else return false;
+        return true;
+    });
+}
+
+// 결정적 난수 (xorshift32)
+struct SoakRng
+{
+    uint32_t s;
+
+    explicit SoakRng(uint32_t seed) : s(seed ? seed : 1) {}
+
+    uint32_t Next()
+    {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+
+    double Uniform() { return (Next() >> 8) / 16777216.0; }
+    bool Chance(double p) { return Uniform() < p; }
+};
+
+// -------------------------------------------
+// 세션 (가상 클라이언트 하나)
+//  - 상태는 공급 스레드 전용, 세션 스레드는 종료 신호(active=false)만 기다린다
+// -------------------------------------------
+struct SoakSession
+{
+    std::shared_ptr<ClientInfo> cli;
+    std::thread thread;
+    bool talking = false;
+    bool slow = false;
+    uint32_t pingSeq = 0;
+    int tone = 0;
+};
+
+// 서버 ClientRecvThread 대역 : 연결이 끊길 때까지 막혀 있다가 RemoveClient 와 같은 순서로 정리
+static void SessionThread(std::shared_ptr<ClientInfo> cli)
+{
+    setThreadName("soak-session");
+    {
+        std::unique_lock<std::mutex> lock(cli->qMutex);
+        cli->qCV.wait(lock, [&] { return !cli->active.load(); });
+    }
+    ClearClientQueue(*cli);
+    DetachClient(cli);
+}
+
+// 종료 신호를 받은 세션 스레드 (표본 / 마지막 정리 전에 join)
+static void JoinSessionThreads(std::vector<std::thread>& leaving)
+{
+    for (std::thread& t : leaving)
+        t.join();
+    leaving.clear();
+}
+
+// 수신 ~ 송신 (가상 시간), 느린 클라이언트는 큐 대기가 지연을 덮으므로 빼고 잰다
+static LatencyHistogram gSoakLatency("soak_total");
+
+// -------------------------------------------
+// 프로세스 표본
+// -------------------------------------------
+struct SoakSample
+{
+    double hours = 0;									// 가상 시간
+    uint32_t clients = 0;
+    uint32_t threads = 0;
+    double extraThreads = 0;							// 스레드 - 살아 있는 세션 (세션 스레드는 세션 수를 따라 오르내린다)
+    double privateMb = 0;
+    double workingSetMb = 0;
+    double liveAllocs = 0;								// allocs - frees
+    double latencyP99Ms = 0;							// 구간 분포 (gSoakLatency)
+    double mixTickP99Ms = 0;
+    uint64_t drops = 0;
+};
+
+static uint32_t CountProcessThreads()
+{
+    HANDLE snap = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snap == INVALID_HANDLE_VALUE)
+        return 0;
+
+    const DWORD pid = GetCurrentProcessId();
+    uint32_t n = 0;
+    THREADENTRY32 te;
+    te.dwSize = sizeof(te);
+    for (BOOL ok = Thread32First(snap, &te); ok; ok = Thread32Next(snap, &te))
+    {
+        if (te.th32OwnerProcessID == pid)
+            n++;
+    }
+    CloseHandle(snap);
+    return n;
+}
+
+static void SampleProcess(SoakSample& s)
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc)))
+    {
+        s.privateMb = pmc.PrivateUsage / 1048576.0;
+        s.workingSetMb = pmc.WorkingSetSize / 1048576.0;
+    }
+    s.threads = CountProcessThreads();
+    const AllocCounts a = allocTotalCounts();
+    s.liveAllocs = (double)(a.allocs - a.frees);
+}
+
+// -------------------------------------------
+// 추세 판정
+//  - 워밍업 뒤 표본에 y = a + b * hours 를 맞추고 실행 구간 동안의 증가량 b * span 을 본다
+//  - 증가량이 절대 허용치와 (기준값 x 상대 허용치) 를 모두 넘으면 실패 (기준값 : 앞 1/4 평균)
+// -------------------------------------------
+struct TrendRule
+{
+    const char* name;
+    const char* unit;
+    double SoakSample::* field;
+    double absTol;
+    double relTol;										// 0 이면 절대 허용치만
+};
+
+struct TrendResult
+{
+    double baseline = 0;
+    double perHour = 0;
+    double growth = 0;
+    bool failed = false;
+};
+
+static TrendResult FitTrend(const std::vector<SoakSample>& samples, const TrendRule& rule)
+{
+    TrendResult r;
+    const size_t n = samples.size();
+    double mx = 0, my = 0;
+    for (const SoakSample& s : samples)
+    {
+        mx += s.hours;
+        my += s.*rule.field;
+    }
+    mx /= n;
+    my /= n;
+
+    double sxy = 0, sxx = 0;
+    for (const SoakSample& s : samples)
+    {
+        sxy += (s.hours - mx) * (s.*rule.field - my);
+        sxx += (s.hours - mx) * (s.hours - mx);
+    }
+    r.perHour = sxx > 0 ? sxy / sxx : 0.0;
+    r.growth = r.perHour * (samples.back().hours - samples.front().hours);
+
+    const size_t q = (std::max)((size_t)1, n / 4);
+    for (size_t i = 0; i < q; i++)
+        r.baseline += samples[i].*rule.field;
+    r.baseline /= q;
+
+    r.failed = r.growth > rule.absTol && r.growth > std::fabs(r.baseline) * rule.relTol;
+    return r;
+}
+
+static void PrintSample(std::ostream& os, const SoakSample& s)
+{
+    char line[320];
+    snprintf(line, sizeof(line), "[soak] %6.2f h  접속 %4u  스레드 %4u  private %8.1f MB  ws %8.1f MB  할당 %9.0f  latency p99 %7.3f ms  tick p99 %7.3f ms  drop %llu",
+        s.hours, s.clients, s.threads, s.privateMb, s.workingSetMb, s.liveAllocs, s.latencyP99Ms, s.mixTickP99Ms,
+        (unsigned long long)s.drops);
+    os << line << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    SoakConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : Soak.exe [--hours H] [--clients N] [--session-sec S] [--sample-sec S] [--warmup-min M] [--seed N] [--csv 파일]" << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!cfg.csv.empty())
+    {
+        csv.open(cfg.csv);
+        csv << "hours,clients,threads,private_mb,working_set_mb,live_allocs,latency_p99_ms,mix_tick_p99_ms,drops\n";
+    }
+
+    const MixKernelOps& mix = GetMixKernel(BestMixKernel());
+    const int64_t tickNs = MIX_TICK_MS * 1000000LL;
+    const int64_t totalTicks = (int64_t)(cfg.hours * 3600.0 * 1000.0 / MIX_TICK_MS);
+    const int sampleTicks = cfg.sampleSec * 1000 / MIX_TICK_MS;
+    const double leaveProb = MIX_TICK_MS / (cfg.sessionSec * 1000.0);
+    const double talkEndProb = MIX_TICK_MS / (SOAK_TALK_MEAN_SEC * 1000.0);
+    const double talkStartProb = MIX_TICK_MS / (SOAK_SILENCE_MEAN_SEC * 1000.0);
+    const int pingTicks = TIME_SYNC_INTERVAL_MS / MIX_TICK_MS;
+    const int reportTicks = CLIENT_REPORT_SEC * 1000 / MIX_TICK_MS;
+
+    // 입력 프레임 (톤 8개를 돌려 쓴다), DTX / 단계 보고 프레임
+    const std::vector<std::vector<char>> tones = makeToneFrames(8, 150.0, 40.0);
+    const HarnessCtrlFrame dtx = makeDtxFrame();
+    char report[CTRL_MAX_FRAME];
+    HistogramSnapshot emptyStages[CSTAGE_COUNT];
+    const uint32_t reportLen = buildClientReportFrame(report, emptyStages);
+    char echoOn[CTRL_MAX_FRAME];
+    const uint32_t echoOnLen = buildEchoRequestFrame(echoOn, true);
+
+    VirtualPipeline pipeline;
+
+    std::cout << "[soak] 가상 " << cfg.hours << " 시간 / 정원 " << cfg.clients << " / 평균 세션 " << cfg.sessionSec
+        << " 초 / 표본 " << cfg.sampleSec << " 초 / 커널 " << mix.name << std::endl;
+
+    SoakRng rng(cfg.seed);
+    std::vector<SoakSession> sessions;
+    std::vector<SoakSample> samples;
+    std::vector<std::thread> leaving;
+    uint64_t attachRefused = 0;
+    uint32_t nextId = 1;
+    HistogramSnapshot prevTotal = gSoakLatency.Snapshot();
+    HistogramSnapshot prevTick = gStageHist[STAGE_MIX_TICK].Snapshot();
+    const uint32_t threadsBefore = CountProcessThreads();
+
+    pipeline.Start(mix);
+    const int64_t startNs = pipeline.NowNs();
+    for (int64_t tick = 0; tick < totalTicks; tick++)
+    {
+        const int64_t now = pipeline.NowNs();
+
+        // 1. 접속
+        if ((int)sessions.size() < cfg.clients && rng.Chance(SOAK_JOIN_PROB))
+        {
+            SoakSession s;
+            s.cli = std::make_shared<ClientInfo>();
+            s.cli->id = nextId++;
+            s.slow = s.cli->id % SOAK_SLOW_EVERY == 0;
+            s.tone = (int)(s.cli->id % tones.size());
+            if (AttachClient(s.cli))
+            {
+                s.thread = std::thread(SessionThread, s.cli);
+                if (s.cli->id % SOAK_ECHO_EVERY == 0)
+                    IngestFrame(*s.cli, echoOn, echoOnLen, now);
+                sessions.push_back(std::move(s));
+            }
+            else if (attachRefused++ == 0)
+            {
+                // 정원은 슬롯 상한 이하 : 나간 세션의 슬롯이 반납되지 않고 있다 (판정에서 실패)
+                std::cout << "[soak] 접속 거부 : 슬롯 부족 (최대 " << CLIENT_SLOT_MAX << "명)" << std::endl;
+            }
+        }
+
+        // 2. 종료 / 발화 / 제어 프레임
+        for (size_t i = 0; i < sessions.size();)
+        {
+            SoakSession& s = sessions[i];
+            ClientInfo& cli = *s.cli;
+            if (rng.Chance(leaveProb))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(cli.qMutex);
+                    DeactivateClient(cli);
+                }
+                cli.qCV.notify_all();
+                leaving.push_back(std::move(s.thread));
+                sessions[i] = std::move(sessions.back());
+                sessions.pop_back();
+                continue;
+            }
+
+            if (s.talking && rng.Chance(talkEndProb))
+            {
+                s.talking = false;
+                IngestFrame(cli, dtx.data, dtx.len, now);
+            }
+            else if (!s.talking && rng.Chance(talkStartProb))
+                s.talking = true;
+
+            if (s.talking)
+                IngestFrame(cli, tones[s.tone].data(), AUDIO_BUFFER_SIZE, now);
+
+            const int64_t phase = tick + cli.id;
+            if (phase % pingTicks == 0)
+            {
+                TimePing ping;
+                ping.seq = s.pingSeq++;
+                ping.t1 = now;
+                char frame[CTRL_MAX_FRAME];
+                IngestFrame(cli, frame, buildTimePingFrame(frame, ping), now);
+            }
+            if (phase % reportTicks == 0)
+                IngestFrame(cli, report, reportLen, now);
+            i++;
+        }
+
+        pipeline.Tick();
+
+        // 3. 송신 큐 비우기 (느린 클라이언트는 가끔만)
+        for (SoakSession& s : sessions)
+        {
+            if (!s.slow || tick % SOAK_SLOW_DRAIN_TICKS == 0)
+                drainClient(*s.cli, s.slow ? nullptr : &gSoakLatency);
+        }
+
+        // 4. 표본
+        if ((tick + 1) % sampleTicks == 0)
+        {
+            JoinSessionThreads(leaving);
+
+            SoakSample s;
+            s.hours = (pipeline.NowNs() - startNs) / 3.6e12;
+            {
+                std::lock_guard<std::mutex> glock(gClientMutex);
+                s.clients = (uint32_t)gClients.size();
+            }
+            SampleProcess(s);
+            s.extraThreads = (double)s.threads - (double)sessions.size();
+
+            const HistogramSnapshot total = gSoakLatency.Snapshot();
+            const HistogramSnapshot tickHist = gStageHist[STAGE_MIX_TICK].Snapshot();
+            s.latencyP99Ms = total.Since(prevTotal).Percentile(0.99) / 1e6;
+            s.mixTickP99Ms = tickHist.Since(prevTick).Percentile(0.99) / 1e6;
+            prevTotal = total;
+            prevTick = tickHist;
+
+            std::vector<uint64_t> counters;
+            gCounters.Sum(counters, CNT_COUNT);
+            s.drops = counters[CNT_FRAMES_DROPPED];
+
+            PrintSample(std::cout, s);
+            if (csv)
+            {
+                csv << s.hours << "," << s.clients << "," << s.threads << "," << s.privateMb << "," << s.workingSetMb << ","
+                    << s.liveAllocs << "," << s.latencyP99Ms << "," << s.mixTickP99Ms << "," << s.drops << "\n";
+            }
+            samples.push_back(s);
+        }
+    }
+
+    // 모두 내보낸다
+    for (SoakSession& s : sessions)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s.cli->qMutex);
+            DeactivateClient(*s.cli);
+        }
+        s.cli->qCV.notify_all();
+        leaving.push_back(std::move(s.thread));
+    }
+    sessions.clear();
+
+    pipeline.Stop();
+    JoinSessionThreads(leaving);
+
+    // -------------------------------------------
+    // 판정
+    // -------------------------------------------
+    bool failed = false;
+    const double warmupHours = cfg.warmupMin / 60.0;
+    std::vector<SoakSample> steady;
+    for (const SoakSample& s : samples)
+    {
+        if (s.hours > warmupHours)
+            steady.push_back(s);
+    }
+
+    static const TrendRule kRules[] = {
+        { "private_bytes", "MB", &SoakSample::privateMb, 8.0, 0.10 },
+        { "live_allocs", "개", &SoakSample::liveAllocs, 256.0, 0.05 },
+        { "latency_p99", "ms", &SoakSample::latencyP99Ms, 1.0, 0.20 },
+        { "mix_tick_p99", "ms", &SoakSample::mixTickP99Ms, 0.25, 0.50 },
+        { "threads_per_conn", "개", &SoakSample::extraThreads, 2.0, 0.0 },
+    };
+
+    if (steady.size() < 4)
+        std::cout << "[soak] 워밍업 뒤 표본 " << steady.size() << "개 : 추세 판정 생략 (--hours 를 늘리거나 --sample-sec 를 줄인다)" << std::endl;
+    else
+    {
+        std::cout << "[soak] 추세 (워밍업 " << cfg.warmupMin << " 분 제외, 표본 " << steady.size() << "개)" << std::endl;
+        for (const TrendRule& rule : kRules)
+        {
+            const TrendResult r = FitTrend(steady, rule);
+            failed |= r.failed;
+            char line[256];
+            snprintf(line, sizeof(line), "[soak]   %-18s 기준 %10.3f %-2s  기울기 %+10.4f /h  증가 %+10.3f  (허용 %.3f, %.0f%%)  %s",
+                rule.name, r.baseline, rule.unit, r.perHour, r.growth, rule.absTol, rule.relTol * 100, r.failed ? "실패" : "ok");
+            std::cout << line << std::endl;
+        }
+    }
+
+    // 마지막 정리 상태
+    std::vector<uint64_t> counters;
+    gCounters.Sum(counters, CNT_COUNT);
+    size_t remaining;
+    {
+        std::lock_guard<std::mutex> glock(gClientMutex);
+        remaining = gClients.size();
+    }
+    const uint32_t threadsAfter = CountProcessThreads();
+    const bool cleanExit = remaining == 0 && attachRefused == 0
+        && counters[CNT_CLIENTS_ACCEPTED] == counters[CNT_CLIENTS_REMOVED] && threadsAfter <= threadsBefore;
+    std::cout << "[soak] 접속 " << counters[CNT_CLIENTS_ACCEPTED] << " / 제거 " << counters[CNT_CLIENTS_REMOVED]
+        << " / gClients 잔여 " << remaining << " / 슬롯 부족 거부 " << attachRefused << " / 스레드 " << threadsBefore << " -> " << threadsAfter << (cleanExit ? "" : "  실패") << std::endl;
+    failed |= !cleanExit;
+
+    std::cout << (failed ? "[soak] 실패 : 증가 추세 또는 정리 누락" : "[soak] 통과") << std::endl;
+    return failed ? 1 : 0;
+}
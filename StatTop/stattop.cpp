@@ -0,0 +1,269 @@
+﻿// =============================
+//      stattop.cpp
+//      Date : 2026-10-17
+// =============================
+// 공유 메모리 통계 뷰어 (top 형식)
+//  - 서버가 게시하는 공유 메모리 세그먼트(core/stats_shm.h, 서버 --shm-ms)를 --interval ms 마다 읽어 화면 갱신
+//  - 소켓 / HTTP 스크랩이 아니라 매핑된 메모리 복사라 수 ms 간격으로 봐도 서버 쪽 비용이 없다
+//  - 초당 rate 는 직전 스냅샷과의 게시 시각 차이로 계산 (게시 주기보다 짧게 읽으면 직전 rate 유지)
+//  - 클라이언트는 --sort 기준 상위 --top 명 (queue : 송신 큐 깊이, drops : 초당 drop, out : 초당 송신, id)
+//  - 서버가 없거나 재시작되면 1초마다 다시 붙는다 (게시 주기의 몇 배 동안 게시가 없으면 멈춘 것으로 보고 다시 붙는다)
+//
+//  사용법 : StatTop.exe [--interval MS] [--top N] [--sort queue|drops|out|id] [--name 이름] [--once]
+// =============================
+#include "../core/core.h"
+#include "../core/stats_shm.h"
+#include <algorithm>
+#include <csignal>
+#include <map>
+#include <memory>
+#include <sstream>
+
+struct TopConfig
+{
+    int intervalMs = 100;
+    int top = 20;
+    std::string sort = "queue";
+    std::wstring name = STATS_SHM_DEFAULT_NAME;
+    bool once = false;
+};
+
+// 클라이언트 한 명의 초당 변화량
+struct ClientRate
+{
+    StatsShmClient cur;
+    double dropsPerSec = 0;
+    double inPerSec = 0;
+    double outPerSec = 0;
+};
+
+static std::atomic<bool> gRunning{ true };
+
+static void SignalHandler(int) { gRunning = false; }
+
+static bool ParseArgs(int argc, char* argv[], TopConfig& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (a == "--once")
+            cfg.once = true;
+        else if (a == "--interval" && hasValue)
+            cfg.intervalMs = (std::max)(1, std::atoi(argv[++i]));
+        else if (a == "--top" && hasValue)
+            cfg.top = (std::max)(0, std::atoi(argv[++i]));
+        else if (a == "--sort" && hasValue)
+        {
+            cfg.sort = argv[++i];
+            if (cfg.sort != "queue" && cfg.sort != "drops" && cfg.sort != "out" && cfg.sort != "id")
+                return false;
+        }
+        else if (a == "--name" && hasValue)
+        {
+            const std::string n = argv[++i];
+            cfg.name.assign(n.begin(), n.end());
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+static double PerSec(uint64_t cur, uint64_t prev, double sec)
+{
+    return sec > 0 && cur >= prev ? (cur - prev) / sec : 0.0;
+}
+
+// -------------------------------------------
+// Render
+//  - 한 화면 분량을 문자열로 만든다 (prev 가 없으면 rate 는 0)
+// -------------------------------------------
+static std::string Render(const TopConfig& cfg, uint32_t pid, const StatsShmPayload& cur, const StatsShmPayload* prev,
+    double sec, uint32_t retries)
+{
+    std::ostringstream os;
+    char line[256];
+
+    const double ageMs = (nowNs() - cur.publishNs) / 1e6;
+    snprintf(line, sizeof(line), "GroupAudioChat 서버 pid %u  게시 #%llu (%.1f ms 전)  읽기 재시도 %u",
+        pid, (unsigned long long)cur.publishCount, ageMs, retries);
+    os << line << "\n";
+
+    const StatsShmPayload& p = prev ? *prev : cur;
+    snprintf(line, sizeof(line), "클라이언트 %u (접속 %llu / 제거 %llu)",
+        cur.clientsTotal, (unsigned long long)cur.clientsAccepted, (unsigned long long)cur.clientsRemoved);
+    os << line << "\n";
+    snprintf(line, sizeof(line), "수신  %9.1f fr/s  제어 %6.1f/s  %8.2f MB/s     송신 %9.1f fr/s  %8.2f MB/s",
+        PerSec(cur.framesReceived, p.framesReceived, sec), PerSec(cur.ctrlReceived, p.ctrlReceived, sec),
+        PerSec(cur.bytesIn, p.bytesIn, sec) / 1e6,
+        PerSec(cur.framesSent, p.framesSent, sec), PerSec(cur.bytesOut, p.bytesOut, sec) / 1e6);
+    os << line << "\n";
+
+    const double ticks = PerSec(cur.mixTicks, p.mixTicks, sec);
+    const uint64_t tickDelta = cur.mixTicks - p.mixTicks;
+    snprintf(line, sizeof(line), "믹서  %6.1f tick/s  batch %3lld  tick %7.3f ms (최대 %.3f)  overrun %llu",
+        ticks, (long long)cur.mixBatchFrames, cur.tickLastNs / 1e6, cur.tickMaxNs / 1e6,
+        (unsigned long long)cur.tickOverruns);
+    os << line << "\n";
+    snprintf(line, sizeof(line), "      on-CPU %7.3f ms  off-CPU %7.3f ms  락 대기 %7.3f ms  (구간 평균 on %.3f / off %.3f ms)",
+        cur.tickLastCpuNs / 1e6, cur.tickLastOffCpuNs / 1e6, cur.tickLockWaitNs / 1e6,
+        tickDelta ? (cur.tickCpuNs - p.tickCpuNs) / 1e6 / tickDelta : 0.0,
+        tickDelta ? (cur.tickOffCpuNs - p.tickOffCpuNs) / 1e6 / tickDelta : 0.0);
+    os << line << "\n";
+    snprintf(line, sizeof(line), "drop  %6.1f/s (누적 %llu)",
+        PerSec(cur.framesDropped, p.framesDropped, sec), (unsigned long long)cur.framesDropped);
+    os << line << "\n\n";
+
+    // 클라이언트별 rate (직전 스냅샷에서 같은 id 를 찾는다)
+    std::map<uint32_t, const StatsShmClient*> prevById;
+    if (prev)
+    {
+        for (uint32_t i = 0; i < prev->clientCount; i++)
+            prevById[prev->clients[i].id] = &prev->clients[i];
+    }
+
+    std::vector<ClientRate> rows;
+    for (uint32_t i = 0; i < cur.clientCount; i++)
+    {
+        ClientRate r;
+        r.cur = cur.clients[i];
+        auto it = prevById.find(r.cur.id);
+        if (it != prevById.end())
+        {
+            r.dropsPerSec = PerSec(r.cur.dropped, it->second->dropped, sec);
+            r.inPerSec = PerSec(r.cur.framesIn, it->second->framesIn, sec);
+            r.outPerSec = PerSec(r.cur.framesOut, it->second->framesOut, sec);
+        }
+        rows.push_back(r);
+    }
+
+    std::sort(rows.begin(), rows.end(), [&](const ClientRate& a, const ClientRate& b) {
+        if (cfg.sort == "drops") return a.dropsPerSec != b.dropsPerSec ? a.dropsPerSec > b.dropsPerSec : a.cur.dropped > b.cur.dropped;
+        if (cfg.sort == "out") return a.outPerSec > b.outPerSec;
+        if (cfg.sort == "id") return a.cur.id < b.cur.id;
+        return a.cur.queueDepth > b.cur.queueDepth;
+    });
+
+    os << "      id  발화  queue   drop/s     drops   in fr/s  out fr/s" << "\n";
+    const size_t shown = (std::min)(rows.size(), (size_t)cfg.top);
+    for (size_t i = 0; i < shown; i++)
+    {
+        const ClientRate& r = rows[i];
+        snprintf(line, sizeof(line), "  %6u  %4s  %5llu %8.1f %9llu %9.1f %9.1f",
+            r.cur.id, r.cur.talking ? "o" : "-", (unsigned long long)r.cur.queueDepth, r.dropsPerSec,
+            (unsigned long long)r.cur.dropped, r.inPerSec, r.outPerSec);
+        os << line << "\n";
+    }
+    if (cur.clientsTotal > cur.clientCount)
+        os << "  (세그먼트에 담긴 " << cur.clientCount << "명만 표시, 전체 " << cur.clientsTotal << "명)" << "\n";
+
+    return os.str();
+}
+
+// 콘솔 VT 시퀀스 사용 (화면 지우기 / 커서 이동)
+static void EnableVirtualTerminal()
+{
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(out, &mode))
+        SetConsoleMode(out, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+}
+
+int main(int argc, char* argv[])
+{
+    TopConfig cfg;
+    if (!ParseArgs(argc, argv, cfg))
+    {
+        std::cerr << "사용법 : StatTop.exe [--interval MS] [--top N] [--sort queue|drops|out|id] [--name 이름] [--once]" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, SignalHandler);
+    if (!cfg.once)
+        EnableVirtualTerminal();
+
+    // 스냅샷 두 개를 번갈아 쓴다 (클라이언트 배열 때문에 크므로 힙)
+    std::unique_ptr<StatsShmPayload> snaps[2] = {
+        std::unique_ptr<StatsShmPayload>(new StatsShmPayload()),
+        std::unique_ptr<StatsShmPayload>(new StatsShmPayload()) };
+    int curIdx = 0;
+    bool havePrev = false;
+
+    StatsShmReader reader;
+    bool attached = false;
+    while (gRunning)
+    {
+        if (!attached)
+        {
+            const int rc = reader.Open(cfg.name);
+            if (rc == 2)
+            {
+                std::cerr << "[stattop] 세그먼트 버전 불일치 (서버와 StatTop 을 같은 소스로 빌드해야 한다)" << std::endl;
+                return 1;
+            }
+            if (rc != 0)
+            {
+                if (cfg.once)
+                {
+                    std::cerr << "[stattop] 통계 세그먼트 없음 (서버가 --shm-ms 0 이거나 실행 중이 아님)" << std::endl;
+                    return 1;
+                }
+                std::cout << "\x1b[H\x1b[J[stattop] 서버 대기 중..." << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            attached = true;
+            havePrev = false;
+        }
+
+        StatsShmPayload& cur = *snaps[curIdx];
+        const StatsShmPayload& prev = *snaps[curIdx ^ 1];
+        uint32_t retries = 0;
+        const bool consistent = reader.Read(cur, retries);
+
+        // 서버가 멈췄는지 (게시 도중 멈췄거나 게시 주기의 몇 배 동안 게시가 없으면 다시 붙는다 : 재시작하면 새 세그먼트)
+        // 서버가 매핑을 쥔 채 멈추면 Open 이 바로 다시 성공하므로 쉬었다가 붙는다
+        if (!consistent || (nowNs() - cur.publishNs > reader.StaleNs() && !cfg.once))
+        {
+            if (cfg.once)
+            {
+                std::cerr << "[stattop] 서버가 게시 도중 멈춤 (일관된 스냅샷을 읽지 못함)" << std::endl;
+                return 1;
+            }
+            reader.Close();
+            attached = false;
+            std::cout << "\x1b[H\x1b[J[stattop] 서버 게시 멈춤, 다시 붙는 중..." << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.intervalMs));
+            continue;
+        }
+
+        // --once 도 rate 를 보여주도록 첫 스냅샷은 기준으로만 쓴다
+        if (cfg.once && !havePrev)
+        {
+            curIdx ^= 1;
+            havePrev = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.intervalMs));
+            continue;
+        }
+
+        // 게시가 아직 안 바뀌었으면 화면과 기준 스냅샷(prev)을 그대로 둔다
+        const bool fresh = !havePrev || cur.publishCount != prev.publishCount;
+        const double sec = havePrev ? (cur.publishNs - prev.publishNs) / 1e9 : 0.0;
+        if (fresh)
+        {
+            const std::string screen = Render(cfg, reader.ServerPid(), cur, havePrev ? &prev : nullptr, sec, retries);
+            if (cfg.once)
+            {
+                std::cout << screen;
+                return 0;
+            }
+            std::cout << "\x1b[H\x1b[J" << screen << std::flush;
+            curIdx ^= 1;
+            havePrev = true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(cfg.intervalMs));
+    }
+    return 0;
+}
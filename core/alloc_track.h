@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// ──────────────────────────────
+// 힙 할당 추적 (빌드 모드)
+// - GAC_ALLOC_TRACK=1 이면 전역 operator new / delete 를 바꿔 스레드별 / 전체 할당 횟수를 센다
+// - 기본값 0 : 아래 함수는 모두 0 을 돌려주고 HotPathAllocScope 는 빈 객체 (비용 없음)
+// - 서버를 /DGAC_ALLOC_TRACK=1 로 빌드하면 /metrics 에 gac_hot_path_allocations_total 이 나온다
+//   (AllocCheck 도구는 항상 켠 상태로 빌드)
+// - operator new 교체는 실행 파일 전체에 하나만 있어야 한다
+//   (이 저장소의 실행 파일은 .cpp 하나짜리라 그 .cpp 가 include 하면 된다)
+// - 스레드별 카운터는 POD thread_local 이라 operator new 안에서 써도 할당이 일어나지 않는다
+// ──────────────────────────────
+#ifndef GAC_ALLOC_TRACK
+#define GAC_ALLOC_TRACK 0
+#endif
+
+struct AllocCounts
+{
+	uint64_t allocs = 0;
+	uint64_t frees = 0;
+	uint64_t bytes = 0;										// 할당 요청 바이트 누적
+};
+
+#if GAC_ALLOC_TRACK
+
+static thread_local uint64_t tAllocs = 0;
+static thread_local uint64_t tFrees = 0;
+static thread_local uint64_t tAllocBytes = 0;
+static std::atomic<uint64_t> gAllocTotal{ 0 };
+static std::atomic<uint64_t> gFreeTotal{ 0 };
+static std::atomic<uint64_t> gAllocBytesTotal{ 0 };
+
+static void* allocTracked(size_t size)
+{
+	void* p = std::malloc(size ? size : 1);
+	if (p)
+	{
+		tAllocs++;
+		tAllocBytes += size;
+		gAllocTotal.fetch_add(1, std::memory_order_relaxed);
+		gAllocBytesTotal.fetch_add(size, std::memory_order_relaxed);
+	}
+	return p;
+}
+
+static void freeTracked(void* p)
+{
+	if (!p)
+		return;
+	tFrees++;
+	gFreeTotal.fetch_add(1, std::memory_order_relaxed);
+	std::free(p);
+}
+
+void* operator new(size_t size)
+{
+	void* p = allocTracked(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = allocTracked(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocTracked(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocTracked(size); }
+void operator delete(void* p) noexcept { freeTracked(p); }
+void operator delete[](void* p) noexcept { freeTracked(p); }
+void operator delete(void* p, size_t) noexcept { freeTracked(p); }
+void operator delete[](void* p, size_t) noexcept { freeTracked(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { freeTracked(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { freeTracked(p); }
+
+static bool allocTrackEnabled() { return true; }
+
+// 현재 스레드 누적
+static AllocCounts allocThreadCounts()
+{
+	AllocCounts c;
+	c.allocs = tAllocs;
+	c.frees = tFrees;
+	c.bytes = tAllocBytes;
+	return c;
+}
+
+// 프로세스 전체 누적
+static AllocCounts allocTotalCounts()
+{
+	AllocCounts c;
+	c.allocs = gAllocTotal.load(std::memory_order_relaxed);
+	c.frees = gFreeTotal.load(std::memory_order_relaxed);
+	c.bytes = gAllocBytesTotal.load(std::memory_order_relaxed);
+	return c;
+}
+
+#else
+
+static bool allocTrackEnabled() { return false; }
+static AllocCounts allocThreadCounts() { return AllocCounts(); }
+static AllocCounts allocTotalCounts() { return AllocCounts(); }
+
+#endif
+
+// ──────────────────────────────
+// HotPathAllocScope
+// - 범위 안에서 현재 스레드가 한 할당 횟수를 counter 에 더한다
+// - 워밍업 뒤 핫 패스(수신 적재 / 믹스 / 팬아웃 / 송신) 카운터가 늘면 회귀
+// ──────────────────────────────
+#if GAC_ALLOC_TRACK
+class HotPathAllocScope
+{
+public:
+	explicit HotPathAllocScope(std::atomic<uint64_t>& counter)
+		: mCounter(counter), mStart(tAllocs)
+	{
+	}
+
+	~HotPathAllocScope()
+	{
+		const uint64_t n = tAllocs - mStart;
+		if (n)
+			mCounter.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	HotPathAllocScope(const HotPathAllocScope&) = delete;
+	HotPathAllocScope& operator=(const HotPathAllocScope&) = delete;
+
+private:
+	std::atomic<uint64_t>& mCounter;
+	uint64_t mStart;
+};
+#else
+class HotPathAllocScope
+{
+public:
+	explicit HotPathAllocScope(std::atomic<uint64_t>&) {}
+};
+#endif
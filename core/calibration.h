@@ -0,0 +1,341 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "mixer.h"
+
+// ──────────────────────────────
+// 음향 루프백 보정 (장치 입출력 지연 측정)
+// - 재생 장치로 MLS(최대 길이 수열, ±1) 자극을 CAL_TRIALS 번 내보내고 캡처 스트림에서
+//   상호상관(cross-correlation) 최댓값 위치를 찾아 재생 위치 ~ 캡처 위치 차이(장치 왕복 지연)를 잰다
+//   . MLS 의 자기상관은 0 지연에서만 크고 나머지는 거의 0 이라 잡음 / 잔향 속에서도 최댓값이 뚜렷하다
+//   . 극성이 뒤집히는 장치가 있어 |상관| 최댓값을 쓰고, 이웃 두 값으로 포물선 보간해 1 샘플 미만까지 추정
+//   . 최댓값 / 상관 RMS 가 CAL_MIN_PEAK_RATIO 보다 작으면 그 시도는 검출 실패로 본다
+// - 결과는 검출된 시도들의 중앙값, 시도 간 차이(spread)는 장치 버퍼링 지터
+// - 상관은 지연마다 길이 refLen 내적이라 계산량이 크다 : 믹서와 같은 방식으로 scalar / SSE2 / AVX2 커널을 고른다
+// - 입출력(장치 / 파일 / 합성 루프백)은 호출 측이 맡고 여기서는 재생 스트림 생성과 분석만 한다
+//   captureShift : 재생 스트림 0 번 샘플과 같은 시점의 캡처 스트림 위치 (장치는 waveOutWrite 순간의 캡처 위치)
+// ──────────────────────────────
+#define CAL_MLS_ORDER 13								// 8191 샘플 (16kHz 에서 약 0.5초)
+#define CAL_MLS_TAPS 0x100Du							// order 13 Galois LFSR (주기 8191 확인)
+#define CAL_LEVEL 8192									// 자극 진폭 (-12 dBFS)
+#define CAL_TRIALS 3
+#define CAL_LEAD_MS 300									// 첫 자극 앞 무음 (장치 시작 과도 구간)
+#define CAL_MAX_LATENCY_MS 1000							// 이 이상 늦게 들어오면 찾지 않는다
+#define CAL_GAP_MS 200									// 자극 사이 여유 (CAL_MAX_LATENCY_MS 에 더한다)
+#define CAL_MIN_PEAK_RATIO 8.0
+
+typedef float (*CalDotFn)(const float* a, const float* b, size_t n);
+
+struct CalibrationPlan
+{
+	uint32_t sampleRate = 0;
+	std::vector<float> reference;						// MLS 한 주기 (±1)
+	std::vector<int16_t> play;							// 재생 스트림 전체 (mono)
+	size_t offsets[CAL_TRIALS] = {};					// 자극 시작 위치 (재생 스트림 샘플)
+	size_t maxLagSamples = 0;
+};
+
+struct CalibrationTrial
+{
+	bool found = false;
+	double latencySamples = 0.0;
+	double peakRatio = 0.0;
+};
+
+struct CalibrationResult
+{
+	CalibrationTrial trials[CAL_TRIALS];
+	int detected = 0;
+	double latencyMs = 0.0;								// 검출된 시도의 중앙값
+	double spreadMs = 0.0;								// 검출된 시도의 최대 - 최소
+	double analyzeMs = 0.0;								// 상관 계산 시간
+	const char* kernel = "";
+};
+
+// ──────────────────────────────
+// 상관 커널 (내적)
+// ──────────────────────────────
+static float CalDot_Scalar(const float* a, const float* b, size_t n)
+{
+	float acc = 0.0f;
+	for (size_t i = 0; i < n; i++)
+		acc += a[i] * b[i];
+	return acc;
+}
+
+#ifdef MIX_HAS_X86_SIMD
+static float CalDot_SSE2(const float* a, const float* b, size_t n)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + CalDot_Scalar(a + i, b + i, n - i);
+}
+
+// 누산기 2개로 add 지연을 숨긴다 (FMA 는 AVX2 확인으로 보장되지 않아 쓰지 않음)
+static float CalDot_AVX2(const float* a, const float* b, size_t n)
+{
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+	}
+	const __m256 acc = _mm256_add_ps(acc0, acc1);
+	const __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + CalDot_SSE2(a + i, b + i, n - i);
+}
+#endif
+
+static CalDotFn GetCalDot(MixKernelKind kind)
+{
+#ifdef MIX_HAS_X86_SIMD
+	if (kind == MIX_KERNEL_AVX2)
+		return CalDot_AVX2;
+	if (kind == MIX_KERNEL_SSE2)
+		return CalDot_SSE2;
+#endif
+	(void)kind;
+	return CalDot_Scalar;
+}
+
+// ──────────────────────────────
+// 재생 스트림 : [CAL_LEAD_MS 무음] + CAL_TRIALS x [MLS + (CAL_MAX_LATENCY_MS + CAL_GAP_MS) 무음]
+// ──────────────────────────────
+static void BuildCalibrationPlan(uint32_t sampleRate, CalibrationPlan& plan)
+{
+	plan.sampleRate = sampleRate;
+	plan.maxLagSamples = (size_t)sampleRate * CAL_MAX_LATENCY_MS / 1000;
+
+	const size_t len = ((size_t)1 << CAL_MLS_ORDER) - 1;
+	plan.reference.resize(len);
+	uint32_t state = 1;
+	for (size_t i = 0; i < len; i++)
+	{
+		plan.reference[i] = (state & 1) ? 1.0f : -1.0f;
+		state = (state & 1) ? (state >> 1) ^ CAL_MLS_TAPS : state >> 1;
+	}
+
+	const size_t lead = (size_t)sampleRate * CAL_LEAD_MS / 1000;
+	const size_t gap = plan.maxLagSamples + (size_t)sampleRate * CAL_GAP_MS / 1000;
+	plan.play.assign(lead + CAL_TRIALS * (len + gap), 0);
+	for (int t = 0; t < CAL_TRIALS; t++)
+	{
+		plan.offsets[t] = lead + t * (len + gap);
+		for (size_t i = 0; i < len; i++)
+			plan.play[plan.offsets[t] + i] = (int16_t)(plan.reference[i] * CAL_LEVEL);
+	}
+}
+
+// 장치가 재생을 다 마친 뒤에도 마지막 자극이 캡처될 때까지 필요한 캡처 길이 (captureShift 제외)
+static size_t CalibrationCaptureSamples(const CalibrationPlan& plan)
+{
+	return plan.play.size() + plan.maxLagSamples;
+}
+
+// ──────────────────────────────
+// 시도 하나 : 캡처 [start, start + maxLag] 구간에서 상관 최댓값 위치
+// ──────────────────────────────
+static CalibrationTrial DetectCalibrationTrial(const CalibrationPlan& plan, const std::vector<float>& capture,
+	int64_t start, CalDotFn dot, std::vector<float>& corr)
+{
+	CalibrationTrial trial;
+	const size_t refLen = plan.reference.size();
+	if (start < 0 || (size_t)start + refLen > capture.size())
+		return trial;
+
+	const size_t lags = (std::min)(plan.maxLagSamples + 1, capture.size() - refLen - (size_t)start + 1);
+	corr.resize(lags);
+	double energy = 0.0;
+	size_t best = 0;
+	for (size_t k = 0; k < lags; k++)
+	{
+		corr[k] = std::fabs(dot(plan.reference.data(), capture.data() + start + k, refLen));
+		energy += (double)corr[k] * corr[k];
+		if (corr[k] > corr[best])
+			best = k;
+	}
+
+	const double rms = std::sqrt(energy / lags);
+	trial.peakRatio = rms > 0.0 ? corr[best] / rms : 0.0;
+	if (trial.peakRatio < CAL_MIN_PEAK_RATIO)
+		return trial;
+
+	// 포물선 보간 (양 끝이면 정수 위치 그대로)
+	double frac = 0.0;
+	if (best > 0 && best + 1 < lags)
+	{
+		const double l = corr[best - 1], c = corr[best], r = corr[best + 1];
+		const double denom = l - 2.0 * c + r;
+		if (denom < 0.0)
+			frac = 0.5 * (l - r) / denom;
+	}
+	trial.found = true;
+	trial.latencySamples = (double)best + frac;
+	return trial;
+}
+
+// ──────────────────────────────
+// 캡처 스트림 분석 (mono 16bit)
+// ──────────────────────────────
+static void AnalyzeCalibration(const CalibrationPlan& plan, const int16_t* capture, size_t captureLen,
+	int64_t captureShift, MixKernelKind kind, CalibrationResult& out)
+{
+	out = CalibrationResult();
+	out.kernel = GetMixKernel(kind).name;
+	const CalDotFn dot = GetCalDot(kind);
+
+	std::vector<float> samples(captureLen);
+	for (size_t i = 0; i < captureLen; i++)
+		samples[i] = capture[i] / 32768.0f;
+
+	const int64_t startNs = nowNs();
+	std::vector<float> corr;
+	std::vector<double> found;
+	for (int t = 0; t < CAL_TRIALS; t++)
+	{
+		out.trials[t] = DetectCalibrationTrial(plan, samples, captureShift + (int64_t)plan.offsets[t], dot, corr);
+		if (out.trials[t].found)
+			found.push_back(out.trials[t].latencySamples);
+	}
+	out.analyzeMs = (nowNs() - startNs) / 1e6;
+
+	out.detected = (int)found.size();
+	if (found.empty())
+		return;
+
+	std::sort(found.begin(), found.end());
+	const double median = found.size() % 2 ? found[found.size() / 2]
+		: (found[found.size() / 2 - 1] + found[found.size() / 2]) / 2.0;
+	out.latencyMs = median * 1000.0 / plan.sampleRate;
+	out.spreadMs = (found.back() - found.front()) * 1000.0 / plan.sampleRate;
+}
+
+// ──────────────────────────────
+// 합성 루프백 (자동 점검용)
+// - 재생 스트림을 delaySamples 만큼 늦추고 gain 으로 줄인 뒤 결정적 잡음(진폭 noise)을 더한다
+// ──────────────────────────────
+static void SimulateAcousticLoopback(const std::vector<int16_t>& play, size_t delaySamples, float gain, int noise,
+	std::vector<int16_t>& capture)
+{
+	capture.assign(play.size() + delaySamples + play.size() / 4, 0);
+	uint32_t seed = 0x12345678u;
+	for (size_t i = 0; i < capture.size(); i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		int v = noise > 0 ? (int)(seed >> 16) % (2 * noise + 1) - noise : 0;
+		if (i >= delaySamples && i - delaySamples < play.size())
+			v += (int)(play[i - delaySamples] * gain);
+		capture[i] = MixClamp16(v);
+	}
+}
+
+// ──────────────────────────────
+// WAV 파일 (파일 백엔드 : 자극을 내보내고, 다른 도구로 재생하며 녹음한 파일을 분석)
+// - 16bit PCM 만, 읽을 때 다채널이면 첫 채널만 쓴다
+// ──────────────────────────────
+#pragma pack(push, 1)
+struct WavHeader
+{
+	char riff[4];
+	uint32_t riffBytes;
+	char wave[4];
+	char fmt[4];
+	uint32_t fmtBytes;
+	uint16_t format;
+	uint16_t channels;
+	uint32_t sampleRate;
+	uint32_t byteRate;
+	uint16_t blockAlign;
+	uint16_t bitsPerSample;
+	char data[4];
+	uint32_t dataBytes;
+};
+#pragma pack(pop)
+
+static bool WriteWavMono16(const std::string& path, uint32_t sampleRate, const std::vector<int16_t>& samples)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	WavHeader h;
+	memcpy(h.riff, "RIFF", 4);
+	memcpy(h.wave, "WAVE", 4);
+	memcpy(h.fmt, "fmt ", 4);
+	memcpy(h.data, "data", 4);
+	h.dataBytes = (uint32_t)(samples.size() * sizeof(int16_t));
+	h.riffBytes = (uint32_t)(sizeof(WavHeader) - 8 + h.dataBytes);
+	h.fmtBytes = 16;
+	h.format = 1;
+	h.channels = 1;
+	h.sampleRate = sampleRate;
+	h.bitsPerSample = 16;
+	h.blockAlign = 2;
+	h.byteRate = sampleRate * 2;
+	out.write((const char*)&h, sizeof(h));
+	out.write((const char*)samples.data(), h.dataBytes);
+	return (bool)out;
+}
+
+static bool ReadWavMono16(const std::string& path, uint32_t& sampleRate, std::vector<int16_t>& samples)
+{
+	std::ifstream in(path, std::ios::binary);
+	char riff[12];
+	if (!in.read(riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+		return false;
+
+	// 청크를 훑어 fmt / data 를 찾는다 (LIST 등 다른 청크는 건너뜀)
+	uint16_t format = 0, channels = 0, bits = 0;
+	char id[4];
+	uint32_t bytes = 0;
+	while (in.read(id, 4) && in.read((char*)&bytes, 4))
+	{
+		if (memcmp(id, "fmt ", 4) == 0 && bytes >= 16)
+		{
+			char fmt[16];
+			in.read(fmt, sizeof(fmt));
+			memcpy(&format, fmt, 2);
+			memcpy(&channels, fmt + 2, 2);
+			memcpy(&sampleRate, fmt + 4, 4);
+			memcpy(&bits, fmt + 14, 2);
+			in.seekg(bytes - 16 + (bytes & 1), std::ios::cur);
+		}
+		else if (memcmp(id, "data", 4) == 0)
+		{
+			if (format != 1 || bits != 16 || channels == 0)
+				return false;
+
+			std::vector<int16_t> interleaved(bytes / sizeof(int16_t));
+			in.read((char*)interleaved.data(), interleaved.size() * sizeof(int16_t));
+			interleaved.resize((size_t)in.gcount() / sizeof(int16_t));
+			samples.resize(interleaved.size() / channels);
+			for (size_t i = 0; i < samples.size(); i++)
+				samples[i] = interleaved[i * channels];
+			return true;
+		}
+		else
+			in.seekg(bytes + (bytes & 1), std::ios::cur);
+	}
+	return false;
+}
@@ -0,0 +1,283 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+
+// ──────────────────────────────
+// 캡처 파일 (.gacap)
+// - 서버가 수신한 프레임을 도착 순서대로 이어 붙이는 append-only 파일
+// - 파일 헤더 뒤에 [레코드 헤더 + payload(8바이트 정렬 패딩)] 반복
+// - 고정 레이아웃 리틀 엔디언 (x86/x64 메모리 그대로) 이라 통째로 매핑해서 읽는다
+// - 비정상 종료로 마지막 레코드가 잘려 있으면 읽기 측이 그 앞에서 멈춘다
+// ──────────────────────────────
+#define CAPTURE_MAGIC 0x50414347u							// "GCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_FLUSH_MS 100
+#define CAPTURE_MAX_PENDING (64 * 1024 * 1024)				// 기록 스레드가 밀릴 때 버퍼 상한 (초과분 drop)
+
+enum CaptureRecordType : uint16_t
+{
+	CAPTURE_JOIN = 1,										// 클라이언트 접속 (payload 없음)
+	CAPTURE_FRAME = 2,										// 수신 프레임 (오디오 또는 제어)
+	CAPTURE_LEAVE = 3										// 클라이언트 제거 (payload 없음)
+};
+
+#pragma pack(push, 1)
+struct CaptureFileHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerBytes;									// sizeof(CaptureFileHeader)
+	uint32_t frameBytes;									// 기록 당시 AUDIO_BUFFER_SIZE
+	uint32_t reserved;
+	int64_t startUnixMs;									// 기록 시작 시각 (참고용)
+	int64_t reserved2;
+};
+
+struct CaptureRecordHeader
+{
+	int64_t tsNs;											// 기록 시작 기준 도착 시각
+	uint32_t clientId;
+	uint16_t type;											// CaptureRecordType
+	uint16_t reserved;
+	uint32_t len;											// payload 바이트 (패딩 제외)
+	uint32_t reserved2;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CaptureFileHeader) == 32, "capture header layout");
+static_assert(sizeof(CaptureRecordHeader) == 24, "capture record layout");
+
+static size_t capturePadded(size_t len)
+{
+	return (len + 7) & ~(size_t)7;
+}
+
+// ──────────────────────────────
+// CaptureWriter
+// - Append 는 여러 수신 스레드에서 호출 : mutex 안에서 대기 버퍼에 복사만 한다
+// - 기록 스레드가 CAPTURE_FLUSH_MS 마다 버퍼를 통째로 바꿔 파일에 쓴다
+//   (믹싱 큐 gMixFrames 와 같은 swap 방식, 디스크 I/O 는 수신 경로 밖)
+// ──────────────────────────────
+class CaptureWriter
+{
+public:
+	~CaptureWriter() { Close(); }
+
+	bool Open(const std::string& path)
+	{
+		mOut.open(path, std::ios::binary | std::ios::trunc);
+		if (!mOut)
+			return false;
+
+		CaptureFileHeader h{};
+		h.magic = CAPTURE_MAGIC;
+		h.version = CAPTURE_VERSION;
+		h.headerBytes = sizeof(CaptureFileHeader);
+		h.frameBytes = AUDIO_BUFFER_SIZE;
+		h.startUnixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		mOut.write((const char*)&h, sizeof(h));
+
+		mBaseNs = nowNs();
+		mRunning = true;
+		mThread = std::thread(&CaptureWriter::WriterLoop, this);
+		return true;
+	}
+
+	void Close()
+	{
+		if (!mThread.joinable())
+			return;
+
+		mRunning = false;
+		mCV.notify_one();
+		mThread.join();
+		mOut.close();
+	}
+
+	bool IsOpen() const { return mRunning; }
+
+	// tsNs 는 nowNs() 기준 절대 시각
+	void Append(CaptureRecordType type, uint32_t clientId, int64_t tsNs, const char* data, uint32_t len)
+	{
+		CaptureRecordHeader r{};
+		r.tsNs = tsNs - mBaseNs;
+		r.clientId = clientId;
+		r.type = type;
+		r.len = len;
+
+		const size_t padded = capturePadded(len);
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mPending.size() + sizeof(r) + padded > CAPTURE_MAX_PENDING)
+		{
+			mDropped++;
+			return;
+		}
+
+		const size_t at = mPending.size();
+		mPending.resize(at + sizeof(r) + padded, 0);
+		memcpy(&mPending[at], &r, sizeof(r));
+		if (len)
+			memcpy(&mPending[at + sizeof(r)], data, len);
+		mRecords++;
+	}
+
+	uint64_t Records() const { return mRecords; }
+	uint64_t Dropped() const { return mDropped; }
+
+private:
+	void WriterLoop()
+	{
+		setThreadName("capture-writer");
+		std::vector<char> batch;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCV.wait_for(lock, std::chrono::milliseconds(CAPTURE_FLUSH_MS), [&] { return !mRunning; });
+				batch.swap(mPending);
+			}
+
+			if (!batch.empty())
+			{
+				mOut.write(batch.data(), (std::streamsize)batch.size());
+				mOut.flush();
+				batch.clear();
+			}
+
+			if (!mRunning)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (mPending.empty())
+					break;
+			}
+		}
+	}
+
+	std::ofstream mOut;
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mCV;
+	std::vector<char> mPending;
+	std::atomic<bool> mRunning{ false };
+	std::atomic<uint64_t> mRecords{ 0 };
+	std::atomic<uint64_t> mDropped{ 0 };
+	int64_t mBaseNs = 0;
+};
+
+// ──────────────────────────────
+// CaptureReader
+// - 파일 전체를 읽기 전용으로 매핑 (복사 없음, payload 는 매핑 주소를 그대로 가리킨다)
+// - Next 로 앞에서부터 순서대로 순회, Rewind 로 처음부터 다시
+// ──────────────────────────────
+struct CaptureRecord
+{
+	int64_t tsNs;
+	uint32_t clientId;
+	CaptureRecordType type;
+	const char* data;
+	uint32_t len;
+};
+
+class CaptureReader
+{
+public:
+	~CaptureReader() { Close(); }
+
+	bool Open(const std::string& path)
+	{
+		mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (mFile == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(mFile, &size) || size.QuadPart < (LONGLONG)sizeof(CaptureFileHeader))
+		{
+			Close();
+			return false;
+		}
+		mSize = (size_t)size.QuadPart;
+
+		mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mMapping)
+		{
+			Close();
+			return false;
+		}
+
+		mBase = (const char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		if (!mBase)
+		{
+			Close();
+			return false;
+		}
+
+		memcpy(&mHeader, mBase, sizeof(mHeader));
+		if (mHeader.magic != CAPTURE_MAGIC || mHeader.version != CAPTURE_VERSION ||
+			mHeader.headerBytes < sizeof(CaptureFileHeader) || mHeader.headerBytes > mSize)
+		{
+			Close();
+			return false;
+		}
+
+		Rewind();
+		return true;
+	}
+
+	void Close()
+	{
+		if (mBase)
+			UnmapViewOfFile(mBase);
+		if (mMapping)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mFile);
+		mBase = nullptr;
+		mMapping = nullptr;
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	void Rewind() { mPos = mHeader.headerBytes; }
+
+	// 다음 레코드 (끝이거나 잘린 레코드면 false)
+	bool Next(CaptureRecord& out)
+	{
+		if (!mBase || mPos + sizeof(CaptureRecordHeader) > mSize)
+			return false;
+
+		CaptureRecordHeader r;
+		memcpy(&r, mBase + mPos, sizeof(r));
+		const size_t payload = mPos + sizeof(r);
+		if (payload + capturePadded(r.len) > mSize)
+			return false;
+
+		out.tsNs = r.tsNs;
+		out.clientId = r.clientId;
+		out.type = (CaptureRecordType)r.type;
+		out.data = mBase + payload;
+		out.len = r.len;
+		mPos = payload + capturePadded(r.len);
+		return true;
+	}
+
+	const CaptureFileHeader& Header() const { return mHeader; }
+	size_t SizeBytes() const { return mSize; }
+
+private:
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const char* mBase = nullptr;
+	size_t mSize = 0;
+	size_t mPos = 0;
+	CaptureFileHeader mHeader{};
+};
@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "spsc_ring.h"
+
+struct ClientInfo;
+
+// ──────────────────────────────
+// ClientSlots
+// - 믹서 팬아웃이 tick 마다 클라이언트별로 보는 값을 슬롯 번호로 나란히 둔 배열 (SoA)
+//   gClients 의 shared_ptr 를 따라가 ClientInfo (mutex / condvar / 스레드 / 송신 링) 를 건드리지 않고
+//   플래그 배열만 앞에서부터 읽어 건너뛸 접속을 고른다 (1만 명이면 플래그 10KB)
+// - 슬롯 번호는 접속 동안 바뀌지 않는다 (Acquire ~ Release), 빈 슬롯은 가장 낮은 번호부터 재사용해
+//   훑는 범위 [0, End) 를 촘촘하게 유지한다
+// - 배열마다 캐시 라인 경계에서 시작 : 배열끼리 / 앞뒤 전역과 라인을 나누지 않는다
+// - 플래그는 상태가 바뀔 때만 송수신 스레드가 쓴다
+//   (프레임마다 바뀌는 클라이언트별 카운터 / 송신 큐 깊이는 ClientInfo 에 두어 믹서가 훑는 라인에 I/O 쓰기가 없다)
+// - Acquire / Release / End / Info / Id 는 gClientMutex 안에서만, 플래그는 락 없이
+//   플래그 쓰기는 Acquire ~ Release 사이에만 (DetachClient 는 그 접속의 송수신 스레드가 끝난 뒤 호출)
+// ──────────────────────────────
+#define CLIENT_SLOT_MAX 16384								// 동시 접속 상한
+#define CLIENT_SLOT_NONE UINT32_MAX
+
+enum ClientSlotFlag : uint8_t
+{
+	SLOT_ACTIVE = 1 << 0,									// 팬아웃 대상 (ClientInfo::active 와 함께 내린다)
+	SLOT_ECHO = 1 << 1,										// 에코 모드 (방 믹스 대신 자기 프레임)
+	SLOT_TALKING = 1 << 2,									// 발화 중 (오디오 수신 ~ DTX)
+};
+
+class ClientSlots
+{
+public:
+	ClientSlots()
+	{
+		for (auto& f : mFlags)
+			f.store(0, std::memory_order_relaxed);
+		memset(mInfo, 0, sizeof(mInfo));
+		memset(mIds, 0, sizeof(mIds));
+		memset(mUsed, 0, sizeof(mUsed));
+	}
+
+	// 가장 낮은 빈 슬롯 (가득 차면 CLIENT_SLOT_NONE)
+	uint32_t Acquire(ClientInfo* info, uint32_t id)
+	{
+		for (uint32_t w = 0; w < CLIENT_SLOT_MAX / 64; w++)
+		{
+			if (mUsed[w] == ~0ull)
+				continue;
+
+			uint32_t bit = 0;
+			while (mUsed[w] & (1ull << bit))
+				bit++;
+			mUsed[w] |= 1ull << bit;
+
+			const uint32_t slot = w * 64 + bit;
+			mInfo[slot] = info;
+			mIds[slot] = id;
+			mFlags[slot].store(SLOT_ACTIVE, std::memory_order_relaxed);
+			if (slot >= mEnd)
+				mEnd = slot + 1;
+			return slot;
+		}
+		return CLIENT_SLOT_NONE;
+	}
+
+	void Release(uint32_t slot)
+	{
+		if (slot == CLIENT_SLOT_NONE)
+			return;
+
+		mFlags[slot].store(0, std::memory_order_relaxed);
+		mInfo[slot] = nullptr;
+		mIds[slot] = 0;
+		mUsed[slot / 64] &= ~(1ull << (slot % 64));
+		while (mEnd > 0 && !(mUsed[(mEnd - 1) / 64] & (1ull << ((mEnd - 1) % 64))))
+			mEnd--;
+	}
+
+	void Set(uint32_t slot, uint8_t flag)
+	{
+		if (slot != CLIENT_SLOT_NONE)
+			mFlags[slot].fetch_or(flag, std::memory_order_relaxed);
+	}
+
+	void Clear(uint32_t slot, uint8_t flag)
+	{
+		if (slot != CLIENT_SLOT_NONE)
+			mFlags[slot].fetch_and((uint8_t)~flag, std::memory_order_relaxed);
+	}
+
+	// 훑을 범위 : 가장 높은 사용 슬롯 + 1
+	uint32_t End() const { return mEnd; }
+	uint8_t Flags(uint32_t slot) const { return mFlags[slot].load(std::memory_order_relaxed); }
+	ClientInfo* Info(uint32_t slot) const { return mInfo[slot]; }
+	uint32_t Id(uint32_t slot) const { return mIds[slot]; }
+
+	// flag 가 켜진 슬롯 수 (메트릭)
+	uint32_t Count(uint8_t flag) const
+	{
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < mEnd; i++)
+			if (Flags(i) & flag)
+				n++;
+		return n;
+	}
+
+private:
+	alignas(CACHE_LINE_SIZE) std::atomic<uint8_t> mFlags[CLIENT_SLOT_MAX];
+	alignas(CACHE_LINE_SIZE) ClientInfo* mInfo[CLIENT_SLOT_MAX];
+	alignas(CACHE_LINE_SIZE) uint32_t mIds[CLIENT_SLOT_MAX];
+	alignas(CACHE_LINE_SIZE) uint64_t mUsed[CLIENT_SLOT_MAX / 64];		// 사용 중 슬롯 비트맵
+	uint32_t mEnd = 0;
+};
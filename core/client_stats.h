@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "core.h"
+#include "histogram.h"
+
+// ──────────────────────────────
+// 클라이언트 단계별 지연 보고
+// - 클라이언트가 자기 쪽 단계(캡처 ~ 송신 완료, 수신 ~ 재생 완료)를 LatencyHistogram(ns) 으로 재고
+//   CLIENT_REPORT_SEC 마다 구간 분포를 CTRL_CLIENT_STATS 제어 프레임으로 서버에 보낸다
+// - 제어 프레임은 CTRL_MAX_FRAME 안에 들어가야 하므로 HDR 버킷을 거친 로그 버킷으로 줄여 보낸다
+//   (250us 부터 두 배 간격 CLIENT_REPORT_BUCKETS 개, 마지막 버킷은 상한 없음 + 단계별 최대값)
+// - 서버는 모든 클라이언트 보고를 단계별 fleet 히스토그램에 합친다 (버킷 상한값으로 기록 : 보수적)
+// ──────────────────────────────
+enum ClientStage
+{
+	CSTAGE_CAPTURE_GATE,								// waveIn 버퍼 완료 ~ 송신 채널 publish (VAD 게이트, pre-roll 보관 포함)
+	CSTAGE_SEND_QUEUE_WAIT,								// 송신 채널 publish ~ 송신 시작
+	CSTAGE_SEND,										// 송신 시작 ~ sendFrame 완료 (소켓 버퍼가 차면 길어진다)
+	CSTAGE_RECV_ENQUEUE,								// recvFrame 완료 ~ 재생 채널 publish
+	CSTAGE_PLAY_QUEUE_WAIT,								// 재생 채널 publish ~ waveOutWrite
+	CSTAGE_DEVICE_PLAY,									// waveOutWrite ~ 재생 완료 (장치 버퍼링 + 프레임 길이)
+	CSTAGE_SEND_TOTAL,									// 캡처 완료 ~ 송신 완료
+	CSTAGE_PLAY_TOTAL,									// 수신 완료 ~ 재생 완료
+	CSTAGE_COUNT
+};
+
+static const char* const kClientStageNames[CSTAGE_COUNT] = {
+	"capture_gate", "send_queue_wait", "send", "recv_enqueue",
+	"play_queue_wait", "device_play", "send_total", "play_total",
+};
+
+#define CLIENT_REPORT_VERSION 1
+#define CLIENT_REPORT_BUCKETS 12
+#define CLIENT_REPORT_SEC 10
+#define CLIENT_REPORT_FIRST_NS 250000ULL				// 첫 버킷 상한 (250us)
+
+// 버킷 i 의 상한 (ns), 마지막 버킷은 상한 없음
+static uint64_t clientReportBucketUpper(int i)
+{
+	return i < CLIENT_REPORT_BUCKETS - 1 ? (CLIENT_REPORT_FIRST_NS << i) : UINT64_MAX;
+}
+
+static int clientReportBucketOf(uint64_t ns)
+{
+	for (int i = 0; i < CLIENT_REPORT_BUCKETS - 1; i++)
+	{
+		if (ns <= clientReportBucketUpper(i))
+			return i;
+	}
+	return CLIENT_REPORT_BUCKETS - 1;
+}
+
+#pragma pack(push, 1)
+struct ClientReportStage
+{
+	uint16_t counts[CLIENT_REPORT_BUCKETS];				// 포화 65535
+	uint32_t maxUs;
+};
+
+struct ClientReportPayload
+{
+	uint8_t version;
+	uint8_t stages;
+	uint8_t buckets;
+	uint8_t reserved;
+	ClientReportStage stage[CSTAGE_COUNT];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CtrlHeader) + sizeof(ClientReportPayload) <= CTRL_MAX_FRAME, "client report exceeds CTRL_MAX_FRAME");
+
+// ──────────────────────────────
+// 구간 스냅샷 -> CTRL_CLIENT_STATS 프레임 (out 은 CTRL_MAX_FRAME 이상), 반환 : 프레임 길이
+// ──────────────────────────────
+static uint32_t buildClientReportFrame(char* out, const HistogramSnapshot (&interval)[CSTAGE_COUNT])
+{
+	ClientReportPayload p;
+	memset(&p, 0, sizeof(p));
+	p.version = CLIENT_REPORT_VERSION;
+	p.stages = CSTAGE_COUNT;
+	p.buckets = CLIENT_REPORT_BUCKETS;
+
+	for (int s = 0; s < CSTAGE_COUNT; s++)
+	{
+		const HistogramSnapshot& h = interval[s];
+		uint32_t counts[CLIENT_REPORT_BUCKETS] = {};
+		for (size_t i = 0; i < HIST_BUCKETS; i++)
+		{
+			if (h.counts[i])
+				counts[clientReportBucketOf(histBucketUpper(i))] += (uint32_t)h.counts[i];
+		}
+
+		for (int b = 0; b < CLIENT_REPORT_BUCKETS; b++)
+			p.stage[s].counts[b] = htons((uint16_t)(std::min)(counts[b], 65535u));
+		p.stage[s].maxUs = htonl((uint32_t)(std::min)(h.Max() / 1000, (uint64_t)UINT32_MAX));
+	}
+
+	return buildCtrlFrame(out, CTRL_CLIENT_STATS, &p, (uint16_t)sizeof(p));
+}
+
+// CTRL_CLIENT_STATS payload -> 호스트 바이트 오더, 버전 / 배치가 다르면 false
+static bool parseClientReport(const char* payload, uint16_t len, ClientReportPayload& out)
+{
+	if (len != sizeof(ClientReportPayload))
+		return false;
+
+	memcpy(&out, payload, sizeof(out));
+	if (out.version != CLIENT_REPORT_VERSION || out.stages != CSTAGE_COUNT || out.buckets != CLIENT_REPORT_BUCKETS)
+		return false;
+
+	for (int s = 0; s < CSTAGE_COUNT; s++)
+	{
+		for (int b = 0; b < CLIENT_REPORT_BUCKETS; b++)
+			out.stage[s].counts[b] = ntohs(out.stage[s].counts[b]);
+		out.stage[s].maxUs = ntohl(out.stage[s].maxUs);
+	}
+	return true;
+}
@@ -10,9 +10,11 @@
 #include <condition_variable>			// 조건 변수 (스레드 동기화)
 #include <queue>								// 오디오 송신 큐
 #include <vector>
-#include <list>
 #include <iostream>
 #include <string>
+#include <cstring>							// memcpy
+#include <chrono>								// 단조 시계 (지연 측정)
+#include <algorithm>							// std::min
 
 // ──────────────────────────────
 // 서버 접속 설정
@@ -38,13 +40,76 @@
 #pragma comment(lib, "winmm.lib")
 
 // ──────────────────────────────
-// 전역 버퍼 관리
+// 단조 시계 (ns)
+// - steady_clock (Windows 에서는 QueryPerformanceCounter) 기반
+// - 단계별 지연 측정 등 같은 프로세스 안에서의 시간 차 계산용
 // ──────────────────────────────
-// 오디오 재생 시 WAVEHDR 구조체가 필요하며
-// waveOutUnprepareHeader 호출 전까지 해제 불가.
-// 따라서 안전한 해제를 위해 리스트로 추적.
-static std::mutex gBufMutex;
-static std::list<WAVEHDR*> gAllocatedBufs;
+static int64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ──────────────────────────────
+// OS 스레드 이름
+// - SetThreadDescription : 디버거, 작업 관리자 계열 도구, WPA(ETW) 스레드 목록에 표시
+// - Windows 10 1607 미만에는 없는 API 라 kernel32 에서 찾아 쓰고, 없으면 아무것도 하지 않는다
+// ──────────────────────────────
+typedef HRESULT(WINAPI* SetThreadDescriptionFn)(HANDLE, PCWSTR);
+
+static void setThreadName(const char* name)
+{
+	static const SetThreadDescriptionFn setDescription =
+		(SetThreadDescriptionFn)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+	if (!setDescription)
+		return;
+
+	wchar_t wideName[64];
+	if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wideName, 64) == 0)
+		return;
+	setDescription(GetCurrentThread(), wideName);
+}
+
+// ──────────────────────────────
+// 소켓 호출 카운터 (빌드 모드)
+// - GAC_SOCKET_COUNTERS=1 이면 아래 송수신 함수가 부르는 send / recv / WSASend 횟수를 스레드별로 센다
+// - 기본값 0 : 카운트 함수는 빈 함수, socketThreadCounts 는 0 (비용 없음)
+// - 커널 호출 횟수를 직접 세는 대신 래퍼 호출 횟수로 프레임당 시스템 호출 수를 잰다
+//   (NetBench 도구는 항상 켠 상태로 빌드)
+// ──────────────────────────────
+#ifndef GAC_SOCKET_COUNTERS
+#define GAC_SOCKET_COUNTERS 0
+#endif
+
+struct SocketCallCounts
+{
+	uint64_t sends = 0;									// send / WSASend 호출 수
+	uint64_t recvs = 0;									// recv 호출 수
+};
+
+#if GAC_SOCKET_COUNTERS
+
+static thread_local uint64_t tSocketSends = 0;
+static thread_local uint64_t tSocketRecvs = 0;
+
+static void countSocketSend() { tSocketSends++; }
+static void countSocketRecv() { tSocketRecvs++; }
+
+static SocketCallCounts socketThreadCounts()
+{
+	SocketCallCounts c;
+	c.sends = tSocketSends;
+	c.recvs = tSocketRecvs;
+	return c;
+}
+
+#else
+
+static void countSocketSend() {}
+static void countSocketRecv() {}
+static SocketCallCounts socketThreadCounts() { return SocketCallCounts(); }
+
+#endif
 
 // ──────────────────────────────
 // 안전한 send()
@@ -57,6 +122,7 @@ static bool sendAll(SOCKET s, const char* data, int len)
 	while (sent < len)
 	{
 		int n = send(s, data + sent, len - sent, 0);
+		countSocketSend();
 
 		// 에러 또는 연결 종료
 		if (n <= 0)
@@ -79,6 +145,7 @@ static bool recvAll(SOCKET s, char* data, int len)
 	while (recvd < len)
 	{
 		int n = recv(s, data + recvd, len - recvd, 0);
+		countSocketRecv();
 
 		// 에러 또는 연결 종료
 		if (n <= 0)
@@ -132,4 +199,337 @@ static bool recvFrame(SOCKET s, std::vector<char>& out)
 
 	out.resize(len);
 	return recvAll(s, out.data(), (int)len);
-}
\ No newline at end of file
+}
+
+// ──────────────────────────────
+// 모아 보내기 (gather) 전송
+// - sendFrame 은 헤더 4바이트와 payload 를 따로 send 해서 프레임당 최소 2번 호출한다
+// - WSASend 에 WSABUF 여러 개를 넘기면 헤더 + payload (+ 다음 프레임들) 를 한 번에 보낸다
+// - 블로킹 소켓이라도 일부만 나갈 수 있으므로 남은 버퍼를 앞으로 당겨 반복 (bufs 는 수정됨)
+// ──────────────────────────────
+#define FRAME_GATHER_MAX 32						// sendFramesGather 한 번의 WSASend 에 묶는 최대 프레임 수
+
+static bool sendBufsAll(SOCKET s, WSABUF* bufs, DWORD count)
+{
+	while (count > 0)
+	{
+		DWORD sent = 0;
+		int rc = WSASend(s, bufs, count, &sent, 0, nullptr, nullptr);
+		countSocketSend();
+
+		// 에러 또는 연결 종료
+		if (rc == SOCKET_ERROR || sent == 0)
+			return false;
+
+		// 다 나간 버퍼는 건너뛰고 걸친 버퍼는 남은 부분만 가리키게 한다
+		while (count > 0 && sent >= bufs->len)
+		{
+			sent -= bufs->len;
+			bufs++;
+			count--;
+		}
+		if (count > 0)
+		{
+			bufs->buf += sent;
+			bufs->len -= sent;
+		}
+	}
+	return true;
+}
+
+// sendFrame 과 같은 바이트열을 WSASend 한 번으로 보낸다
+static bool sendFrameGather(SOCKET s, const char* data, uint32_t len)
+{
+	uint32_t nlen = htonl(len);
+	WSABUF bufs[2];
+	bufs[0].buf = (char*)&nlen;
+	bufs[0].len = sizeof(nlen);
+	bufs[1].buf = (char*)data;
+	bufs[1].len = len;
+	return sendBufsAll(s, bufs, 2);
+}
+
+// 프레임 count 개를 FRAME_GATHER_MAX 개씩 묶어 보낸다 (송신 큐에 여러 프레임이 쌓였을 때)
+static bool sendFramesGather(SOCKET s, const char* const* frames, const uint32_t* lens, size_t count)
+{
+	uint32_t nlens[FRAME_GATHER_MAX];
+	WSABUF bufs[FRAME_GATHER_MAX * 2];
+
+	size_t done = 0;
+	while (done < count)
+	{
+		const size_t batch = (std::min)(count - done, (size_t)FRAME_GATHER_MAX);
+		for (size_t i = 0; i < batch; ++i)
+		{
+			nlens[i] = htonl(lens[done + i]);
+			bufs[i * 2].buf = (char*)&nlens[i];
+			bufs[i * 2].len = sizeof(uint32_t);
+			bufs[i * 2 + 1].buf = (char*)frames[done + i];
+			bufs[i * 2 + 1].len = lens[done + i];
+		}
+		if (!sendBufsAll(s, bufs, (DWORD)(batch * 2)))
+			return false;
+		done += batch;
+	}
+	return true;
+}
+
+// ──────────────────────────────
+// 버퍼링 수신 (FrameReader)
+// - recvFrame 은 헤더와 payload 를 따로 recv 해서 프레임당 최소 2번 호출한다
+// - FrameReader 는 큰 버퍼로 한 번에 받아 그 안에 들어온 프레임을 모두 꺼낸다
+//   (송신 측이 밀려 있으면 recv 한 번에 여러 프레임)
+// - Next 가 돌려준 data 는 다음 Next 호출 전까지만 유효
+// - 방어 규칙은 recvFrame 과 같다 : 0 길이 / 16MB 초과 차단
+// ──────────────────────────────
+#define FRAME_READER_BUFFER (64 * 1024)
+
+class FrameReader
+{
+public:
+	explicit FrameReader(size_t capacity = FRAME_READER_BUFFER)
+		: mBuf(capacity)
+	{
+	}
+
+	bool Next(SOCKET s, const char*& data, uint32_t& len)
+	{
+		// 이전에 돌려준 프레임을 소비 처리
+		mHead += mConsumed;
+		mConsumed = 0;
+
+		for (;;)
+		{
+			const size_t avail = mTail - mHead;
+			if (avail >= sizeof(uint32_t))
+			{
+				uint32_t nlen;
+				memcpy(&nlen, mBuf.data() + mHead, sizeof(nlen));
+				len = ntohl(nlen);
+				if (len == 0 || len > 1u << 24)
+					return false;
+
+				const size_t need = sizeof(uint32_t) + len;
+				if (avail >= need)
+				{
+					data = mBuf.data() + mHead + sizeof(uint32_t);
+					mConsumed = need;
+					return true;
+				}
+
+				// 버퍼보다 큰 프레임 : 프레임 하나가 들어갈 만큼 늘린다
+				if (need > mBuf.size())
+					mBuf.resize(need);
+			}
+
+			// 남은 조각을 앞으로 당긴 뒤 빈 공간만큼 받는다
+			if (mHead > 0)
+			{
+				memmove(mBuf.data(), mBuf.data() + mHead, avail);
+				mHead = 0;
+				mTail = avail;
+			}
+
+			int n = recv(s, mBuf.data() + mTail, (int)(mBuf.size() - mTail), 0);
+			countSocketRecv();
+
+			// 에러 또는 연결 종료
+			if (n <= 0)
+				return false;
+			mTail += (size_t)n;
+		}
+	}
+
+private:
+	std::vector<char> mBuf;
+	size_t mHead = 0;							// 아직 꺼내지 않은 데이터 시작
+	size_t mTail = 0;							// 받은 데이터 끝
+	size_t mConsumed = 0;						// 직전에 돌려준 프레임 (헤더 포함) 길이
+};
+
+// ──────────────────────────────
+// 논블로킹 소켓용 증분 프레임 송수신
+// - 이벤트 루프(WSAEventSelect 등)에서 사용
+// - 한 번에 다 못 보내거나 못 받아도 상태를 보존해 다음 이벤트에서 이어서 처리
+// - 반환값
+//   FRAME_IO_DONE    : 프레임 하나 송/수신 완료
+//   FRAME_IO_PENDING : WSAEWOULDBLOCK, 다음 FD_READ / FD_WRITE 까지 대기
+//   FRAME_IO_ERROR   : 에러, 연결 종료 또는 규약 위반
+// ──────────────────────────────
+enum FrameIoResult
+{
+	FRAME_IO_DONE,
+	FRAME_IO_PENDING,
+	FRAME_IO_ERROR
+};
+
+struct FrameSendState
+{
+	uint32_t nlen = 0;						// 네트워크 바이트 오더 길이 헤더
+	const char* data = nullptr;		// 보낼 payload (완료 전까지 유효해야 함)
+	uint32_t len = 0;						// payload 길이
+	uint32_t sent = 0;						// 헤더 포함 누적 송신 바이트
+	bool busy = false;						// 송신 중인 프레임 존재 여부
+};
+
+struct FrameRecvState
+{
+	uint32_t nlen = 0;						// 수신 중인 길이 헤더
+	uint32_t hdrGot = 0;					// 헤더 누적 수신 바이트
+	uint32_t len = 0;						// payload 길이
+	uint32_t got = 0;						// payload 누적 수신 바이트
+};
+
+// 송신할 프레임 등록 (이전 프레임 완료 후 호출)
+static void beginSendFrame(FrameSendState& st, const char* data, uint32_t len)
+{
+	st.nlen = htonl(len);
+	st.data = data;
+	st.len = len;
+	st.sent = 0;
+	st.busy = true;
+}
+
+static int sendFrameNB(SOCKET s, FrameSendState& st)
+{
+	const uint32_t total = (uint32_t)sizeof(st.nlen) + st.len;
+	while (st.sent < total)
+	{
+		int n;
+		if (st.sent < sizeof(st.nlen))
+			n = send(s, (const char*)&st.nlen + st.sent, (int)(sizeof(st.nlen) - st.sent), 0);
+		else
+			n = send(s, st.data + (st.sent - sizeof(st.nlen)), (int)(total - st.sent), 0);
+		countSocketSend();
+
+		if (n == SOCKET_ERROR)
+			return WSAGetLastError() == WSAEWOULDBLOCK ? FRAME_IO_PENDING : FRAME_IO_ERROR;
+		if (n == 0)
+			return FRAME_IO_ERROR;
+
+		st.sent += (uint32_t)n;
+	}
+
+	st.busy = false;
+	return FRAME_IO_DONE;
+}
+
+// out 은 최소 cap 바이트, 완료 시 st.len 이 프레임 길이
+// 완료 후 다음 프레임을 받기 전에 st = FrameRecvState{} 로 초기화한다
+static int recvFrameNB(SOCKET s, FrameRecvState& st, char* out, uint32_t cap)
+{
+	// 1. 길이 헤더
+	while (st.hdrGot < sizeof(st.nlen))
+	{
+		int n = recv(s, (char*)&st.nlen + st.hdrGot, (int)(sizeof(st.nlen) - st.hdrGot), 0);
+		countSocketRecv();
+		if (n == SOCKET_ERROR)
+			return WSAGetLastError() == WSAEWOULDBLOCK ? FRAME_IO_PENDING : FRAME_IO_ERROR;
+		if (n == 0)
+			return FRAME_IO_ERROR;
+
+		st.hdrGot += (uint32_t)n;
+		if (st.hdrGot == sizeof(st.nlen))
+		{
+			st.len = ntohl(st.nlen);
+
+			// recvFrame 과 동일한 방어 : 0 길이 / 버퍼 초과 차단
+			if (st.len == 0 || st.len > cap)
+				return FRAME_IO_ERROR;
+		}
+	}
+
+	// 2. payload
+	while (st.got < st.len)
+	{
+		int n = recv(s, out + st.got, (int)(st.len - st.got), 0);
+		countSocketRecv();
+		if (n == SOCKET_ERROR)
+			return WSAGetLastError() == WSAEWOULDBLOCK ? FRAME_IO_PENDING : FRAME_IO_ERROR;
+		if (n == 0)
+			return FRAME_IO_ERROR;
+
+		st.got += (uint32_t)n;
+	}
+
+	return FRAME_IO_DONE;
+}
+
+
+// ──────────────────────────────
+// 제어 프레임 규약
+// - 오디오 프레임 : 헤더 없는 PCM, 길이는 항상 AUDIO_BUFFER_SIZE
+// - 제어 프레임   : CtrlHeader 로 시작하며 길이가 AUDIO_BUFFER_SIZE 보다 작다
+// - 길이로 먼저 구분하고 magic 으로 한 번 더 검증한다
+// - 모든 필드는 네트워크 바이트 오더
+// ──────────────────────────────
+#define CTRL_MAGIC 0x47414350u					// 'GACP'
+#define CTRL_MAX_FRAME 256						// 제어 프레임 최대 길이
+
+enum CtrlType : uint16_t
+{
+	CTRL_DTX = 1,										// 무음 구간 알림 (payload : int16 노이즈 레벨 dB)
+	CTRL_CLIENT_STATS = 2,								// 클라이언트 단계별 지연 보고 (payload : ClientReportPayload, client_stats.h)
+	CTRL_TIME_PING = 3,									// 시계 동기화 요청, 클라이언트 -> 서버 (payload : TimePingPayload, time_sync.h)
+	CTRL_TIME_PONG = 4,									// 시계 동기화 응답, 서버 -> 클라이언트 (payload : TimePongPayload)
+	CTRL_ECHO = 5,										// 에코 모드 켜기 / 끄기, 클라이언트 -> 서버 (payload : uint8 enable, echo.h)
+	CTRL_ECHO_TIMING = 6,								// 에코 프레임의 서버 단계 시각, 서버 -> 클라이언트 (payload : EchoTimingPayload)
+};
+
+#pragma pack(push, 1)
+struct CtrlHeader
+{
+	uint32_t magic;
+	uint16_t type;
+	uint16_t len;										// 헤더를 제외한 payload 길이
+};
+#pragma pack(pop)
+
+static bool isAudioFrame(uint32_t len)
+{
+	return len == AUDIO_BUFFER_SIZE;
+}
+
+// out 에 제어 프레임을 만들고 전체 길이를 반환 (out 은 CTRL_MAX_FRAME 이상)
+static uint32_t buildCtrlFrame(char* out, uint16_t type, const void* payload, uint16_t len)
+{
+	if (sizeof(CtrlHeader) + len > CTRL_MAX_FRAME)
+		return 0;
+
+	CtrlHeader hdr;
+	hdr.magic = htonl(CTRL_MAGIC);
+	hdr.type = htons(type);
+	hdr.len = htons(len);
+	memcpy(out, &hdr, sizeof(hdr));
+	if (len > 0)
+		memcpy(out + sizeof(hdr), payload, len);
+
+	return (uint32_t)(sizeof(hdr) + len);
+}
+
+// 제어 프레임이면 type / payload 를 채우고 true
+static bool parseCtrlFrame(const char* data, uint32_t len, uint16_t& type, const char*& payload, uint16_t& payloadLen)
+{
+	if (isAudioFrame(len) || len < sizeof(CtrlHeader))
+		return false;
+
+	CtrlHeader hdr;
+	memcpy(&hdr, data, sizeof(hdr));
+	if (ntohl(hdr.magic) != CTRL_MAGIC)
+		return false;
+
+	payloadLen = ntohs(hdr.len);
+	if (sizeof(CtrlHeader) + payloadLen > len)
+		return false;
+
+	type = ntohs(hdr.type);
+	payload = data + sizeof(CtrlHeader);
+	return true;
+}
+
+// DTX 마커 : 송신을 멈춘다는 알림 + 수신 측 comfort noise 용 노이즈 레벨
+static uint32_t buildDtxFrame(char* out, float noiseDb)
+{
+	uint16_t db = htons((uint16_t)(int16_t)noiseDb);
+	return buildCtrlFrame(out, CTRL_DTX, &db, sizeof(db));
+}
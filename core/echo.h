@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "core.h"
+#include "time_sync.h"
+
+// ──────────────────────────────
+// 에코 모드 (왕복 지연 진단)
+// - 클라이언트가 CTRL_ECHO(enable = 1) 를 보내면 서버는 그 클라이언트를 에코 방으로 옮긴다
+//   . 그 클라이언트의 오디오는 방 믹스에 더하지 않고, 믹서 tick 에서 프레임마다 따로 자기 송신 큐에 넣는다
+//     (수신 -> 믹싱 큐 -> 믹서 tick -> 팬아웃 -> 송신 큐 -> 송신 : 운영 경로 그대로)
+//   . 방 믹스는 받지 않는다
+// - 프레임 마커 레인 0(marker.h)에 seq 가 있으면 서버는 에코 프레임 바로 뒤에 CTRL_ECHO_TIMING 으로
+//   서버 단계 시각(수신 / 믹싱 큐 push / tick 시작 / 송신 큐 push / 송신 시작 / 송신 완료)을 보낸다
+// - 클라이언트는 시계 동기화(time_sync.h) offset 으로 서버 시각을 자기 시계로 옮겨 왕복 시간을 단계별로 나눈다
+//   (uplink / downlink 는 offset 오차만큼 서로 주고받고, 나머지 단계와 합계(rtt)는 offset 과 무관)
+// - 모든 필드는 네트워크 바이트 오더
+// ──────────────────────────────
+enum EchoStage
+{
+	ECHO_STAGE_UPLINK,									// 클라이언트 송신 시작 ~ 서버 수신 완료
+	ECHO_STAGE_INGEST,									// 서버 수신 완료 ~ 믹싱 큐 push
+	ECHO_STAGE_MIX_QUEUE_WAIT,							// 믹싱 큐 push ~ 믹서 tick 시작
+	ECHO_STAGE_MIX_FANOUT,								// 믹서 tick 시작 ~ 송신 큐 push
+	ECHO_STAGE_SEND_QUEUE_WAIT,							// 송신 큐 push ~ 송신 스레드가 꺼낼 때
+	ECHO_STAGE_SERVER_SEND,								// sendFrame 호출
+	ECHO_STAGE_DOWNLINK,								// 서버 송신 완료 ~ 클라이언트 수신 완료
+	ECHO_STAGE_RTT,										// 클라이언트 송신 시작 ~ 에코 수신 완료
+	ECHO_STAGE_COUNT
+};
+
+static const char* const kEchoStageNames[ECHO_STAGE_COUNT] = {
+	"uplink", "ingest", "mix_queue_wait", "mix_fanout",
+	"send_queue_wait", "server_send", "downlink", "rtt",
+};
+
+#pragma pack(push, 1)
+struct EchoTimingPayload
+{
+	uint16_t seq;
+	int64_t recvNs;
+	int64_t queuedNs;
+	int64_t mixNs;
+	int64_t enqueueNs;
+	int64_t dequeueNs;
+	int64_t sentNs;
+};
+#pragma pack(pop)
+
+// 호스트 바이트 오더 사본 (서버 시계)
+struct EchoTiming
+{
+	uint16_t seq = 0;
+	int64_t recvNs = 0;
+	int64_t queuedNs = 0;
+	int64_t mixNs = 0;
+	int64_t enqueueNs = 0;
+	int64_t dequeueNs = 0;
+	int64_t sentNs = 0;
+};
+
+static uint32_t buildEchoRequestFrame(char* out, bool enable)
+{
+	const uint8_t v = enable ? 1 : 0;
+	return buildCtrlFrame(out, CTRL_ECHO, &v, sizeof(v));
+}
+
+static bool parseEchoRequest(const char* payload, uint16_t len, bool& enable)
+{
+	if (len != 1)
+		return false;
+	enable = payload[0] != 0;
+	return true;
+}
+
+static uint32_t buildEchoTimingFrame(char* out, const EchoTiming& t)
+{
+	EchoTimingPayload p;
+	p.seq = htons(t.seq);
+	p.recvNs = (int64_t)hostToNet64((uint64_t)t.recvNs);
+	p.queuedNs = (int64_t)hostToNet64((uint64_t)t.queuedNs);
+	p.mixNs = (int64_t)hostToNet64((uint64_t)t.mixNs);
+	p.enqueueNs = (int64_t)hostToNet64((uint64_t)t.enqueueNs);
+	p.dequeueNs = (int64_t)hostToNet64((uint64_t)t.dequeueNs);
+	p.sentNs = (int64_t)hostToNet64((uint64_t)t.sentNs);
+	return buildCtrlFrame(out, CTRL_ECHO_TIMING, &p, (uint16_t)sizeof(p));
+}
+
+static bool parseEchoTiming(const char* payload, uint16_t len, EchoTiming& out)
+{
+	if (len != sizeof(EchoTimingPayload))
+		return false;
+
+	EchoTimingPayload p;
+	memcpy(&p, payload, sizeof(p));
+	out.seq = ntohs(p.seq);
+	out.recvNs = (int64_t)netToHost64((uint64_t)p.recvNs);
+	out.queuedNs = (int64_t)netToHost64((uint64_t)p.queuedNs);
+	out.mixNs = (int64_t)netToHost64((uint64_t)p.mixNs);
+	out.enqueueNs = (int64_t)netToHost64((uint64_t)p.enqueueNs);
+	out.dequeueNs = (int64_t)netToHost64((uint64_t)p.dequeueNs);
+	out.sentNs = (int64_t)netToHost64((uint64_t)p.sentNs);
+	return true;
+}
+
+// ──────────────────────────────
+// 왕복 한 번을 단계별로 나눈다 (out 은 ns, 클라이언트 시계 기준)
+// - sendNs / recvNs : 클라이언트 송신 시작 / 에코 수신 완료, offsetNs : 서버 시계 - 클라이언트 시계
+// ──────────────────────────────
+static void splitEchoRoundTrip(const EchoTiming& t, int64_t sendNs, int64_t recvNs, int64_t offsetNs,
+	int64_t (&out)[ECHO_STAGE_COUNT])
+{
+	out[ECHO_STAGE_UPLINK] = (t.recvNs - offsetNs) - sendNs;
+	out[ECHO_STAGE_INGEST] = t.queuedNs - t.recvNs;
+	out[ECHO_STAGE_MIX_QUEUE_WAIT] = t.mixNs - t.queuedNs;
+	out[ECHO_STAGE_MIX_FANOUT] = t.enqueueNs - t.mixNs;
+	out[ECHO_STAGE_SEND_QUEUE_WAIT] = t.dequeueNs - t.enqueueNs;
+	out[ECHO_STAGE_SERVER_SEND] = t.sentNs - t.dequeueNs;
+	out[ECHO_STAGE_DOWNLINK] = recvNs - (t.sentNs - offsetNs);
+	out[ECHO_STAGE_RTT] = recvNs - sendNs;
+}
@@ -0,0 +1,236 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// ──────────────────────────────
+// 믹서 CPU 예산 관리 (governor)
+// - tick 비용(벽시계)을 EWMA 로 따라가며 tick 예산(MIX_TICK_MS) 대비 여유를 본다
+// - 부하가 오르면 아래 순서로 한 단계씩 기능을 내려 tick 마감을 지킨다
+//   GOV_LEAN        : 계측 끄기 (프레임별 믹싱 큐 대기, 클라이언트별 팬아웃 시간 / trace 기록)
+//   GOV_SPEAKER_CAP : 한 tick 에 믹싱하는 발화자 수 제한 (직전 tick 발화자 우선)
+//   GOV_CLOSED      : 새 접속 거부
+// - 단계 올림 : EWMA 가 예산의 GOV_STEP_UP_RATIO 를 넘거나 tick 하나가 GOV_EMERGENCY_RATIO 를 넘을 때
+//   (올린 뒤 GOV_SETTLE_TICKS 동안은 효과가 EWMA 에 반영되길 기다린다)
+// - 단계 내림 : EWMA 가 GOV_STEP_DOWN_RATIO 아래로 relax tick 연속 유지될 때
+//   내린 직후 다시 올라가면 relax tick 을 두 배로 늘려 단계가 오르내리며 흔들리지 않게 한다
+// - 믹싱할 것이 없던 시간은 tick 길이(예산) 단위로 환산해 비용 0 인 tick 으로 센다
+//   (믹서는 쉴 때 MIX_IDLE_MS 마다 확인하므로 확인 횟수로 세면 relax / settle / 단계별 tick 이 몇 배로 빨라진다)
+// - 접속 허용 : 닫힌 단계가 아니어도 클라이언트 하나가 늘었을 때의 예상 비용이 GOV_ADMIT_RATIO 를 넘으면 거부
+// - Update / Idle 은 믹서 스레드만 호출, 게이지 / 카운터는 다른 스레드가 락 없이 읽는다
+// - 믹서 스레드는 하나 (방 하나) 라 인스턴스도 하나 : 작업자를 나누면 작업자마다 하나씩 둔다
+// ──────────────────────────────
+#define GOV_EWMA_ALPHA 0.125							// tick 비용 평활 계수
+#define GOV_STEP_UP_RATIO 0.6
+#define GOV_EMERGENCY_RATIO 0.85
+#define GOV_STEP_DOWN_RATIO 0.3
+#define GOV_ADMIT_RATIO 0.7
+#define GOV_SETTLE_TICKS 10								// 단계 변경 후 다음 올림까지 최소 tick
+#define GOV_RELAX_TICKS 100								// 단계 내림에 필요한 연속 저부하 tick (20ms tick 기준 2초, 쉬는 시간 포함)
+#define GOV_RELAX_TICKS_MAX (GOV_RELAX_TICKS * 64)
+#define GOV_SPEAKER_CAP_DEFAULT 8
+#define GOV_SPEAKER_CAP_MAX 64
+
+enum GovernorLevel
+{
+	GOV_NORMAL,
+	GOV_LEAN,
+	GOV_SPEAKER_CAP,
+	GOV_CLOSED,
+	GOV_LEVEL_COUNT
+};
+
+static const char* const kGovernorLevelNames[GOV_LEVEL_COUNT] = { "normal", "lean", "speaker_cap", "closed" };
+
+class TickGovernor
+{
+public:
+	// 파이프라인 구동 전에 한 번 (꺼져 있으면 항상 GOV_NORMAL, 접속 항상 허용)
+	void Configure(bool enabled, int64_t budgetNs, int speakerCap)
+	{
+		mEnabled = enabled;
+		mBudgetNs = (double)budgetNs;
+		mSpeakerCap = (std::max)(1, (std::min)(speakerCap, GOV_SPEAKER_CAP_MAX));
+	}
+
+	bool Enabled() const { return mEnabled; }
+	int SpeakerCap() const { return mSpeakerCap; }
+	int Level() const { return mLevel.load(std::memory_order_relaxed); }
+
+	// tick 하나 끝 (tickNs : tick 전체, fanoutNs : 그중 팬아웃 구간)
+	void Update(int64_t tickNs, int64_t fanoutNs, uint32_t fanoutClients)
+	{
+		if (!mEnabled)
+			return;
+
+		mCostNs += GOV_EWMA_ALPHA * ((double)tickNs - mCostNs);
+		if (fanoutClients > 0)
+			mPerClientNs += GOV_EWMA_ALPHA * ((double)fanoutNs / fanoutClients - mPerClientNs);
+		Evaluate((double)tickNs);
+	}
+
+	// 믹싱 큐가 비어 한 일이 없던 시간 (idleNs : 어떤 tick 도 덮지 않은 경과, 실제 tick 뒤 대기는 빼고 넘긴다)
+	// - tick 길이만큼 쌓일 때마다 비용 0 인 tick 하나로 본다 : 아무도 말하지 않으면 단계가 내려간다
+	// - 못 미친 나머지는 실제 tick 을 건너 이월 : 단계별 tick 합이 경과 시간 / tick 길이와 맞는다
+	// - 오래 멈췄다 돌아와도 relax 최대치 이상은 한꺼번에 돌리지 않는다
+	void Idle(int64_t idleNs)
+	{
+		if (!mEnabled || mBudgetNs <= 0.0)
+			return;
+
+		mIdleNs = (std::min)(mIdleNs + (double)(std::max)(idleNs, (int64_t)0), mBudgetNs * GOV_RELAX_TICKS_MAX);
+		while (mIdleNs >= mBudgetNs)
+		{
+			mIdleNs -= mBudgetNs;
+			mCostNs -= GOV_EWMA_ALPHA * mCostNs;
+			Evaluate(0.0);
+		}
+	}
+
+	// 새 접속 허용 여부 (accept 스레드)
+	bool AdmitJoin() const
+	{
+		if (!mEnabled)
+			return true;
+		if (Level() >= GOV_CLOSED)
+			return false;
+
+		const double projected = (double)mCostGauge.load(std::memory_order_relaxed) +
+			(double)mPerClientGauge.load(std::memory_order_relaxed);
+		return projected <= GOV_ADMIT_RATIO * mBudgetNs;
+	}
+
+	// 메트릭
+	int64_t CostNs() const { return mCostGauge.load(std::memory_order_relaxed); }
+	int64_t PerClientNs() const { return mPerClientGauge.load(std::memory_order_relaxed); }
+	double Headroom() const { return mBudgetNs > 0 ? 1.0 - CostNs() / mBudgetNs : 1.0; }
+	uint64_t StepsUp(int level) const { return mStepsUp[level].load(std::memory_order_relaxed); }
+	uint64_t StepsDown(int level) const { return mStepsDown[level].load(std::memory_order_relaxed); }
+	uint64_t TicksAt(int level) const { return mTicksAt[level].load(std::memory_order_relaxed); }
+
+private:
+	void Evaluate(double tickNs)
+	{
+		mCostGauge.store((int64_t)mCostNs, std::memory_order_relaxed);
+		mPerClientGauge.store((int64_t)mPerClientNs, std::memory_order_relaxed);
+
+		const int level = Level();
+		mTicksAt[level].fetch_add(1, std::memory_order_relaxed);
+		mTicksSinceStepDown++;
+		if (mSettle > 0)
+			mSettle--;
+
+		// 1. 올림 : 평균이 높거나 tick 하나가 마감에 가까우면
+		if (level < GOV_CLOSED && mSettle == 0 &&
+			(mCostNs > GOV_STEP_UP_RATIO * mBudgetNs || tickNs > GOV_EMERGENCY_RATIO * mBudgetNs))
+		{
+			// 내린 지 얼마 안 돼 다시 올리면 다음 내림을 더 늦춘다
+			if (mTicksSinceStepDown < 5 * mRelaxTicks)
+				mRelaxTicks = (std::min)(mRelaxTicks * 2, GOV_RELAX_TICKS_MAX);
+			else
+				mRelaxTicks = GOV_RELAX_TICKS;
+			Step(level + 1);
+			return;
+		}
+
+		// 2. 내림 : 저부하가 relax tick 동안 이어지면
+		if (level > GOV_NORMAL && mCostNs < GOV_STEP_DOWN_RATIO * mBudgetNs)
+		{
+			if (++mCalmTicks >= mRelaxTicks)
+			{
+				Step(level - 1);
+				mTicksSinceStepDown = 0;
+			}
+		}
+		else
+			mCalmTicks = 0;
+	}
+
+	void Step(int to)
+	{
+		const int from = Level();
+		if (to > from)
+			mStepsUp[to].fetch_add(1, std::memory_order_relaxed);
+		else
+			mStepsDown[to].fetch_add(1, std::memory_order_relaxed);
+		mLevel.store(to, std::memory_order_relaxed);
+		mSettle = GOV_SETTLE_TICKS;
+		mCalmTicks = 0;
+	}
+
+	bool mEnabled = false;
+	double mBudgetNs = 0.0;
+	int mSpeakerCap = GOV_SPEAKER_CAP_DEFAULT;
+
+	// 믹서 스레드 전용
+	double mCostNs = 0.0;
+	double mPerClientNs = 0.0;
+	double mIdleNs = 0.0;								// tick 하나에 못 미친 쉬는 시간 (다음 Idle 로 이월)
+	int mSettle = 0;
+	int mCalmTicks = 0;
+	int mRelaxTicks = GOV_RELAX_TICKS;
+	int64_t mTicksSinceStepDown = INT64_MAX / 2;
+
+	// 다른 스레드가 읽는 값
+	std::atomic<int> mLevel{ GOV_NORMAL };
+	std::atomic<int64_t> mCostGauge{ 0 };
+	std::atomic<int64_t> mPerClientGauge{ 0 };
+	std::atomic<uint64_t> mStepsUp[GOV_LEVEL_COUNT] = {};
+	std::atomic<uint64_t> mStepsDown[GOV_LEVEL_COUNT] = {};
+	std::atomic<uint64_t> mTicksAt[GOV_LEVEL_COUNT] = {};
+};
+
+// ──────────────────────────────
+// SpeakerSelector
+// - GOV_SPEAKER_CAP 단계에서 이번 tick 에 믹싱할 발화자 (최대 cap 명) 를 고른다
+// - 직전 tick 에 뽑힌 발화자를 먼저 채우고 남는 자리는 도착 순서대로
+//   (같은 사람이 tick 마다 들어갔다 빠졌다 하며 끊기지 않게)
+// - 고정 배열이라 tick 마다 할당 없음, 믹서 스레드 전용
+// ──────────────────────────────
+class SpeakerSelector
+{
+public:
+	void BeginTick(int cap)
+	{
+		memcpy(mPrev, mCur, sizeof(uint32_t) * mCurCount);
+		mPrevCount = mCurCount;
+		mCurCount = 0;
+		mCap = (std::min)(cap, GOV_SPEAKER_CAP_MAX);
+	}
+
+	// 1차 : 직전 tick 발화자만
+	void KeepIfPrevious(uint32_t id)
+	{
+		if (Find(mPrev, mPrevCount, id))
+			Offer(id);
+	}
+
+	// 2차 : 자리가 남으면 누구든
+	void Offer(uint32_t id)
+	{
+		if (mCurCount < mCap && !Find(mCur, mCurCount, id))
+			mCur[mCurCount++] = id;
+	}
+
+	bool Contains(uint32_t id) const { return Find(mCur, mCurCount, id); }
+
+	// 제한 단계를 벗어나면 직전 목록을 잊는다
+	void Clear() { mCurCount = mPrevCount = 0; }
+
+private:
+	static bool Find(const uint32_t* ids, int count, uint32_t id)
+	{
+		for (int i = 0; i < count; i++)
+			if (ids[i] == id)
+				return true;
+		return false;
+	}
+
+	uint32_t mCur[GOV_SPEAKER_CAP_MAX];
+	uint32_t mPrev[GOV_SPEAKER_CAP_MAX];
+	int mCurCount = 0;
+	int mPrevCount = 0;
+	int mCap = GOV_SPEAKER_CAP_DEFAULT;
+};
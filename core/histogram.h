@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "core.h"
+
+// ──────────────────────────────
+// HDR 스타일 로그-선형 히스토그램
+// - 2의 거듭제곱 구간마다 HIST_SUB_COUNT 개의 선형 하위 버킷 (상대 오차 약 3%)
+// - 값 단위는 호출 측 자유 (서버는 ns)
+// - 2^HIST_MAX_MSB 이상은 마지막 버킷에 기록
+// ──────────────────────────────
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_MSB 40														// 2^40 ns ≈ 18분
+#define HIST_BUCKETS ((HIST_MAX_MSB - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+#define HIST_MAX_INSTANCES 64											// 프로세스 당 LatencyHistogram 최대 개수
+
+static int histMsb64(uint64_t v)
+{
+	int msb = 0;
+	while (v >>= 1)
+		msb++;
+	return msb;
+}
+
+static size_t histBucketOf(uint64_t v)
+{
+	if (v < HIST_SUB_COUNT)
+		return (size_t)v;
+
+	int msb = histMsb64(v);
+	if (msb > HIST_MAX_MSB)
+		return HIST_BUCKETS - 1;
+
+	const uint64_t mantissa = v >> (msb - HIST_SUB_BITS);				// [SUB_COUNT, 2 * SUB_COUNT)
+	return (size_t)(msb - HIST_SUB_BITS + 1) * HIST_SUB_COUNT + (size_t)(mantissa - HIST_SUB_COUNT);
+}
+
+// 버킷에 들어갈 수 있는 가장 큰 값 (보수적 보고용)
+static uint64_t histBucketUpper(size_t idx)
+{
+	if (idx < HIST_SUB_COUNT)
+		return idx;
+
+	const size_t group = idx / HIST_SUB_COUNT;
+	const uint64_t mantissa = idx % HIST_SUB_COUNT + HIST_SUB_COUNT;
+	return ((mantissa + 1) << (group - 1)) - 1;
+}
+
+// ──────────────────────────────
+// ThreadHistogram
+// - 한 스레드만 기록한다 (RMW 없이 relaxed load + store)
+// - 다른 스레드는 언제든 읽을 수 있다 (합칠 때)
+// ──────────────────────────────
+struct ThreadHistogram
+{
+	std::atomic<uint64_t> counts[HIST_BUCKETS];
+
+	ThreadHistogram()
+	{
+		for (auto& c : counts)
+			c.store(0, std::memory_order_relaxed);
+	}
+
+	void Record(uint64_t v, uint64_t n = 1)
+	{
+		std::atomic<uint64_t>& c = counts[histBucketOf(v)];
+		c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+};
+
+// ──────────────────────────────
+// HistogramSnapshot
+// - 여러 스레드 히스토그램을 합친 읽기 전용 사본
+// - 이전 스냅샷을 빼면 구간(interval) 분포가 된다
+// ──────────────────────────────
+struct HistogramSnapshot
+{
+	std::vector<uint64_t> counts = std::vector<uint64_t>(HIST_BUCKETS, 0);
+	uint64_t total = 0;
+
+	void Add(const ThreadHistogram& h)
+	{
+		for (size_t i = 0; i < HIST_BUCKETS; i++)
+		{
+			uint64_t c = h.counts[i].load(std::memory_order_relaxed);
+			counts[i] += c;
+			total += c;
+		}
+	}
+
+	HistogramSnapshot Since(const HistogramSnapshot& prev) const
+	{
+		HistogramSnapshot d;
+		for (size_t i = 0; i < HIST_BUCKETS; i++)
+		{
+			d.counts[i] = counts[i] >= prev.counts[i] ? counts[i] - prev.counts[i] : 0;
+			d.total += d.counts[i];
+		}
+		return d;
+	}
+
+	// q : 0.0 ~ 1.0
+	uint64_t Percentile(double q) const
+	{
+		if (total == 0)
+			return 0;
+
+		uint64_t target = (uint64_t)(q * total);
+		if (target == 0)
+			target = 1;
+
+		uint64_t seen = 0;
+		for (size_t i = 0; i < HIST_BUCKETS; i++)
+		{
+			seen += counts[i];
+			if (seen >= target)
+				return histBucketUpper(i);
+		}
+		return histBucketUpper(HIST_BUCKETS - 1);
+	}
+
+	uint64_t Max() const
+	{
+		for (size_t i = HIST_BUCKETS; i-- > 0;)
+		{
+			if (counts[i])
+				return histBucketUpper(i);
+		}
+		return 0;
+	}
+};
+
+// ──────────────────────────────
+// LatencyHistogram
+// - 이름 붙은 히스토그램, 스레드마다 ThreadHistogram 을 따로 두어 기록 시 락 없음
+// - 스레드별 인스턴스는 처음 기록할 때 한 번만 등록 (이때만 mutex)
+// - 스레드가 끝나면 인스턴스를 free 목록에 돌려놓아 다음 스레드가 재사용
+//   (누적 값은 그대로 유지되므로 합계에는 영향 없음, 클라이언트 churn 에도 메모리 고정)
+// ──────────────────────────────
+class LatencyHistogram
+{
+public:
+	LatencyHistogram(const char* name)
+		: mName(name), mId(NextId())
+	{
+	}
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	// n : 같은 값 n 건 (다른 곳에서 센 분포를 합칠 때)
+	void Record(uint64_t v, uint64_t n = 1)
+	{
+		if (mId < HIST_MAX_INSTANCES)
+			Local().Record(v, n);
+	}
+
+	// 모든 스레드 값을 합친 스냅샷 (읽기 측 전용, 기록 스레드는 막지 않음)
+	HistogramSnapshot Snapshot() const
+	{
+		HistogramSnapshot s;
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto& h : mThreads)
+			s.Add(*h);
+		return s;
+	}
+
+	const char* Name() const { return mName; }
+
+private:
+	// 스레드 종료 시 자신이 쓰던 인스턴스를 반납
+	struct TlsSlots
+	{
+		LatencyHistogram* owner[HIST_MAX_INSTANCES] = {};
+		ThreadHistogram* hist[HIST_MAX_INSTANCES] = {};
+
+		~TlsSlots()
+		{
+			for (int i = 0; i < HIST_MAX_INSTANCES; i++)
+			{
+				if (owner[i])
+					owner[i]->Retire(hist[i]);
+			}
+		}
+	};
+
+	static int NextId()
+	{
+		static std::atomic<int> next{ 0 };
+		return next++;
+	}
+
+	static TlsSlots& Slots()
+	{
+		static thread_local TlsSlots slots;
+		return slots;
+	}
+
+	ThreadHistogram& Local()
+	{
+		TlsSlots& slots = Slots();
+		ThreadHistogram* h = slots.hist[mId];
+		if (h)
+			return *h;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mFree.empty())
+			{
+				h = mFree.back();
+				mFree.pop_back();
+			}
+			else
+			{
+				mThreads.emplace_back(new ThreadHistogram());
+				h = mThreads.back().get();
+			}
+		}
+
+		slots.owner[mId] = this;
+		slots.hist[mId] = h;
+		return *h;
+	}
+
+	void Retire(ThreadHistogram* h)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFree.push_back(h);
+	}
+
+	const char* mName;
+	int mId;
+	mutable std::mutex mMutex;
+	std::vector<std::unique_ptr<ThreadHistogram>> mThreads;
+	std::vector<ThreadHistogram*> mFree;
+};
+
+// ──────────────────────────────
+// 표 출력 (ns 값을 us 로 표시)
+// ──────────────────────────────
+static void printHistogramHeader(std::ostream& os)
+{
+	os << "  stage                     count       p50(us)     p99(us)   p99.9(us)     max(us)" << std::endl;
+}
+
+static void printHistogramRow(std::ostream& os, const char* name, const HistogramSnapshot& s)
+{
+	char line[160];
+	snprintf(line, sizeof(line), "  %-22s %10llu  %10.1f  %10.1f  %10.1f  %10.1f", name,
+		(unsigned long long)s.total,
+		s.Percentile(0.50) / 1000.0, s.Percentile(0.99) / 1000.0,
+		s.Percentile(0.999) / 1000.0, s.Max() / 1000.0);
+	os << line << std::endl;
+}
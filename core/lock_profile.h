@@ -0,0 +1,278 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "core.h"
+#include "histogram.h"
+#include "metrics.h"
+
+// ──────────────────────────────
+// 락 경합 프로파일러
+// - std::mutex 를 그대로 두고, 잡는 곳(호출 지점)마다 LockSite 를 붙여 ProfiledLock 으로 잡는다
+//   -> 같은 락이라도 "믹서 팬아웃" 과 "RemoveClient" 중 누가 기다리게 하는지 따로 보인다
+// - 기록 : 대기 시간(경합일 때만), 보유 시간(매번), 경합 횟수, 대기/보유 합계
+//   히스토그램과 카운터는 모두 스레드별 슬롯이라 기록 시 추가 락 없음
+// - 경합 판정 : try_lock 실패 = 경합, 이때만 대기 시각을 잰다
+// - gLockProfileEnabled 가 false 면 lock / unlock 만 한다 (서버 --lock-profile 로 켠다)
+// - GAC_LOCK_PROFILE=0 이면 컴파일 단계에서 제거
+// ──────────────────────────────
+#ifndef GAC_LOCK_PROFILE
+#define GAC_LOCK_PROFILE 1
+#endif
+
+#define LOCK_MAX_SITES 16
+
+enum LockSiteCounter
+{
+	LOCK_CNT_CONTENDED,
+	LOCK_CNT_WAIT_NS,
+	LOCK_CNT_HOLD_NS,
+	LOCK_CNT_PER_SITE
+};
+
+static_assert(LOCK_MAX_SITES * LOCK_CNT_PER_SITE <= METRIC_MAX_COUNTERS, "lock site counters exceed CounterGroup");
+
+static std::atomic<bool> gLockProfileEnabled{ false };
+static CounterGroup gLockCounters;
+
+// 스레드별 누적 경합 대기 (믹서가 tick 한 번 동안 락에서 잃은 시간을 계산)
+static thread_local int64_t tLockWaitNs = 0;
+
+static int64_t lockThreadWaitNs()
+{
+	return tLockWaitNs;
+}
+
+// ──────────────────────────────
+// LockSite
+// - (락 이름, 호출 지점) 하나, 정적 객체로만 만든다 (생성 시 전역 목록에 등록)
+// - LOCK_MAX_SITES 를 넘으면 기록하지 않는다
+// ──────────────────────────────
+class LockSite
+{
+public:
+	LockSite(const char* lockName, const char* siteName)
+		: mLock(lockName), mSite(siteName), mWait(siteName), mHold(siteName), mIndex(Register(this))
+	{
+	}
+
+	LockSite(const LockSite&) = delete;
+	LockSite& operator=(const LockSite&) = delete;
+
+	bool Active() const { return mIndex >= 0; }
+	const char* LockName() const { return mLock; }
+	const char* SiteName() const { return mSite; }
+
+	void RecordWait(int64_t ns)
+	{
+		mWait.Record((uint64_t)ns);
+		gLockCounters.Add(mIndex * LOCK_CNT_PER_SITE + LOCK_CNT_CONTENDED);
+		gLockCounters.Add(mIndex * LOCK_CNT_PER_SITE + LOCK_CNT_WAIT_NS, (uint64_t)ns);
+		tLockWaitNs += ns;
+	}
+
+	void RecordHold(int64_t ns)
+	{
+		mHold.Record((uint64_t)ns);
+		gLockCounters.Add(mIndex * LOCK_CNT_PER_SITE + LOCK_CNT_HOLD_NS, (uint64_t)ns);
+	}
+
+	HistogramSnapshot WaitSnapshot() const { return mWait.Snapshot(); }
+	HistogramSnapshot HoldSnapshot() const { return mHold.Snapshot(); }
+	int Index() const { return mIndex; }
+
+	static int Count() { return (std::min)(Registry().count, LOCK_MAX_SITES); }
+	static LockSite& At(int i) { return *Registry().sites[i]; }
+
+private:
+	struct SiteRegistry
+	{
+		LockSite* sites[LOCK_MAX_SITES] = {};
+		int count = 0;
+	};
+
+	static SiteRegistry& Registry()
+	{
+		static SiteRegistry registry;
+		return registry;
+	}
+
+	// 정적 초기화 중(단일 스레드)에만 호출된다
+	static int Register(LockSite* site)
+	{
+		SiteRegistry& r = Registry();
+		const int idx = r.count++;
+		if (idx >= LOCK_MAX_SITES)
+			return -1;
+		r.sites[idx] = site;
+		return idx;
+	}
+
+	const char* mLock;
+	const char* mSite;
+	LatencyHistogram mWait;								// 경합한 획득만 (ns)
+	LatencyHistogram mHold;								// 모든 획득 (ns), total = 획득 횟수
+	int mIndex;
+};
+
+// 반환 : 보유 시작 시각 (기록하지 않으면 0)
+static int64_t profiledAcquire(std::mutex& m, LockSite& site)
+{
+#if GAC_LOCK_PROFILE
+	if (gLockProfileEnabled.load(std::memory_order_relaxed) && site.Active())
+	{
+		if (m.try_lock())
+			return nowNs();
+
+		const int64_t waitStart = nowNs();
+		m.lock();
+		const int64_t acquired = nowNs();
+		site.RecordWait(acquired - waitStart);
+		return acquired;
+	}
+#else
+	(void)site;
+#endif
+	m.lock();
+	return 0;
+}
+
+// 보유 시간은 unlock 직전까지, 기록은 unlock 뒤 (보유 구간을 늘리지 않게)
+static void profiledRelease(std::mutex& m, LockSite& site, int64_t holdStartNs)
+{
+	const int64_t releaseNs = holdStartNs ? nowNs() : 0;
+	m.unlock();
+	if (holdStartNs)
+		site.RecordHold(releaseNs - holdStartNs);
+}
+
+// ──────────────────────────────
+// ProfiledLock : std::lock_guard 대신
+// ──────────────────────────────
+class ProfiledLock
+{
+public:
+	ProfiledLock(std::mutex& m, LockSite& site)
+		: mMutex(m), mSite(site), mHoldStartNs(profiledAcquire(m, site))
+	{
+	}
+
+	~ProfiledLock() { profiledRelease(mMutex, mSite, mHoldStartNs); }
+
+	ProfiledLock(const ProfiledLock&) = delete;
+	ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+private:
+	std::mutex& mMutex;
+	LockSite& mSite;
+	int64_t mHoldStartNs;
+};
+
+// ──────────────────────────────
+// ProfiledUniqueLock : 조건 변수 대기가 있는 곳 (std::unique_lock 대신)
+// - Wait 동안은 락을 놓고 있으므로 보유 구간을 끊었다가 깨어난 뒤 다시 시작
+//   (보유 시간은 대기 앞뒤 구간의 합, 깨어날 때의 재획득 대기는 경합으로 세지 않는다)
+// ──────────────────────────────
+class ProfiledUniqueLock
+{
+public:
+	ProfiledUniqueLock(std::mutex& m, LockSite& site)
+		: mSite(site), mHoldStartNs(profiledAcquire(m, site)), mLock(m, std::adopt_lock)
+	{
+	}
+
+	~ProfiledUniqueLock()
+	{
+		std::mutex* m = mLock.release();
+		const int64_t releaseNs = mHoldStartNs ? nowNs() : 0;
+		m->unlock();
+		if (mHoldStartNs)
+			mSite.RecordHold(mHeldNs + (releaseNs - mHoldStartNs));
+	}
+
+	template <typename Pred>
+	void Wait(std::condition_variable& cv, Pred pred)
+	{
+		if (pred())
+			return;
+
+		if (mHoldStartNs)
+			mHeldNs += nowNs() - mHoldStartNs;
+		cv.wait(mLock, pred);
+		if (mHoldStartNs)
+			mHoldStartNs = nowNs();
+	}
+
+	ProfiledUniqueLock(const ProfiledUniqueLock&) = delete;
+	ProfiledUniqueLock& operator=(const ProfiledUniqueLock&) = delete;
+
+private:
+	LockSite& mSite;
+	int64_t mHoldStartNs;
+	int64_t mHeldNs = 0;								// Wait 앞 보유 구간 합
+	std::unique_lock<std::mutex> mLock;					// 획득 뒤에 adopt (선언 순서 유지)
+};
+
+// ──────────────────────────────
+// 보고
+// - 대기 합계가 큰 순서 : 위쪽 호출 지점이 tick / 송수신 지연을 가장 많이 먹는다
+// ──────────────────────────────
+struct LockSiteReport
+{
+	const LockSite* site;
+	uint64_t acquisitions;
+	uint64_t contended;
+	uint64_t waitNs;
+	uint64_t holdNs;
+	HistogramSnapshot wait;
+	HistogramSnapshot hold;
+};
+
+static std::vector<LockSiteReport> collectLockProfile()
+{
+	std::vector<uint64_t> c;
+	gLockCounters.Sum(c, LOCK_MAX_SITES * LOCK_CNT_PER_SITE);
+
+	std::vector<LockSiteReport> out;
+	for (int i = 0; i < LockSite::Count(); i++)
+	{
+		const LockSite& site = LockSite::At(i);
+		const size_t base = (size_t)site.Index() * LOCK_CNT_PER_SITE;
+
+		LockSiteReport r;
+		r.site = &site;
+		r.wait = site.WaitSnapshot();
+		r.hold = site.HoldSnapshot();
+		r.acquisitions = r.hold.total;
+		r.contended = c[base + LOCK_CNT_CONTENDED];
+		r.waitNs = c[base + LOCK_CNT_WAIT_NS];
+		r.holdNs = c[base + LOCK_CNT_HOLD_NS];
+		out.push_back(std::move(r));
+	}
+
+	std::sort(out.begin(), out.end(), [](const LockSiteReport& a, const LockSiteReport& b) {
+		return a.waitNs > b.waitNs;
+	});
+	return out;
+}
+
+static void printLockProfile(std::ostream& os)
+{
+	os << "  lock           site               acquired  contended   wait(ms)  wait p99(us)  hold p99(us)  hold max(us)" << std::endl;
+	for (const LockSiteReport& r : collectLockProfile())
+	{
+		char line[200];
+		snprintf(line, sizeof(line), "  %-14s %-16s %10llu %10llu %10.2f %13.1f %13.1f %13.1f",
+			r.site->LockName(), r.site->SiteName(),
+			(unsigned long long)r.acquisitions, (unsigned long long)r.contended, r.waitNs / 1e6,
+			r.wait.Percentile(0.99) / 1000.0, r.hold.Percentile(0.99) / 1000.0, r.hold.Max() / 1000.0);
+		os << line << std::endl;
+	}
+}
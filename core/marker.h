@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// ──────────────────────────────
+// 오디오 내장 마커 (지연 측정용)
+// - 프레임 앞쪽 MARKER_LANES * 2 개 샘플을 "마커 레인" 으로 예약한다
+// - 측정용 송신자(probe)는 자기 레인에 [seq, seq ^ MARKER_CHECK] 를 쓰고
+//   나머지 송신자는 레인 영역을 모두 0 으로 둔다
+// - 서버 믹서는 단순 덧셈이므로 레인 값은 믹싱 후에도 그대로 남는다
+// - 같은 레인에 두 프레임이 겹쳐 더해지면 체크 값이 깨져 무시된다
+// - seq 는 1 ~ 32767 (0 은 마커 없음)
+// ──────────────────────────────
+#define MARKER_LANES 8
+#define MARKER_SAMPLES (MARKER_LANES * 2)
+#define MARKER_CHECK 0x2A5A
+#define MARKER_SEQ_MAX 32767
+
+// 레인 영역을 0 으로 비운다 (probe 가 아닌 송신자)
+static void ClearMarkerLanes(int16_t* pcm)
+{
+	for (int i = 0; i < MARKER_SAMPLES; i++)
+		pcm[i] = 0;
+}
+
+static void WriteMarker(int16_t* pcm, int lane, uint16_t seq)
+{
+	pcm[lane * 2] = (int16_t)seq;
+	pcm[lane * 2 + 1] = (int16_t)(seq ^ MARKER_CHECK);
+}
+
+// 유효한 마커가 있으면 seq 를 채우고 true
+static bool ReadMarker(const int16_t* pcm, int lane, uint16_t& seq)
+{
+	const int16_t v = pcm[lane * 2];
+	const int16_t check = pcm[lane * 2 + 1];
+	if (v <= 0)
+		return false;
+
+	if ((int16_t)(v ^ MARKER_CHECK) != check)
+		return false;
+
+	seq = (uint16_t)v;
+	return true;
+}
+
+// 1 ~ MARKER_SEQ_MAX 를 순환하는 다음 seq
+static uint16_t NextMarkerSeq(uint16_t seq)
+{
+	return seq >= MARKER_SEQ_MAX ? 1 : (uint16_t)(seq + 1);
+}
@@ -0,0 +1,154 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+
+// ──────────────────────────────
+// MediaClock
+// - 미디어 파이프라인(믹서 tick, 큐 대기 시각 등)이 쓰는 시계
+// - SystemClock  : 실제 시간 (nowNs / sleep_for), 서버 기본값
+// - VirtualClock : 가상 시간, 참여 스레드가 모두 잠들면 다음 깨어날 시각으로 즉시 건너뛴다
+//   (1시간 세션을 CPU 가 허락하는 만큼 빠르게 재생)
+// - 작업 비용(tick 소요 시간 등) 측정은 시계와 무관하게 항상 nowNs 를 쓴다
+// ──────────────────────────────
+class MediaClock
+{
+public:
+	virtual ~MediaClock() {}
+
+	virtual int64_t NowNs() = 0;
+	virtual void SleepUntil(int64_t deadlineNs) = 0;
+
+	// 참여 스레드 등록 / 해제 (VirtualClock 만 의미 있음)
+	virtual void Join() {}
+	virtual void Leave() {}
+
+	void SleepFor(int64_t ns) { SleepUntil(NowNs() + ns); }
+	void SleepForMs(int ms) { SleepFor(ms * 1000000LL); }
+};
+
+class SystemClock : public MediaClock
+{
+public:
+	int64_t NowNs() override { return nowNs(); }
+
+	void SleepUntil(int64_t deadlineNs) override
+	{
+		const int64_t wait = deadlineNs - nowNs();
+		if (wait > 0)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+	}
+};
+
+// ──────────────────────────────
+// VirtualClock
+// - Join 한 스레드(참여자)만 SleepUntil 을 호출해야 한다
+// - 참여자가 모두 SleepUntil 안에 있으면 가장 이른 (시각, 요청 순서) 하나만 깨운다
+//   -> 한 번에 참여자 하나만 실행되므로 재생 결과가 매번 같다
+// - 참여자가 시계 밖에서 막히면(소켓, 조건 변수 등) 시간이 멈춘다 : 그런 스레드는 참여시키지 않는다
+// - SleepUntil(과거 시각) 도 차례를 양보한다 (같은 시각의 다른 참여자 먼저)
+// ──────────────────────────────
+class VirtualClock : public MediaClock
+{
+public:
+	explicit VirtualClock(int64_t startNs = 0)
+		: mNow(startNs)
+	{
+	}
+
+	int64_t NowNs() override
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mNow;
+	}
+
+	void Join() override
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mParticipants++;
+	}
+
+	void Leave() override
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mParticipants--;
+		AdvanceLocked();
+	}
+
+	void SleepUntil(int64_t deadlineNs) override
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		const uint64_t seq = ++mSeq;
+		mWaiters.push(Waiter{ deadlineNs, seq });
+		AdvanceLocked();
+		mCV.wait(lock, [&] { return mWoken == seq; });
+	}
+
+	// 지금까지 건너뛴 횟수 (진단용)
+	uint64_t Steps()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mSteps;
+	}
+
+private:
+	struct Waiter
+	{
+		int64_t t;
+		uint64_t seq;
+
+		bool operator>(const Waiter& o) const
+		{
+			return t != o.t ? t > o.t : seq > o.seq;
+		}
+	};
+
+	// 모든 참여자가 대기 중이면 가장 이른 대기자 하나를 깨운다
+	void AdvanceLocked()
+	{
+		if (mWaiters.empty() || (int)mWaiters.size() < mParticipants)
+			return;
+
+		const Waiter next = mWaiters.top();
+		mWaiters.pop();
+		if (next.t > mNow)
+			mNow = next.t;
+		mWoken = next.seq;
+		mSteps++;
+		mCV.notify_all();
+	}
+
+	std::mutex mMutex;
+	std::condition_variable mCV;
+	std::priority_queue<Waiter, std::vector<Waiter>, std::greater<Waiter>> mWaiters;
+	int64_t mNow;
+	int mParticipants = 0;
+	uint64_t mSeq = 0;
+	uint64_t mWoken = 0;
+	uint64_t mSteps = 0;
+};
+
+// ──────────────────────────────
+// ClockParticipant
+// - 참여 스레드가 끝날 때 Leave (예외/조기 반환에도 빠지지 않게)
+// - Join 은 스레드 생성 전에 생성 측에서 해 두어야 시작 직후 시간이 앞서 나가지 않는다
+// ──────────────────────────────
+class ClockParticipant
+{
+public:
+	explicit ClockParticipant(MediaClock& clock) : mClock(clock) {}
+	~ClockParticipant() { mClock.Leave(); }
+
+	ClockParticipant(const ClockParticipant&) = delete;
+	ClockParticipant& operator=(const ClockParticipant&) = delete;
+
+private:
+	MediaClock& mClock;
+};
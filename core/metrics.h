@@ -0,0 +1,273 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "spsc_ring.h"
+
+// ──────────────────────────────
+// CounterGroup
+// - 스레드마다 카운터 배열(shard)을 따로 두어 증가 시 락/RMW 없음
+// - shard 는 처음 증가할 때 한 번만 등록 (이때만 mutex)
+// - 읽기(스크랩)는 모든 shard 를 relaxed 로 합산
+// - 스레드가 끝나면 shard 를 free 목록에 반납 (값은 그대로라 합계 유지)
+// ──────────────────────────────
+#define METRIC_MAX_COUNTERS 48
+#define METRIC_MAX_GROUPS 8
+
+// 앞뒤 패딩으로 다른 스레드 shard 와 캐시 라인을 공유하지 않게 한다
+// (C++14 new 는 64바이트 정렬을 보장하지 않으므로 alignas 대신 패딩)
+struct CounterShard
+{
+	char padFront[CACHE_LINE_SIZE];
+	std::atomic<uint64_t> v[METRIC_MAX_COUNTERS];
+	char padBack[CACHE_LINE_SIZE];
+
+	CounterShard()
+	{
+		for (auto& c : v)
+			c.store(0, std::memory_order_relaxed);
+	}
+};
+
+class CounterGroup
+{
+public:
+	CounterGroup()
+		: mId(NextId())
+	{
+	}
+
+	CounterGroup(const CounterGroup&) = delete;
+	CounterGroup& operator=(const CounterGroup&) = delete;
+
+	void Add(size_t idx, uint64_t n = 1)
+	{
+		if (mId >= METRIC_MAX_GROUPS || idx >= METRIC_MAX_COUNTERS)
+			return;
+
+		std::atomic<uint64_t>& c = Local().v[idx];
+		c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// 모든 스레드 합계 (out 은 count 개로 채워진다)
+	void Sum(std::vector<uint64_t>& out, size_t count) const
+	{
+		out.assign(count, 0);
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto& s : mShards)
+		{
+			for (size_t i = 0; i < count && i < METRIC_MAX_COUNTERS; i++)
+				out[i] += s->v[i].load(std::memory_order_relaxed);
+		}
+	}
+
+private:
+	struct TlsSlots
+	{
+		CounterGroup* owner[METRIC_MAX_GROUPS] = {};
+		CounterShard* shard[METRIC_MAX_GROUPS] = {};
+
+		~TlsSlots()
+		{
+			for (int i = 0; i < METRIC_MAX_GROUPS; i++)
+			{
+				if (owner[i])
+					owner[i]->Retire(shard[i]);
+			}
+		}
+	};
+
+	static int NextId()
+	{
+		static std::atomic<int> next{ 0 };
+		return next++;
+	}
+
+	static TlsSlots& Slots()
+	{
+		static thread_local TlsSlots slots;
+		return slots;
+	}
+
+	CounterShard& Local()
+	{
+		TlsSlots& slots = Slots();
+		CounterShard* s = slots.shard[mId];
+		if (s)
+			return *s;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mFree.empty())
+			{
+				s = mFree.back();
+				mFree.pop_back();
+			}
+			else
+			{
+				mShards.emplace_back(new CounterShard());
+				s = mShards.back().get();
+			}
+		}
+
+		slots.owner[mId] = this;
+		slots.shard[mId] = s;
+		return *s;
+	}
+
+	void Retire(CounterShard* s)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFree.push_back(s);
+	}
+
+	int mId;
+	mutable std::mutex mMutex;
+	std::vector<std::unique_ptr<CounterShard>> mShards;
+	std::vector<CounterShard*> mFree;
+};
+
+// 단일 기록자 카운터 (객체 하나를 한 스레드만 증가시킬 때, 예: 클라이언트별 수신 스레드)
+static void bumpCounter(std::atomic<uint64_t>& c, uint64_t n = 1)
+{
+	c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// ──────────────────────────────
+// Prometheus 텍스트 형식 (exposition format 0.0.4) 작성 보조
+// ──────────────────────────────
+class PromWriter
+{
+public:
+	void Family(const char* name, const char* type, const char* help)
+	{
+		mOs << "# HELP " << name << " " << help << "\n";
+		mOs << "# TYPE " << name << " " << type << "\n";
+	}
+
+	// labels 예 : "client=\"3\"" (비어 있으면 라벨 없음)
+	void Sample(const char* name, const std::string& labels, double value)
+	{
+		char num[32];
+		snprintf(num, sizeof(num), "%.17g", value);
+		mOs << name;
+		if (!labels.empty())
+			mOs << "{" << labels << "}";
+		mOs << " " << num << "\n";
+	}
+
+	void Sample(const char* name, double value)
+	{
+		Sample(name, std::string(), value);
+	}
+
+	std::string Str() const { return mOs.str(); }
+
+private:
+	std::ostringstream mOs;
+};
+
+// ──────────────────────────────
+// 메트릭 HTTP 엔드포인트
+// - GET /metrics 에 render() 결과를 응답, 그 외 경로는 404
+// - 요청마다 연결을 닫는 단순 구현 (스크레이퍼 1~2개 기준)
+// - WSAPoll 로 대기하므로 running 이 false 가 되면 METRIC_POLL_MS 안에 반환
+// - onIdle 은 요청이 없어도 주기적으로 호출된다 (초당 rate 샘플링 등)
+// ──────────────────────────────
+#define METRICS_PORT 9464
+#define METRIC_POLL_MS 200
+#define METRIC_REQUEST_MAX 4096
+
+static SOCKET openMetricsListener(uint16_t port)
+{
+	SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	int yes = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+	// 외부 노출 방지 : 로컬 루프백에만 바인드
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(s, 8) == SOCKET_ERROR)
+	{
+		closesocket(s);
+		return INVALID_SOCKET;
+	}
+	return s;
+}
+
+static void handleMetricsRequest(SOCKET c, const std::function<std::string()>& render)
+{
+	// 느린 스크레이퍼가 루프를 붙잡지 않도록 수신 타임아웃
+	DWORD timeoutMs = 1000;
+	setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeoutMs, sizeof(timeoutMs));
+
+	std::string req;
+	char buf[1024];
+	while (req.size() < METRIC_REQUEST_MAX && req.find("\r\n\r\n") == std::string::npos)
+	{
+		int r = recv(c, buf, sizeof(buf), 0);
+		if (r <= 0)
+			break;
+		req.append(buf, r);
+	}
+
+	std::string status = "200 OK";
+	std::string body;
+	if (req.compare(0, 13, "GET /metrics ") == 0 || req.compare(0, 13, "GET /metrics?") == 0)
+		body = render();
+	else
+	{
+		status = "404 Not Found";
+		body = "not found\n";
+	}
+
+	std::ostringstream resp;
+	resp << "HTTP/1.1 " << status << "\r\n"
+		<< "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body;
+
+	const std::string out = resp.str();
+	sendAll(c, out.data(), (int)out.size());
+	shutdown(c, SD_SEND);
+}
+
+static void serveMetrics(SOCKET listenSock, const std::atomic<bool>& running,
+	const std::function<std::string()>& render, const std::function<void()>& onIdle)
+{
+	while (running)
+	{
+		WSAPOLLFD pfd{};
+		pfd.fd = listenSock;
+		pfd.events = POLLRDNORM;
+
+		int n = WSAPoll(&pfd, 1, METRIC_POLL_MS);
+		if (onIdle)
+			onIdle();
+		if (n <= 0 || !(pfd.revents & POLLRDNORM))
+			continue;
+
+		SOCKET c = accept(listenSock, nullptr, nullptr);
+		if (c == INVALID_SOCKET)
+			continue;
+
+		handleMetricsRequest(c, render);
+		closesocket(c);
+	}
+}
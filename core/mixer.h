@@ -0,0 +1,302 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "core.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define MIX_HAS_X86_SIMD 1
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// ──────────────────────────────
+// 믹싱 커널
+// - 서버 MixerThread 의 믹싱 경로를 분리해 벤치마크 / 재생 도구에서도 그대로 사용
+// - 16bit PCM, 프레임당 MIX_FRAME_SAMPLES 샘플 (48kHz stereo 20ms)
+// - 버스 형식 2가지
+//   1. int16 버스 : 더할 때마다 포화 (기존 서버 동작과 동일)
+//   2. float 버스 : 누적 후 마지막에 한 번만 포화 → mix-minus (전체 - 본인) 가 정확
+// - 구현 3가지 : scalar / SSE2 / AVX2 (실행 시 CPU 기능 확인 후 선택)
+// ──────────────────────────────
+#define MIX_FRAME_SAMPLES (AUDIO_BUFFER_SIZE / sizeof(int16_t))
+
+typedef void (*MixAdd16Fn)(int16_t* dst, const int16_t* src, size_t n);							// dst = sat(dst + src)
+typedef void (*MixSub16Fn)(int16_t* out, const int16_t* bus, const int16_t* own, size_t n);	// out = sat(bus - own)
+typedef void (*MixAccumFn)(float* bus, const int16_t* src, size_t n);								// bus += src
+typedef void (*MixBusToPcmFn)(int16_t* out, const float* bus, const int16_t* own, size_t n);	// out = sat(bus - own), own 은 nullptr 가능
+typedef bool (*MixIsSilentFn)(const int16_t* src, size_t n);											// 디지털 무음 (전부 0) 여부
+
+struct MixKernelOps
+{
+	const char* name;
+	MixAdd16Fn add16;
+	MixSub16Fn sub16;
+	MixAccumFn accum;
+	MixBusToPcmFn busToPcm;
+	MixIsSilentFn isSilent;
+};
+
+enum MixKernelKind
+{
+	MIX_KERNEL_SCALAR,
+	MIX_KERNEL_SSE2,
+	MIX_KERNEL_AVX2,
+	MIX_KERNEL_COUNT
+};
+
+// ──────────────────────────────
+// scalar
+// ──────────────────────────────
+static inline int16_t MixClamp16(int s)
+{
+	if (s > 32767)
+		return 32767;
+	if (s < -32768)
+		return -32768;
+	return (int16_t)s;
+}
+
+static void MixAdd16_Scalar(int16_t* dst, const int16_t* src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = MixClamp16(dst[i] + src[i]);
+}
+
+static void MixSub16_Scalar(int16_t* out, const int16_t* bus, const int16_t* own, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = MixClamp16(bus[i] - own[i]);
+}
+
+static void MixAccum_Scalar(float* bus, const int16_t* src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		bus[i] += (float)src[i];
+}
+
+static void MixBusToPcm_Scalar(int16_t* out, const float* bus, const int16_t* own, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		float v = own ? bus[i] - (float)own[i] : bus[i];
+		if (v > 32767.0f)
+			v = 32767.0f;
+		if (v < -32768.0f)
+			v = -32768.0f;
+		out[i] = (int16_t)(v < 0.0f ? v - 0.5f : v + 0.5f);
+	}
+}
+
+static bool MixIsSilent_Scalar(const int16_t* src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		if (src[i] != 0)
+			return false;
+	}
+	return true;
+}
+
+#ifdef MIX_HAS_X86_SIMD
+// ──────────────────────────────
+// SSE2 (8 샘플 단위, 나머지는 scalar)
+// ──────────────────────────────
+static void MixAdd16_SSE2(int16_t* dst, const int16_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epi16(a, b));
+	}
+	MixAdd16_Scalar(dst + i, src + i, n - i);
+}
+
+static void MixSub16_SSE2(int16_t* out, const int16_t* bus, const int16_t* own, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(bus + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(own + i));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_subs_epi16(a, b));
+	}
+	MixSub16_Scalar(out + i, bus + i, own + i, n - i);
+}
+
+static void MixAccum_SSE2(float* bus, const int16_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+		_mm_storeu_ps(bus + i, _mm_add_ps(_mm_loadu_ps(bus + i), _mm_cvtepi32_ps(lo)));
+		_mm_storeu_ps(bus + i + 4, _mm_add_ps(_mm_loadu_ps(bus + i + 4), _mm_cvtepi32_ps(hi)));
+	}
+	MixAccum_Scalar(bus + i, src + i, n - i);
+}
+
+static void MixBusToPcm_SSE2(int16_t* out, const float* bus, const int16_t* own, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128 lo = _mm_loadu_ps(bus + i);
+		__m128 hi = _mm_loadu_ps(bus + i + 4);
+		if (own)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*)(own + i));
+			lo = _mm_sub_ps(lo, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)));
+			hi = _mm_sub_ps(hi, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)));
+		}
+		// packs 가 int16 범위로 포화시켜 준다
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+	MixBusToPcm_Scalar(out + i, bus + i, own ? own + i : nullptr, n - i);
+}
+
+static bool MixIsSilent_SSE2(const int16_t* src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*)(src + i)));
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF)
+		return false;
+	return MixIsSilent_Scalar(src + i, n - i);
+}
+
+// ──────────────────────────────
+// AVX2 (16 샘플 단위, 나머지는 SSE2)
+// ──────────────────────────────
+static void MixAdd16_AVX2(int16_t* dst, const int16_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_adds_epi16(a, b));
+	}
+	MixAdd16_SSE2(dst + i, src + i, n - i);
+}
+
+static void MixSub16_AVX2(int16_t* out, const int16_t* bus, const int16_t* own, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(bus + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(own + i));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_subs_epi16(a, b));
+	}
+	MixSub16_SSE2(out + i, bus + i, own + i, n - i);
+}
+
+static void MixAccum_AVX2(float* bus, const int16_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s)));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1)));
+		_mm256_storeu_ps(bus + i, _mm256_add_ps(_mm256_loadu_ps(bus + i), lo));
+		_mm256_storeu_ps(bus + i + 8, _mm256_add_ps(_mm256_loadu_ps(bus + i + 8), hi));
+	}
+	MixAccum_SSE2(bus + i, src + i, n - i);
+}
+
+static void MixBusToPcm_AVX2(int16_t* out, const float* bus, const int16_t* own, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 lo = _mm256_loadu_ps(bus + i);
+		__m256 hi = _mm256_loadu_ps(bus + i + 8);
+		if (own)
+		{
+			__m256i s = _mm256_loadu_si256((const __m256i*)(own + i));
+			lo = _mm256_sub_ps(lo, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s))));
+			hi = _mm256_sub_ps(hi, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1))));
+		}
+		// packs 는 128bit 레인 단위로 섞이므로 64bit 단위로 다시 정렬
+		__m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+	MixBusToPcm_SSE2(out + i, bus + i, own ? own + i : nullptr, n - i);
+}
+
+static bool MixIsSilent_AVX2(const int16_t* src, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i*)(src + i)));
+
+	if (!_mm256_testz_si256(acc, acc))
+		return false;
+	return MixIsSilent_SSE2(src + i, n - i);
+}
+#endif
+
+// ──────────────────────────────
+// 커널 선택
+// ──────────────────────────────
+static bool MixKernelSupported(MixKernelKind kind)
+{
+	switch (kind)
+	{
+	case MIX_KERNEL_SCALAR:
+		return true;
+#ifdef MIX_HAS_X86_SIMD
+	case MIX_KERNEL_SSE2:
+		return true;		// x86 / x64 빌드 기본 요구 사항
+	case MIX_KERNEL_AVX2:
+	{
+		int r[4];
+		__cpuid(r, 1);
+		const bool osxsave = (r[2] & (1 << 27)) != 0;
+		const bool avx = (r[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(r, 7, 0);
+		return (r[1] & (1 << 5)) != 0;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+static const MixKernelOps& GetMixKernel(MixKernelKind kind)
+{
+	static const MixKernelOps kernels[MIX_KERNEL_COUNT] = {
+		{ "scalar", MixAdd16_Scalar, MixSub16_Scalar, MixAccum_Scalar, MixBusToPcm_Scalar, MixIsSilent_Scalar },
+#ifdef MIX_HAS_X86_SIMD
+		{ "sse2", MixAdd16_SSE2, MixSub16_SSE2, MixAccum_SSE2, MixBusToPcm_SSE2, MixIsSilent_SSE2 },
+		{ "avx2", MixAdd16_AVX2, MixSub16_AVX2, MixAccum_AVX2, MixBusToPcm_AVX2, MixIsSilent_AVX2 },
+#else
+		{ "sse2", MixAdd16_Scalar, MixSub16_Scalar, MixAccum_Scalar, MixBusToPcm_Scalar, MixIsSilent_Scalar },
+		{ "avx2", MixAdd16_Scalar, MixSub16_Scalar, MixAccum_Scalar, MixBusToPcm_Scalar, MixIsSilent_Scalar },
+#endif
+	};
+	return kernels[kind];
+}
+
+// 지원되는 것 중 가장 넓은 커널
+static MixKernelKind BestMixKernel()
+{
+	for (int k = MIX_KERNEL_COUNT - 1; k > MIX_KERNEL_SCALAR; k--)
+	{
+		if (MixKernelSupported((MixKernelKind)k))
+			return (MixKernelKind)k;
+	}
+	return MIX_KERNEL_SCALAR;
+}
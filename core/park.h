@@ -0,0 +1,231 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pipeline.h"
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+// ──────────────────────────────
+// 대기 청취자 (parked listener)
+// - 접속 직후 클라이언트는 전용 수신 스레드 없이 여기 놓인다 (송신 스레드 / 송신 큐는 그대로 : 청취자도 믹스를 받는다)
+// - 스레드 하나가 WSAPoll 로 대기 소켓 전부를 지켜보며 제어 프레임 (ping, 보고, 에코, DTX) 만 직접 처리한다
+//   접속당 비용은 프레임 수신 상태 + CTRL_MAX_FRAME 버퍼 + WSAPOLLFD 하나
+//   (수신 스레드의 스택 / 커널 스택 / TEB, 수신 벡터가 없다)
+// - 오디오 길이 헤더가 오면 (발화 시작) wake 콜백으로 넘긴다 : 서버는 그때 수신 스레드를 만들어 payload 부터 읽힌다
+// - 소켓은 송신 스레드가 블로킹으로 쓰고 있어 논블로킹으로 바꿀 수 없다 (ioctlsocket 은 송신에도 적용)
+//   -> 읽기 가능 신호마다 recv 를 한 번만 호출 (받을 데이터가 있으니 블로킹되지 않는다)
+// - 대기 목록은 Run 스레드 전용, Park 는 다른 스레드에서 mutex 로 넘긴다 (다음 poll 주기에 반영)
+// ──────────────────────────────
+#define PARK_POLL_MS 50									// 새 대기 접속 반영 / 종료 확인 주기
+
+typedef void (*ParkWakeFn)(const std::shared_ptr<ClientInfo>& cli, uint32_t pendingLen);
+typedef void (*ParkDropFn)(const std::shared_ptr<ClientInfo>& cli);	// 대기 스레드에서 호출 : 막히는 정리는 다른 스레드로 넘긴다
+
+class ListenerPark
+{
+public:
+	// 대기 상태로 넘긴다 (accept 스레드 또는 발화를 마친 수신 스레드, 넘긴 뒤에는 소켓을 읽지 않는다)
+	void Park(const std::shared_ptr<ClientInfo>& cli, bool returning)
+	{
+		if (returning)
+			gCounters.Add(CNT_PARK_RETURNS);
+		std::lock_guard<std::mutex> lock(mIncomingMutex);
+		mIncoming.push_back(cli);
+		mParked.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	size_t Parked() const { return mParked.load(std::memory_order_relaxed); }
+
+	// 대기 스레드 본체 : running 이 false 가 되면 남은 접속을 drop 으로 정리하고 반환
+	void Run(const std::atomic<bool>& running, ParkWakeFn wake, ParkDropFn drop)
+	{
+		while (running)
+		{
+			Adopt();
+			if (mSlots.empty())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(PARK_POLL_MS));
+				continue;
+			}
+
+			const int n = WSAPoll(mFds.data(), (ULONG)mFds.size(), PARK_POLL_MS);
+			if (n == SOCKET_ERROR)
+			{
+				std::cerr << "[park] WSAPoll 실패: " << WSAGetLastError() << std::endl;
+				std::this_thread::sleep_for(std::chrono::milliseconds(PARK_POLL_MS));
+				continue;
+			}
+
+			for (size_t i = 0; i < mSlots.size();)
+			{
+				Slot& slot = mSlots[i];
+				const short revents = mFds[i].revents;
+				mFds[i].revents = 0;
+
+				// 송신 실패로 이미 비활성이 된 접속
+				if (!slot.cli->active)
+				{
+					Erase(i, drop);
+					continue;
+				}
+				if (!(revents & (POLLRDNORM | POLLERR | POLLHUP)))
+				{
+					i++;
+					continue;
+				}
+
+				switch (Step(slot))
+				{
+				case STEP_ERROR:
+					Erase(i, drop);
+					break;
+				case STEP_WAKE:
+				{
+					const std::shared_ptr<ClientInfo> cli = slot.cli;
+					const uint32_t pendingLen = slot.st.len;
+					Erase(i, nullptr);
+					gCounters.Add(CNT_PARK_WAKEUPS);
+					wake(cli, pendingLen);
+					break;
+				}
+				default:
+					i++;
+					break;
+				}
+			}
+		}
+
+		// 종료 : 아직 넘겨받지 않은 접속까지 정리
+		Adopt();
+		while (!mSlots.empty())
+			Erase(mSlots.size() - 1, drop);
+	}
+
+private:
+	enum StepResult { STEP_PENDING, STEP_ERROR, STEP_WAKE };
+
+	struct Slot
+	{
+		std::shared_ptr<ClientInfo> cli;
+		FrameRecvState st;
+		char buf[CTRL_MAX_FRAME];
+	};
+
+	// recv 한 번 : 헤더가 끝나 오디오 길이면 STEP_WAKE, 제어 프레임이 끝나면 IngestFrame
+	StepResult Step(Slot& slot)
+	{
+		FrameRecvState& st = slot.st;
+		const SOCKET s = slot.cli->sock;
+		const bool header = st.hdrGot < sizeof(st.nlen);
+		const int n = header
+			? recv(s, (char*)&st.nlen + st.hdrGot, (int)(sizeof(st.nlen) - st.hdrGot), 0)
+			: recv(s, slot.buf + st.got, (int)(st.len - st.got), 0);
+		countSocketRecv();
+		if (n <= 0)
+			return STEP_ERROR;
+
+		if (header)
+		{
+			st.hdrGot += (uint32_t)n;
+			if (st.hdrGot < sizeof(st.nlen))
+				return STEP_PENDING;
+
+			// recvFrame 과 같은 방어 : 0 길이 / 16MB 초과 차단
+			st.len = ntohl(st.nlen);
+			if (st.len == 0 || st.len > 1u << 24)
+				return STEP_ERROR;
+			return st.len > CTRL_MAX_FRAME ? STEP_WAKE : STEP_PENDING;
+		}
+
+		st.got += (uint32_t)n;
+		if (st.got == st.len)
+		{
+			IngestFrame(*slot.cli, slot.buf, st.len, pipelineNowNs());
+			st = FrameRecvState{};
+		}
+		return STEP_PENDING;
+	}
+
+	void Adopt()
+	{
+		std::lock_guard<std::mutex> lock(mIncomingMutex);
+		for (size_t i = 0; i < mIncoming.size(); i++)
+		{
+			mSlots.emplace_back();
+			mSlots.back().cli = std::move(mIncoming[i]);
+
+			WSAPOLLFD pfd = {};
+			pfd.fd = mSlots.back().cli->sock;
+			pfd.events = POLLRDNORM;
+			mFds.push_back(pfd);
+		}
+		mIncoming.clear();
+	}
+
+	// 마지막 항목과 바꿔 지운다 (drop 이 nullptr 이면 수신 스레드로 넘어간 접속)
+	void Erase(size_t i, ParkDropFn drop)
+	{
+		std::shared_ptr<ClientInfo> cli = std::move(mSlots[i].cli);
+		if (i + 1 != mSlots.size())
+		{
+			mSlots[i] = std::move(mSlots.back());
+			mFds[i] = mFds.back();
+		}
+		mSlots.pop_back();
+		mFds.pop_back();
+		mParked.fetch_sub(1, std::memory_order_relaxed);
+
+		if (drop)
+			drop(cli);
+	}
+
+	std::mutex mIncomingMutex;
+	std::vector<std::shared_ptr<ClientInfo>> mIncoming;
+	std::atomic<size_t> mParked{ 0 };
+
+	// Run 스레드 전용 (mSlots[i] 와 mFds[i] 가 같은 접속)
+	std::vector<Slot> mSlots;
+	std::vector<WSAPOLLFD> mFds;
+};
+
+// ──────────────────────────────
+// 접속당 메모리
+// - 프로세스 private 바이트에서 접속을 받기 전 기준값을 빼 접속 수로 나눈다
+//   (스레드 스택 / ClientInfo / 송신 큐 / 소켓 버퍼 중 사용자 공간 몫이 모두 들어간다)
+// - 커널 스택 / 소켓 커널 버퍼는 private 바이트에 잡히지 않는다
+// - 대기 청취자 효과 재현 : 서버를 띄우고 LoadGen --clients 9000 --probes 1 --talk-ratio 0 --seconds 60 으로
+//   접속을 채운 뒤 서버 호스트에서 http://127.0.0.1:9464/metrics 의 gac_connection_footprint_bytes 를 읽는다
+//   (메트릭 엔드포인트는 루프백에만 열린다 : openMetricsListener)
+//   같은 실행을 서버 --no-parking 으로 한 번 더 해 두 값을 비교 (gac_clients_parked 로 대기 상태 확인)
+// ──────────────────────────────
+struct ProcessMemory
+{
+	uint64_t privateBytes = 0;
+	uint64_t workingSetBytes = 0;
+};
+
+static ProcessMemory processMemoryNow()
+{
+	ProcessMemory m;
+	PROCESS_MEMORY_COUNTERS_EX pmc = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc)))
+	{
+		m.privateBytes = pmc.PrivateUsage;
+		m.workingSetBytes = pmc.WorkingSetSize;
+	}
+	return m;
+}
+
+static double connectionFootprintBytes(const ProcessMemory& base, const ProcessMemory& now, size_t connections)
+{
+	if (connections == 0 || now.privateBytes <= base.privateBytes)
+		return 0.0;
+	return (double)(now.privateBytes - base.privateBytes) / connections;
+}
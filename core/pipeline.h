@@ -0,0 +1,904 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core.h"
+#include "alloc_track.h"
+#include "capture.h"
+#include "client_slots.h"
+#include "client_stats.h"
+#include "echo.h"
+#include "governor.h"
+#include "histogram.h"
+#include "lock_profile.h"
+#include "marker.h"
+#include "media_clock.h"
+#include "metrics.h"
+#include "mixer.h"
+#include "probes.h"
+#include "rt_sched.h"
+#include "thread_stats.h"
+#include "time_sync.h"
+#include "trace.h"
+
+// ──────────────────────────────
+// 서버 오디오 파이프라인 (수신 이후 ~ 송신 큐)
+// - 수신 프레임 적재(IngestFrame), 믹서 tick(MixTick), 송신 큐 소비(PopPacket / AccountSent)
+// - 소켓/스레드는 다루지 않는다 : 서버는 소켓 스레드로, Replay 는 오프라인 루프로 구동
+// - 시각은 gPipelineClock (미디어 시계) 기준 : 서버는 실제 시간, Replay/시험은 VirtualClock
+//   (tick 비용 / 팬아웃 비용 / trace 구간은 실제 CPU 시간이므로 항상 nowNs)
+// ──────────────────────────────
+
+// ──────────────────────────────
+// 단계별 지연 히스토그램 (ns)
+// - INGEST          : 프레임 수신 완료 ~ 믹싱 큐 push
+// - MIX_QUEUE_WAIT  : 믹싱 큐 push ~ 믹서 tick 시작
+// - MIX_TICK        : 믹서 tick 한 번 (믹싱 + 팬아웃 전체)
+// - FANOUT_ENQUEUE  : 클라이언트 하나의 송신 큐에 넣는 시간
+// - SEND_QUEUE_WAIT : 송신 큐 push ~ 송신 스레드가 꺼낼 때
+// - SEND            : sendFrame 호출 시간
+// - SERVER_TOTAL    : 믹스에 포함된 가장 오래된 수신 ~ 송신 완료
+// ──────────────────────────────
+enum LatencyStage
+{
+	STAGE_INGEST,
+	STAGE_MIX_QUEUE_WAIT,
+	STAGE_MIX_TICK,
+	STAGE_FANOUT_ENQUEUE,
+	STAGE_SEND_QUEUE_WAIT,
+	STAGE_SEND,
+	STAGE_SERVER_TOTAL,
+	STAGE_COUNT
+};
+
+static LatencyHistogram gStageHist[STAGE_COUNT] = {
+	{ "ingest" },
+	{ "mix_queue_wait" },
+	{ "mix_tick" },
+	{ "fanout_enqueue" },
+	{ "send_queue_wait" },
+	{ "send" },
+	{ "server_total" },
+};
+
+// ──────────────────────────────
+// 클라이언트 보고 단계별 지연 (ns, 전체 클라이언트 합산)
+// - CTRL_CLIENT_STATS 보고(client_stats.h)의 거친 버킷을 버킷 상한값으로 다시 기록
+// - 서버가 잴 수 없는 캡처 / 장치 재생 구간까지 포함해 종단 간 지연을 어디서 쓰는지 본다
+// ──────────────────────────────
+static LatencyHistogram gClientStageHist[CSTAGE_COUNT] = {
+	{ "client_capture_gate" },
+	{ "client_send_queue_wait" },
+	{ "client_send" },
+	{ "client_recv_enqueue" },
+	{ "client_play_queue_wait" },
+	{ "client_device_play" },
+	{ "client_send_total" },
+	{ "client_play_total" },
+};
+
+// ──────────────────────────────
+// 메트릭 카운터 (CounterGroup : 스레드별 shard, 증가 시 락 없음)
+// - 합계는 /metrics 스크랩 시에만 계산
+// ──────────────────────────────
+enum ServerCounter
+{
+	CNT_CLIENTS_ACCEPTED,
+	CNT_CLIENTS_REMOVED,
+	CNT_FRAMES_RECEIVED,
+	CNT_CTRL_RECEIVED,
+	CNT_BYTES_IN,
+	CNT_MIX_TICKS,
+	CNT_TICK_OVERRUNS,
+	CNT_FRAMES_MIXED,
+	CNT_FRAMES_ENQUEUED,
+	CNT_FRAMES_DROPPED,
+	CNT_FRAMES_SENT,
+	CNT_BYTES_OUT,
+	CNT_MIX_POOL_MISSES,
+	CNT_MIX_TICK_CPU_NS,								// tick 중 믹서가 실제로 CPU 에서 돈 시간 (cycle 환산)
+	CNT_MIX_TICK_OFFCPU_NS,								// tick 벽시계 - CPU : 선점 / 락 대기 / 페이지 폴트
+	CNT_CLIENT_REPORTS,									// 받은 CTRL_CLIENT_STATS 보고 (형식이 맞는 것만)
+	CNT_TIME_PINGS,										// 받은 CTRL_TIME_PING
+	CNT_TIME_PONGS,										// 보낸 CTRL_TIME_PONG (이전 pong 이 아직 큐에 있으면 답하지 않는다)
+	CNT_ECHO_FRAMES,									// 에코 모드 클라이언트에게 돌려준 프레임
+	CNT_GOV_FRAMES_CAPPED,								// 발화자 상한 (GOV_SPEAKER_CAP) 으로 믹싱에서 뺀 프레임
+	CNT_GOV_JOINS_REFUSED,								// 믹서 예산 부족으로 거부한 접속
+	CNT_PARK_WAKEUPS,									// 대기 청취자가 발화를 시작해 수신 스레드를 받은 횟수 (park.h)
+	CNT_PARK_RETURNS,									// 발화를 마치고 (DTX) 대기 상태로 돌아간 횟수
+	CNT_COUNT
+};
+static CounterGroup gCounters;
+
+// ──────────────────────────────
+// 핫 패스 할당 횟수 (GAC_ALLOC_TRACK=1 빌드에서만 증가)
+// - 워밍업(스레드별 histogram/counter 슬롯, 큐 용량 확보) 이후에는 모두 0 이어야 한다
+// ──────────────────────────────
+enum HotPath
+{
+	HOT_INGEST,											// IngestFrame
+	HOT_MIX,											// MixTick : 믹싱 큐 교환 + 합산
+	HOT_FANOUT,											// MixTick : 송신 큐 push
+	HOT_SEND,											// PopPacket / AccountSent
+	HOT_PATH_COUNT
+};
+
+static const char* const kHotPathNames[HOT_PATH_COUNT] = { "ingest", "mix", "fanout", "send" };
+static std::atomic<uint64_t> gHotPathAllocs[HOT_PATH_COUNT];
+
+// 믹서 스레드만 기록하는 게이지
+static std::atomic<int64_t> gMixTickLastNs{ 0 };
+static std::atomic<int64_t> gMixTickMaxNs{ 0 };
+static std::atomic<int64_t> gMixBatchFrames{ 0 };		// 마지막 tick 에 믹싱한 프레임 수 (믹싱 큐 깊이)
+static std::atomic<int64_t> gMixTickLockWaitNs{ 0 };	// 마지막 tick 이 락 경합으로 기다린 시간 (--lock-profile)
+static std::atomic<int64_t> gMixTickCpuNs{ 0 };			// 마지막 tick 의 on-CPU 시간
+static std::atomic<int64_t> gMixTickOffCpuNs{ 0 };		// 마지막 tick 의 off-CPU 시간 (벽시계 - on-CPU)
+
+// ──────────────────────────────
+// 믹서 깨어남 지연 (ns)
+// - 대기 목표 시각 ~ 실제로 다시 돌기 시작한 시각 (타이머 해상도 + 실행 대기열 대기)
+// - tick 비용은 정상인데 이 값이 크면 알고리즘이 아니라 CPU 를 못 받는 것
+// ──────────────────────────────
+static LatencyHistogram gMixWakeDelayHist("mixer_wake_delay");
+
+#define MIX_TICK_MS 20									// 믹서 tick 주기, 작업이 이보다 길면 overrun
+#define MIX_IDLE_MS 5									// 믹싱 큐가 비었을 때 재확인 간격
+
+// ──────────────────────────────
+// 믹서 CPU 예산 관리 (governor.h)
+// - 기본 꺼짐 (Replay / 시험 도구는 tick 비용과 무관하게 같은 결과를 내야 한다)
+// - 서버는 구동 전에 Configure 로 켠다
+// ──────────────────────────────
+static TickGovernor gMixGovernor;
+static SpeakerSelector gSpeakerSelector;				// 믹서 스레드 전용
+
+// 파이프라인 미디어 시계 (기본 실제 시간, 파이프라인 구동 전에만 바꾼다)
+static SystemClock gSystemClock;
+static MediaClock* gPipelineClock = &gSystemClock;
+
+static int64_t pipelineNowNs()
+{
+	return gPipelineClock->NowNs();
+}
+
+// 수신 프레임 기록 (nullptr 이면 기록 안 함)
+static CaptureWriter* gCaptureWriter = nullptr;
+
+// ──────────────────────────────
+// 송신 큐 항목
+// - 믹스 결과 공유 포인터 + 단계 측정용 시각
+// ──────────────────────────────
+struct OutPacket
+{
+	std::shared_ptr<std::vector<char>> data;
+	int64_t enqueueNs = 0;								// 송신 큐 push 시각
+	int64_t originNs = 0;								// 이 믹스에 포함된 가장 오래된 프레임 수신 시각
+	bool timePong = false;								// CTRL_TIME_PONG : 송신 직전에 t3 를 채우고 오디오 통계에서 뺀다
+
+	// 에코 프레임 (echo.h) : echoSeq 가 0 이 아니면 송신 후 CTRL_ECHO_TIMING 을 보낸다
+	uint16_t echoSeq = 0;
+	int64_t echoQueuedNs = 0;							// 믹싱 큐 push 시각
+	int64_t echoMixNs = 0;								// 믹서 tick 시작 시각
+};
+
+// ──────────────────────────────
+// OutPacketQueue
+// - 송신 큐 : MAX_QUEUE_FRAMES 고정 링 (qMutex 안에서만 접근)
+// - std::queue(deque) 는 push 마다 블록을 할당/해제할 수 있어 대신 쓴다
+// - 팬아웃이 가득 찬 큐는 먼저 pop 하므로 용량을 넘지 않는다
+// - pop 은 슬롯의 공유 포인터를 바로 놓아 믹스 버퍼가 풀로 돌아가게 한다
+// ──────────────────────────────
+class OutPacketQueue
+{
+public:
+	bool empty() const { return mCount == 0; }
+	size_t size() const { return mCount; }
+
+	OutPacket& front() { return mSlots[mHead]; }
+
+	void push(OutPacket&& packet)
+	{
+		mSlots[(mHead + mCount) % MAX_QUEUE_FRAMES] = std::move(packet);
+		mCount++;
+	}
+
+	void pop()
+	{
+		mSlots[mHead] = OutPacket();
+		mHead = (mHead + 1) % MAX_QUEUE_FRAMES;
+		mCount--;
+	}
+
+private:
+	OutPacket mSlots[MAX_QUEUE_FRAMES];
+	size_t mHead = 0;
+	size_t mCount = 0;
+};
+
+// ──────────────────────────────
+// 클라이언트 엔트리
+// 1. 각 클라이언트 별 송신 전용 큐 / 스레드를 보유
+// 2. 느린 클리이언트가 있어도 다른 클라이언트로의 송신은 지연되지 않는다
+// ──────────────────────────────
+struct ClientInfo
+{
+	SOCKET sock = INVALID_SOCKET;
+	// 메트릭 라벨용 접속 번호
+	uint32_t id = 0;
+	// gClientSlots 슬롯 번호 (AttachClient ~ DetachClient, 믹서 팬아웃은 이 번호로 플래그 배열을 본다)
+	uint32_t slot = CLIENT_SLOT_NONE;
+	// 송신 전용 큐
+	std::mutex qMutex;
+	std::condition_variable qCV;
+	// 공유 포인터로 패킷을 보관하여 불필요한 복사를 줄인다 (고정 링, 할당 없음)
+	OutPacketQueue q;
+	// 송신 스레드
+	std::thread sendThread;
+	// 활성 상태
+	std::atomic<bool> active{ true };
+	// 발화 상태 (오디오 수신 시 true, DTX 마커 수신 시 false)
+	std::atomic<bool> talking{ false };
+	// 에코 모드 (CTRL_ECHO) : 방 믹스 대신 자기 프레임을 그대로 돌려받는다
+	std::atomic<bool> echo{ false };
+	// 백프레셔 카운터 (무한 메모리 증가 방지용) - 단순 프레임 수 제한
+	size_t queuedFrames = 0;
+
+	// 클라이언트별 메트릭 (필드마다 기록 스레드가 하나, 스크랩은 락 없이 읽음)
+	std::atomic<uint64_t> framesIn{ 0 };				// 수신 스레드
+	std::atomic<uint64_t> bytesIn{ 0 };					// 수신 스레드
+	std::atomic<uint64_t> framesOut{ 0 };				// 송신 스레드
+	std::atomic<uint64_t> bytesOut{ 0 };				// 송신 스레드
+	std::atomic<uint64_t> dropped{ 0 };					// 믹서 스레드 (MAX_QUEUE_FRAMES 초과)
+	std::atomic<uint64_t> queueDepth{ 0 };				// qMutex 안에서 queuedFrames 를 그대로 반영
+
+	// 시계 동기화 (time_sync.h) : pong 버퍼는 접속 때 한 번 만들어 재사용 (수신 경로 할당 없음)
+	std::shared_ptr<std::vector<char>> pongBuf = std::make_shared<std::vector<char>>(CTRL_MAX_FRAME);
+	// 클라이언트가 ping 에 실어 보낸 추정값 (수신 스레드 기록, 스크랩은 락 없이 읽음)
+	std::atomic<bool> clockSynced{ false };
+	std::atomic<int64_t> clockOffsetNs{ 0 };			// 서버 시계 - 클라이언트 시계 (clockRefNs 시점)
+	std::atomic<int64_t> clockRefNs{ 0 };				// 추정값을 받은 서버 시각
+	std::atomic<int64_t> clockRttNs{ 0 };
+	std::atomic<int32_t> clockSkewPpb{ 0 };
+};
+
+// 클라이언트 시각 -> 서버 시각 (동기화 전이면 false)
+static bool clientToServerNs(const ClientInfo& cli, int64_t clientNs, int64_t& serverNs)
+{
+	if (!cli.clockSynced.load(std::memory_order_acquire))
+		return false;
+
+	const int64_t offset = cli.clockOffsetNs.load(std::memory_order_relaxed);
+	const int64_t refNs = cli.clockRefNs.load(std::memory_order_relaxed);
+	const double skew = cli.clockSkewPpb.load(std::memory_order_relaxed) / 1e9;
+	serverNs = clientNs + offset + (int64_t)(skew * (double)(clientNs + offset - refNs));
+	return true;
+}
+
+static std::vector<std::shared_ptr<ClientInfo>> gClients;
+// ──────────────────────────────
+// 멀티스레드에서 동시에 gClients 벡터를 접근할 수 있으므로
+// mutex로 보호한다
+// ──────────────────────────────
+static std::mutex gClientMutex;
+
+// 믹서 팬아웃용 슬롯 배열 (client_slots.h, 등록 / 해제는 gClientMutex 안에서 gClients 와 함께)
+static ClientSlots gClientSlots;
+
+// ──────────────────────────────
+// 락 호출 지점 (lock_profile.h, --lock-profile 일 때만 기록)
+// ──────────────────────────────
+static LockSite gSiteAcceptAttach("gClientMutex", "accept_attach");
+static LockSite gSiteRemoveDetach("gClientMutex", "remove_detach");
+static LockSite gSiteMixerFanout("gClientMutex", "mixer_fanout");
+static LockSite gSiteMetricsScrape("gClientMutex", "metrics_scrape");
+static LockSite gSiteShmPublish("gClientMutex", "shm_publish");
+static LockSite gSiteIngestPush("gMixMutex", "ingest_push");
+static LockSite gSiteMixerSwap("gMixMutex", "mixer_swap");
+static LockSite gSiteFanoutEnqueue("qMutex", "fanout_enqueue");
+static LockSite gSiteSendPop("qMutex", "send_pop");
+static LockSite gSiteRemoveClear("qMutex", "remove_clear");
+static LockSite gSiteTimePong("qMutex", "time_pong");
+
+// ──────────────────────────────
+// 믹싱 큐
+// - 프레임은 고정 크기 배열로 벡터 안에 바로 복사 (프레임마다 할당 없음)
+// - gMixFrames 와 믹서 전용 gMixBatch 를 tick 마다 swap : 두 벡터 모두 용량을 유지
+// ──────────────────────────────
+struct MixFrame
+{
+	MixFrame() {}										// data 0 초기화 생략 (바로 덮어쓴다)
+
+	int64_t recvNs = 0;									// 수신 완료 시각
+	int64_t queuedNs = 0;								// 믹싱 큐 push 시각
+	uint32_t clientId = 0;
+	bool echo = false;									// 에코 모드 클라이언트의 프레임 (방 믹스에서 뺀다)
+	uint16_t echoSeq = 0;								// 마커 레인 0 의 seq (없으면 0)
+	char data[AUDIO_BUFFER_SIZE];						// 16bit stereo PCM
+};
+static std::mutex gMixMutex;
+static std::vector<MixFrame> gMixFrames;
+static std::vector<MixFrame> gMixBatch;					// 믹서 스레드 전용
+
+// ──────────────────────────────
+// MixBufferPool
+// - 믹스 결과 버퍼 풀 (믹서 스레드 전용)
+// - tick 마다 하나를 꺼내 모든 클라이언트가 같은 버퍼를 공유 (클라이언트별 복사 없음)
+// - 풀만 참조하는 버퍼(use_count == 1) 를 순서대로 재사용
+//   송신 큐에 최대 MAX_QUEUE_FRAMES 개 + 송신 중 하나씩 남으므로 그보다 조금 크게 잡는다
+// - 모두 사용 중이면 풀 밖에서 새로 할당 (CNT_MIX_POOL_MISSES)
+// ──────────────────────────────
+#define MIX_POOL_BUFFERS (MAX_QUEUE_FRAMES + 8)
+
+class MixBufferPool
+{
+public:
+	std::shared_ptr<std::vector<char>> Acquire()
+	{
+		for (size_t n = 0; n < MIX_POOL_BUFFERS; n++)
+		{
+			std::shared_ptr<std::vector<char>>& buf = mBuffers[mNext];
+			mNext = (mNext + 1) % MIX_POOL_BUFFERS;
+
+			if (!buf)
+			{
+				buf = std::make_shared<std::vector<char>>(AUDIO_BUFFER_SIZE);
+				return buf;
+			}
+			if (buf.use_count() == 1)
+			{
+				// 마지막 사용자(송신 스레드)의 읽기가 끝난 뒤에 덮어쓴다
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return buf;
+			}
+		}
+
+		gCounters.Add(CNT_MIX_POOL_MISSES);
+		return std::make_shared<std::vector<char>>(AUDIO_BUFFER_SIZE);
+	}
+
+	// 풀 버퍼를 모두 미리 만들어 건드리고 (--lock-memory 면) 잠근다 (믹서 시작 전)
+	void Prefault()
+	{
+		for (auto& buf : mBuffers)
+		{
+			if (!buf)
+				buf = std::make_shared<std::vector<char>>(AUDIO_BUFFER_SIZE);
+			memset(buf->data(), 0, buf->size());
+			rtLockRegion(buf->data(), buf->size());
+		}
+	}
+
+private:
+	std::shared_ptr<std::vector<char>> mBuffers[MIX_POOL_BUFFERS];
+	size_t mNext = 0;
+};
+static MixBufferPool gMixPool;
+
+// ──────────────────────────────
+// PrefaultPipeline
+// - 믹서 풀 버퍼와 믹싱 큐 두 벡터(frames 개 용량)를 미리 만들어 페이지를 건드리고 잠근다 (rt_sched.h)
+// - 첫 발화 때 페이지 폴트 / 힙 확장이 tick 안에서 일어나지 않게 한다
+// - 용량을 넘어 자라는 부분은 잠그지 않는다 (믹싱 큐는 접속 수만큼 자랄 수 있다)
+// - 파이프라인 스레드가 돌기 전에 호출
+// ──────────────────────────────
+#define MIX_PREFAULT_FRAMES 256
+
+static void PrefaultPipeline(size_t frames)
+{
+	gMixPool.Prefault();
+
+	std::vector<MixFrame>* queues[2] = { &gMixFrames, &gMixBatch };
+	for (std::vector<MixFrame>* q : queues)
+	{
+		q->resize((std::max)(frames, q->capacity()));
+		for (MixFrame& f : *q)
+			memset(f.data, 0, sizeof(f.data));
+		rtLockRegion(q->data(), q->size() * sizeof(MixFrame));
+		q->clear();										// 용량 유지
+	}
+}
+
+// ──────────────────────────────
+// AttachClient / DetachClient
+// - gClients 등록 / 제거 (+ 슬롯, 접속 카운터, 캡처 JOIN / LEAVE 기록)
+// - 슬롯이 모두 차 있으면 (CLIENT_SLOT_MAX) 등록하지 않고 false
+// ──────────────────────────────
+static bool AttachClient(const std::shared_ptr<ClientInfo>& cli)
+{
+	ProfiledLock glock(gClientMutex, gSiteAcceptAttach);
+	cli->slot = gClientSlots.Acquire(cli.get(), cli->id);
+	if (cli->slot == CLIENT_SLOT_NONE)
+		return false;
+	gClients.push_back(cli);
+	gCounters.Add(CNT_CLIENTS_ACCEPTED);
+	if (gCaptureWriter)
+		gCaptureWriter->Append(CAPTURE_JOIN, cli->id, pipelineNowNs(), nullptr, 0);
+	return true;
+}
+
+static void DetachClient(const std::shared_ptr<ClientInfo>& cli)
+{
+	ProfiledLock glock(gClientMutex, gSiteRemoveDetach);
+	gClientSlots.Release(cli->slot);
+	cli->slot = CLIENT_SLOT_NONE;
+	gClients.erase(std::remove(gClients.begin(), gClients.end(), cli), gClients.end());
+	gCounters.Add(CNT_CLIENTS_REMOVED);
+	if (gCaptureWriter)
+		gCaptureWriter->Append(CAPTURE_LEAVE, cli->id, pipelineNowNs(), nullptr, 0);
+}
+
+// 활성 플래그 내리기 (ClientInfo 와 슬롯 플래그를 함께), 이전 값 반환
+static bool DeactivateClient(ClientInfo& cli)
+{
+	const bool wasActive = cli.active.exchange(false);
+	gClientSlots.Clear(cli.slot, SLOT_ACTIVE);
+	return wasActive;
+}
+
+// 송신 큐 비우기 (제거 직전)
+static void ClearClientQueue(ClientInfo& cli)
+{
+	ProfiledLock lock(cli.qMutex, gSiteRemoveClear);
+	while (!cli.q.empty()) cli.q.pop();
+	cli.queuedFrames = 0;
+	cli.queueDepth.store(0, std::memory_order_relaxed);
+}
+
+// ──────────────────────────────
+// MergeClientReport
+// - 보고 버킷 하나의 n 건을 버킷 상한값으로 기록 (단계 최대값보다 크면 최대값)
+// - 상한 없는 마지막 버킷은 최대값으로
+// ──────────────────────────────
+static void MergeClientReport(const ClientReportPayload& r)
+{
+	for (int s = 0; s < CSTAGE_COUNT; s++)
+	{
+		const uint64_t maxNs = (uint64_t)r.stage[s].maxUs * 1000;
+		for (int b = 0; b < CLIENT_REPORT_BUCKETS; b++)
+		{
+			const uint16_t n = r.stage[s].counts[b];
+			if (n == 0)
+				continue;
+
+			uint64_t v = clientReportBucketUpper(b);
+			if (maxNs > 0 && maxNs < v)
+				v = (std::max)(maxNs, b > 0 ? clientReportBucketUpper(b - 1) : (uint64_t)0);
+			gClientStageHist[s].Record(v, n);
+		}
+	}
+	gCounters.Add(CNT_CLIENT_REPORTS);
+}
+
+// ──────────────────────────────
+// AnswerTimePing
+// - 클라이언트 추정값 보관 후 pong 을 송신 큐에 넣는다 (t3 는 송신 스레드가 보내기 직전에 채운다)
+// - pong 버퍼가 아직 큐 / 송신 중이면 (use_count > 1) 이번 ping 은 답하지 않는다 : 클라이언트는 표본 하나를 잃을 뿐
+// - 큐가 가득 차도 답하지 않는다 (오디오를 밀어내지 않음)
+// ──────────────────────────────
+static void AnswerTimePing(ClientInfo& cli, const TimePing& ping, int64_t recvNs)
+{
+	gCounters.Add(CNT_TIME_PINGS);
+	if (ping.synced)
+	{
+		cli.clockOffsetNs.store(ping.offsetNs, std::memory_order_relaxed);
+		cli.clockRefNs.store(recvNs, std::memory_order_relaxed);
+		cli.clockRttNs.store(ping.rttNs, std::memory_order_relaxed);
+		cli.clockSkewPpb.store(ping.skewPpb, std::memory_order_relaxed);
+		cli.clockSynced.store(true, std::memory_order_release);
+	}
+
+	if (cli.pongBuf.use_count() > 1)
+		return;
+
+	cli.pongBuf->resize(CTRL_MAX_FRAME);
+	cli.pongBuf->resize(buildTimePongFrame(cli.pongBuf->data(), ping, recvNs));
+
+	ProfiledLock lock(cli.qMutex, gSiteTimePong);
+	if (!cli.active || cli.queuedFrames >= MAX_QUEUE_FRAMES)
+		return;
+
+	OutPacket packet;
+	packet.data = cli.pongBuf;
+	packet.enqueueNs = pipelineNowNs();
+	packet.originNs = recvNs;
+	packet.timePong = true;
+	cli.q.push(std::move(packet));
+	cli.queuedFrames++;
+	cli.queueDepth.store(cli.queuedFrames, std::memory_order_relaxed);
+	cli.qCV.notify_one();
+}
+
+// ──────────────────────────────
+// HandleControlFrame
+// - 오디오가 아닌 제어 프레임 처리 (믹싱 대상 아님)
+// - CTRL_DTX          : 클라이언트가 무음 구간에 들어가 송신을 멈춤
+// - CTRL_CLIENT_STATS : 클라이언트 단계별 지연 보고, 형식이 다르면 (버전 불일치) 버린다
+// - CTRL_TIME_PING    : 실려 온 시계 추정값을 보관하고 pong 을 송신 큐에 넣는다 (recvNs = t2)
+// - CTRL_ECHO         : 에코 모드 켜기 / 끄기 (다음 tick 부터)
+// ──────────────────────────────
+static void HandleControlFrame(ClientInfo& cli, const char* frame, uint32_t len, int64_t recvNs)
+{
+	uint16_t type = 0;
+	const char* payload = nullptr;
+	uint16_t payloadLen = 0;
+	if (!parseCtrlFrame(frame, len, type, payload, payloadLen))
+		return;
+
+	switch (type)
+	{
+	case CTRL_DTX:
+		cli.talking = false;
+		gClientSlots.Clear(cli.slot, SLOT_TALKING);
+		break;
+	case CTRL_CLIENT_STATS:
+	{
+		ClientReportPayload report;
+		if (parseClientReport(payload, payloadLen, report))
+			MergeClientReport(report);
+		break;
+	}
+	case CTRL_ECHO:
+	{
+		bool enable = false;
+		if (parseEchoRequest(payload, payloadLen, enable))
+		{
+			cli.echo = enable;
+			if (enable)
+				gClientSlots.Set(cli.slot, SLOT_ECHO);
+			else
+				gClientSlots.Clear(cli.slot, SLOT_ECHO);
+		}
+		break;
+	}
+	case CTRL_TIME_PING:
+	{
+		TimePing ping;
+		if (parseTimePing(payload, payloadLen, ping))
+			AnswerTimePing(cli, ping, recvNs);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// ──────────────────────────────
+// IngestFrame
+// - 수신한 프레임 하나를 처리 (recvNs : 수신 완료 시각, pipelineNowNs 기준)
+// 1. 캡처 기록 / 수신 카운터
+// 2. 제어 프레임은 HandleControlFrame, 오디오는 믹싱 큐에 push
+// ──────────────────────────────
+static void IngestFrame(ClientInfo& cli, const char* frame, uint32_t len, int64_t recvNs)
+{
+	HotPathAllocScope allocScope(gHotPathAllocs[HOT_INGEST]);
+	probeFrameReceived(cli.id, len);
+
+	if (gCaptureWriter)
+		gCaptureWriter->Append(CAPTURE_FRAME, cli.id, recvNs, frame, len);
+
+	const uint64_t wireBytes = len + sizeof(uint32_t);
+	bumpCounter(cli.bytesIn, wireBytes);
+	gCounters.Add(CNT_BYTES_IN, wireBytes);
+
+	// 제어 프레임 (DTX 등) 은 믹싱하지 않는다
+	if (!isAudioFrame(len))
+	{
+		gCounters.Add(CNT_CTRL_RECEIVED);
+		HandleControlFrame(cli, frame, len, recvNs);
+		return;
+	}
+	// 슬롯 플래그는 발화 시작 때만 쓴다 (프레임마다 쓰면 믹서가 훑는 라인을 건드린다)
+	if (!cli.talking.load(std::memory_order_relaxed))
+	{
+		cli.talking = true;
+		gClientSlots.Set(cli.slot, SLOT_TALKING);
+	}
+	bumpCounter(cli.framesIn);
+	gCounters.Add(CNT_FRAMES_RECEIVED);
+
+	// 에코 모드면 마커 seq 를 읽어 둔다 (서버 단계 시각을 돌려줄 프레임)
+	const bool echo = cli.echo.load(std::memory_order_relaxed);
+	uint16_t echoSeq = 0;
+	if (echo && !ReadMarker((const int16_t*)frame, 0, echoSeq))
+		echoSeq = 0;
+
+	// 믹스 프레임 수신 (믹싱 큐 안에 바로 복사)
+	int64_t queuedNs;
+	{
+		ProfiledLock lock(gMixMutex, gSiteIngestPush);
+		gMixFrames.emplace_back();
+		MixFrame& mf = gMixFrames.back();
+		memcpy(mf.data, frame, AUDIO_BUFFER_SIZE);
+		mf.recvNs = recvNs;
+		mf.clientId = cli.id;
+		mf.echo = echo;
+		mf.echoSeq = echoSeq;
+		mf.queuedNs = queuedNs = pipelineNowNs();
+	}
+	gStageHist[STAGE_INGEST].Record(queuedNs - recvNs);
+}
+
+// ──────────────────────────────
+// PushOutPacket
+// - 송신 큐 push, 가득 차 있으면 가장 오래된 패킷부터 drop (qMutex 안에서 호출)
+// ──────────────────────────────
+static void PushOutPacket(ClientInfo& cli, OutPacket&& packet)
+{
+	while (cli.queuedFrames >= MAX_QUEUE_FRAMES && !cli.q.empty())
+	{
+		probeFrameDropped(cli.id, (uint32_t)cli.q.front().data->size(), (uint32_t)cli.queuedFrames);
+		cli.q.pop();
+		cli.queuedFrames--;
+		bumpCounter(cli.dropped);
+		traceInstant("queue_drop", cli.id);
+		gCounters.Add(CNT_FRAMES_DROPPED);
+	}
+
+	const uint32_t bytes = (uint32_t)packet.data->size();
+	packet.enqueueNs = pipelineNowNs();
+	cli.q.push(std::move(packet));
+	cli.queuedFrames++;
+	cli.queueDepth.store(cli.queuedFrames, std::memory_order_relaxed);
+	cli.qCV.notify_one();
+	probeFrameEnqueued(cli.id, bytes, (uint32_t)cli.queuedFrames);
+	gCounters.Add(CNT_FRAMES_ENQUEUED);
+}
+
+// ──────────────────────────────
+// EchoFrames
+// - 에코 모드 클라이언트 : 이번 tick 에 들어온 자기 프레임을 믹스 대신 하나씩 그대로 돌려준다
+// - 프레임마다 믹스 풀 버퍼를 하나씩 쓰므로 에코 클라이언트가 많으면 풀 miss 가 늘 수 있다 (진단용)
+// - 반환 : 돌려준 프레임이 있으면 true
+// ──────────────────────────────
+static bool EchoFrames(ClientInfo& cli, const std::vector<MixFrame>& frames, int64_t tickStartNs)
+{
+	bool any = false;
+	for (const MixFrame& f : frames)
+	{
+		if (!f.echo || f.clientId != cli.id)
+			continue;
+
+		OutPacket packet;
+		packet.data = gMixPool.Acquire();
+		memcpy(packet.data->data(), f.data, AUDIO_BUFFER_SIZE);
+		packet.originNs = f.recvNs;
+		packet.echoSeq = f.echoSeq;
+		packet.echoQueuedNs = f.queuedNs;
+		packet.echoMixNs = tickStartNs;
+
+		ProfiledLock lock(cli.qMutex, gSiteFanoutEnqueue);
+		PushOutPacket(cli, std::move(packet));
+		gCounters.Add(CNT_ECHO_FRAMES);
+		any = true;
+	}
+	return any;
+}
+
+// ──────────────────────────────
+// MixTick
+// - 믹서 tick 한 번 : 믹싱 큐를 비워 합산하고 모든 클라이언트 송신 큐에 push
+// - 에코 모드 클라이언트의 프레임은 합산에서 빼고 EchoFrames 로 본인에게만 돌려준다
+// - 믹싱 큐가 비어 있으면 아무것도 하지 않고 0 반환 (호출 측이 MIX_IDLE_MS 대기)
+// - gMixGovernor 단계에 따라 계측을 끄고 (GOV_LEAN) 발화자 수를 제한한다 (GOV_SPEAKER_CAP)
+//   단계는 tick 시작 때 한 번 읽고, 끝나면 tick / 팬아웃 비용을 넘겨 다음 단계를 정하게 한다
+// - 반환 : 믹싱 큐에서 꺼낸 프레임 수
+// ──────────────────────────────
+static size_t MixTick(const MixKernelOps& mix)
+{
+	std::vector<MixFrame>& framesToMix = gMixBatch;
+	const int64_t lockWaitStartNs = lockThreadWaitNs();
+	std::shared_ptr<std::vector<char>> mixed;
+	int64_t tickStartNs, cpuStartNs, originNs;
+	uint64_t cpuStartCycles;
+	size_t roomFrames = 0;								// 방 믹스에 더한 프레임 (에코 프레임 제외)
+	size_t cappedFrames = 0;							// 발화자 상한으로 뺀 프레임
+	const int govLevel = gMixGovernor.Level();
+	const bool lean = govLevel >= GOV_LEAN;
+	const bool capSpeakers = govLevel >= GOV_SPEAKER_CAP;
+
+	{
+		HotPathAllocScope allocScope(gHotPathAllocs[HOT_MIX]);
+		{
+			ProfiledLock lock(gMixMutex, gSiteMixerSwap);
+			if (gMixFrames.empty())
+				return 0;
+			framesToMix.swap(gMixFrames);
+		}
+		probeMixTickBegin((uint32_t)framesToMix.size());
+		tickStartNs = pipelineNowNs();
+		cpuStartNs = nowNs();
+		cpuStartCycles = threadCyclesNow();
+
+		// mix
+		mixed = gMixPool.Acquire();
+		memset(mixed->data(), 0, AUDIO_BUFFER_SIZE);
+		originNs = tickStartNs;
+		if (capSpeakers)
+		{
+			gSpeakerSelector.BeginTick(gMixGovernor.SpeakerCap());
+			for (auto& f : framesToMix)
+				if (!f.echo)
+					gSpeakerSelector.KeepIfPrevious(f.clientId);
+			for (auto& f : framesToMix)
+				if (!f.echo)
+					gSpeakerSelector.Offer(f.clientId);
+		}
+		else
+			gSpeakerSelector.Clear();
+
+		for (auto& f : framesToMix)
+		{
+			if (!lean)
+				gStageHist[STAGE_MIX_QUEUE_WAIT].Record(tickStartNs - f.queuedNs);
+			if (f.echo)
+				continue;
+			if (capSpeakers && !gSpeakerSelector.Contains(f.clientId))
+			{
+				cappedFrames++;
+				continue;
+			}
+			roomFrames++;
+			originNs = (std::min)(originNs, f.recvNs);
+			mix.add16((int16_t*)mixed->data(), (const int16_t*)f.data, MIX_FRAME_SAMPLES);
+		}
+	}
+
+	// 모든 클라이언트에 push (같은 믹스 버퍼를 공유)
+	// 슬롯 플래그 배열을 차례로 훑고 보낼 접속만 ClientInfo 를 따라간다
+	uint32_t fanoutClients = 0;
+	const int64_t fanoutStartNs = nowNs();
+	{
+		HotPathAllocScope allocScope(gHotPathAllocs[HOT_FANOUT]);
+		ProfiledLock glock(gClientMutex, gSiteMixerFanout);
+		const uint32_t slotEnd = gClientSlots.End();
+		for (uint32_t slot = 0; slot < slotEnd; slot++)
+		{
+			const uint8_t flags = gClientSlots.Flags(slot);
+			if (!(flags & SLOT_ACTIVE))
+				continue;
+			// 에코 프레임만 들어온 tick 은 방 믹스를 보내지 않는다
+			const bool echo = (flags & SLOT_ECHO) != 0;
+			if (!echo && roomFrames == 0)
+				continue;
+
+			ClientInfo* cli = gClientSlots.Info(slot);
+			const int64_t enqStartNs = lean ? 0 : nowNs();
+			if (echo)
+			{
+				if (!EchoFrames(*cli, framesToMix, tickStartNs))
+					continue;
+			}
+			else
+			{
+				OutPacket packet;
+				packet.data = mixed;
+				packet.originNs = originNs;
+				ProfiledLock lock(cli->qMutex, gSiteFanoutEnqueue);
+				PushOutPacket(*cli, std::move(packet));
+			}
+			fanoutClients++;
+			if (lean)
+				continue;
+			const int64_t enqEndNs = nowNs();
+			gStageHist[STAGE_FANOUT_ENQUEUE].Record(enqEndNs - enqStartNs);
+			traceComplete("enqueue", enqStartNs, enqEndNs, gClientSlots.Id(slot));
+		}
+	}
+	const int64_t fanoutNs = nowNs() - fanoutStartNs;
+	const size_t mixedFrames = framesToMix.size();
+	framesToMix.clear();								// 용량 유지 (다음 tick 에 gMixFrames 로 돌아간다)
+
+	const int64_t tickNs = nowNs() - cpuStartNs;
+	const int64_t tickCpuNs = (std::min)(tickNs, (int64_t)((threadCyclesNow() - cpuStartCycles) / threadCyclesPerNs()));
+	gStageHist[STAGE_MIX_TICK].Record(tickNs);
+	traceComplete("mix_tick", cpuStartNs, cpuStartNs + tickNs, (uint32_t)mixedFrames);
+	probeMixTickEnd((uint32_t)mixedFrames, fanoutClients, tickNs);
+
+	gCounters.Add(CNT_MIX_TICKS);
+	gCounters.Add(CNT_FRAMES_MIXED, mixedFrames - cappedFrames);
+	if (cappedFrames > 0)
+		gCounters.Add(CNT_GOV_FRAMES_CAPPED, cappedFrames);
+	gCounters.Add(CNT_MIX_TICK_CPU_NS, (uint64_t)tickCpuNs);
+	gCounters.Add(CNT_MIX_TICK_OFFCPU_NS, (uint64_t)(tickNs - tickCpuNs));
+	if (tickNs > MIX_TICK_MS * 1000000LL)
+		gCounters.Add(CNT_TICK_OVERRUNS);
+	gMixTickLastNs.store(tickNs, std::memory_order_relaxed);
+	gMixTickMaxNs.store((std::max)(gMixTickMaxNs.load(std::memory_order_relaxed), tickNs), std::memory_order_relaxed);
+	gMixBatchFrames.store((int64_t)mixedFrames, std::memory_order_relaxed);
+	gMixTickLockWaitNs.store(lockThreadWaitNs() - lockWaitStartNs, std::memory_order_relaxed);
+	gMixTickCpuNs.store(tickCpuNs, std::memory_order_relaxed);
+	gMixTickOffCpuNs.store(tickNs - tickCpuNs, std::memory_order_relaxed);
+	gMixGovernor.Update(tickNs, fanoutNs, fanoutClients);
+
+	return mixedFrames;
+}
+
+// ──────────────────────────────
+// PopPacket
+// - 송신 큐에서 패킷 하나를 꺼낸다
+// - wait = true 면 패킷이 오거나 비활성화될 때까지 대기 (서버 송신 스레드)
+// - 꺼내지 못했으면 false (비어 있음 / 비활성)
+// ──────────────────────────────
+static bool PopPacket(ClientInfo& cli, OutPacket& out, bool wait)
+{
+	HotPathAllocScope allocScope(gHotPathAllocs[HOT_SEND]);
+	ProfiledUniqueLock lock(cli.qMutex, gSiteSendPop);
+	if (wait)
+		lock.Wait(cli.qCV, [&] { return !cli.q.empty() || !cli.active; });
+	if (!cli.active || cli.q.empty())
+		return false;
+
+	out = std::move(cli.q.front());
+	cli.q.pop();
+	if (cli.queuedFrames > 0)
+		cli.queuedFrames--;
+	cli.queueDepth.store(cli.queuedFrames, std::memory_order_relaxed);
+	return true;
+}
+
+// ──────────────────────────────
+// AccountSent
+// - 송신 완료한 패킷의 카운터 / 단계 지연 기록
+// - dequeueNs : PopPacket 직후, sentNs : 송신 완료 (둘 다 pipelineNowNs 기준)
+// ──────────────────────────────
+static void AccountSent(ClientInfo& cli, const OutPacket& packet, int64_t dequeueNs, int64_t sentNs)
+{
+	HotPathAllocScope allocScope(gHotPathAllocs[HOT_SEND]);
+	const uint64_t wireBytes = packet.data->size() + sizeof(uint32_t);
+	bumpCounter(cli.bytesOut, wireBytes);
+	gCounters.Add(CNT_BYTES_OUT, wireBytes);
+
+	// pong 은 믹스 프레임이 아니므로 바이트만 센다
+	if (packet.timePong)
+	{
+		gCounters.Add(CNT_TIME_PONGS);
+		return;
+	}
+
+	bumpCounter(cli.framesOut);
+	gCounters.Add(CNT_FRAMES_SENT);
+
+	gStageHist[STAGE_SEND_QUEUE_WAIT].Record(dequeueNs - packet.enqueueNs);
+	gStageHist[STAGE_SEND].Record(sentNs - dequeueNs);
+	gStageHist[STAGE_SERVER_TOTAL].Record(sentNs - packet.originNs);
+	probeFrameSent(cli.id, (uint32_t)wireBytes, sentNs - dequeueNs);
+}
+
+// ──────────────────────────────
+// RunMixerLoop
+// - 믹서 스레드 본체 : tick 후 MIX_TICK_MS, 믹싱 큐가 비었으면 MIX_IDLE_MS 대기
+// - 대기는 gPipelineClock 으로 하므로 VirtualClock 이면 즉시 다음 시각으로 넘어간다
+//   (VirtualClock 참여자로 Join 된 뒤 호출해야 한다)
+// - 대기마다 목표 시각 대비 깨어남 지연을 gMixWakeDelayHist 에 기록
+// ──────────────────────────────
+static void RunMixerLoop(const MixKernelOps& mix, const std::atomic<bool>& running)
+{
+	nameThread("mixer");
+	threadCyclesPerNs();								// cycle 환산 비율 보정 (첫 tick 비용에 섞이지 않게 미리)
+	ClockParticipant participant(*gPipelineClock);
+
+	// governor 에 쉬는 시간으로 넘긴 마지막 시각 : 실제 tick 과 그 뒤 MIX_TICK_MS 대기는 tick 하나로 이미 세므로 건너뛴다
+	int64_t idleFromNs = gPipelineClock->NowNs();
+	while (running)
+	{
+		// 직전 확인 이후 어떤 tick 도 덮지 않은 시간을 먼저 넘기고, 믹싱 큐가 비어 있으면 짧게 대기 후 재확인
+		const int64_t startNs = gPipelineClock->NowNs();
+		gMixGovernor.Idle(startNs - idleFromNs);
+		idleFromNs = startNs;
+		const bool idle = MixTick(mix) == 0;
+		const int sleepMs = idle ? MIX_IDLE_MS : MIX_TICK_MS;
+
+		const int64_t wakeNs = gPipelineClock->NowNs() + sleepMs * 1000000LL;
+		gPipelineClock->SleepUntil(wakeNs);
+		const int64_t wokeNs = gPipelineClock->NowNs();
+		gMixWakeDelayHist.Record((uint64_t)(std::max)((int64_t)0, wokeNs - wakeNs));
+		if (!idle)
+			idleFromNs = wokeNs;
+	}
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipeline.h"
+
+// ──────────────────────────────
+// 가상 시간 파이프라인 시험 도구 공용 (AllocCheck, Soak)
+// - 서버 파이프라인을 소켓 없이 VirtualClock 으로 구동 : 공급 스레드(호출자)가 IngestFrame 후 Tick,
+//   믹서 스레드가 RunMixerLoop 로 믹싱 / 팬아웃, 공급 스레드가 drainClient 로 송신 큐를 비운다
+// ──────────────────────────────
+
+// "--key value" 쌍만 받는 인자 해석 : apply(key, value) 가 false 면 사용법 오류
+template <typename Apply>
+static bool parseArgPairs(int argc, char* argv[], Apply apply)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string key = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		if (!apply(key, std::string(argv[++i])))
+			return false;
+	}
+	return true;
+}
+
+// 시험 입력 톤 프레임 (baseHz + stepHz * i, 진폭 200, 스테레오 같은 값)
+static std::vector<std::vector<char>> makeToneFrames(size_t count, double baseHz, double stepHz)
+{
+	std::vector<std::vector<char>> tones(count, std::vector<char>(AUDIO_BUFFER_SIZE));
+	for (size_t t = 0; t < count; t++)
+	{
+		int16_t* pcm = (int16_t*)tones[t].data();
+		for (size_t n = 0; n < MIX_FRAME_SAMPLES; n++)
+			pcm[n] = (int16_t)(200 * std::sin(2.0 * 3.14159265358979 * (baseHz + stepHz * t) * (n / 2) / 48000.0));
+	}
+	return tones;
+}
+
+// 제어 프레임 한 개 (루프 밖에서 한 번 만들어 되풀이 IngestFrame)
+struct HarnessCtrlFrame
+{
+	char data[CTRL_MAX_FRAME];
+	uint32_t len = 0;
+};
+
+// 무음 진입 DTX : 클라이언트 / LoadGen 과 같은 buildDtxFrame (잡음 레벨은 네트워크 바이트 순서)
+static HarnessCtrlFrame makeDtxFrame(float noiseDb = -60.0f)
+{
+	HarnessCtrlFrame f;
+	f.len = buildDtxFrame(f.data, noiseDb);
+	return f;
+}
+
+// 송신 스레드 대역 : 큐를 비우며 바로 보낸 것으로 계산 (record 가 있으면 수신 ~ 송신 지연 기록)
+static void drainClient(ClientInfo& cli, LatencyHistogram* record = nullptr)
+{
+	OutPacket packet;
+	while (PopPacket(cli, packet, false))
+	{
+		const int64_t now = pipelineNowNs();
+		AccountSent(cli, packet, now, now);
+		if (record && packet.originNs != 0)
+			record->Record((uint64_t)(now - packet.originNs));
+	}
+}
+
+// ──────────────────────────────
+// VirtualPipeline
+// - VirtualClock 을 gPipelineClock 으로 걸고 공급자(Start 를 부른 스레드)와 믹서 스레드를 참여시킨다
+// - Tick : 공급자가 한 tick 잠든다 (믹서가 그 사이 MixTick, 가상 시간이라 바로 돌아온다)
+//   SleepForMs : tick 과 어긋난 시각에 넣어야 할 때 (믹서 확인 시각과 겹치면 순서가 정해지지 않는다)
+// - Stop : 남은 프레임이 나가도록 두 tick 더 돌린 뒤 믹서를 멈추고 join (Start 와 같은 스레드에서)
+// ──────────────────────────────
+class VirtualPipeline
+{
+public:
+	VirtualPipeline() { gPipelineClock = &mClock; }
+	~VirtualPipeline()
+	{
+		Stop();
+		gPipelineClock = &gSystemClock;
+	}
+
+	VirtualPipeline(const VirtualPipeline&) = delete;
+	VirtualPipeline& operator=(const VirtualPipeline&) = delete;
+
+	void Start(const MixKernelOps& mix)
+	{
+		mClock.Join();						// 공급자 (현재 스레드)
+		mClock.Join();						// 믹서
+		mRunning = true;
+		mMixer = std::thread(RunMixerLoop, std::cref(mix), std::cref(mRunning));
+	}
+
+	void Tick() { mClock.SleepForMs(MIX_TICK_MS); }
+	void SleepForMs(int ms) { mClock.SleepForMs(ms); }
+	int64_t NowNs() { return mClock.NowNs(); }
+
+	void Stop()
+	{
+		if (!mMixer.joinable())
+			return;
+		mClock.SleepForMs(MIX_TICK_MS * 2);
+		mRunning = false;
+		mClock.Leave();						// 공급자가 빠져야 믹서가 마지막 대기에서 깨어난다
+		mMixer.join();
+	}
+
+private:
+	VirtualClock mClock;
+	std::atomic<bool> mRunning{ false };
+	std::thread mMixer;
+};
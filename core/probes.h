@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "core.h"
+#include "trace.h"
+
+// ──────────────────────────────
+// 정적 프로브 (운영 중 프로파일링)
+// - ETW TraceLogging 이벤트 : 프로바이더 "GroupAudioChat.Pipeline"
+//   세션이 이 프로바이더를 켜지 않았으면 TraceLoggingWrite 는 활성 여부 확인 한 번으로 끝난다
+//   (인자 평가 / 기록 없음) -> 운영 빌드에 그대로 두고 필요할 때만 붙는다
+// - 재빌드 / 재시작 없이 수집 :
+//     wpr 또는 tracelog 로 아래 GUID 를 켜거나, PerfView /Providers=*GroupAudioChat.Pipeline
+//   OS 스레드 이름(nameThread)이 같은 트레이스의 CPU 샘플 / 컨텍스트 스위치에 붙는다
+// - 이벤트 (모두 clientId 와 크기 인자)
+//     FrameReceived  : 수신 프레임 하나 (clientId, bytes)
+//     MixTickBegin   : 믹서 tick 시작 (frames)
+//     MixTickEnd     : 믹서 tick 끝 (frames, clients, tickNs)
+//     FrameEnqueued  : 송신 큐 push (clientId, bytes, queueDepth)
+//     FrameDropped   : 백프레셔로 가장 오래된 패킷 버림 (clientId, bytes, queueDepth)
+//     FrameSent      : 송신 완료 (clientId, bytes, sendNs)
+// - 등록은 실행 파일 main 에서 registerProbes / unregisterProbes (등록 전 기록은 버려진다)
+// - GAC_PROBES=0 이면 컴파일 단계에서 제거
+// - 프로바이더 정의가 있으므로 실행 파일마다 .cpp 하나만 include 해야 한다 (alloc_track.h 와 같은 제약)
+// ──────────────────────────────
+#ifndef GAC_PROBES
+#define GAC_PROBES 1
+#endif
+
+#if GAC_PROBES
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+
+// {048B9532-0ACF-4B7C-9B88-3C8DFEAD49C1}
+TRACELOGGING_DEFINE_PROVIDER(gProbeProvider, "GroupAudioChat.Pipeline",
+	(0x048b9532, 0x0acf, 0x4b7c, 0x9b, 0x88, 0x3c, 0x8d, 0xfe, 0xad, 0x49, 0xc1));
+
+// 이벤트 키워드 (세션에서 골라 켤 수 있게 수신 / 믹서 / 송신으로 나눈다)
+#define PROBE_KW_RECV		0x1
+#define PROBE_KW_MIX		0x2
+#define PROBE_KW_SEND		0x4
+
+static bool gProbesRegistered = false;
+#endif
+
+static void registerProbes()
+{
+#if GAC_PROBES
+	if (!gProbesRegistered)
+		gProbesRegistered = SUCCEEDED(TraceLoggingRegister(gProbeProvider));
+#endif
+}
+
+static void unregisterProbes()
+{
+#if GAC_PROBES
+	if (gProbesRegistered)
+		TraceLoggingUnregister(gProbeProvider);
+	gProbesRegistered = false;
+#endif
+}
+
+// ──────────────────────────────
+// 프로브 지점
+// ──────────────────────────────
+static void probeFrameReceived(uint32_t clientId, uint32_t bytes)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "FrameReceived",
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingKeyword(PROBE_KW_RECV),
+		TraceLoggingUInt32(clientId, "clientId"), TraceLoggingUInt32(bytes, "bytes"));
+#else
+	(void)clientId; (void)bytes;
+#endif
+}
+
+static void probeMixTickBegin(uint32_t frames)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "MixTickBegin",
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingKeyword(PROBE_KW_MIX),
+		TraceLoggingUInt32(frames, "frames"));
+#else
+	(void)frames;
+#endif
+}
+
+static void probeMixTickEnd(uint32_t frames, uint32_t clients, int64_t tickNs)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "MixTickEnd",
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingKeyword(PROBE_KW_MIX),
+		TraceLoggingUInt32(frames, "frames"), TraceLoggingUInt32(clients, "clients"),
+		TraceLoggingInt64(tickNs, "tickNs"));
+#else
+	(void)frames; (void)clients; (void)tickNs;
+#endif
+}
+
+static void probeFrameEnqueued(uint32_t clientId, uint32_t bytes, uint32_t queueDepth)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "FrameEnqueued",
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingKeyword(PROBE_KW_MIX),
+		TraceLoggingUInt32(clientId, "clientId"), TraceLoggingUInt32(bytes, "bytes"),
+		TraceLoggingUInt32(queueDepth, "queueDepth"));
+#else
+	(void)clientId; (void)bytes; (void)queueDepth;
+#endif
+}
+
+// 드롭은 드물고 중요하므로 INFO 레벨 (VERBOSE 를 끄고 드롭만 볼 수 있다)
+static void probeFrameDropped(uint32_t clientId, uint32_t bytes, uint32_t queueDepth)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "FrameDropped",
+		TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingKeyword(PROBE_KW_MIX),
+		TraceLoggingUInt32(clientId, "clientId"), TraceLoggingUInt32(bytes, "bytes"),
+		TraceLoggingUInt32(queueDepth, "queueDepth"));
+#else
+	(void)clientId; (void)bytes; (void)queueDepth;
+#endif
+}
+
+static void probeFrameSent(uint32_t clientId, uint32_t bytes, int64_t sendNs)
+{
+#if GAC_PROBES
+	TraceLoggingWrite(gProbeProvider, "FrameSent",
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE), TraceLoggingKeyword(PROBE_KW_SEND),
+		TraceLoggingUInt32(clientId, "clientId"), TraceLoggingUInt32(bytes, "bytes"),
+		TraceLoggingInt64(sendNs, "sendNs"));
+#else
+	(void)clientId; (void)bytes; (void)sendNs;
+#endif
+}
+
+// ──────────────────────────────
+// nameThread
+// - OS 스레드 이름(setThreadName) + trace 타임라인 이름(traceThreadName) 을 같이 설정
+// - 스레드 시작 직후, 첫 trace 이벤트 전에 호출
+// ──────────────────────────────
+static void nameThread(const char* name)
+{
+	setThreadName(name);
+	traceThreadName(name);
+}
@@ -0,0 +1,279 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include "core.h"
+#include "thread_stats.h"
+#include <avrt.h>
+
+#pragma comment(lib, "avrt.lib")
+
+// ──────────────────────────────
+// 미디어 스레드 실시간 스케줄링 / CPU 고정 / 메모리 잠금
+// - 공유 호스트에서 로그 수집이나 예약 작업이 믹서를 선점해 생기는 tick 지터를 줄인다
+// - Linux 의 SCHED_FIFO / SCHED_RR, sched_setaffinity, mlockall 에 해당하는 Windows 기능을 쓴다
+//   RT_SCHED_MMCSS    : 믹서를 MMCSS "Pro Audio" 작업으로 등록 (권한 불필요, 서비스가 우선순위를 올려 준다)
+//   RT_SCHED_HIGH     : 프로세스 HIGH_PRIORITY_CLASS + 믹서 TIME_CRITICAL / 송수신 HIGHEST
+//   RT_SCHED_REALTIME : 프로세스 REALTIME_PRIORITY_CLASS (SeIncreaseBasePriorityPrivilege 필요)
+//                       권한이 없으면 Windows 가 조용히 HIGH 로 낮추므로 GetPriorityClass 로 실제 값을 확인한다
+// - CPU 고정 : 역할별 CPU 목록으로 SetThreadAffinityMask (믹서 / 송수신 스레드)
+// - 메모리 잠금 : 작업 집합 최소 크기를 올린 뒤 (SetProcessWorkingSetSize) 핫 패스 영역을 VirtualLock
+//   mlockall 처럼 프로세스 전체를 잠그는 API 가 없어 미리 건드린 (prefault) 풀 / 스택만 잠근다
+// - 무엇이든 실패하면 그 항목만 건너뛰고 계속 돈다 : 실제로 얻은 값은 gRtReport 에 남겨 출력 / 메트릭으로 보여 준다
+// ──────────────────────────────
+#define RT_PREFAULT_STACK_BYTES (256 * 1024)			// 스레드 시작 시 미리 건드려 잠그는 스택 크기
+#define RT_WORKING_SET_EXTRA (64 * 1024 * 1024)		// 잠금용으로 작업 집합 최소 / 최대에 더하는 크기
+
+enum RtSchedMode
+{
+	RT_SCHED_NONE,
+	RT_SCHED_MMCSS,
+	RT_SCHED_HIGH,
+	RT_SCHED_REALTIME,
+	RT_SCHED_MODE_COUNT
+};
+
+static const char* const kRtSchedModeNames[RT_SCHED_MODE_COUNT] = { "none", "mmcss", "high", "realtime" };
+
+struct RtConfig
+{
+	RtSchedMode mode = RT_SCHED_NONE;
+	DWORD_PTR mixerCpus = 0;							// 0 이면 고정 안 함
+	DWORD_PTR ioCpus = 0;								// 송수신 스레드 (대기 청취자 스레드 포함)
+	bool lockMemory = false;							// 작업 집합 확대 + prefault + VirtualLock
+};
+
+// ──────────────────────────────
+// 실제로 적용된 결과 (메트릭 / 시작 출력용, 락 없이 읽는다)
+// - 역할별 값은 그 역할 스레드가 마지막으로 적용한 결과 (송수신은 스레드가 많아도 설정이 같다)
+// ──────────────────────────────
+struct RtRoleReport
+{
+	std::atomic<int> threads{ 0 };						// 적용을 시도한 스레드 수 (누적)
+	std::atomic<int> priority{ THREAD_PRIORITY_NORMAL };// GetThreadPriority 결과
+	std::atomic<bool> mmcss{ false };
+	std::atomic<uint64_t> affinity{ 0 };				// 적용된 마스크 (0 = 고정 안 함 / 실패)
+	std::atomic<int> failures{ 0 };						// 요청했는데 얻지 못한 항목 수 (누적)
+};
+
+struct RtReport
+{
+	RtSchedMode requested = RT_SCHED_NONE;
+	DWORD priorityClass = 0;							// GetPriorityClass 결과
+	bool workingSetRaised = false;
+	std::atomic<uint64_t> lockedBytes{ 0 };
+	std::atomic<uint64_t> lockFailures{ 0 };
+	RtRoleReport roles[THREAD_ROLE_COUNT];
+};
+
+static RtConfig gRtConfig;
+static RtReport gRtReport;
+
+static const char* rtPriorityClassName(DWORD cls)
+{
+	switch (cls)
+	{
+	case REALTIME_PRIORITY_CLASS: return "realtime";
+	case HIGH_PRIORITY_CLASS: return "high";
+	case ABOVE_NORMAL_PRIORITY_CLASS: return "above_normal";
+	case NORMAL_PRIORITY_CLASS: return "normal";
+	case BELOW_NORMAL_PRIORITY_CLASS: return "below_normal";
+	case IDLE_PRIORITY_CLASS: return "idle";
+	default: return "unknown";
+	}
+}
+
+static bool parseRtSchedMode(const std::string& s, RtSchedMode& out)
+{
+	for (int m = 0; m < RT_SCHED_MODE_COUNT; m++)
+	{
+		if (s == kRtSchedModeNames[m])
+		{
+			out = (RtSchedMode)m;
+			return true;
+		}
+	}
+	return false;
+}
+
+// "0,2-3" 형식 CPU 목록 -> 마스크 (범위 밖 / 형식 오류면 false)
+static bool parseCpuList(const std::string& s, DWORD_PTR& mask)
+{
+	const int maxCpu = (int)(sizeof(DWORD_PTR) * 8);
+	mask = 0;
+	size_t pos = 0;
+	while (pos < s.size())
+	{
+		size_t end = s.find(',', pos);
+		if (end == std::string::npos)
+			end = s.size();
+		const std::string item = s.substr(pos, end - pos);
+		pos = end + 1;
+
+		if (item.empty() || item.find_first_not_of("0123456789-") != std::string::npos)
+			return false;
+
+		int lo = 0, hi = 0;
+		const size_t dash = item.find('-');
+		if (dash == std::string::npos)
+			lo = hi = std::atoi(item.c_str());
+		else
+		{
+			lo = std::atoi(item.substr(0, dash).c_str());
+			hi = std::atoi(item.substr(dash + 1).c_str());
+		}
+		if (lo < 0 || hi < lo || hi >= maxCpu)
+			return false;
+		for (int c = lo; c <= hi; c++)
+			mask |= (DWORD_PTR)1 << c;
+	}
+	return mask != 0;
+}
+
+// ──────────────────────────────
+// 메모리 잠금
+// - lockMemory 일 때만, 실패는 세기만 한다 (작업 집합 한도에 걸리면 잠그지 못한 채로 돈다)
+// - 해제하지 않는다 : 잠근 영역은 프로세스가 끝날 때까지 쓰는 풀 / 스택
+// ──────────────────────────────
+static void rtLockRegion(const void* p, size_t bytes)
+{
+	if (!gRtConfig.lockMemory || !p || bytes == 0)
+		return;
+
+	if (VirtualLock((LPVOID)p, bytes))
+		gRtReport.lockedBytes.fetch_add(bytes, std::memory_order_relaxed);
+	else
+		gRtReport.lockFailures.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 스택 prefault : 지금 쓰는 위치 아래 RT_PREFAULT_STACK_BYTES 를 건드려 커밋하고 잠근다
+// (인라인되면 호출 측 프레임이 커지므로 막는다)
+static __declspec(noinline) void rtPrefaultStack()
+{
+	volatile char probe[RT_PREFAULT_STACK_BYTES];
+	for (size_t i = 0; i < sizeof(probe); i += 4096)
+		probe[i] = 0;
+	probe[sizeof(probe) - 1] = 0;
+	rtLockRegion((const void*)probe, sizeof(probe));
+}
+
+// ──────────────────────────────
+// rtApplyProcess
+// - 프로세스 단위 설정 (스레드 시작 전에 한 번) : 우선순위 클래스, 작업 집합
+// - 결과를 gRtReport 에 남기고 한 줄로 출력
+// ──────────────────────────────
+static void rtApplyProcess(const RtConfig& cfg, std::ostream& os)
+{
+	gRtConfig = cfg;
+	gRtReport.requested = cfg.mode;
+
+	HANDLE process = GetCurrentProcess();
+	if (cfg.mode == RT_SCHED_REALTIME)
+		SetPriorityClass(process, REALTIME_PRIORITY_CLASS);
+	else if (cfg.mode == RT_SCHED_HIGH)
+		SetPriorityClass(process, HIGH_PRIORITY_CLASS);
+	gRtReport.priorityClass = GetPriorityClass(process);
+
+	if (cfg.lockMemory)
+	{
+		SIZE_T minWs = 0, maxWs = 0;
+		if (GetProcessWorkingSetSize(process, &minWs, &maxWs))
+			gRtReport.workingSetRaised = SetProcessWorkingSetSize(process, minWs + RT_WORKING_SET_EXTRA, maxWs + RT_WORKING_SET_EXTRA) != 0;
+	}
+
+	os << "[rt] 요청 " << kRtSchedModeNames[cfg.mode] << " -> 프로세스 우선순위 클래스 "
+		<< rtPriorityClassName(gRtReport.priorityClass);
+	if (cfg.mode == RT_SCHED_REALTIME && gRtReport.priorityClass != REALTIME_PRIORITY_CLASS)
+		os << " (realtime 권한 없음, 낮춰서 적용)";
+	if (cfg.lockMemory)
+		os << " / 작업 집합 확대 " << (gRtReport.workingSetRaised ? "성공" : "실패 (잠금이 일부 실패할 수 있음)");
+	os << std::endl;
+}
+
+// ──────────────────────────────
+// RtThreadScope
+// - 미디어 스레드 시작 시 생성 : 우선순위 / MMCSS / CPU 고정 / 스택 prefault + 잠금
+// - 믹서는 MMCSS 와 TIME_CRITICAL, 송수신 스레드는 한 단계 낮게 (MMCSS 는 믹서만 : 접속마다 등록하지 않는다)
+// - 소멸 시 MMCSS 등록만 되돌린다 (스레드가 끝나는 시점이라 우선순위 / 마스크는 그대로 둔다)
+// ──────────────────────────────
+class RtThreadScope
+{
+public:
+	explicit RtThreadScope(ThreadRole role)
+	{
+		const RtConfig& cfg = gRtConfig;
+		RtRoleReport& r = gRtReport.roles[role];
+		const bool mixer = role == THREAD_ROLE_MIXER;
+		const bool io = role == THREAD_ROLE_SEND || role == THREAD_ROLE_RECV || role == THREAD_ROLE_PARK;
+		if (!mixer && !io)
+			return;
+		r.threads.fetch_add(1, std::memory_order_relaxed);
+
+		// 1. 우선순위
+		int priority = THREAD_PRIORITY_NORMAL;
+		if (cfg.mode == RT_SCHED_HIGH || cfg.mode == RT_SCHED_REALTIME)
+			priority = mixer ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+		else if (cfg.mode == RT_SCHED_MMCSS && io)
+			priority = THREAD_PRIORITY_ABOVE_NORMAL;
+		if (priority != THREAD_PRIORITY_NORMAL && !SetThreadPriority(GetCurrentThread(), priority))
+			r.failures.fetch_add(1, std::memory_order_relaxed);
+
+		// 2. MMCSS (믹서만)
+		if (mixer && cfg.mode == RT_SCHED_MMCSS)
+		{
+			DWORD taskIndex = 0;
+			mMmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+			if (mMmcss)
+				AvSetMmThreadPriority(mMmcss, AVRT_PRIORITY_HIGH);
+			else
+				r.failures.fetch_add(1, std::memory_order_relaxed);
+		}
+		r.mmcss.store(mMmcss != nullptr, std::memory_order_relaxed);
+		r.priority.store(GetThreadPriority(GetCurrentThread()), std::memory_order_relaxed);
+
+		// 3. CPU 고정
+		const DWORD_PTR mask = mixer ? cfg.mixerCpus : cfg.ioCpus;
+		if (mask != 0)
+		{
+			if (SetThreadAffinityMask(GetCurrentThread(), mask) != 0)
+				r.affinity.store((uint64_t)mask, std::memory_order_relaxed);
+			else
+				r.failures.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// 4. 스택 prefault + 잠금 (믹서만 : 송수신 스레드는 접속마다 생겨 잠금 한도를 금방 채운다)
+		if (mixer && cfg.lockMemory)
+			rtPrefaultStack();
+	}
+
+	~RtThreadScope()
+	{
+		if (mMmcss)
+			AvRevertMmThreadCharacteristics(mMmcss);
+	}
+
+	RtThreadScope(const RtThreadScope&) = delete;
+	RtThreadScope& operator=(const RtThreadScope&) = delete;
+
+private:
+	HANDLE mMmcss = nullptr;
+};
+
+// 역할 하나의 적용 결과 한 줄 (예 : "우선순위 15, MMCSS 켜짐, CPU 0x4")
+static void rtDescribeRole(ThreadRole role, std::ostream& os)
+{
+	const RtRoleReport& r = gRtReport.roles[role];
+	char mask[32];
+	snprintf(mask, sizeof(mask), "0x%llx", (unsigned long long)r.affinity.load(std::memory_order_relaxed));
+	os << "우선순위 " << r.priority.load(std::memory_order_relaxed)
+		<< ", MMCSS " << (r.mmcss.load(std::memory_order_relaxed) ? "켜짐" : "꺼짐")
+		<< ", CPU " << (r.affinity.load(std::memory_order_relaxed) ? mask : "고정 안 함")
+		<< ", 잠금 " << gRtReport.lockedBytes.load(std::memory_order_relaxed) / 1024 << "KB";
+	if (r.failures.load(std::memory_order_relaxed) > 0)
+		os << " (요청 중 " << r.failures.load(std::memory_order_relaxed) << "개 실패)";
+}
@@ -0,0 +1,145 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "core.h"
+
+// ──────────────────────────────
+// 캐시 라인 크기
+// - head / tail 을 서로 다른 라인에 두어 생산자/소비자 간 false sharing 방지
+// ──────────────────────────────
+#define CACHE_LINE_SIZE 64
+
+// ──────────────────────────────
+// SpscRing
+// - 단일 생산자 / 단일 소비자 전용 lock-free 링 버퍼
+// - 용량 N 은 2의 거듭제곱이어야 한다 (인덱스를 마스킹으로 계산)
+// - head/tail 은 계속 증가하는 카운터이므로 N 개를 모두 채울 수 있다
+// - 생산자는 TryPush 만, 소비자는 TryPop 만 호출해야 한다
+// ──────────────────────────────
+template <typename T, size_t N>
+class SpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+	// 생산자 : 가득 차 있으면 false
+	bool TryPush(const T& v)
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) >= N)
+			return false;
+
+		mSlots[tail & (N - 1)] = v;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 소비자 : 비어 있으면 false
+	bool TryPop(T& out)
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+
+		out = mSlots[head & (N - 1)];
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 대략적인 적재 수 (모니터링 용도, 어느 스레드에서든 호출 가능)
+	size_t Size() const
+	{
+		return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+	}
+
+	bool Empty() const { return Size() == 0; }
+
+	static constexpr size_t Capacity() { return N; }
+
+private:
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> mHead{ 0 };	// 소비자 전용
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> mTail{ 0 };	// 생산자 전용
+	alignas(CACHE_LINE_SIZE) T mSlots[N];
+};
+
+// ──────────────────────────────
+// AudioFrame
+// - 풀에서 재사용되는 고정 크기 오디오 프레임 (힙 할당 없음)
+// - len 은 실제 유효 바이트 수
+// - originNs / queuedNs : 단계별 지연 계측용 시각 (client_stats.h, 0 이면 계측하지 않는 프레임)
+// ──────────────────────────────
+struct AudioFrame
+{
+	uint32_t len = 0;
+	int64_t originNs = 0;								// 송신 : 캡처 버퍼 완료, 수신 : recvFrame 완료
+	int64_t queuedNs = 0;								// 채널 Publish 시각
+	char data[AUDIO_BUFFER_SIZE];
+};
+
+// ──────────────────────────────
+// FrameChannel
+// - 고정 개수의 AudioFrame 을 미리 만들어 두고 두 개의 SPSC 링으로 순환시킨다
+//   1. mFree : 소비자 → 생산자 (다 쓴 프레임 반납)
+//   2. mFull : 생산자 → 소비자 (채워진 프레임 전달)
+// - 생산자 : Acquire → (데이터 채우기) → Publish
+// - 소비자 : Consume → (사용) → Release
+// - Acquire 가 nullptr 이면 소비자가 밀린 상태 → 호출 측에서 프레임 drop 처리
+// ──────────────────────────────
+template <size_t N>
+class FrameChannel
+{
+public:
+	FrameChannel()
+	{
+		for (size_t i = 0; i < N; i++)
+			mFree.TryPush(&mFrames[i]);
+	}
+
+	FrameChannel(const FrameChannel&) = delete;
+	FrameChannel& operator=(const FrameChannel&) = delete;
+
+	// 생산자 측
+	AudioFrame* Acquire()
+	{
+		AudioFrame* f = nullptr;
+		return mFree.TryPop(f) ? f : nullptr;
+	}
+	void Publish(AudioFrame* f) { mFull.TryPush(f); }
+
+	// 소비자 측
+	AudioFrame* Consume()
+	{
+		AudioFrame* f = nullptr;
+		return mFull.TryPop(f) ? f : nullptr;
+	}
+	void Release(AudioFrame* f) { mFree.TryPush(f); }
+
+	// 최신 프레임만 꺼내고 나머지는 즉시 반납 (실시간 음성 : 오래된 프레임은 의미 없음)
+	// skipped 에는 버린 프레임 수를 누적한다
+	AudioFrame* ConsumeLatest(size_t& skipped)
+	{
+		AudioFrame* latest = Consume();
+		if (!latest)
+			return nullptr;
+
+		AudioFrame* next = nullptr;
+		while ((next = Consume()) != nullptr)
+		{
+			Release(latest);
+			latest = next;
+			skipped++;
+		}
+		return latest;
+	}
+
+	// 소비자 대기 중인 프레임 수
+	size_t Pending() const { return mFull.Size(); }
+
+private:
+	AudioFrame mFrames[N];
+	SpscRing<AudioFrame*, N> mFree;
+	SpscRing<AudioFrame*, N> mFull;
+};
@@ -0,0 +1,240 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "core.h"
+
+// ──────────────────────────────
+// 공유 메모리 통계 세그먼트
+// - 서버가 카운터 / 게이지 / 클라이언트별 큐 깊이를 이름 있는 파일 매핑에 주기적으로 복사하고
+//   StatTop 같은 읽기 도구가 시스템 호출 없이 (매핑 후에는 메모리 읽기만) 수 ms 간격으로 읽는다
+// - 쓰는 쪽은 서버의 게시 스레드 하나뿐 : 핫 패스(수신 / 믹서 / 송신)는 이 세그먼트를 모른다
+// - seqlock : 쓰기 전에 seq 를 홀수로, 다 쓰면 짝수로 올린다
+//   읽는 쪽은 seq 가 짝수이고 복사 전후 값이 같을 때만 스냅샷을 받아들인다 (쓰는 쪽은 기다리지 않음)
+// - 버전 : 헤더(magic / version / 크기)는 생성 때 한 번만 쓰고, 배치가 바뀌면 STATS_SHM_VERSION 을 올린다
+//   읽는 쪽은 magic / version / payloadBytes 가 다르면 붙지 않는다
+// - 게시 주기(periodMs)도 헤더에 적는다 : 읽는 쪽은 주기의 STATS_SHM_STALE_PERIODS 배 동안 게시가 없으면 멈춘 것으로 본다
+// - 읽기 재시도는 STATS_SHM_READ_RETRIES 번까지 : 쓰는 쪽이 쓰다가 죽거나 멈춰 seq 가 홀수로 남아도 읽는 쪽은 돌아온다
+// - 이름 기본값 "Local\GroupAudioChat.Stats" (같은 로그온 세션), 서버 / 도구 모두 --shm-name 으로 바꿀 수 있다
+// ──────────────────────────────
+#define STATS_SHM_MAGIC 0x53434147u						// "GACS"
+#define STATS_SHM_VERSION 2
+#define STATS_SHM_MAX_CLIENTS 1024						// 넘는 클라이언트는 clientsTotal 에만 센다
+#define STATS_SHM_DEFAULT_NAME L"Local\\GroupAudioChat.Stats"
+#define STATS_SHM_READ_RETRIES 100000					// 게시 한 번은 memcpy 하나라 정상이면 몇 번 안에 끝난다
+#define STATS_SHM_STALE_PERIODS 10						// 게시 주기의 이 배수 동안 게시가 없으면 멈춘 것으로 본다
+#define STATS_SHM_STALE_MIN_MS 1000
+
+struct StatsShmClient
+{
+	uint32_t id;
+	uint32_t talking;
+	uint64_t framesIn;
+	uint64_t bytesIn;
+	uint64_t framesOut;
+	uint64_t bytesOut;
+	uint64_t dropped;
+	uint64_t queueDepth;
+};
+
+// seqlock 으로 보호되는 본문 (읽는 쪽은 통째로 복사)
+struct StatsShmPayload
+{
+	int64_t publishNs;									// 게시 시각 (서버 nowNs, 같은 머신이면 읽는 쪽 nowNs 와 비교 가능)
+	uint64_t publishCount;
+
+	// 누적 카운터
+	uint64_t clientsAccepted;
+	uint64_t clientsRemoved;
+	uint64_t framesReceived;
+	uint64_t ctrlReceived;
+	uint64_t framesMixed;
+	uint64_t framesEnqueued;
+	uint64_t framesSent;
+	uint64_t framesDropped;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	uint64_t mixTicks;
+	uint64_t tickOverruns;
+	uint64_t tickCpuNs;
+	uint64_t tickOffCpuNs;
+
+	// 믹서 게이지 (마지막 tick)
+	int64_t tickLastNs;
+	int64_t tickMaxNs;
+	int64_t tickLastCpuNs;
+	int64_t tickLastOffCpuNs;
+	int64_t tickLockWaitNs;
+	int64_t mixBatchFrames;
+
+	uint32_t clientsTotal;								// 접속 중인 전체 클라이언트
+	uint32_t clientCount;								// clients[] 에 담긴 수 (최대 STATS_SHM_MAX_CLIENTS)
+	StatsShmClient clients[STATS_SHM_MAX_CLIENTS];
+};
+
+struct StatsShmSegment
+{
+	// 헤더 (생성 시 한 번)
+	uint32_t magic;
+	uint32_t version;
+	uint32_t payloadBytes;
+	uint32_t pid;
+	uint32_t periodMs;									// 게시 주기 (서버 --shm-ms)
+	uint32_t reserved;
+
+	std::atomic<uint64_t> seq;
+
+	alignas(64) StatsShmPayload payload;				// 헤더와 다른 캐시 라인에서 시작
+};
+
+// ──────────────────────────────
+// StatsShmWriter (서버)
+// - Publish 는 게시 스레드에서만 : 로컬 스테이징 버퍼를 채운 뒤 seqlock 구간에서 memcpy 한 번
+// ──────────────────────────────
+class StatsShmWriter
+{
+public:
+	~StatsShmWriter() { Close(); }
+
+	bool Create(const std::wstring& name, uint32_t periodMs)
+	{
+		mMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)sizeof(StatsShmSegment), name.c_str());
+		if (!mMapping)
+			return false;
+
+		mSeg = (StatsShmSegment*)MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, sizeof(StatsShmSegment));
+		if (!mSeg)
+		{
+			Close();
+			return false;
+		}
+
+		// 새 매핑은 0 으로 채워져 있다, magic 은 마지막에 (읽는 쪽은 magic 으로 준비 여부 판단)
+		// 서버 재시작 때 읽는 쪽이 아직 열고 있던 매핑을 다시 받을 수 있으므로 seq 는 0 으로 되돌리지 않고
+		// 이전 서버가 쓰다 멈춘 홀수 값만 짝수로 맞춘다
+		mSeg->version = STATS_SHM_VERSION;
+		mSeg->payloadBytes = (uint32_t)sizeof(StatsShmPayload);
+		mSeg->pid = GetCurrentProcessId();
+		mSeg->periodMs = periodMs;
+		const uint64_t s = mSeg->seq.load(std::memory_order_relaxed);
+		if (s & 1)
+			mSeg->seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		mSeg->magic = STATS_SHM_MAGIC;
+		return true;
+	}
+
+	void Close()
+	{
+		if (mSeg)
+			UnmapViewOfFile(mSeg);
+		if (mMapping)
+			CloseHandle(mMapping);
+		mSeg = nullptr;
+		mMapping = nullptr;
+	}
+
+	bool IsOpen() const { return mSeg != nullptr; }
+
+	void Publish(const StatsShmPayload& p)
+	{
+		// 클라이언트 배열은 채운 만큼만 복사
+		const size_t bytes = offsetof(StatsShmPayload, clients) + p.clientCount * sizeof(StatsShmClient);
+		const uint64_t s = mSeg->seq.load(std::memory_order_relaxed);
+		mSeg->seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&mSeg->payload, &p, bytes);
+		mSeg->seq.store(s + 2, std::memory_order_release);
+	}
+
+private:
+	HANDLE mMapping = nullptr;
+	StatsShmSegment* mSeg = nullptr;
+};
+
+// ──────────────────────────────
+// StatsShmReader (도구)
+// - Read : 일관된 스냅샷을 얻을 때까지 재시도 (쓰기 구간은 memcpy 하나라 거의 재시도 없음)
+//   STATS_SHM_READ_RETRIES 번 안에 못 얻으면 false (쓰는 쪽이 게시 도중 멈춤 : 오래된 스냅샷처럼 다룬다)
+// ──────────────────────────────
+class StatsShmReader
+{
+public:
+	~StatsShmReader() { Close(); }
+
+	// 반환 : 0 성공, 1 세그먼트 없음 (서버 미실행), 2 버전 / 크기 불일치
+	int Open(const std::wstring& name)
+	{
+		mMapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+		if (!mMapping)
+			return 1;
+
+		mSeg = (const StatsShmSegment*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, sizeof(StatsShmSegment));
+		if (!mSeg)
+		{
+			Close();
+			return 1;
+		}
+
+		if (mSeg->magic != STATS_SHM_MAGIC || mSeg->version != STATS_SHM_VERSION || mSeg->payloadBytes != sizeof(StatsShmPayload))
+		{
+			Close();
+			return 2;
+		}
+		return 0;
+	}
+
+	void Close()
+	{
+		if (mSeg)
+			UnmapViewOfFile(mSeg);
+		if (mMapping)
+			CloseHandle(mMapping);
+		mSeg = nullptr;
+		mMapping = nullptr;
+	}
+
+	uint32_t ServerPid() const { return mSeg ? mSeg->pid : 0; }
+	uint32_t PeriodMs() const { return mSeg ? mSeg->periodMs : 0; }
+
+	// 게시가 이 시간 넘게 없으면 멈춘 서버 (ns)
+	int64_t StaleNs() const
+	{
+		const int64_t ms = (std::max)((int64_t)STATS_SHM_STALE_MIN_MS, (int64_t)PeriodMs() * STATS_SHM_STALE_PERIODS);
+		return ms * 1000000LL;
+	}
+
+	// retries : 쓰는 중이던 스냅샷을 버린 횟수, 재시도 한도를 넘으면 false
+	bool Read(StatsShmPayload& out, uint32_t& retries) const
+	{
+		retries = 0;
+		while (retries < STATS_SHM_READ_RETRIES)
+		{
+			const uint64_t s1 = mSeg->seq.load(std::memory_order_acquire);
+			if ((s1 & 1) == 0)
+			{
+				memcpy(&out, (const void*)&mSeg->payload, offsetof(StatsShmPayload, clients));
+				const uint32_t n = (std::min)(out.clientCount, (uint32_t)STATS_SHM_MAX_CLIENTS);
+				memcpy(out.clients, (const void*)mSeg->payload.clients, n * sizeof(StatsShmClient));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (mSeg->seq.load(std::memory_order_relaxed) == s1)
+				{
+					out.clientCount = n;
+					return true;
+				}
+			}
+			retries++;
+			YieldProcessor();
+		}
+		return false;
+	}
+
+private:
+	HANDLE mMapping = nullptr;
+	const StatsShmSegment* mSeg = nullptr;
+};
@@ -0,0 +1,274 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "core.h"
+#include <winternl.h>
+
+// ──────────────────────────────
+// 스레드별 CPU / 스케줄링 계측
+// - tick 벽시계 시간만으로는 "믹서가 느린지" 와 "CPU 를 못 받는지" 를 구분할 수 없어서
+//   역할(믹서 / accept / 송신 / 수신 / 통계 / 메트릭 / 공유 메모리 게시 / 대기 청취자)별 스레드 CPU 시간과 컨텍스트 스위치를 센다
+// - CPU 시간   : GetThreadTimes (user / kernel, 100ns 단위지만 실제 갱신은 스케줄러 tick 단위라 누적값만 의미 있음)
+// - CPU cycle  : QueryThreadCycleTime (정밀, tick 하나의 on-CPU 시간도 잴 수 있다)
+// - 컨텍스트 스위치 : NtQuerySystemInformation(SystemProcessInformation) 의 스레드별 ContextSwitches
+//   Windows 는 자발적 / 비자발적을 나누지 않는다 (합계만)
+// - 스케줄러 대기(run queue)는 Windows 에 schedstat 같은 카운터가 없어 믹서에서 간접으로 잰다
+//   (pipeline.h : tick 의 off-CPU 시간 = 벽시계 - cycle 환산 CPU, 깨어남 지연 = 실제 기상 - 목표 시각)
+// - 스레드는 시작 시 ThreadStatsScope 로 등록, 종료 시 최종값을 역할별 누적에 합친다
+//   (종료 스레드의 컨텍스트 스위치는 마지막 수집 시점 값까지)
+// ──────────────────────────────
+enum ThreadRole
+{
+	THREAD_ROLE_MIXER,
+	THREAD_ROLE_ACCEPT,
+	THREAD_ROLE_SEND,
+	THREAD_ROLE_RECV,
+	THREAD_ROLE_STATS,
+	THREAD_ROLE_METRICS,
+	THREAD_ROLE_PUBLISH,
+	THREAD_ROLE_PARK,
+	THREAD_ROLE_COUNT
+};
+
+static const char* const kThreadRoleNames[THREAD_ROLE_COUNT] = { "mixer", "accept", "send", "recv", "stats", "metrics", "shm", "park" };
+
+struct ThreadCpuSample
+{
+	uint64_t userNs = 0;
+	uint64_t kernelNs = 0;
+	uint64_t cycles = 0;
+	uint64_t contextSwitches = 0;
+
+	void Add(const ThreadCpuSample& o)
+	{
+		userNs += o.userNs;
+		kernelNs += o.kernelNs;
+		cycles += o.cycles;
+		contextSwitches += o.contextSwitches;
+	}
+};
+
+// 현재 스레드 누적 cycle
+static uint64_t threadCyclesNow()
+{
+	ULONG64 cycles = 0;
+	QueryThreadCycleTime(GetCurrentThread(), &cycles);
+	return (uint64_t)cycles;
+}
+
+// ──────────────────────────────
+// cycle -> ns 환산 비율
+// - QueryThreadCycleTime 은 TSC 기준이라 고정 비율, 처음 쓸 때 5ms 씩 3 번 바쁜 대기로 잰다
+// - 측정 중 선점되면 비율이 작게 나오므로 최대값
+// ──────────────────────────────
+static double calibrateThreadCycles()
+{
+	double best = 0.0;
+	for (int i = 0; i < 3; i++)
+	{
+		const uint64_t c0 = threadCyclesNow();
+		const int64_t t0 = nowNs();
+		int64_t t1 = t0;
+		while (t1 - t0 < 5000000LL)
+			t1 = nowNs();
+		const uint64_t c1 = threadCyclesNow();
+		best = (std::max)(best, (double)(c1 - c0) / (double)(t1 - t0));
+	}
+	return best > 0.0 ? best : 1.0;
+}
+
+static double threadCyclesPerNs()
+{
+	static const double rate = calibrateThreadCycles();
+	return rate;
+}
+
+// ──────────────────────────────
+// 컨텍스트 스위치
+// - 이 프로세스의 (스레드 ID, 누적 스위치) 목록, 스레드 ID 순 정렬
+// - 시스템 전체 프로세스 목록을 받아오는 호출이라 스크랩 / 통계 주기에서만 쓴다
+// ──────────────────────────────
+typedef NTSTATUS(NTAPI* NtQuerySystemInformationFn)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, ULONG*);
+
+struct ThreadSwitchCount
+{
+	DWORD tid;
+	uint64_t switches;
+};
+
+static std::vector<ThreadSwitchCount> queryContextSwitches()
+{
+	static const NtQuerySystemInformationFn query =
+		(NtQuerySystemInformationFn)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation");
+	std::vector<ThreadSwitchCount> out;
+	if (!query)
+		return out;
+
+	const NTSTATUS kInfoLengthMismatch = (NTSTATUS)0xC0000004L;
+	std::vector<char> buf(256 * 1024);
+	NTSTATUS status;
+	for (;;)
+	{
+		ULONG needed = 0;
+		status = query(SystemProcessInformation, buf.data(), (ULONG)buf.size(), &needed);
+		if (status != kInfoLengthMismatch)
+			break;
+		buf.resize((std::max)((size_t)needed, buf.size()) + 64 * 1024);
+	}
+	if (status < 0)
+		return out;
+
+	const DWORD pid = GetCurrentProcessId();
+	const char* p = buf.data();
+	for (;;)
+	{
+		const SYSTEM_PROCESS_INFORMATION* proc = (const SYSTEM_PROCESS_INFORMATION*)p;
+		if ((DWORD)(ULONG_PTR)proc->UniqueProcessId == pid)
+		{
+			// 스레드 배열은 프로세스 항목 바로 뒤, Reserved3 가 ContextSwitches
+			const SYSTEM_THREAD_INFORMATION* threads = (const SYSTEM_THREAD_INFORMATION*)(proc + 1);
+			for (ULONG i = 0; i < proc->NumberOfThreads; i++)
+				out.push_back({ (DWORD)(ULONG_PTR)threads[i].ClientId.UniqueThread, (uint64_t)threads[i].Reserved3 });
+			break;
+		}
+		if (proc->NextEntryOffset == 0)
+			break;
+		p += proc->NextEntryOffset;
+	}
+
+	std::sort(out.begin(), out.end(), [](const ThreadSwitchCount& a, const ThreadSwitchCount& b) {
+		return a.tid < b.tid;
+	});
+	return out;
+}
+
+// ──────────────────────────────
+// 스레드 목록
+// - 등록 / 해제 / 수집만 gThreadStatsMutex 를 잡는다 (스레드 시작 / 종료, 스크랩 주기)
+// ──────────────────────────────
+struct ThreadStatsEntry
+{
+	ThreadRole role;
+	DWORD tid;
+	HANDLE handle;
+	uint64_t lastSwitches;								// 마지막 수집 때 본 값
+};
+
+static std::mutex gThreadStatsMutex;
+static std::vector<ThreadStatsEntry> gThreadStatsLive;
+static ThreadCpuSample gThreadStatsRetired[THREAD_ROLE_COUNT];
+
+static uint64_t fileTimeNs(const FILETIME& ft)
+{
+	return ((((uint64_t)ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100;
+}
+
+static ThreadCpuSample sampleThread(HANDLE h)
+{
+	ThreadCpuSample s;
+	FILETIME created, exited, kernel, user;
+	if (GetThreadTimes(h, &created, &exited, &kernel, &user))
+	{
+		s.userNs = fileTimeNs(user);
+		s.kernelNs = fileTimeNs(kernel);
+	}
+	ULONG64 cycles = 0;
+	if (QueryThreadCycleTime(h, &cycles))
+		s.cycles = (uint64_t)cycles;
+	return s;
+}
+
+class ThreadStatsScope
+{
+public:
+	explicit ThreadStatsScope(ThreadRole role)
+		: mTid(GetCurrentThreadId())
+	{
+		HANDLE h = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, mTid);
+		if (!h)
+			return;
+
+		std::lock_guard<std::mutex> lock(gThreadStatsMutex);
+		gThreadStatsLive.push_back({ role, mTid, h, 0 });
+	}
+
+	~ThreadStatsScope()
+	{
+		std::lock_guard<std::mutex> lock(gThreadStatsMutex);
+		for (size_t i = 0; i < gThreadStatsLive.size(); i++)
+		{
+			ThreadStatsEntry& e = gThreadStatsLive[i];
+			if (e.tid != mTid)
+				continue;
+
+			ThreadCpuSample s = sampleThread(e.handle);
+			s.contextSwitches = e.lastSwitches;
+			gThreadStatsRetired[e.role].Add(s);
+			CloseHandle(e.handle);
+			gThreadStatsLive[i] = gThreadStatsLive.back();
+			gThreadStatsLive.pop_back();
+			break;
+		}
+	}
+
+	ThreadStatsScope(const ThreadStatsScope&) = delete;
+	ThreadStatsScope& operator=(const ThreadStatsScope&) = delete;
+
+private:
+	DWORD mTid;
+};
+
+// ──────────────────────────────
+// 역할별 수집 (살아 있는 스레드 + 종료 누적)
+// ──────────────────────────────
+struct ThreadRoleReport
+{
+	int threads = 0;									// 살아 있는 스레드 수
+	ThreadCpuSample total;
+};
+
+static void collectThreadStats(ThreadRoleReport (&out)[THREAD_ROLE_COUNT])
+{
+	const std::vector<ThreadSwitchCount> switches = queryContextSwitches();
+
+	std::lock_guard<std::mutex> lock(gThreadStatsMutex);
+	for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+	{
+		out[r] = ThreadRoleReport();
+		out[r].total = gThreadStatsRetired[r];
+	}
+
+	for (ThreadStatsEntry& e : gThreadStatsLive)
+	{
+		auto it = std::lower_bound(switches.begin(), switches.end(), e.tid,
+			[](const ThreadSwitchCount& s, DWORD tid) { return s.tid < tid; });
+		if (it != switches.end() && it->tid == e.tid)
+			e.lastSwitches = it->switches;
+
+		ThreadCpuSample s = sampleThread(e.handle);
+		s.contextSwitches = e.lastSwitches;
+		out[e.role].threads++;
+		out[e.role].total.Add(s);
+	}
+}
+
+static void printThreadStats(std::ostream& os)
+{
+	ThreadRoleReport roles[THREAD_ROLE_COUNT];
+	collectThreadStats(roles);
+
+	os << "  role      threads   user(s) kernel(s)   Gcycles    ctx-switch" << std::endl;
+	for (int r = 0; r < THREAD_ROLE_COUNT; r++)
+	{
+		const ThreadCpuSample& t = roles[r].total;
+		char line[160];
+		snprintf(line, sizeof(line), "  %-9s %7d %9.2f %9.2f %9.2f %13llu", kThreadRoleNames[r], roles[r].threads,
+			t.userNs / 1e9, t.kernelNs / 1e9, t.cycles / 1e9, (unsigned long long)t.contextSwitches);
+		os << line << std::endl;
+	}
+}
@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "core.h"
+
+// ──────────────────────────────
+// 시계 동기화 (NTP 방식 ping / pong)
+// - 클라이언트가 CTRL_TIME_PING(t1 : 클라이언트 송신)을 보내면 서버는 수신 시각 t2 와
+//   송신 스레드가 보내기 직전 시각 t3 를 채운 CTRL_TIME_PONG 으로 답하고, 클라이언트는 수신 시각 t4 를 잰다
+//     offset = ((t2 - t1) + (t3 - t4)) / 2        서버 시계 - 클라이언트 시계
+//     rtt    = (t4 - t1) - (t3 - t2)              서버 안에 머문 시간(송신 큐 대기 포함)은 뺀다
+// - 소켓 버퍼 / 스케줄링 지연은 한쪽 방향에만 붙어 offset 을 치우치게 하므로
+//   최근 TIME_SYNC_WINDOW 표본 중 rtt 가 가장 작은 표본만 쓴다 (min-RTT 필터)
+// - skew : 걸러낸 표본(최근 TIME_SYNC_HISTORY 개)의 offset 을 시간에 대해 최소제곱 직선으로 맞춘 기울기
+//   표본 구간이 TIME_SYNC_SKEW_SPAN_NS 보다 짧으면 0 으로 두고 마지막 걸러낸 offset 을 그대로 쓴다
+// - 양쪽 시각은 nowNs (단조 시계) 라 offset 은 부팅 시각 차이까지 포함한 큰 값 : 시각 변환에만 쓴다
+// - 클라이언트는 다음 ping 에 자기 추정값(offset / rtt / skew)을 실어 보내고 서버는 클라이언트별로 보관한다
+// - 모든 필드는 네트워크 바이트 오더
+// ──────────────────────────────
+#define TIME_SYNC_INTERVAL_MS 1000						// 정상 ping 주기
+#define TIME_SYNC_BURST_MS 100							// 첫 TIME_SYNC_WINDOW 번은 짧은 간격 (빠른 수렴)
+#define TIME_SYNC_WINDOW 8
+#define TIME_SYNC_HISTORY 32
+#define TIME_SYNC_SKEW_SPAN_NS 10000000000LL			// skew 추정에 필요한 최소 구간 (10초)
+
+static uint64_t hostToNet64(uint64_t v)
+{
+	return ((uint64_t)htonl((uint32_t)v) << 32) | htonl((uint32_t)(v >> 32));
+}
+
+static uint64_t netToHost64(uint64_t v)
+{
+	return hostToNet64(v);
+}
+
+#pragma pack(push, 1)
+struct TimePingPayload
+{
+	uint32_t seq;
+	int64_t t1;
+	// 클라이언트의 현재 추정값 (synced 가 0 이면 무시)
+	uint8_t synced;
+	int64_t offsetNs;
+	int64_t rttNs;
+	int32_t skewPpb;
+};
+
+struct TimePongPayload
+{
+	uint32_t seq;
+	int64_t t1;											// ping 의 t1 그대로
+	int64_t t2;
+	int64_t t3;											// 송신 직전에 stampTimePong 으로 채운다
+};
+#pragma pack(pop)
+
+// 호스트 바이트 오더 사본
+struct TimePing
+{
+	uint32_t seq = 0;
+	int64_t t1 = 0;
+	bool synced = false;
+	int64_t offsetNs = 0;
+	int64_t rttNs = 0;
+	int32_t skewPpb = 0;
+};
+
+struct TimePong
+{
+	uint32_t seq = 0;
+	int64_t t1 = 0;
+	int64_t t2 = 0;
+	int64_t t3 = 0;
+};
+
+static uint32_t buildTimePingFrame(char* out, const TimePing& ping)
+{
+	TimePingPayload p;
+	p.seq = htonl(ping.seq);
+	p.t1 = (int64_t)hostToNet64((uint64_t)ping.t1);
+	p.synced = ping.synced ? 1 : 0;
+	p.offsetNs = (int64_t)hostToNet64((uint64_t)ping.offsetNs);
+	p.rttNs = (int64_t)hostToNet64((uint64_t)ping.rttNs);
+	p.skewPpb = (int32_t)htonl((uint32_t)ping.skewPpb);
+	return buildCtrlFrame(out, CTRL_TIME_PING, &p, (uint16_t)sizeof(p));
+}
+
+static bool parseTimePing(const char* payload, uint16_t len, TimePing& out)
+{
+	if (len != sizeof(TimePingPayload))
+		return false;
+
+	TimePingPayload p;
+	memcpy(&p, payload, sizeof(p));
+	out.seq = ntohl(p.seq);
+	out.t1 = (int64_t)netToHost64((uint64_t)p.t1);
+	out.synced = p.synced != 0;
+	out.offsetNs = (int64_t)netToHost64((uint64_t)p.offsetNs);
+	out.rttNs = (int64_t)netToHost64((uint64_t)p.rttNs);
+	out.skewPpb = (int32_t)ntohl((uint32_t)p.skewPpb);
+	return true;
+}
+
+// t3 는 0 으로 두고 송신 직전에 stampTimePong 으로 채운다
+static uint32_t buildTimePongFrame(char* out, const TimePing& ping, int64_t t2)
+{
+	TimePongPayload p;
+	p.seq = htonl(ping.seq);
+	p.t1 = (int64_t)hostToNet64((uint64_t)ping.t1);
+	p.t2 = (int64_t)hostToNet64((uint64_t)t2);
+	p.t3 = 0;
+	return buildCtrlFrame(out, CTRL_TIME_PONG, &p, (uint16_t)sizeof(p));
+}
+
+static void stampTimePong(char* frame, int64_t t3)
+{
+	const uint64_t v = hostToNet64((uint64_t)t3);
+	memcpy(frame + sizeof(CtrlHeader) + offsetof(TimePongPayload, t3), &v, sizeof(v));
+}
+
+static bool parseTimePong(const char* payload, uint16_t len, TimePong& out)
+{
+	if (len != sizeof(TimePongPayload))
+		return false;
+
+	TimePongPayload p;
+	memcpy(&p, payload, sizeof(p));
+	out.seq = ntohl(p.seq);
+	out.t1 = (int64_t)netToHost64((uint64_t)p.t1);
+	out.t2 = (int64_t)netToHost64((uint64_t)p.t2);
+	out.t3 = (int64_t)netToHost64((uint64_t)p.t3);
+	return true;
+}
+
+// ──────────────────────────────
+// ClockSync
+// - 클라이언트 NetThread 전용 (한 스레드에서만 쓴다)
+// - AddSample 로 표본을 넣고 OffsetNs / ToServerNs 로 로컬 시각을 서버 시각으로 바꾼다
+// ──────────────────────────────
+class ClockSync
+{
+public:
+	// 반환 : 표본을 받아들였으면 true (rtt 가 음수인 깨진 표본은 버린다)
+	bool AddSample(int64_t t1, int64_t t2, int64_t t3, int64_t t4)
+	{
+		const int64_t rtt = (t4 - t1) - (t3 - t2);
+		if (rtt < 0 || t3 < t2 || t4 < t1)
+			return false;
+
+		Sample s;
+		s.localNs = t1 + (t4 - t1) / 2;
+		s.offsetNs = ((t2 - t1) + (t3 - t4)) / 2;
+		s.rttNs = rtt;
+		mWindow[mSamples % TIME_SYNC_WINDOW] = s;
+		mSamples++;
+
+		// 창 안의 최소 rtt 표본, 이미 쓴 표본보다 새로울 때만 반영
+		const uint32_t n = (std::min)(mSamples, (uint32_t)TIME_SYNC_WINDOW);
+		const Sample* best = &mWindow[0];
+		for (uint32_t i = 1; i < n; i++)
+		{
+			if (mWindow[i].rttNs < best->rttNs)
+				best = &mWindow[i];
+		}
+		mMinRttNs = best->rttNs;
+		if (mFiltered > 0 && best->localNs <= mLastLocalNs)
+			return true;
+
+		mHistory[mFiltered % TIME_SYNC_HISTORY] = *best;
+		mFiltered++;
+		mLastLocalNs = best->localNs;
+		Refit(*best);
+		return true;
+	}
+
+	bool Synced() const { return mFiltered > 0; }
+	uint32_t Samples() const { return mSamples; }
+
+	// 최근 창의 최소 rtt
+	int64_t RttNs() const { return mMinRttNs; }
+
+	// 서버 시계 - 로컬 시계 (localNs 시점, skew 반영)
+	int64_t OffsetNs(int64_t localNs) const
+	{
+		return mAnchorOffsetNs + (int64_t)(mSkew * (double)(localNs - mAnchorLocalNs));
+	}
+
+	int64_t ToServerNs(int64_t localNs) const { return localNs + OffsetNs(localNs); }
+
+	// 로컬 시계 대비 서버 시계가 빠른 정도 (ppm)
+	double SkewPpm() const { return mSkew * 1e6; }
+
+	// 다음 ping 에 실을 추정값
+	void FillPing(TimePing& ping, int64_t localNs) const
+	{
+		ping.synced = Synced();
+		ping.offsetNs = Synced() ? OffsetNs(localNs) : 0;
+		ping.rttNs = mMinRttNs;
+		ping.skewPpb = (int32_t)(mSkew * 1e9);
+	}
+
+private:
+	struct Sample
+	{
+		int64_t localNs = 0;								// t1, t4 중간
+		int64_t offsetNs = 0;
+		int64_t rttNs = 0;
+	};
+
+	// 걸러낸 표본으로 직선 맞춤 (값이 커서 첫 표본 기준 차이로 계산)
+	void Refit(const Sample& latest)
+	{
+		const uint32_t n = (std::min)(mFiltered, (uint32_t)TIME_SYNC_HISTORY);
+		const Sample& base = mHistory[0];
+		int64_t first = latest.localNs;
+		for (uint32_t i = 0; i < n; i++)
+			first = (std::min)(first, mHistory[i].localNs);
+
+		if (n < 3 || latest.localNs - first < TIME_SYNC_SKEW_SPAN_NS)
+		{
+			mSkew = 0.0;
+			mAnchorLocalNs = latest.localNs;
+			mAnchorOffsetNs = latest.offsetNs;
+			return;
+		}
+
+		double mx = 0.0, my = 0.0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			mx += (double)(mHistory[i].localNs - base.localNs);
+			my += (double)(mHistory[i].offsetNs - base.offsetNs);
+		}
+		mx /= n;
+		my /= n;
+
+		double sxy = 0.0, sxx = 0.0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const double dx = (double)(mHistory[i].localNs - base.localNs) - mx;
+			const double dy = (double)(mHistory[i].offsetNs - base.offsetNs) - my;
+			sxy += dx * dy;
+			sxx += dx * dx;
+		}
+		mSkew = sxx > 0.0 ? sxy / sxx : 0.0;
+		mAnchorLocalNs = base.localNs + (int64_t)mx;
+		mAnchorOffsetNs = base.offsetNs + (int64_t)my;
+	}
+
+	Sample mWindow[TIME_SYNC_WINDOW];
+	Sample mHistory[TIME_SYNC_HISTORY];
+	uint32_t mSamples = 0;
+	uint32_t mFiltered = 0;
+	int64_t mLastLocalNs = 0;
+	int64_t mMinRttNs = 0;
+	double mSkew = 0.0;									// 서버 시계 변화 / 로컬 시계 변화 - 1
+	int64_t mAnchorLocalNs = 0;
+	int64_t mAnchorOffsetNs = 0;
+};
@@ -0,0 +1,322 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "core.h"
+#include "spsc_ring.h"
+
+// ──────────────────────────────
+// Chrome / Perfetto trace-event 기록
+// - 스레드마다 SpscRing 하나 (기록 스레드 = 생산자, 플러시 스레드 = 소비자)
+// - 기록 경로는 락/할당 없음, 링이 가득 차면 이벤트를 버리고 개수만 센다
+// - 플러시 스레드가 TRACE_FLUSH_MS 마다 모든 링을 비워 JSON 으로 쓴다
+// - 꺼져 있을 때는 relaxed load 한 번 + 분기뿐 (nowNs 도 호출하지 않음)
+// - GAC_TRACE 를 0 으로 정의하면 기록 함수가 빈 함수가 된다
+// - 출력은 JSON Array 형식 : 비정상 종료로 닫는 ']' 가 빠져도 chrome://tracing,
+//   ui.perfetto.dev 에서 그대로 열린다
+// ──────────────────────────────
+#ifndef GAC_TRACE
+#define GAC_TRACE 1
+#endif
+
+#define TRACE_RING_EVENTS 1024
+#define TRACE_MAX_THREADS 256					// 동시 기록 스레드 수 상한 (초과분은 drop 으로 집계)
+#define TRACE_FLUSH_MS 50
+#define TRACE_NAME_MAX 32
+
+struct TraceEvent
+{
+	int64_t tsNs;
+	int64_t durNs;
+	const char* name;						// 문자열 리터럴만 (포인터만 저장)
+	uint32_t arg;
+	char phase;								// 'X' 구간, 'i' 순간
+};
+
+enum TraceBufferState
+{
+	TRACE_BUF_FREE,
+	TRACE_BUF_CLAIMING,							// 점유 중 (tid/name 채우는 동안 플러시 스레드는 건너뜀)
+	TRACE_BUF_OWNED,
+	TRACE_BUF_RETIRED							// 스레드 종료, 플러시 스레드가 비운 뒤 FREE
+};
+
+struct TraceThreadBuffer
+{
+	std::atomic<int> state{ TRACE_BUF_FREE };
+	std::atomic<uint64_t> dropped{ 0 };
+	uint32_t tid = 0;
+	uint32_t generation = 0;					// 재사용될 때마다 증가 (thread_name 메타데이터 재출력)
+	char name[TRACE_NAME_MAX] = {};
+	SpscRing<TraceEvent, TRACE_RING_EVENTS> ring;
+};
+
+static std::atomic<bool> gTraceOn{ false };
+static TraceThreadBuffer gTraceBuffers[TRACE_MAX_THREADS];
+static std::atomic<uint64_t> gTraceUnbuffered{ 0 };		// 빈 버퍼가 없어 버린 이벤트
+
+static bool traceEnabled()
+{
+#if GAC_TRACE
+	return gTraceOn.load(std::memory_order_relaxed);
+#else
+	return false;
+#endif
+}
+
+// ──────────────────────────────
+// 스레드별 버퍼 연결
+// - 첫 이벤트 때 빈 버퍼를 하나 점유 (CAS), 스레드 종료 시 RETIRED 로 반납
+// ──────────────────────────────
+struct TraceTls
+{
+	TraceThreadBuffer* buf = nullptr;
+	bool exhausted = false;
+	char name[TRACE_NAME_MAX] = {};
+
+	~TraceTls()
+	{
+		if (buf)
+			buf->state.store(TRACE_BUF_RETIRED, std::memory_order_release);
+	}
+};
+
+static TraceTls& traceTls()
+{
+	static thread_local TraceTls tls;
+	return tls;
+}
+
+// 타임라인에 표시할 스레드 이름 (첫 이벤트 전에 호출해야 반영된다)
+static void traceThreadName(const char* name)
+{
+#if GAC_TRACE
+	TraceTls& tls = traceTls();
+	snprintf(tls.name, sizeof(tls.name), "%s", name);
+#else
+	(void)name;
+#endif
+}
+
+static TraceThreadBuffer* traceLocalBuffer()
+{
+	TraceTls& tls = traceTls();
+	if (tls.buf || tls.exhausted)
+		return tls.buf;
+
+	for (auto& b : gTraceBuffers)
+	{
+		int expected = TRACE_BUF_FREE;
+		if (b.state.load(std::memory_order_relaxed) != TRACE_BUF_FREE)
+			continue;
+		if (!b.state.compare_exchange_strong(expected, TRACE_BUF_CLAIMING, std::memory_order_acquire))
+			continue;
+
+		b.tid = (uint32_t)GetCurrentThreadId();
+		b.generation++;
+		if (tls.name[0])
+			memcpy(b.name, tls.name, sizeof(b.name));
+		else
+			snprintf(b.name, sizeof(b.name), "thread-%u", b.tid);
+		b.state.store(TRACE_BUF_OWNED, std::memory_order_release);
+		tls.buf = &b;
+		return tls.buf;
+	}
+
+	tls.exhausted = true;
+	return nullptr;
+}
+
+static void tracePush(const TraceEvent& e)
+{
+	TraceThreadBuffer* b = traceLocalBuffer();
+	if (!b)
+	{
+		gTraceUnbuffered.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (!b->ring.TryPush(e))
+		b->dropped.store(b->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// 시작/끝 시각을 이미 알고 있는 구간 이벤트
+static void traceComplete(const char* name, int64_t startNs, int64_t endNs, uint32_t arg = 0)
+{
+	if (!traceEnabled())
+		return;
+	tracePush(TraceEvent{ startNs, endNs - startNs, name, arg, 'X' });
+}
+
+// 순간 이벤트 (큐 drop 등)
+static void traceInstant(const char* name, uint32_t arg = 0)
+{
+	if (!traceEnabled())
+		return;
+	tracePush(TraceEvent{ nowNs(), 0, name, arg, 'i' });
+}
+
+// ──────────────────────────────
+// TraceScope
+// - 생성 ~ 소멸 구간을 'X' 이벤트 하나로 기록
+// - 꺼져 있으면 시각을 읽지 않는다
+// ──────────────────────────────
+class TraceScope
+{
+public:
+	TraceScope(const char* name, uint32_t arg = 0)
+		: mName(name), mArg(arg), mStartNs(traceEnabled() ? nowNs() : 0)
+	{
+	}
+
+	~TraceScope()
+	{
+		if (mStartNs != 0)
+			traceComplete(mName, mStartNs, nowNs(), mArg);
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	// 중간에 값이 정해지는 인자 (예: 믹싱한 프레임 수)
+	void SetArg(uint32_t arg) { mArg = arg; }
+
+private:
+	const char* mName;
+	uint32_t mArg;
+	int64_t mStartNs;
+};
+
+// ──────────────────────────────
+// TraceSession
+// - Start : 파일을 열고 기록을 켠 뒤 플러시 스레드 시작
+// - Stop  : 기록을 끄고 남은 이벤트를 모두 쓴 뒤 파일 닫기
+// - 프로세스당 하나만 사용
+// ──────────────────────────────
+class TraceSession
+{
+public:
+	~TraceSession() { Stop(); }
+
+	bool Start(const std::string& path)
+	{
+#if GAC_TRACE
+		mOut.open(path, std::ios::binary | std::ios::trunc);
+		if (!mOut)
+			return false;
+
+		mOut << "[\n";
+		mBaseNs = nowNs();
+		mFirst = true;
+		for (auto& g : mSeenGeneration)
+			g = 0;
+
+		mFlushing = true;
+		gTraceOn = true;
+		mThread = std::thread(&TraceSession::FlushLoop, this);
+		return true;
+#else
+		(void)path;
+		return false;
+#endif
+	}
+
+	void Stop()
+	{
+		if (!mThread.joinable())
+			return;
+
+		gTraceOn = false;
+		mFlushing = false;
+		mThread.join();
+
+		// 마지막 드레인 + 버린 이벤트 수 기록
+		uint64_t dropped = gTraceUnbuffered.load();
+		Drain();
+		for (auto& b : gTraceBuffers)
+			dropped += b.dropped.load();
+
+		char line[160];
+		snprintf(line, sizeof(line),
+			"%s{\"name\":\"trace_dropped_events\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"count\":%llu}}\n]\n",
+			mFirst ? "" : ",", (unsigned)GetCurrentProcessId(), (unsigned long long)dropped);
+		mOut << line;
+		mOut.close();
+
+		std::cout << "[trace] 기록 종료 (버린 이벤트 " << dropped << "개)" << std::endl;
+	}
+
+private:
+	void FlushLoop()
+	{
+		setThreadName("trace-flush");
+		while (mFlushing)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_MS));
+			Drain();
+		}
+	}
+
+	void Drain()
+	{
+		const unsigned pid = (unsigned)GetCurrentProcessId();
+		for (int i = 0; i < TRACE_MAX_THREADS; i++)
+		{
+			TraceThreadBuffer& b = gTraceBuffers[i];
+			const int state = b.state.load(std::memory_order_acquire);
+			if (state == TRACE_BUF_FREE || state == TRACE_BUF_CLAIMING)
+				continue;
+
+			if (mSeenGeneration[i] != b.generation)
+			{
+				mSeenGeneration[i] = b.generation;
+				WriteLine("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+					pid, b.tid, b.name);
+			}
+
+			TraceEvent e;
+			while (b.ring.TryPop(e))
+			{
+				const double ts = (e.tsNs - mBaseNs) / 1000.0;
+				if (e.phase == 'X')
+				{
+					WriteLine("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"v\":%u}}",
+						e.name, pid, b.tid, ts, e.durNs / 1000.0, e.arg);
+				}
+				else
+				{
+					WriteLine("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"args\":{\"v\":%u}}",
+						e.name, pid, b.tid, ts, e.arg);
+				}
+			}
+
+			// 종료된 스레드의 버퍼는 비운 뒤 재사용 가능하게 돌려놓는다
+			if (state == TRACE_BUF_RETIRED && b.ring.Empty())
+				b.state.store(TRACE_BUF_FREE, std::memory_order_release);
+		}
+		mOut.flush();
+	}
+
+	template <typename... Args>
+	void WriteLine(const char* fmt, Args... args)
+	{
+		char line[256];
+		snprintf(line, sizeof(line), fmt, args...);
+		if (!mFirst)
+			mOut << ",\n";
+		mOut << line;
+		mFirst = false;
+	}
+
+	std::ofstream mOut;
+	std::thread mThread;
+	std::atomic<bool> mFlushing{ false };
+	int64_t mBaseNs = 0;
+	bool mFirst = true;
+	uint32_t mSeenGeneration[TRACE_MAX_THREADS] = {};
+};
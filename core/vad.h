@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// ──────────────────────────────
+// VAD 기본값
+// ──────────────────────────────
+#define VAD_THRESHOLD_DB 9.0f					// 노이즈 플로어 대비 이 이상 크면 음성
+#define VAD_MIN_SPEECH_DB -50.0f			// 절대 하한 (이보다 작으면 무조건 무음)
+#define VAD_HANGOVER_MS 300					// 음성 종료 후에도 이 시간만큼 송신 유지 (어미 잘림 방지)
+#define VAD_PREROLL_MS 200						// 음성 시작 직전 이 시간만큼 보관했다가 함께 송신 (첫 음절 보존)
+#define VAD_FLOOR_RISE_DB_PER_SEC 3.0f	// 노이즈 플로어 상승 속도 (하강은 즉시)
+
+// ──────────────────────────────
+// 16bit PCM 프레임의 RMS 레벨 (dBFS)
+// - 완전 무음이면 -96 dB 로 고정
+// ──────────────────────────────
+static float FrameLevelDb(const int16_t* samples, size_t count)
+{
+	if (count == 0)
+		return -96.0f;
+
+	double acc = 0.0;
+	for (size_t i = 0; i < count; i++)
+		acc += (double)samples[i] * samples[i];
+
+	double rms = std::sqrt(acc / count) / 32768.0;
+	if (rms < 1.6e-5)
+		return -96.0f;
+
+	return (float)(20.0 * std::log10(rms));
+}
+
+// ──────────────────────────────
+// VoiceActivityDetector
+// - 에너지 기반 VAD + 적응형 노이즈 플로어 + hangover
+// 1. 프레임 레벨이 플로어보다 낮으면 플로어를 즉시 내림
+// 2. 높으면 초당 VAD_FLOOR_RISE_DB_PER_SEC 만큼만 천천히 올림 (말소리에 끌려가지 않게)
+// 3. 레벨 > 플로어 + 임계값 이면 음성, 이후 hangover 프레임 동안 음성 상태 유지
+// - pre-roll 버퍼링은 프레임을 소유한 호출 측에서 PrerollFrames() 만큼 보관한다
+// ──────────────────────────────
+class VoiceActivityDetector
+{
+public:
+	explicit VoiceActivityDetector(float frameMs)
+		: mFrameMs(frameMs)
+	{
+		mHangoverFrames = FramesFor(VAD_HANGOVER_MS);
+		mPrerollFrames = FramesFor(VAD_PREROLL_MS);
+	}
+
+	// 프레임 하나를 판정하고 송신 여부(음성 또는 hangover 중)를 반환
+	bool Process(const int16_t* samples, size_t count)
+	{
+		mLevelDb = FrameLevelDb(samples, count);
+
+		if (mLevelDb < mFloorDb)
+			mFloorDb = mLevelDb;
+		else
+			mFloorDb += VAD_FLOOR_RISE_DB_PER_SEC * mFrameMs / 1000.0f;
+
+		const bool speech = mLevelDb > VAD_MIN_SPEECH_DB && mLevelDb > mFloorDb + VAD_THRESHOLD_DB;
+		if (speech)
+			mHangLeft = mHangoverFrames;
+		else if (mHangLeft > 0)
+			mHangLeft--;
+
+		const bool wasActive = mActive;
+		mActive = speech || mHangLeft > 0;
+		mOnset = mActive && !wasActive;
+		return mActive;
+	}
+
+	bool Active() const { return mActive; }
+	bool Onset() const { return mOnset; }			// 직전 Process 에서 무음 → 음성 전환
+	float LevelDb() const { return mLevelDb; }
+	float NoiseFloorDb() const { return mFloorDb; }
+	int PrerollFrames() const { return mPrerollFrames; }
+
+private:
+	int FramesFor(int ms) const
+	{
+		return mFrameMs > 0.0f ? (int)std::ceil(ms / mFrameMs) : 0;
+	}
+
+	float mFrameMs;
+	int mHangoverFrames = 0;
+	int mPrerollFrames = 0;
+	int mHangLeft = 0;
+	float mLevelDb = -96.0f;
+	float mFloorDb = -60.0f;
+	bool mActive = false;
+	bool mOnset = false;
+};